@@ -10,6 +10,8 @@
 #include "containers/lhmss.h"
 #include "containers/lhmsll.h"
 #include "input/lrec_readers.h"
+#include "input/file_decompressor.h"
+#include "input/read_ahead_stream.h"
 #include "dsl/function_manager.h"
 #include "dsl/mlr_dsl_cst.h"
 #include "mapping/mappers.h"
@@ -159,6 +161,9 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 	int no_input       = FALSE;
 	int have_rand_seed = FALSE;
 	unsigned rand_seed = 0;
+	file_decompression_t file_decompression = FILE_DECOMPRESSION_AUTO;
+	int read_ahead_depth = 0;
+	long long read_ahead_block_size = READ_AHEAD_DEFAULT_BLOCK_SIZE;
 
 	int argi = 1;
 	for (; argi < argc; /* variable increment: 1 or 2 depending on flag */) {
@@ -182,6 +187,10 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 			no_input = TRUE;
 			argi += 1;
 
+		} else if (streq(argv[argi], "--pipeline")) {
+			popts->use_pipeline = TRUE;
+			argi += 1;
+
 		} else if (streq(argv[argi], "--from")) {
 			check_arg_count(argv, argi, argc, 2);
 			slls_append(popts->filenames, argv[argi+1], NO_FREE);
@@ -210,6 +219,47 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 			}
 			argi += 2;
 
+		} else if (streq(argv[argi], "--records-per-batch")) {
+			check_arg_count(argv, argi, argc, 2);
+			if (sscanf(argv[argi+1], "%d", &popts->records_per_batch) != 1 || popts->records_per_batch <= 0) {
+				fprintf(stderr,
+					"%s: --records-per-batch argument must be a positive integer; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			argi += 2;
+
+		} else if (streq(argv[argi], "--gzin")) {
+			file_decompression = FILE_DECOMPRESSION_GZIP;
+			argi += 1;
+
+		} else if (streq(argv[argi], "--zin")) {
+			file_decompression = FILE_DECOMPRESSION_ZLIB;
+			argi += 1;
+
+		} else if (streq(argv[argi], "--read-ahead")) {
+			check_arg_count(argv, argi, argc, 2);
+			if (sscanf(argv[argi+1], "%d", &read_ahead_depth) != 1 || read_ahead_depth < 2) {
+				fprintf(stderr,
+					"%s: --read-ahead argument must be an integer at least 2; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			argi += 2;
+
+		} else if (streq(argv[argi], "--read-ahead-block-size")) {
+			check_arg_count(argv, argi, argc, 2);
+			if (sscanf(argv[argi+1], "%lld", &read_ahead_block_size) != 1 || read_ahead_block_size <= 0) {
+				fprintf(stderr,
+					"%s: --read-ahead-block-size argument must be a positive integer; got \"%s\".\n",
+					MLR_GLOBALS.bargv0, argv[argi+1]);
+				main_usage_short(stderr, MLR_GLOBALS.bargv0);
+				exit(1);
+			}
+			argi += 2;
+
 		} else if (streq(argv[argi], "--seed")) {
 			check_arg_count(argv, argi, argc, 2);
 			if (sscanf(argv[argi+1], "0x%x", &rand_seed) == 1) {
@@ -231,6 +281,15 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 		}
 	}
 
+	// Memory-mapped files are read by page faults, not by read(), so there would
+	// be nothing for the read-ahead thread to do.
+	if (read_ahead_depth > 0 && popts->reader_opts.use_mmap_for_read == NEITHER_TRUE_NOR_FALSE)
+		popts->reader_opts.use_mmap_for_read = FALSE;
+	// Records from memory-mapped files must be freed on the thread which read
+	// them; see input/file_reader_mmap.h.
+	if (popts->use_pipeline)
+		popts->reader_opts.use_mmap_for_read = FALSE;
+
 	cli_apply_defaults(popts);
 
 	lhmss_t* default_rses = get_default_rses();
@@ -287,6 +346,9 @@ cli_opts_t* parse_command_line(int argc, char** argv, sllv_t** ppmapper_list) {
 		exit(1);
 	}
 
+	file_decompressor_set_mode(file_decompression);
+	read_ahead_set_options(read_ahead_depth, read_ahead_block_size);
+
 	if (have_rand_seed) {
 		mtrand_init(rand_seed);
 	} else {
@@ -875,6 +937,14 @@ static void main_usage_compressed_data_options(FILE* o, char* argv0) {
 	fprintf(o, "  utilities. You can use it to apply per-file filters of your choice.\n");
 	fprintf(o, "  For output compression (or other) utilities, simply pipe the output:\n");
 	fprintf(o, "    %s ... | {your compression command}\n", argv0);
+	fprintf(o, "\n");
+	fprintf(o, "  Without --prepipe, gzip-compressed input files are decompressed natively,\n");
+	fprintf(o, "  as are zlib-compressed files whose names end in \".z\". These are recognized by\n");
+	fprintf(o, "  their first few bytes, which can only be done for regular files. For\n");
+	fprintf(o, "  standard input and other pipes, or to override the recognition, use:\n");
+	fprintf(o, "  --gzin              Decompress all input as gzip.\n");
+	fprintf(o, "  --zin               Decompress all input as zlib.\n");
+	fprintf(o, "  These apply to join's left file as well.\n");
 }
 
 static void main_usage_separator_options(FILE* o, char* argv0) {
@@ -979,6 +1049,41 @@ static void main_usage_other_options(FILE* o, char* argv0) {
 	fprintf(o, "                     urand()/urandint()/urand32().\n");
 	fprintf(o, "  --nr-progress-mod {m}, with m a positive integer: print filename and record\n");
 	fprintf(o, "                     count to stderr every m input records.\n");
+	fprintf(o, "  --mmap --no-mmap   Memory-map regular input files (the default), or read\n");
+	fprintf(o, "                     them through stdio. This applies to DKVP, NIDX, CSV-lite,\n");
+	fprintf(o, "                     and PPRINT input; standard input and --prepipe always use\n");
+	fprintf(o, "                     stdio.\n");
+	fprintf(o, "  --nr-threads {n}   Parse regular input files in chunks on n threads, with\n");
+	fprintf(o, "                     records passed to the verb chain in their original order.\n");
+	fprintf(o, "                     This applies to DKVP, NIDX, CSV-lite, CSV, and PPRINT\n");
+	fprintf(o, "                     input with single-character separators, and not with\n");
+	fprintf(o, "                     --pass-comments. Default 1.\n");
+	fprintf(o, "  --read-ahead {n}   Read input on a separate thread, up to n blocks ahead of\n");
+	fprintf(o, "                     the record parser, so that waiting on the disk or network\n");
+	fprintf(o, "                     overlaps with record processing. n must be at least 2.\n");
+	fprintf(o, "                     Implies --no-mmap unless --mmap is given. Does not apply\n");
+	fprintf(o, "                     with --prepipe, whose command already runs alongside\n");
+	fprintf(o, "                     Miller, or to files read with --nr-threads. Default off.\n");
+	fprintf(o, "  --read-ahead-block-size {n} Size in bytes of each read-ahead block.\n");
+	fprintf(o, "                     Default %d.\n", READ_AHEAD_DEFAULT_BLOCK_SIZE);
+	fprintf(o, "  --pipeline         Run each verb in the then-chain, and the record-writer, on\n");
+	fprintf(o, "                     a thread of its own, passing records along in batches.\n");
+	fprintf(o, "                     Output records are the same as without it, but: verbs such\n");
+	fprintf(o, "                     as head may let a few more input records be read before\n");
+	fprintf(o, "                     stopping; output from print, emit > stdout, etc. may be\n");
+	fprintf(o, "                     interleaved differently with the record stream; and\n");
+	fprintf(o, "                     random-number functions, whose generator is shared, are\n");
+	fprintf(o, "                     not reproducible with --seed. Implies --no-mmap.\n");
+	fprintf(o, "                     Default off.\n");
+	fprintf(o, "  --records-per-batch {n} Read up to n records before passing them along the\n");
+	fprintf(o, "                     then-chain together, when each verb in the chain supports\n");
+	fprintf(o, "                     this (cat, cut, head, label, rename, and put/filter without\n");
+	fprintf(o, "                     print, tee, dump, or redirected output). Use 1 to pass\n");
+	fprintf(o, "                     each record along as soon as it is read. Default %d for\n",
+		DEFAULT_RECORDS_PER_BATCH);
+	fprintf(o, "                     regular files, and 1 for standard input from a pipe or\n");
+	fprintf(o, "                     terminal, other non-regular files, and --prepipe, so that\n");
+	fprintf(o, "                     output keeps up with input such as from tail -f.\n");
 	fprintf(o, "  --from {filename}  Use this to specify an input file before the verb(s),\n");
 	fprintf(o, "                     rather than after. May be used more than once. Example:\n");
 	fprintf(o, "                     \"%s --from a.dat --from b.dat cat\" is the same as\n", argv0);
@@ -1089,6 +1194,8 @@ void cli_opts_init(cli_opts_t* popts) {
 	popts->nr_progress_mod = 0LL;
 
 	popts->do_in_place     = FALSE;
+	popts->use_pipeline    = FALSE;
+	popts->records_per_batch = 0;
 }
 
 void cli_reader_opts_init(cli_reader_opts_t* preader_opts) {
@@ -1105,6 +1212,8 @@ void cli_reader_opts_init(cli_reader_opts_t* preader_opts) {
 	preader_opts->allow_ragged_csv_input         = NEITHER_TRUE_NOR_FALSE;
 
 	preader_opts->prepipe                        = NULL;
+	preader_opts->use_mmap_for_read              = NEITHER_TRUE_NOR_FALSE;
+	preader_opts->nr_threads                     = 0;
 	preader_opts->comment_handling               = COMMENTS_ARE_DATA;
 	preader_opts->comment_string                 = NULL;
 
@@ -1159,6 +1268,12 @@ void cli_apply_reader_defaults(cli_reader_opts_t* preader_opts) {
 	if (preader_opts->allow_ragged_csv_input == NEITHER_TRUE_NOR_FALSE)
 		preader_opts->allow_ragged_csv_input = FALSE;
 
+	if (preader_opts->use_mmap_for_read == NEITHER_TRUE_NOR_FALSE)
+		preader_opts->use_mmap_for_read = TRUE;
+
+	if (preader_opts->nr_threads == 0)
+		preader_opts->nr_threads = 1;
+
 	if (preader_opts->input_json_flatten_separator == NULL)
 		preader_opts->input_json_flatten_separator = DEFAULT_JSON_FLATTEN_SEPARATOR;
 }
@@ -1265,6 +1380,12 @@ void cli_merge_reader_opts(cli_reader_opts_t* pfunc_opts, cli_reader_opts_t* pma
 	if (pfunc_opts->allow_ragged_csv_input == NEITHER_TRUE_NOR_FALSE)
 		pfunc_opts->allow_ragged_csv_input = pmain_opts->allow_ragged_csv_input;
 
+	if (pfunc_opts->use_mmap_for_read == NEITHER_TRUE_NOR_FALSE)
+		pfunc_opts->use_mmap_for_read = pmain_opts->use_mmap_for_read;
+
+	if (pfunc_opts->nr_threads == 0)
+		pfunc_opts->nr_threads = pmain_opts->nr_threads;
+
 	if (pfunc_opts->input_json_flatten_separator == NULL)
 		pfunc_opts->input_json_flatten_separator = pmain_opts->input_json_flatten_separator;
 }
@@ -1593,15 +1714,24 @@ int cli_handle_reader_options(char** argv, int argc, int *pargi, cli_reader_opts
 		argi += 1;
 
 	} else if (streq(argv[argi], "--mmap")) {
-		// No-op as of 5.6.3 (mmap is being abandoned) but don't break
-		// the command-line user experience.
+		preader_opts->use_mmap_for_read = TRUE;
 		argi += 1;
 
 	} else if (streq(argv[argi], "--no-mmap")) {
-		// No-op as of 5.6.3 (mmap is being abandoned) but don't break
-		// the command-line user experience.
+		preader_opts->use_mmap_for_read = FALSE;
 		argi += 1;
 
+	} else if (streq(argv[argi], "--nr-threads")) {
+		check_arg_count(argv, argi, argc, 2);
+		if (sscanf(argv[argi+1], "%d", &preader_opts->nr_threads) != 1 || preader_opts->nr_threads <= 0) {
+			fprintf(stderr,
+				"%s: --nr-threads argument must be a positive integer; got \"%s\".\n",
+				MLR_GLOBALS.bargv0, argv[argi+1]);
+			main_usage_short(stderr, MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+		argi += 2;
+
 	} else if (streq(argv[argi], "--prepipe")) {
 		check_arg_count(argv, argi, argc, 2);
 		preader_opts->prepipe = argv[argi+1];
@@ -15,6 +15,8 @@
 #include "containers/lhmss.h"
 #include <unistd.h>
 
+#define DEFAULT_RECORDS_PER_BATCH 1024
+
 // ----------------------------------------------------------------
 typedef struct _genereator_opts_t {
 	char* field_name;
@@ -42,6 +44,14 @@ typedef struct _cli_reader_opts_t {
 	// files are read directly rather than through a pipe.
 	char* prepipe;
 
+	// For DKVP, NIDX, and CSV-lite: memory-map regular files rather than
+	// reading them through stdio. Ignored for --prepipe and standard input.
+	int   use_mmap_for_read;
+
+	// For DKVP, NIDX, CSV-lite, and CSV: number of threads for parsing regular
+	// files, in chunks, in parallel. Zero if unspecified.
+	int   nr_threads;
+
 	comment_handling_t comment_handling;
 	char* comment_string;
 
@@ -95,6 +105,14 @@ typedef struct _cli_opts_t {
 
 	int do_in_place;
 
+	// Run each mapper, and the writer, on a thread of its own.
+	int use_pipeline;
+
+	// Records read before being passed along the then-chain, when all the
+	// verbs in it support this. 1 means record-at-a-time. 0, if not specified,
+	// means DEFAULT_RECORDS_PER_BATCH for regular files and 1 otherwise.
+	int records_per_batch;
+
 } cli_opts_t;
 
 // ----------------------------------------------------------------
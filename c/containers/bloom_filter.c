@@ -0,0 +1,64 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/bloom_filter.h"
+
+// Odd multipliers, one per word, from the Parquet split-block Bloom filter.
+static const uint32_t salts[8] = {
+	0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+	0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+// ----------------------------------------------------------------
+bloom_filter_t* bloom_filter_alloc(long long expected_count) {
+	bloom_filter_t* pfilter = mlr_malloc_or_die(sizeof(bloom_filter_t));
+	long long num_bits = expected_count * BLOOM_FILTER_BITS_PER_VALUE;
+	long long bits_per_block = 8 * sizeof(bloom_filter_block_t);
+	pfilter->num_blocks = (num_bits + bits_per_block - 1) / bits_per_block;
+	if (pfilter->num_blocks < 1)
+		pfilter->num_blocks = 1;
+	pfilter->pblocks = mlr_malloc_or_die(pfilter->num_blocks * sizeof(bloom_filter_block_t));
+	memset(pfilter->pblocks, 0, pfilter->num_blocks * sizeof(bloom_filter_block_t));
+	return pfilter;
+}
+
+void bloom_filter_free(bloom_filter_t* pfilter) {
+	if (pfilter == NULL)
+		return;
+	free(pfilter->pblocks);
+	free(pfilter);
+}
+
+// ----------------------------------------------------------------
+// The hashes coming in may be weak in some bits, so they're remixed to 64
+// (the splitmix64 finalizer). The top half picks the block, without a modulus;
+// the bottom half, times each salt, picks the bit in each word.
+static inline uint64_t bloom_filter_mix(int hash) {
+	uint64_t x = (uint32_t)hash;
+	x += 0x9e3779b97f4a7c15ULL;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+	return x ^ (x >> 31);
+}
+
+static inline bloom_filter_block_t* bloom_filter_block(bloom_filter_t* pfilter, uint64_t mixed) {
+	return &pfilter->pblocks[((mixed >> 32) * pfilter->num_blocks) >> 32];
+}
+
+void bloom_filter_add(bloom_filter_t* pfilter, int hash) {
+	uint64_t mixed = bloom_filter_mix(hash);
+	bloom_filter_block_t* pblock = bloom_filter_block(pfilter, mixed);
+	uint32_t key = (uint32_t)mixed;
+	for (int i = 0; i < 8; i++)
+		pblock->words[i] |= 1U << ((key * salts[i]) >> 27);
+}
+
+int bloom_filter_might_contain(bloom_filter_t* pfilter, int hash) {
+	uint64_t mixed = bloom_filter_mix(hash);
+	bloom_filter_block_t* pblock = bloom_filter_block(pfilter, mixed);
+	uint32_t key = (uint32_t)mixed;
+	for (int i = 0; i < 8; i++)
+		if ((pblock->words[i] & (1U << ((key * salts[i]) >> 27))) == 0)
+			return FALSE;
+	return TRUE;
+}
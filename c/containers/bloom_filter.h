@@ -0,0 +1,40 @@
+// ================================================================
+// Bloom filter over hash values: a set which can say for sure that a value was
+// never added, but only probably that it was. Used to turn away lookups which
+// would miss, more cheaply than the hash map they'd miss in.
+//
+// This is the split-block variant: the bits are in 32-byte blocks, one block
+// per value, and within the block one bit is set in each of its eight 32-bit
+// words. So a lookup touches one cache line. At 16 bits per value the false-
+// positive rate is around half a percent.
+//
+// Values are the int hashes Miller already computes, e.g. slls_hash_func or
+// group_key_t's; the filter remixes them itself.
+// ================================================================
+
+#ifndef BLOOM_FILTER_H
+#define BLOOM_FILTER_H
+
+#include <stdint.h>
+
+#define BLOOM_FILTER_BITS_PER_VALUE 16
+
+typedef struct _bloom_filter_block_t {
+	uint32_t words[8];
+} bloom_filter_block_t;
+
+typedef struct _bloom_filter_t {
+	bloom_filter_block_t* pblocks;
+	unsigned long long    num_blocks;
+} bloom_filter_t;
+
+// Sized for the expected number of values; more can be added, at the cost of
+// more false positives.
+bloom_filter_t* bloom_filter_alloc(long long expected_count);
+void bloom_filter_free(bloom_filter_t* pfilter);
+
+void bloom_filter_add(bloom_filter_t* pfilter, int hash);
+// False means the hash was never added; true means it probably was.
+int  bloom_filter_might_contain(bloom_filter_t* pfilter, int hash);
+
+#endif // BLOOM_FILTER_H
@@ -71,8 +71,7 @@ void hss_free(hss_t* pset) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int hss_find_index_for_key(hss_t* pset, char* key, int* pideal_index) {
-	int hash = mlr_string_hash_func(key);
+static int hss_find_index_for_key(hss_t* pset, char* key, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pset->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -82,7 +81,7 @@ static int hss_find_index_for_key(hss_t* pset, char* key, int* pideal_index) {
 		if (pe->state == OCCUPIED) {
 			char* ekey = pe->key;
 			// Existing key found in chain.
-			if (streq(key, ekey))
+			if (pe->hash == hash && streq(key, ekey))
 				return index;
 		}
 		else if (pe->state == EMPTY) {
@@ -107,13 +106,17 @@ static int hss_find_index_for_key(hss_t* pset, char* key, int* pideal_index) {
 
 // ----------------------------------------------------------------
 static void hss_enlarge(hss_t* pset);
+static void hss_add_with_hash(hss_t* pset, char* key, int hash);
 
 void hss_add(hss_t* pset, char* key) {
 	if ((pset->num_occupied + pset->num_freed) >= (pset->array_length*LOAD_FACTOR))
 		hss_enlarge(pset);
+	hss_add_with_hash(pset, key, mlr_string_hash_func(key));
+}
 
+static void hss_add_with_hash(hss_t* pset, char* key, int hash) {
 	int ideal_index = 0;
-	int index = hss_find_index_for_key(pset, key, &ideal_index);
+	int index = hss_find_index_for_key(pset, key, hash, &ideal_index);
 	hsse_t* pe = &pset->array[index];
 
 	if (pe->state == OCCUPIED) {
@@ -125,6 +128,7 @@ void hss_add(hss_t* pset, char* key) {
 		pe->key = key;
 		pe->state = OCCUPIED;
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pset->num_occupied++;
 	}
 	else {
@@ -143,7 +147,7 @@ static void hss_enlarge(hss_t* pset) {
 	for (int index = 0; index < old_array_length; index++) {
 		hsse_t e = old_array[index];
 		if (e.state == OCCUPIED)
-			hss_add(pset, e.key);
+			hss_add_with_hash(pset, e.key, e.hash);
 	}
 
 	free(old_array);
@@ -151,8 +155,9 @@ static void hss_enlarge(hss_t* pset) {
 
 // ----------------------------------------------------------------
 int hss_has(hss_t* pset, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = hss_find_index_for_key(pset, key, &ideal_index);
+	int index = hss_find_index_for_key(pset, key, hash, &ideal_index);
 	hsse_t* pe = &pset->array[index];
 
 	if (pe->state == OCCUPIED)
@@ -167,8 +172,9 @@ int hss_has(hss_t* pset, char* key) {
 
 // ----------------------------------------------------------------
 void hss_remove(hss_t* pset, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = hss_find_index_for_key(pset, key, &ideal_index);
+	int index = hss_find_index_for_key(pset, key, hash, &ideal_index);
 	hsse_t* pe = &pset->array[index];
 	if (pe->state == OCCUPIED) {
 		pe->key          = NULL;
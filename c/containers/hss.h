@@ -18,6 +18,7 @@ typedef struct _hsse_t {
 	char* key;
 	int   state;
 	int   ideal_index;
+	int   hash;
 } hsse_t;
 
 // ----------------------------------------------------------------
@@ -0,0 +1,351 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lib/mlrutil.h"
+#include "containers/hyperloglog.h"
+
+// Sparse entries are (index << 6) | rho at this precision.
+#define SPARSE_PRECISION 25
+#define SPARSE_RHO_BITS  6
+
+// Serialized form: version, precision, form, then the payload.
+#define HEX_FORMAT_VERSION 1
+#define HEX_FORM_SPARSE    0
+#define HEX_FORM_DENSE     1
+#define HEX_HEADER_LENGTH  6
+
+static void hyperloglog_add_sparse_entry(hyperloglog_t* phll, unsigned int entry);
+static void hyperloglog_flush_pending(hyperloglog_t* phll);
+static void hyperloglog_to_dense(hyperloglog_t* phll);
+static void hyperloglog_set_register_from_entry(hyperloglog_t* phll, unsigned int entry);
+static double ertl_sigma(double x);
+static double ertl_tau(double x);
+static int entry_comparator(const void* pva, const void* pvb);
+static char* hex_put_byte(char* p, unsigned int byte);
+static int hex_get_byte(char* p);
+
+// ----------------------------------------------------------------
+hyperloglog_t* hyperloglog_alloc(int precision) {
+	MLR_INTERNAL_CODING_ERROR_IF(precision < HYPERLOGLOG_MIN_PRECISION || precision > HYPERLOGLOG_MAX_PRECISION);
+	hyperloglog_t* phll = mlr_malloc_or_die(sizeof(hyperloglog_t));
+	phll->precision        = precision;
+	phll->num_registers    = 1 << precision;
+	phll->pregisters       = NULL;
+	phll->psparse          = NULL;
+	phll->sparse_length    = 0;
+	phll->sparse_capacity  = 0;
+	// The pending buffer, in bytes, is a sixteenth of the registers.
+	phll->pending_capacity = (phll->num_registers / 64 < 4) ? 4 : phll->num_registers / 64;
+	phll->ppending         = mlr_malloc_or_die(phll->pending_capacity * sizeof(unsigned int));
+	phll->pending_length   = 0;
+	return phll;
+}
+
+void hyperloglog_free(hyperloglog_t* phll) {
+	if (phll == NULL)
+		return;
+	free(phll->pregisters);
+	free(phll->psparse);
+	free(phll->ppending);
+	free(phll);
+}
+
+// ----------------------------------------------------------------
+// FNV-1a: cheap and byte-at-a-time. Its low-quality high bits are fixed up by
+// the finalizer in hyperloglog_add_hash.
+unsigned long long hyperloglog_string_hash(char* str, unsigned long long hash) {
+	unsigned char* p = (unsigned char*)str;
+	do {
+		hash ^= *p;
+		hash *= 0x100000001b3ULL;
+	} while (*p++);
+	return hash;
+}
+
+void hyperloglog_add_string(hyperloglog_t* phll, char* str) {
+	hyperloglog_add_hash(phll, hyperloglog_string_hash(str, HYPERLOGLOG_HASH_SEED));
+}
+
+void hyperloglog_add_hash(hyperloglog_t* phll, unsigned long long hash) {
+	// The murmur3 64-bit finalizer
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdULL;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ULL;
+	hash ^= hash >> 33;
+
+	if (phll->pregisters != NULL) {
+		int p = phll->precision;
+		unsigned long long index = hash >> (64 - p);
+		unsigned long long rest = hash << p;
+		unsigned char rho = (rest == 0ULL) ? 64 - p + 1 : __builtin_clzll(rest) + 1;
+		if (rho > phll->pregisters[index])
+			phll->pregisters[index] = rho;
+	} else {
+		unsigned int index = hash >> (64 - SPARSE_PRECISION);
+		unsigned long long rest = hash << SPARSE_PRECISION;
+		unsigned int rho = (rest == 0ULL) ? 64 - SPARSE_PRECISION + 1 : __builtin_clzll(rest) + 1;
+		hyperloglog_add_sparse_entry(phll, (index << SPARSE_RHO_BITS) | rho);
+	}
+}
+
+// ----------------------------------------------------------------
+static void hyperloglog_add_sparse_entry(hyperloglog_t* phll, unsigned int entry) {
+	if (phll->pregisters != NULL) {
+		hyperloglog_set_register_from_entry(phll, entry);
+		return;
+	}
+	phll->ppending[phll->pending_length++] = entry;
+	if (phll->pending_length >= phll->pending_capacity) {
+		hyperloglog_flush_pending(phll);
+		// Four bytes per entry versus one per register
+		if (4 * (phll->sparse_length + phll->pending_capacity) > phll->num_registers)
+			hyperloglog_to_dense(phll);
+	}
+}
+
+// Sorts the pending entries and merges them into the sparse list, keeping
+// the largest rho for each index: entries sort by index then rho, so that's
+// the last of each run.
+static void hyperloglog_flush_pending(hyperloglog_t* phll) {
+	if (phll->pending_length == 0)
+		return;
+	qsort(phll->ppending, phll->pending_length, sizeof(unsigned int), entry_comparator);
+
+	int n = phll->sparse_length + phll->pending_length;
+	unsigned int* pmerged = mlr_malloc_or_die(n * sizeof(unsigned int));
+	int i = 0, j = 0, k = 0;
+	while (i < phll->sparse_length || j < phll->pending_length) {
+		unsigned int entry;
+		if (j >= phll->pending_length || (i < phll->sparse_length && phll->psparse[i] <= phll->ppending[j]))
+			entry = phll->psparse[i++];
+		else
+			entry = phll->ppending[j++];
+		if (k > 0 && (pmerged[k-1] >> SPARSE_RHO_BITS) == (entry >> SPARSE_RHO_BITS))
+			pmerged[k-1] = entry;
+		else
+			pmerged[k++] = entry;
+	}
+	free(phll->psparse);
+	phll->psparse         = pmerged;
+	phll->sparse_length   = k;
+	phll->sparse_capacity = n;
+	phll->pending_length  = 0;
+}
+
+static void hyperloglog_to_dense(hyperloglog_t* phll) {
+	if (phll->pregisters != NULL)
+		return;
+	hyperloglog_flush_pending(phll);
+	phll->pregisters = mlr_malloc_or_die(phll->num_registers);
+	memset(phll->pregisters, 0, phll->num_registers);
+	for (int i = 0; i < phll->sparse_length; i++)
+		hyperloglog_set_register_from_entry(phll, phll->psparse[i]);
+	free(phll->psparse);
+	phll->psparse         = NULL;
+	phll->sparse_length   = 0;
+	phll->sparse_capacity = 0;
+}
+
+// The sparse index's bits below the register index are the first bits after
+// it in the hash: if any is set, they give rho; else it's their count plus
+// the sparse rho.
+static void hyperloglog_set_register_from_entry(hyperloglog_t* phll, unsigned int entry) {
+	int extra_bits = SPARSE_PRECISION - phll->precision;
+	unsigned int sparse_index = entry >> SPARSE_RHO_BITS;
+	unsigned int index = sparse_index >> extra_bits;
+	unsigned int low = sparse_index & ((1U << extra_bits) - 1);
+	unsigned char rho = (low != 0)
+		? extra_bits - (31 - __builtin_clz(low))
+		: extra_bits + (entry & ((1U << SPARSE_RHO_BITS) - 1));
+	if (rho > phll->pregisters[index])
+		phll->pregisters[index] = rho;
+}
+
+// ----------------------------------------------------------------
+void hyperloglog_merge(hyperloglog_t* phll, hyperloglog_t* pother) {
+	MLR_INTERNAL_CODING_ERROR_IF(phll->precision != pother->precision);
+	if (pother->pregisters == NULL) {
+		hyperloglog_flush_pending(pother);
+		for (int i = 0; i < pother->sparse_length; i++)
+			hyperloglog_add_sparse_entry(phll, pother->psparse[i]);
+	} else {
+		hyperloglog_to_dense(phll);
+		for (int i = 0; i < phll->num_registers; i++)
+			if (pother->pregisters[i] > phll->pregisters[i])
+				phll->pregisters[i] = pother->pregisters[i];
+	}
+}
+
+// ----------------------------------------------------------------
+char* hyperloglog_to_hex(hyperloglog_t* phll) {
+	int sparse = phll->pregisters == NULL;
+	if (sparse)
+		hyperloglog_flush_pending(phll);
+	int payload_length = sparse ? 8 * phll->sparse_length : 2 * phll->num_registers;
+	char* hex = mlr_malloc_or_die(HEX_HEADER_LENGTH + payload_length + 1);
+	char* p = hex;
+	p = hex_put_byte(p, HEX_FORMAT_VERSION);
+	p = hex_put_byte(p, phll->precision);
+	p = hex_put_byte(p, sparse ? HEX_FORM_SPARSE : HEX_FORM_DENSE);
+	if (sparse) {
+		for (int i = 0; i < phll->sparse_length; i++) {
+			unsigned int entry = phll->psparse[i];
+			p = hex_put_byte(p, entry >> 24);
+			p = hex_put_byte(p, entry >> 16);
+			p = hex_put_byte(p, entry >> 8);
+			p = hex_put_byte(p, entry);
+		}
+	} else {
+		for (int i = 0; i < phll->num_registers; i++)
+			p = hex_put_byte(p, phll->pregisters[i]);
+	}
+	*p = 0;
+	return hex;
+}
+
+// Sparse entries go back in through the pending list, so the input needn't be
+// sorted and the sketch goes dense if they're too many.
+hyperloglog_t* hyperloglog_from_hex(char* hex) {
+	int length = strlen(hex);
+	if (length < HEX_HEADER_LENGTH || (length % 2) != 0)
+		return NULL;
+	int version   = hex_get_byte(&hex[0]);
+	int precision = hex_get_byte(&hex[2]);
+	int form      = hex_get_byte(&hex[4]);
+	if (version != HEX_FORMAT_VERSION)
+		return NULL;
+	if (precision < HYPERLOGLOG_MIN_PRECISION || precision > HYPERLOGLOG_MAX_PRECISION)
+		return NULL;
+
+	char* payload = &hex[HEX_HEADER_LENGTH];
+	int payload_length = length - HEX_HEADER_LENGTH;
+	hyperloglog_t* phll = hyperloglog_alloc(precision);
+
+	if (form == HEX_FORM_SPARSE) {
+		if ((payload_length % 8) != 0) {
+			hyperloglog_free(phll);
+			return NULL;
+		}
+		for (int i = 0; i < payload_length; i += 8) {
+			int b0 = hex_get_byte(&payload[i]);
+			int b1 = hex_get_byte(&payload[i+2]);
+			int b2 = hex_get_byte(&payload[i+4]);
+			int b3 = hex_get_byte(&payload[i+6]);
+			unsigned int rho = b3 & ((1U << SPARSE_RHO_BITS) - 1);
+			if (b0 < 0 || b1 < 0 || b2 < 0 || b3 < 0 || b0 >= 0x80
+				|| rho == 0 || rho > 64 - SPARSE_PRECISION + 1)
+			{
+				hyperloglog_free(phll);
+				return NULL;
+			}
+			hyperloglog_add_sparse_entry(phll,
+				((unsigned int)b0 << 24) | ((unsigned int)b1 << 16) | ((unsigned int)b2 << 8) | (unsigned int)b3);
+		}
+	} else if (form == HEX_FORM_DENSE) {
+		if (payload_length != 2 * phll->num_registers) {
+			hyperloglog_free(phll);
+			return NULL;
+		}
+		phll->pregisters = mlr_malloc_or_die(phll->num_registers);
+		for (int i = 0; i < phll->num_registers; i++) {
+			int rho = hex_get_byte(&payload[2*i]);
+			if (rho < 0 || rho > 64 - precision + 1) {
+				hyperloglog_free(phll);
+				return NULL;
+			}
+			phll->pregisters[i] = rho;
+		}
+	} else {
+		hyperloglog_free(phll);
+		return NULL;
+	}
+	return phll;
+}
+
+static char* hex_put_byte(char* p, unsigned int byte) {
+	static const char digits[] = "0123456789abcdef";
+	*p++ = digits[(byte >> 4) & 0xf];
+	*p++ = digits[byte & 0xf];
+	return p;
+}
+
+// Returns -1 if either character isn't a hex digit.
+static int hex_get_byte(char* p) {
+	int byte = 0;
+	for (int i = 0; i < 2; i++) {
+		char c = p[i];
+		int nybble;
+		if (c >= '0' && c <= '9')
+			nybble = c - '0';
+		else if (c >= 'a' && c <= 'f')
+			nybble = c - 'a' + 10;
+		else if (c >= 'A' && c <= 'F')
+			nybble = c - 'A' + 10;
+		else
+			return -1;
+		byte = (byte << 4) | nybble;
+	}
+	return byte;
+}
+
+// ----------------------------------------------------------------
+// Sparse: linear counting over the 2^25 sparse registers, nearly exact at the
+// counts for which the sketch stays sparse. Dense: Ertl's improved raw
+// estimator from the histogram of register values.
+long long hyperloglog_count(hyperloglog_t* phll) {
+	if (phll->pregisters == NULL) {
+		hyperloglog_flush_pending(phll);
+		double m = (double)(1 << SPARSE_PRECISION);
+		return llround(m * log(m / (m - phll->sparse_length)));
+	}
+
+	int q = 64 - phll->precision;
+	double m = phll->num_registers;
+	long long histogram[66];
+	memset(histogram, 0, sizeof(histogram));
+	for (int i = 0; i < phll->num_registers; i++)
+		histogram[phll->pregisters[i]]++;
+
+	double z = m * ertl_tau(1.0 - histogram[q+1] / m);
+	for (int k = q; k >= 1; k--)
+		z = 0.5 * (z + histogram[k]);
+	z += m * ertl_sigma(histogram[0] / m);
+	return llround(m * m / (2.0 * log(2.0)) / z);
+}
+
+static double ertl_sigma(double x) {
+	if (x == 1.0)
+		return INFINITY;
+	double y = 1.0;
+	double z = x;
+	double z_prev;
+	do {
+		x *= x;
+		z_prev = z;
+		z += x * y;
+		y += y;
+	} while (z != z_prev);
+	return z;
+}
+
+static double ertl_tau(double x) {
+	if (x == 0.0 || x == 1.0)
+		return 0.0;
+	double y = 1.0;
+	double z = 1.0 - x;
+	double z_prev;
+	do {
+		x = sqrt(x);
+		z_prev = z;
+		y *= 0.5;
+		z -= (1.0 - x) * (1.0 - x) * y;
+	} while (z != z_prev);
+	return z / 3.0;
+}
+
+static int entry_comparator(const void* pva, const void* pvb) {
+	unsigned int a = *(const unsigned int*)pva;
+	unsigned int b = *(const unsigned int*)pvb;
+	return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
@@ -0,0 +1,222 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lib/mlrutil.h"
+#include "containers/kll_sketch.h"
+
+typedef struct _kll_weighted_item_t {
+	double    value;
+	long long weight;
+} kll_weighted_item_t;
+
+static void kll_sketch_add_level(kll_sketch_t* psketch);
+static int  kll_level_capacity(kll_sketch_t* psketch, int h);
+static void kll_level_append(kll_level_t* plevel, double value);
+static void kll_sketch_compress(kll_sketch_t* psketch);
+static void kll_sketch_compact_level(kll_sketch_t* psketch, int h);
+static int  kll_random_bit(kll_sketch_t* psketch);
+static double kll_sketch_value_at_rank(kll_sketch_t* psketch, kll_weighted_item_t* pitems, int num_items,
+	long long index);
+static int  double_comparator(const void* pva, const void* pvb);
+static int  weighted_item_comparator(const void* pva, const void* pvb);
+
+// ----------------------------------------------------------------
+kll_sketch_t* kll_sketch_alloc(int k) {
+	kll_sketch_t* psketch = mlr_malloc_or_die(sizeof(kll_sketch_t));
+	if (k < 8)
+		k = 8;
+	psketch->k               = k;
+	psketch->levels_capacity = 8;
+	psketch->plevels         = mlr_malloc_or_die(psketch->levels_capacity * sizeof(kll_level_t));
+	psketch->num_levels      = 0;
+	psketch->num_items       = 0;
+	psketch->max_items       = 0;
+	psketch->count           = 0LL;
+	psketch->min             = INFINITY;
+	psketch->max             = -INFINITY;
+	// Fixed seed so that output is reproducible from run to run.
+	psketch->rng_state       = 0x9e3779b97f4a7c15ULL;
+	kll_sketch_add_level(psketch);
+	return psketch;
+}
+
+void kll_sketch_free(kll_sketch_t* psketch) {
+	if (psketch == NULL)
+		return;
+	for (int h = 0; h < psketch->num_levels; h++)
+		free(psketch->plevels[h].pitems);
+	free(psketch->plevels);
+	free(psketch);
+}
+
+// ----------------------------------------------------------------
+void kll_sketch_add(kll_sketch_t* psketch, double value) {
+	if (isnan(value))
+		return;
+	kll_level_append(&psketch->plevels[0], value);
+	psketch->num_items++;
+	psketch->count++;
+	if (value < psketch->min)
+		psketch->min = value;
+	if (value > psketch->max)
+		psketch->max = value;
+	if (psketch->num_items >= psketch->max_items)
+		kll_sketch_compress(psketch);
+}
+
+void kll_sketch_merge(kll_sketch_t* psketch, kll_sketch_t* pother) {
+	while (psketch->num_levels < pother->num_levels)
+		kll_sketch_add_level(psketch);
+	for (int h = 0; h < pother->num_levels; h++) {
+		kll_level_t* plevel = &pother->plevels[h];
+		for (int i = 0; i < plevel->length; i++)
+			kll_level_append(&psketch->plevels[h], plevel->pitems[i]);
+		psketch->num_items += plevel->length;
+	}
+	psketch->count += pother->count;
+	if (pother->min < psketch->min)
+		psketch->min = pother->min;
+	if (pother->max > psketch->max)
+		psketch->max = pother->max;
+	while (psketch->num_items >= psketch->max_items)
+		kll_sketch_compress(psketch);
+}
+
+long long kll_sketch_count(kll_sketch_t* psketch) {
+	return psketch->count;
+}
+
+// ----------------------------------------------------------------
+// Adding a level at the top shrinks the capacities of all those below it.
+static void kll_sketch_add_level(kll_sketch_t* psketch) {
+	if (psketch->num_levels >= psketch->levels_capacity) {
+		psketch->levels_capacity *= 2;
+		psketch->plevels = mlr_realloc_or_die(psketch->plevels, psketch->levels_capacity * sizeof(kll_level_t));
+	}
+	kll_level_t* plevel = &psketch->plevels[psketch->num_levels++];
+	plevel->length   = 0;
+	plevel->capacity = 0;
+	plevel->pitems   = NULL;
+	psketch->max_items = 0;
+	for (int h = 0; h < psketch->num_levels; h++)
+		psketch->max_items += kll_level_capacity(psketch, h);
+}
+
+static int kll_level_capacity(kll_sketch_t* psketch, int h) {
+	int depth = psketch->num_levels - 1 - h;
+	int capacity = (int)ceil(psketch->k * pow(2.0/3.0, depth));
+	return (capacity < 2) ? 2 : capacity;
+}
+
+static void kll_level_append(kll_level_t* plevel, double value) {
+	if (plevel->length >= plevel->capacity) {
+		plevel->capacity = (plevel->capacity == 0) ? 16 : 2 * plevel->capacity;
+		plevel->pitems = mlr_realloc_or_die(plevel->pitems, plevel->capacity * sizeof(double));
+	}
+	plevel->pitems[plevel->length++] = value;
+}
+
+// Compacts the lowest level which is at or over its capacity.
+static void kll_sketch_compress(kll_sketch_t* psketch) {
+	for (int h = 0; h < psketch->num_levels; h++) {
+		if (psketch->plevels[h].length >= kll_level_capacity(psketch, h)) {
+			if (h + 1 >= psketch->num_levels)
+				kll_sketch_add_level(psketch);
+			kll_sketch_compact_level(psketch, h);
+			return;
+		}
+	}
+}
+
+// With an odd number of items, the largest stays behind so that total weight
+// is conserved.
+static void kll_sketch_compact_level(kll_sketch_t* psketch, int h) {
+	kll_level_t* plevel = &psketch->plevels[h];
+	qsort(plevel->pitems, plevel->length, sizeof(double), double_comparator);
+	int num_paired = plevel->length & ~1;
+	int offset = kll_random_bit(psketch);
+	for (int i = offset; i < num_paired; i += 2)
+		kll_level_append(&psketch->plevels[h+1], plevel->pitems[i]);
+	if (plevel->length > num_paired)
+		plevel->pitems[0] = plevel->pitems[num_paired];
+	plevel->length -= num_paired;
+	psketch->num_items -= num_paired / 2;
+}
+
+// xorshift64*: a local generator rather than mtrand, so that the sketch
+// doesn't disturb the sequence seen by --seed users of urand() et al.
+static int kll_random_bit(kll_sketch_t* psketch) {
+	unsigned long long x = psketch->rng_state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	psketch->rng_state = x;
+	return (int)((x * 0x2545f4914f6cdd1dULL) >> 63);
+}
+
+// ----------------------------------------------------------------
+double kll_sketch_percentile(kll_sketch_t* psketch, double p, int interpolate) {
+	long long n = psketch->count;
+	if (n == 0LL)
+		return NAN;
+
+	kll_weighted_item_t* pitems = mlr_malloc_or_die(psketch->num_items * sizeof(kll_weighted_item_t));
+	int num_items = 0;
+	for (int h = 0; h < psketch->num_levels; h++) {
+		kll_level_t* plevel = &psketch->plevels[h];
+		for (int i = 0; i < plevel->length; i++) {
+			pitems[num_items].value  = plevel->pitems[i];
+			pitems[num_items].weight = 1LL << h;
+			num_items++;
+		}
+	}
+	qsort(pitems, num_items, sizeof(kll_weighted_item_t), weighted_item_comparator);
+
+	double rv;
+	if (!interpolate) {
+		long long index = p*n/100.0;
+		rv = kll_sketch_value_at_rank(psketch, pitems, num_items, index);
+	} else {
+		double findex = (p/100.0)*(n-1);
+		if (findex < 0.0)
+			findex = 0.0;
+		long long iindex = (long long)floor(findex);
+		double a = kll_sketch_value_at_rank(psketch, pitems, num_items, iindex);
+		if (iindex >= n-1) {
+			rv = a;
+		} else {
+			double b = kll_sketch_value_at_rank(psketch, pitems, num_items, iindex + 1);
+			rv = a + (findex - iindex) * (b - a);
+		}
+	}
+	free(pitems);
+	return rv;
+}
+
+// The first item whose cumulative weight passes the index; compaction may
+// have dropped the extremes, so the first and last ranks are kept apart.
+static double kll_sketch_value_at_rank(kll_sketch_t* psketch, kll_weighted_item_t* pitems, int num_items,
+	long long index)
+{
+	if (index <= 0LL)
+		return psketch->min;
+	if (index >= psketch->count - 1)
+		return psketch->max;
+	long long cumulative_weight = 0LL;
+	for (int i = 0; i < num_items; i++) {
+		cumulative_weight += pitems[i].weight;
+		if (cumulative_weight > index)
+			return pitems[i].value;
+	}
+	return pitems[num_items-1].value;
+}
+
+static int double_comparator(const void* pva, const void* pvb) {
+	double a = *(const double*)pva;
+	double b = *(const double*)pvb;
+	return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+static int weighted_item_comparator(const void* pva, const void* pvb) {
+	return double_comparator(&((const kll_weighted_item_t*)pva)->value, &((const kll_weighted_item_t*)pvb)->value);
+}
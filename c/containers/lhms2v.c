@@ -41,7 +41,7 @@
 #define EMPTY    0xce
 
 // ----------------------------------------------------------------
-static void* lhms2v_put_no_enlarge(lhms2v_t* pmap, char* key1, char* key2, void* pvvalue, char free_flags);
+static void* lhms2v_put_no_enlarge(lhms2v_t* pmap, char* key1, char* key2, int hash, void* pvvalue, char free_flags);
 static void lhms2v_enlarge(lhms2v_t* pmap);
 
 // ================================================================
@@ -92,8 +92,7 @@ void lhms2v_free(lhms2v_t* pmap) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int lhms2v_find_index_for_key(lhms2v_t* pmap, char* key1, char* key2, int* pideal_index) {
-	int hash = mlr_string_pair_hash_func(key1, key2);
+static int lhms2v_find_index_for_key(lhms2v_t* pmap, char* key1, char* key2, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pmap->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -105,7 +104,7 @@ static int lhms2v_find_index_for_key(lhms2v_t* pmap, char* key1, char* key2, int
 			char* ekey1 = pe->key1;
 			char* ekey2 = pe->key2;
 			// Existing key found in chain.
-			if (streq(key1, ekey1) && streq(key2, ekey2))
+			if (pe->hash == hash && streq(key1, ekey1) && streq(key2, ekey2))
 				return index;
 		}
 		else if (pmap->states[index] == EMPTY) {
@@ -133,12 +132,13 @@ static int lhms2v_find_index_for_key(lhms2v_t* pmap, char* key1, char* key2, int
 void* lhms2v_put(lhms2v_t* pmap, char* key1, char* key2, void* pvvalue, char free_flags) {
 	if ((pmap->num_occupied + pmap->num_freed) >= (pmap->array_length*LOAD_FACTOR))
 		lhms2v_enlarge(pmap);
-	return lhms2v_put_no_enlarge(pmap, key1, key2, pvvalue, free_flags);
+	int hash = mlr_string_pair_hash_func(key1, key2);
+	return lhms2v_put_no_enlarge(pmap, key1, key2, hash, pvvalue, free_flags);
 }
 
-static void* lhms2v_put_no_enlarge(lhms2v_t* pmap, char* key1, char* key2, void* pvvalue, char free_flags) {
+static void* lhms2v_put_no_enlarge(lhms2v_t* pmap, char* key1, char* key2, int hash, void* pvvalue, char free_flags) {
 	int ideal_index = 0;
-	int index = lhms2v_find_index_for_key(pmap, key1, key2, &ideal_index);
+	int index = lhms2v_find_index_for_key(pmap, key1, key2, hash, &ideal_index);
 	lhms2ve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -148,6 +148,7 @@ static void* lhms2v_put_no_enlarge(lhms2v_t* pmap, char* key1, char* key2, void*
 	else if (pmap->states[index] == EMPTY) {
 		// End of chain.
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pe->key1 = key1;
 		pe->key2 = key2;
 		pe->pvvalue = pvvalue;
@@ -176,8 +177,9 @@ static void* lhms2v_put_no_enlarge(lhms2v_t* pmap, char* key1, char* key2, void*
 
 // ----------------------------------------------------------------
 void* lhms2v_get(lhms2v_t* pmap, char* key1, char* key2) {
+	int hash = mlr_string_pair_hash_func(key1, key2);
 	int ideal_index = 0;
-	int index = lhms2v_find_index_for_key(pmap, key1, key2, &ideal_index);
+	int index = lhms2v_find_index_for_key(pmap, key1, key2, hash, &ideal_index);
 	lhms2ve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED)
@@ -192,8 +194,9 @@ void* lhms2v_get(lhms2v_t* pmap, char* key1, char* key2) {
 
 // ----------------------------------------------------------------
 int lhms2v_has_key(lhms2v_t* pmap, char* key1, char* key2) {
+	int hash = mlr_string_pair_hash_func(key1, key2);
 	int ideal_index = 0;
-	int index = lhms2v_find_index_for_key(pmap, key1, key2, &ideal_index);
+	int index = lhms2v_find_index_for_key(pmap, key1, key2, hash, &ideal_index);
 
 	if (pmap->states[index] == OCCUPIED)
 		return TRUE;
@@ -219,7 +222,7 @@ static void lhms2v_enlarge(lhms2v_t* pmap) {
 	lhms2v_init(pmap, pmap->array_length*ENLARGEMENT_FACTOR);
 
 	for (lhms2ve_t* pe = old_head; pe != NULL; pe = pe->pnext) {
-		lhms2v_put_no_enlarge(pmap, pe->key1, pe->key2, pe->pvvalue, pe->free_flags);
+		lhms2v_put_no_enlarge(pmap, pe->key1, pe->key2, pe->hash, pe->pvvalue, pe->free_flags);
 	}
 	free(old_entries);
 	free(old_states);
@@ -21,6 +21,7 @@
 // ----------------------------------------------------------------
 typedef struct _lhms2ve_t {
 	int   ideal_index;
+	int   hash;
 	char* key1;
 	char* key2;
 	void* pvvalue;
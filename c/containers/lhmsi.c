@@ -44,7 +44,7 @@
 #define EMPTY    0xce
 
 // ----------------------------------------------------------------
-static void lhmsi_put_no_enlarge(lhmsi_t* pmap, char* key, int value, char free_flags);
+static void lhmsi_put_no_enlarge(lhmsi_t* pmap, char* key, int hash, int value, char free_flags);
 static void lhmsi_enlarge(lhmsi_t* pmap);
 
 // ================================================================
@@ -99,8 +99,7 @@ void lhmsi_free(lhmsi_t* pmap) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int lhmsi_find_index_for_key(lhmsi_t* pmap, char* key, int* pideal_index) {
-	int hash = mlr_string_hash_func(key);
+static int lhmsi_find_index_for_key(lhmsi_t* pmap, char* key, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pmap->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -110,7 +109,7 @@ static int lhmsi_find_index_for_key(lhmsi_t* pmap, char* key, int* pideal_index)
 		if (pmap->states[index] == OCCUPIED) {
 			char* ekey = pe->key;
 			// Existing key found in chain.
-			if (streq(key, ekey))
+			if (pe->hash == hash && streq(key, ekey))
 				return index;
 		}
 		else if (pmap->states[index] == EMPTY) {
@@ -137,12 +136,13 @@ static int lhmsi_find_index_for_key(lhmsi_t* pmap, char* key, int* pideal_index)
 void lhmsi_put(lhmsi_t* pmap, char* key, int value, char free_flags) {
 	if ((pmap->num_occupied + pmap->num_freed) >= (pmap->array_length*LOAD_FACTOR))
 		lhmsi_enlarge(pmap);
-	lhmsi_put_no_enlarge(pmap, key, value, free_flags);
+	int hash = mlr_string_hash_func(key);
+	lhmsi_put_no_enlarge(pmap, key, hash, value, free_flags);
 }
 
-static void lhmsi_put_no_enlarge(lhmsi_t* pmap, char* key, int value, char free_flags) {
+static void lhmsi_put_no_enlarge(lhmsi_t* pmap, char* key, int hash, int value, char free_flags) {
 	int ideal_index = 0;
-	int index = lhmsi_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsi_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsie_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -152,6 +152,7 @@ static void lhmsi_put_no_enlarge(lhmsi_t* pmap, char* key, int value, char free_
 	} else if (pmap->states[index] == EMPTY) {
 		// End of chain.
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pe->key = key;
 		pe->value = value;
 		pe->free_flags = free_flags;
@@ -178,8 +179,9 @@ static void lhmsi_put_no_enlarge(lhmsi_t* pmap, char* key, int value, char free_
 
 // ----------------------------------------------------------------
 int lhmsi_get(lhmsi_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsi_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsi_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsie_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED)
@@ -194,8 +196,9 @@ int lhmsi_get(lhmsi_t* pmap, char* key) {
 
 // ----------------------------------------------------------------
 int lhmsi_test_and_get(lhmsi_t* pmap, char* key, int* pval) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsi_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsi_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsie_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -210,8 +213,9 @@ int lhmsi_test_and_get(lhmsi_t* pmap, char* key, int* pval) {
 }
 
 lhmsie_t* lhmsi_get_entry(lhmsi_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsi_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsi_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsie_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED)
@@ -226,8 +230,9 @@ lhmsie_t* lhmsi_get_entry(lhmsi_t* pmap, char* key) {
 
 // ----------------------------------------------------------------
 int lhmsi_has_key(lhmsi_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsi_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsi_find_index_for_key(pmap, key, hash, &ideal_index);
 
 	if (pmap->states[index] == OCCUPIED)
 		return TRUE;
@@ -254,7 +259,7 @@ static void lhmsi_enlarge(lhmsi_t* pmap) {
 	lhmsi_init(pmap, pmap->array_length*ENLARGEMENT_FACTOR);
 
 	for (lhmsie_t* pe = old_head; pe != NULL; pe = pe->pnext) {
-		lhmsi_put_no_enlarge(pmap, pe->key, pe->value, pe->free_flags);
+		lhmsi_put_no_enlarge(pmap, pe->key, pe->hash, pe->value, pe->free_flags);
 	}
 	free(old_entries);
 	free(old_states);
@@ -19,6 +19,7 @@
 // ----------------------------------------------------------------
 typedef struct _lhmsie_t {
 	int   ideal_index;
+	int   hash;
 	char* key;
 	int value;
 	char  free_flags;
@@ -44,7 +44,7 @@
 #define EMPTY    0xce
 
 // ----------------------------------------------------------------
-static void lhmsll_put_no_enlarge(lhmsll_t* pmap, char* key, int value, char free_flags);
+static void lhmsll_put_no_enlarge(lhmsll_t* pmap, char* key, int hash, int value, char free_flags);
 static void lhmsll_enlarge(lhmsll_t* pmap);
 
 // ================================================================
@@ -99,8 +99,7 @@ void lhmsll_free(lhmsll_t* pmap) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int lhmsll_find_index_for_key(lhmsll_t* pmap, char* key, int* pideal_index) {
-	int hash = mlr_string_hash_func(key);
+static int lhmsll_find_index_for_key(lhmsll_t* pmap, char* key, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pmap->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -110,7 +109,7 @@ static int lhmsll_find_index_for_key(lhmsll_t* pmap, char* key, int* pideal_inde
 		if (pmap->states[index] == OCCUPIED) {
 			char* ekey = pe->key;
 			// Existing key found in chain.
-			if (streq(key, ekey))
+			if (pe->hash == hash && streq(key, ekey))
 				return index;
 		}
 		else if (pmap->states[index] == EMPTY) {
@@ -138,12 +137,13 @@ static int lhmsll_find_index_for_key(lhmsll_t* pmap, char* key, int* pideal_inde
 void lhmsll_put(lhmsll_t* pmap, char* key, int value, char free_flags) {
 	if ((pmap->num_occupied + pmap->num_freed) >= (pmap->array_length*LOAD_FACTOR))
 		lhmsll_enlarge(pmap);
-	lhmsll_put_no_enlarge(pmap, key, value, free_flags);
+	int hash = mlr_string_hash_func(key);
+	lhmsll_put_no_enlarge(pmap, key, hash, value, free_flags);
 }
 
-static void lhmsll_put_no_enlarge(lhmsll_t* pmap, char* key, int value, char free_flags) {
+static void lhmsll_put_no_enlarge(lhmsll_t* pmap, char* key, int hash, int value, char free_flags) {
 	int ideal_index = 0;
-	int index = lhmsll_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsll_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmslle_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -153,6 +153,7 @@ static void lhmsll_put_no_enlarge(lhmsll_t* pmap, char* key, int value, char fre
 	} else if (pmap->states[index] == EMPTY) {
 		// End of chain.
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pe->key = key;
 		pe->value = value;
 		pe->free_flags = free_flags;
@@ -179,8 +180,9 @@ static void lhmsll_put_no_enlarge(lhmsll_t* pmap, char* key, int value, char fre
 
 // ----------------------------------------------------------------
 long long lhmsll_get(lhmsll_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsll_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsll_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmslle_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED)
@@ -195,8 +197,9 @@ long long lhmsll_get(lhmsll_t* pmap, char* key) {
 
 // ----------------------------------------------------------------
 int lhmsll_test_and_get(lhmsll_t* pmap, char* key, long long* pval) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsll_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsll_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmslle_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -211,8 +214,9 @@ int lhmsll_test_and_get(lhmsll_t* pmap, char* key, long long* pval) {
 }
 
 int lhmsll_test_and_increment(lhmsll_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsll_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsll_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmslle_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -227,8 +231,9 @@ int lhmsll_test_and_increment(lhmsll_t* pmap, char* key) {
 }
 
 lhmslle_t* lhmsll_get_entry(lhmsll_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsll_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsll_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmslle_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED)
@@ -243,8 +248,9 @@ lhmslle_t* lhmsll_get_entry(lhmsll_t* pmap, char* key) {
 
 // ----------------------------------------------------------------
 int lhmsll_has_key(lhmsll_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsll_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsll_find_index_for_key(pmap, key, hash, &ideal_index);
 
 	if (pmap->states[index] == OCCUPIED)
 		return TRUE;
@@ -271,7 +277,7 @@ static void lhmsll_enlarge(lhmsll_t* pmap) {
 	lhmsll_init(pmap, pmap->array_length*ENLARGEMENT_FACTOR);
 
 	for (lhmslle_t* pe = old_head; pe != NULL; pe = pe->pnext) {
-		lhmsll_put_no_enlarge(pmap, pe->key, pe->value, pe->free_flags);
+		lhmsll_put_no_enlarge(pmap, pe->key, pe->hash, pe->value, pe->free_flags);
 	}
 	free(old_entries);
 	free(old_states);
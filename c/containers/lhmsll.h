@@ -19,6 +19,7 @@
 // ----------------------------------------------------------------
 typedef struct _lhmslle_t {
 	int   ideal_index;
+	int   hash;
 	char* key;
 	long long value;
 	char  free_flags;
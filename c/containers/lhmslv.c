@@ -41,7 +41,7 @@
 #define EMPTY    0xce
 
 // ----------------------------------------------------------------
-static void* lhmslv_put_no_enlarge(lhmslv_t* pmap, slls_t* key, void* pvvalue, char free_flags);
+static void* lhmslv_put_no_enlarge(lhmslv_t* pmap, slls_t* key, int hash, void* pvvalue, char free_flags);
 static void lhmslv_enlarge(lhmslv_t* pmap);
 
 // ================================================================
@@ -89,8 +89,7 @@ void lhmslv_free(lhmslv_t* pmap) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int lhmslv_find_index_for_key(lhmslv_t* pmap, slls_t* key, int* pideal_index) {
-	int hash = slls_hash_func(key);
+static int lhmslv_find_index_for_key(lhmslv_t* pmap, slls_t* key, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pmap->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -100,7 +99,7 @@ static int lhmslv_find_index_for_key(lhmslv_t* pmap, slls_t* key, int* pideal_in
 		if (pmap->states[index] == OCCUPIED) {
 			slls_t* ekey = pe->key;
 			// Existing key found in chain.
-			if (slls_equals(key, ekey))
+			if (pe->hash == hash && slls_equals(key, ekey))
 				return index;
 		}
 		else if (pmap->states[index] == EMPTY) {
@@ -126,14 +125,18 @@ static int lhmslv_find_index_for_key(lhmslv_t* pmap, slls_t* key, int* pideal_in
 
 // ----------------------------------------------------------------
 void* lhmslv_put(lhmslv_t* pmap, slls_t* key, void* pvvalue, char free_flags) {
+	return lhmslv_put_with_hash(pmap, key, slls_hash_func(key), pvvalue, free_flags);
+}
+
+void* lhmslv_put_with_hash(lhmslv_t* pmap, slls_t* key, int hash, void* pvvalue, char free_flags) {
 	if ((pmap->num_occupied + pmap->num_freed) >= (pmap->array_length*LOAD_FACTOR))
 		lhmslv_enlarge(pmap);
-	return lhmslv_put_no_enlarge(pmap, key, pvvalue, free_flags);
+	return lhmslv_put_no_enlarge(pmap, key, hash, pvvalue, free_flags);
 }
 
-static void* lhmslv_put_no_enlarge(lhmslv_t* pmap, slls_t* key, void* pvvalue, char free_flags) {
+static void* lhmslv_put_no_enlarge(lhmslv_t* pmap, slls_t* key, int hash, void* pvvalue, char free_flags) {
 	int ideal_index = 0;
-	int index = lhmslv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmslv_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmslve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -143,6 +146,7 @@ static void* lhmslv_put_no_enlarge(lhmslv_t* pmap, slls_t* key, void* pvvalue, c
 	} else if (pmap->states[index] == EMPTY) {
 		// End of chain.
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pe->key = key;
 		pe->free_flags = free_flags;
 		pe->pvvalue = pvvalue;
@@ -171,8 +175,12 @@ static void* lhmslv_put_no_enlarge(lhmslv_t* pmap, slls_t* key, void* pvvalue, c
 
 // ----------------------------------------------------------------
 void* lhmslv_get(lhmslv_t* pmap, slls_t* key) {
+	return lhmslv_get_with_hash(pmap, key, slls_hash_func(key));
+}
+
+void* lhmslv_get_with_hash(lhmslv_t* pmap, slls_t* key, int hash) {
 	int ideal_index = 0;
-	int index = lhmslv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmslv_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmslve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED)
@@ -187,8 +195,9 @@ void* lhmslv_get(lhmslv_t* pmap, slls_t* key) {
 
 // ----------------------------------------------------------------
 int lhmslv_has_key(lhmslv_t* pmap, slls_t* key) {
+	int hash = slls_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmslv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmslv_find_index_for_key(pmap, key, hash, &ideal_index);
 
 	if (pmap->states[index] == OCCUPIED)
 		return TRUE;
@@ -214,7 +223,7 @@ static void lhmslv_enlarge(lhmslv_t* pmap) {
 	lhmslv_init(pmap, pmap->array_length*ENLARGEMENT_FACTOR);
 
 	for (lhmslve_t* pe = old_head; pe != NULL; pe = pe->pnext) {
-		lhmslv_put_no_enlarge(pmap, pe->key, pe->pvvalue, pe->free_flags);
+		lhmslv_put_no_enlarge(pmap, pe->key, pe->hash, pe->pvvalue, pe->free_flags);
 	}
 	free(old_entries);
 	free(old_states);
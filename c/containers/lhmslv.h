@@ -21,6 +21,7 @@
 // ----------------------------------------------------------------
 typedef struct _lhmslve_t {
 	int     ideal_index;
+	int     hash;
 	slls_t* key;
 	void*   pvvalue;
 	char    free_flags;
@@ -46,6 +47,9 @@ void   lhmslv_free(lhmslv_t* pmap);
 void*  lhmslv_put(lhmslv_t* pmap, slls_t* key, void* pvvalue, char free_flags);
 void*  lhmslv_get(lhmslv_t* pmap, slls_t* key);
 int    lhmslv_has_key(lhmslv_t* pmap, slls_t* key);
+// For keys whose slls_hash_func value is already known, e.g. from group_key_select.
+void*  lhmslv_put_with_hash(lhmslv_t* pmap, slls_t* key, int hash, void* pvvalue, char free_flags);
+void*  lhmslv_get_with_hash(lhmslv_t* pmap, slls_t* key, int hash);
 int    lhmslv_size(lhmslv_t* pmap);
 
 // Unit-test hook
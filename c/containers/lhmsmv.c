@@ -44,7 +44,7 @@
 #define EMPTY    0xce
 
 // ----------------------------------------------------------------
-static void lhmsmv_put_no_enlarge(lhmsmv_t* pmap, char* key, mv_t* pvalue, char free_flags);
+static void lhmsmv_put_no_enlarge(lhmsmv_t* pmap, char* key, int hash, mv_t* pvalue, char free_flags);
 static void lhmsmv_enlarge(lhmsmv_t* pmap);
 
 static void lhmsmv_init(lhmsmv_t *pmap, int length) {
@@ -124,8 +124,7 @@ void lhmsmv_free(lhmsmv_t* pmap) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int lhmsmv_find_index_for_key(lhmsmv_t* pmap, char* key, int* pideal_index) {
-	int hash = mlr_string_hash_func(key);
+static int lhmsmv_find_index_for_key(lhmsmv_t* pmap, char* key, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pmap->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -135,7 +134,7 @@ static int lhmsmv_find_index_for_key(lhmsmv_t* pmap, char* key, int* pideal_inde
 		if (pmap->states[index] == OCCUPIED) {
 			char* ekey = pe->key;
 			// Existing key found in chain.
-			if (streq(key, ekey))
+			if (pe->hash == hash && streq(key, ekey))
 				return index;
 		}
 		else if (pmap->states[index] == EMPTY) {
@@ -163,12 +162,13 @@ static int lhmsmv_find_index_for_key(lhmsmv_t* pmap, char* key, int* pideal_inde
 void lhmsmv_put(lhmsmv_t* pmap, char* key, mv_t* pvalue, char free_flags) {
 	if ((pmap->num_occupied + pmap->num_freed) >= (pmap->array_length*LOAD_FACTOR))
 		lhmsmv_enlarge(pmap);
-	lhmsmv_put_no_enlarge(pmap, key, pvalue, free_flags);
+	int hash = mlr_string_hash_func(key);
+	lhmsmv_put_no_enlarge(pmap, key, hash, pvalue, free_flags);
 }
 
-static void lhmsmv_put_no_enlarge(lhmsmv_t* pmap, char* key, mv_t* pvalue, char free_flags) {
+static void lhmsmv_put_no_enlarge(lhmsmv_t* pmap, char* key, int hash, mv_t* pvalue, char free_flags) {
 	int ideal_index = 0;
-	int index = lhmsmv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsmv_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsmve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -188,6 +188,7 @@ static void lhmsmv_put_no_enlarge(lhmsmv_t* pmap, char* key, mv_t* pvalue, char
 	} else if (pmap->states[index] == EMPTY) {
 		// End of chain.
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pe->key = key;
 		pe->value = *pvalue;
 		pe->free_flags = free_flags;
@@ -214,8 +215,9 @@ static void lhmsmv_put_no_enlarge(lhmsmv_t* pmap, char* key, mv_t* pvalue, char
 
 // ----------------------------------------------------------------
 mv_t* lhmsmv_get(lhmsmv_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsmv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsmv_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsmve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -230,8 +232,9 @@ mv_t* lhmsmv_get(lhmsmv_t* pmap, char* key) {
 
 // ----------------------------------------------------------------
 int lhmsmv_has_key(lhmsmv_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsmv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsmv_find_index_for_key(pmap, key, hash, &ideal_index);
 
 	if (pmap->states[index] == OCCUPIED)
 		return TRUE;
@@ -252,7 +255,7 @@ static void lhmsmv_enlarge(lhmsmv_t* pmap) {
 	lhmsmv_init(pmap, pmap->array_length*ENLARGEMENT_FACTOR);
 
 	for (lhmsmve_t* pe = old_head; pe != NULL; pe = pe->pnext) {
-		lhmsmv_put_no_enlarge(pmap, pe->key, &pe->value, pe->free_flags);
+		lhmsmv_put_no_enlarge(pmap, pe->key, pe->hash, &pe->value, pe->free_flags);
 	}
 	free(old_entries);
 	free(old_states);
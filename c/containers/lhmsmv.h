@@ -22,6 +22,7 @@
 // ----------------------------------------------------------------
 typedef struct _lhmsmve_t {
 	int   ideal_index;
+	int   hash;
 	char  free_flags;
 	char* key;
 	mv_t  value;
@@ -44,7 +44,7 @@
 #define EMPTY    0xce
 
 // ----------------------------------------------------------------
-static void lhmss_put_no_enlarge(lhmss_t* pmap, char* key, char* value, char free_flags);
+static void lhmss_put_no_enlarge(lhmss_t* pmap, char* key, int hash, char* value, char free_flags);
 static void lhmss_enlarge(lhmss_t* pmap);
 
 static void lhmss_init(lhmss_t *pmap, int length) {
@@ -100,8 +100,7 @@ void lhmss_free(lhmss_t* pmap) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int lhmss_find_index_for_key(lhmss_t* pmap, char* key, int* pideal_index) {
-	int hash = mlr_string_hash_func(key);
+static int lhmss_find_index_for_key(lhmss_t* pmap, char* key, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pmap->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -111,7 +110,7 @@ static int lhmss_find_index_for_key(lhmss_t* pmap, char* key, int* pideal_index)
 		if (pmap->states[index] == OCCUPIED) {
 			char* ekey = pe->key;
 			// Existing key found in chain.
-			if (streq(key, ekey))
+			if (pe->hash == hash && streq(key, ekey))
 				return index;
 		}
 		else if (pmap->states[index] == EMPTY) {
@@ -139,12 +138,13 @@ static int lhmss_find_index_for_key(lhmss_t* pmap, char* key, int* pideal_index)
 void lhmss_put(lhmss_t* pmap, char* key, char* value, char free_flags) {
 	if ((pmap->num_occupied + pmap->num_freed) >= (pmap->array_length*LOAD_FACTOR))
 		lhmss_enlarge(pmap);
-	lhmss_put_no_enlarge(pmap, key, value, free_flags);
+	int hash = mlr_string_hash_func(key);
+	lhmss_put_no_enlarge(pmap, key, hash, value, free_flags);
 }
 
-static void lhmss_put_no_enlarge(lhmss_t* pmap, char* key, char* value, char free_flags) {
+static void lhmss_put_no_enlarge(lhmss_t* pmap, char* key, int hash, char* value, char free_flags) {
 	int ideal_index = 0;
-	int index = lhmss_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmss_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsse_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -162,6 +162,7 @@ static void lhmss_put_no_enlarge(lhmss_t* pmap, char* key, char* value, char fre
 	} else if (pmap->states[index] == EMPTY) {
 		// End of chain.
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pe->key = key;
 		pe->value = value;
 		pe->free_flags = free_flags;
@@ -188,8 +189,9 @@ static void lhmss_put_no_enlarge(lhmss_t* pmap, char* key, char* value, char fre
 
 // ----------------------------------------------------------------
 char* lhmss_get(lhmss_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmss_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmss_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsse_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -204,8 +206,9 @@ char* lhmss_get(lhmss_t* pmap, char* key) {
 
 // ----------------------------------------------------------------
 int lhmss_has_key(lhmss_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmss_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmss_find_index_for_key(pmap, key, hash, &ideal_index);
 
 	if (pmap->states[index] == OCCUPIED)
 		return TRUE;
@@ -232,7 +235,7 @@ static void lhmss_enlarge(lhmss_t* pmap) {
 	lhmss_init(pmap, pmap->array_length*ENLARGEMENT_FACTOR);
 
 	for (lhmsse_t* pe = old_head; pe != NULL; pe = pe->pnext) {
-		lhmss_put_no_enlarge(pmap, pe->key, pe->value, pe->free_flags);
+		lhmss_put_no_enlarge(pmap, pe->key, pe->hash, pe->value, pe->free_flags);
 	}
 	free(old_entries);
 	free(old_states);
@@ -21,6 +21,7 @@
 // ----------------------------------------------------------------
 typedef struct _lhmsse_t {
 	int   ideal_index;
+	int   hash;
 	char  free_flags;
 	char* key;
 	char* value;
@@ -45,7 +45,7 @@
 #define EMPTY    0xce
 
 // ----------------------------------------------------------------
-static void lhmsv_put_no_enlarge(lhmsv_t* pmap, char* key, void* pvvalue, char free_flags);
+static void lhmsv_put_no_enlarge(lhmsv_t* pmap, char* key, int hash, void* pvvalue, char free_flags);
 static void lhmsv_enlarge(lhmsv_t* pmap);
 
 static void lhmsv_init(lhmsv_t *pmap, int length) {
@@ -107,8 +107,7 @@ void lhmsv_clear(lhmsv_t* pmap) {
 // ----------------------------------------------------------------
 // Used by get() and remove().
 // Returns >=0 for where the key is *or* should go (end of chain).
-static int lhmsv_find_index_for_key(lhmsv_t* pmap, char* key, int* pideal_index) {
-	int hash = mlr_string_hash_func(key);
+static int lhmsv_find_index_for_key(lhmsv_t* pmap, char* key, int hash, int* pideal_index) {
 	int index = mlr_canonical_mod(hash, pmap->array_length);
 	*pideal_index = index;
 	int num_tries = 0;
@@ -118,7 +117,7 @@ static int lhmsv_find_index_for_key(lhmsv_t* pmap, char* key, int* pideal_index)
 		if (pmap->states[index] == OCCUPIED) {
 			char* ekey = pe->key;
 			// Existing key found in chain.
-			if (streq(key, ekey))
+			if (pe->hash == hash && streq(key, ekey))
 				return index;
 		}
 		else if (pmap->states[index] == EMPTY) {
@@ -146,12 +145,13 @@ static int lhmsv_find_index_for_key(lhmsv_t* pmap, char* key, int* pideal_index)
 void lhmsv_put(lhmsv_t* pmap, char* key, void* pvvalue, char free_flags) {
 	if ((pmap->num_occupied + pmap->num_freed) >= (pmap->array_length*LOAD_FACTOR))
 		lhmsv_enlarge(pmap);
-	lhmsv_put_no_enlarge(pmap, key, pvvalue, free_flags);
+	int hash = mlr_string_hash_func(key);
+	lhmsv_put_no_enlarge(pmap, key, hash, pvvalue, free_flags);
 }
 
-static void lhmsv_put_no_enlarge(lhmsv_t* pmap, char* key, void* pvvalue, char free_flags) {
+static void lhmsv_put_no_enlarge(lhmsv_t* pmap, char* key, int hash, void* pvvalue, char free_flags) {
 	int ideal_index = 0;
-	int index = lhmsv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsv_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED) {
@@ -161,6 +161,7 @@ static void lhmsv_put_no_enlarge(lhmsv_t* pmap, char* key, void* pvvalue, char f
 	} else if (pmap->states[index] == EMPTY) {
 		// End of chain.
 		pe->ideal_index = ideal_index;
+		pe->hash = hash;
 		pe->key = key;
 		pe->pvvalue = pvvalue;
 		pe->free_flags = free_flags;
@@ -187,8 +188,9 @@ static void lhmsv_put_no_enlarge(lhmsv_t* pmap, char* key, void* pvvalue, char f
 
 // ----------------------------------------------------------------
 void* lhmsv_get(lhmsv_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsv_find_index_for_key(pmap, key, hash, &ideal_index);
 	lhmsve_t* pe = &pmap->entries[index];
 
 	if (pmap->states[index] == OCCUPIED)
@@ -203,8 +205,9 @@ void* lhmsv_get(lhmsv_t* pmap, char* key) {
 
 // ----------------------------------------------------------------
 int  lhmsv_has_key(lhmsv_t* pmap, char* key) {
+	int hash = mlr_string_hash_func(key);
 	int ideal_index = 0;
-	int index = lhmsv_find_index_for_key(pmap, key, &ideal_index);
+	int index = lhmsv_find_index_for_key(pmap, key, hash, &ideal_index);
 
 	if (pmap->states[index] == OCCUPIED)
 		return TRUE;
@@ -225,7 +228,7 @@ static void lhmsv_enlarge(lhmsv_t* pmap) {
 	lhmsv_init(pmap, pmap->array_length*ENLARGEMENT_FACTOR);
 
 	for (lhmsve_t* pe = old_head; pe != NULL; pe = pe->pnext) {
-		lhmsv_put_no_enlarge(pmap, pe->key, pe->pvvalue, pe->free_flags);
+		lhmsv_put_no_enlarge(pmap, pe->key, pe->hash, pe->pvvalue, pe->free_flags);
 	}
 	free(old_entries);
 	free(old_states);
@@ -22,6 +22,7 @@
 // ----------------------------------------------------------------
 typedef struct _lhmsve_t {
 	int   ideal_index;
+	int   hash;
 	char* key;
 	void* pvvalue;
 	char  free_flags;
@@ -11,7 +11,19 @@
 
 #define SB_ALLOC_LENGTH 256
 
+// See lrec_alloc_entry.
+struct _lrece_block_t {
+	struct _lrece_block_t* pnext;
+	int     capacity;
+	int     used;
+	lrece_t entries[];
+};
+
+#define LREC_INITIAL_BLOCK_CAPACITY 8
+
 static lrece_t* lrec_find_entry(lrec_t* prec, char* key);
+static lrece_t* lrec_alloc_entry(lrec_t* prec);
+static void lrec_release_entry(lrec_t* prec, lrece_t* pe);
 static void lrec_link_at_head(lrec_t* prec, lrece_t* pe);
 static void lrec_link_at_tail(lrec_t* prec, lrece_t* pe);
 
@@ -75,9 +87,12 @@ static void lrec_free_contents(lrec_t* prec) {
 			free(pe->key);
 		if (pe->free_flags & FREE_ENTRY_VALUE)
 			free(pe->value);
-		lrece_t* ope = pe;
 		pe = pe->pnext;
-		free(ope);
+	}
+	for (lrece_block_t* pblock = prec->pentry_blocks; pblock != NULL; /*pblock = pblock->pnext*/) {
+		lrece_block_t* opblock = pblock;
+		pblock = pblock->pnext;
+		free(opblock);
 	}
 	prec->pfree_backing_func(prec);
 }
@@ -102,6 +117,7 @@ void lrec_free(lrec_t* prec) {
 // ----------------------------------------------------------------
 lrec_t* lrec_copy(lrec_t* pinrec) {
 	lrec_t* poutrec = lrec_unbacked_alloc();
+	lrec_reserve(poutrec, pinrec->field_count);
 	for (lrece_t* pe = pinrec->phead; pe != NULL; pe = pe->pnext) {
 		lrec_put(poutrec, mlr_strdup_or_die(pe->key), mlr_strdup_or_die(pe->value),
 			FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
@@ -109,6 +125,16 @@ lrec_t* lrec_copy(lrec_t* pinrec) {
 	return poutrec;
 }
 
+// ----------------------------------------------------------------
+size_t lrec_approximate_size(lrec_t* prec) {
+	size_t size = sizeof(lrec_t);
+	for (lrece_block_t* pblock = prec->pentry_blocks; pblock != NULL; pblock = pblock->pnext)
+		size += sizeof(lrece_block_t) + pblock->capacity * sizeof(lrece_t);
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext)
+		size += strlen(pe->key) + 1 + (pe->value == NULL ? 0 : strlen(pe->value) + 1);
+	return size;
+}
+
 // ----------------------------------------------------------------
 void lrec_put(lrec_t* prec, char* key, char* value, char free_flags) {
 	lrece_t* pe = lrec_find_entry(prec, key);
@@ -125,7 +151,7 @@ void lrec_put(lrec_t* prec, char* key, char* value, char free_flags) {
 		else
 			pe->free_flags &= ~FREE_ENTRY_VALUE;
 	} else {
-		pe = mlr_malloc_or_die(sizeof(lrece_t));
+		pe = lrec_alloc_entry(prec);
 		pe->key         = key;
 		pe->value       = value;
 		pe->free_flags  = free_flags;
@@ -161,7 +187,7 @@ void lrec_put_ext(lrec_t* prec, char* key, char* value, char free_flags, char qu
 		else
 			pe->free_flags &= ~FREE_ENTRY_VALUE;
 	} else {
-		pe = mlr_malloc_or_die(sizeof(lrece_t));
+		pe = lrec_alloc_entry(prec);
 		pe->key         = key;
 		pe->value       = value;
 		pe->free_flags  = free_flags;
@@ -194,7 +220,7 @@ void lrec_prepend(lrec_t* prec, char* key, char* value, char free_flags) {
 		if (free_flags & FREE_ENTRY_VALUE)
 			pe->free_flags |= FREE_ENTRY_VALUE;
 	} else {
-		pe = mlr_malloc_or_die(sizeof(lrece_t));
+		pe = lrec_alloc_entry(prec);
 		pe->key         = key;
 		pe->value       = value;
 		pe->free_flags  = free_flags;
@@ -227,7 +253,7 @@ lrece_t* lrec_put_after(lrec_t* prec, lrece_t* pd, char* key, char* value, char
 		if (free_flags & FREE_ENTRY_VALUE)
 			pe->free_flags |= FREE_ENTRY_VALUE;
 	} else { // Insert after specified entry
-		pe = mlr_malloc_or_die(sizeof(lrece_t));
+		pe = lrec_alloc_entry(prec);
 		pe->key         = key;
 		pe->value       = value;
 		pe->free_flags  = free_flags;
@@ -339,7 +365,7 @@ void lrec_remove(lrec_t* prec, char* key) {
 		free(pe->value);
 	}
 
-	free(pe);
+	lrec_release_entry(prec, pe);
 }
 
 // ----------------------------------------------------------------
@@ -357,7 +383,7 @@ void lrec_remove_by_position(lrec_t* prec, int position) { // 1-up not 0-up
 		free(pe->value);
 	}
 
-	free(pe);
+	lrec_release_entry(prec, pe);
 }
 
 // Before:
@@ -403,7 +429,7 @@ void lrec_rename(lrec_t* prec, char* old_key, char* new_key, int new_needs_freei
 			else
 				pold->free_flags &= ~FREE_ENTRY_KEY;
 			lrec_unlink(prec, pnew);
-			free(pnew);
+			lrec_release_entry(prec, pnew);
 		}
 	}
 }
@@ -434,7 +460,7 @@ void  lrec_rename_at_position(lrec_t* prec, int position, char* new_key, int new
 	}
 	if (pother != NULL) {
 		lrec_unlink(prec, pother);
-		free(pother);
+		lrec_release_entry(prec, pother);
 	}
 }
 
@@ -498,7 +524,7 @@ void  lrec_label(lrec_t* prec, slls_t* pnames_as_list, hss_t* pnames_as_set) {
 				free(pe->value);
 			}
 			lrec_unlink(prec, pe);
-			free(pe);
+			lrec_release_entry(prec, pe);
 			pe = pnext;
 		} else {
 			pe = pe->pnext;
@@ -548,7 +574,7 @@ void lrec_unlink_and_free(lrec_t* prec, lrece_t* pe) {
 	if (pe->free_flags & FREE_ENTRY_VALUE)
 		free(pe->value);
 	lrec_unlink(prec, pe);
-	free(pe);
+	lrec_release_entry(prec, pe);
 }
 
 // ----------------------------------------------------------------
@@ -585,6 +611,45 @@ static void lrec_link_at_tail(lrec_t* prec, lrece_t* pe) {
 	prec->field_count++;
 }
 
+// ----------------------------------------------------------------
+// Entries are handed out in order from the current block, so the entries of a
+// record built front to back are contiguous. Removed entries are kept on a
+// free list for reuse by the same record; blocks are freed with the record.
+
+static lrece_block_t* lrec_alloc_block(lrec_t* prec, int capacity) {
+	lrece_block_t* pblock = mlr_malloc_or_die(sizeof(lrece_block_t) + capacity * sizeof(lrece_t));
+	pblock->pnext      = prec->pentry_blocks;
+	pblock->capacity   = capacity;
+	pblock->used       = 0;
+	prec->pentry_blocks = pblock;
+	return pblock;
+}
+
+static lrece_t* lrec_alloc_entry(lrec_t* prec) {
+	if (prec->pfree_entries != NULL) {
+		lrece_t* pe = prec->pfree_entries;
+		prec->pfree_entries = pe->pnext;
+		return pe;
+	}
+	lrece_block_t* pblock = prec->pentry_blocks;
+	if (pblock == NULL)
+		pblock = lrec_alloc_block(prec, LREC_INITIAL_BLOCK_CAPACITY);
+	else if (pblock->used == pblock->capacity)
+		pblock = lrec_alloc_block(prec, 2 * pblock->capacity);
+	return &pblock->entries[pblock->used++];
+}
+
+static void lrec_release_entry(lrec_t* prec, lrece_t* pe) {
+	pe->pnext = prec->pfree_entries;
+	prec->pfree_entries = pe;
+}
+
+void lrec_reserve(lrec_t* prec, int field_count) {
+	lrece_block_t* pblock = prec->pentry_blocks;
+	if (pblock == NULL || pblock->capacity - pblock->used < field_count)
+		lrec_alloc_block(prec, field_count < LREC_INITIAL_BLOCK_CAPACITY ? LREC_INITIAL_BLOCK_CAPACITY : field_count);
+}
+
 // ----------------------------------------------------------------
 void lrec_dump(lrec_t* prec) {
 	lrec_dump_fp(prec, stdout);
@@ -6,6 +6,9 @@
 // Design:
 //
 // * It keeps a doubly-linked list of key-value pairs.
+// * The list entries are allocated in blocks owned by the record, so that a
+//   record built field by field costs a few mallocs rather than one per field,
+//   and its entries are adjacent in memory.
 // * No hash functions are computed when the map is written to or read from.
 // * Gets are implemented by sequential scan through the list: given a key,
 //   the key-value pairs are scanned through until a match is (or is not) found.
@@ -43,6 +46,7 @@
 #ifndef LREC_H
 #define LREC_H
 
+#include <stddef.h>
 #include "lib/free_flags.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
@@ -54,6 +58,9 @@
 struct _lrec_t; // forward reference
 typedef struct _lrec_t lrec_t;
 
+// Storage for a record's entries; see lrec.c.
+typedef struct _lrece_block_t lrece_block_t;
+
 typedef void lrec_free_func_t(lrec_t* prec);
 
 // ----------------------------------------------------------------
@@ -78,6 +85,11 @@ struct _lrec_t {
 	lrece_t* phead;
 	lrece_t* ptail;
 
+	// The entries are allocated from blocks belonging to the record, rather
+	// than one malloc each, and are all freed at once with the record.
+	lrece_block_t* pentry_blocks;
+	lrece_t*       pfree_entries; // Removed entries for reuse, linked by pnext
+
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	// See comments above free_flags. Used to track a mallocked pointer to be
 	// freed at lrec_free().
@@ -89,6 +101,15 @@ struct _lrec_t {
 	// For XTAB format.
 	slls_t* pxtab_lines;
 
+	// For mmap-backed DKVP, NIDX, and CSV-lite formats: the segment of the
+	// mapped file which the keys and values point into. This is reference-
+	// counted by the file reader; see input/file_reader_mmap.h.
+	void* pvmmap_segment;
+
+	// For JSON format: the parsed JSON object which the keys and values point
+	// into. See input/mlr_json_adapter.h.
+	void* pvjson_value;
+
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	// Format-dependent virtual-function pointer:
 	lrec_free_func_t* pfree_backing_func;
@@ -102,10 +123,18 @@ lrec_t* lrec_csvlite_alloc(char* data_line);
 lrec_t* lrec_csv_alloc(char* data_line);
 lrec_t* lrec_xtab_alloc(slls_t* pxtab_lines);
 
+// Makes room for this many more fields without further allocation. Optional;
+// for use by record-readers which know the field count up front.
+void lrec_reserve(lrec_t* prec, int field_count);
+
 void lrec_clear(lrec_t* prec);
 void  lrec_free(lrec_t* prec);
 lrec_t* lrec_copy(lrec_t* pinrec);
 
+// Approximate bytes of memory held by the record, for verbs which keep records
+// within a memory budget: entries plus key and value strings.
+size_t lrec_approximate_size(lrec_t* prec);
+
 // The only difference between lrec_put and lrec_prepend is that the latter
 // adds to the end of the record, while the former adds to the beginning.
 //
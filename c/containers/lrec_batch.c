@@ -0,0 +1,25 @@
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "containers/lrec_batch.h"
+
+// ----------------------------------------------------------------
+lrec_batch_t* lrec_batch_alloc(int capacity) {
+	lrec_batch_t* pbatch = mlr_malloc_or_die(sizeof(lrec_batch_t));
+	pbatch->length   = 0;
+	pbatch->capacity = capacity;
+	pbatch->pentries = mlr_malloc_or_die(capacity * sizeof(lrec_batch_entry_t));
+	return pbatch;
+}
+
+void lrec_batch_free(lrec_batch_t* pbatch) {
+	if (pbatch == NULL)
+		return;
+	free(pbatch->pentries);
+	free(pbatch);
+}
+
+// ----------------------------------------------------------------
+void lrec_batch_grow(lrec_batch_t* pbatch) {
+	pbatch->capacity *= 2;
+	pbatch->pentries = mlr_realloc_or_die(pbatch->pentries, pbatch->capacity * sizeof(lrec_batch_entry_t));
+}
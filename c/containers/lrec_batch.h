@@ -0,0 +1,40 @@
+// ================================================================
+// Array of records, passed in bulk from the record-reader through the mappers
+// to the record-writer. Each record is held along with the NR and FNR it was
+// read with, since a batch may be consumed some time after its records were
+// read. The array is reused from one batch to the next; it grows on append as
+// needed, since a mapper may produce more records than it was given.
+// ================================================================
+
+#ifndef LREC_BATCH_H
+#define LREC_BATCH_H
+
+#include "containers/lrec.h"
+
+typedef struct _lrec_batch_entry_t {
+	lrec_t*   prec;
+	long long nr;
+	long long fnr;
+} lrec_batch_entry_t;
+
+typedef struct _lrec_batch_t {
+	int length;
+	int capacity;
+	lrec_batch_entry_t* pentries;
+} lrec_batch_t;
+
+lrec_batch_t* lrec_batch_alloc(int capacity);
+// Frees the array but not the records.
+void lrec_batch_free(lrec_batch_t* pbatch);
+void lrec_batch_grow(lrec_batch_t* pbatch);
+
+static inline void lrec_batch_append(lrec_batch_t* pbatch, lrec_t* prec, long long nr, long long fnr) {
+	if (pbatch->length == pbatch->capacity)
+		lrec_batch_grow(pbatch);
+	lrec_batch_entry_t* pentry = &pbatch->pentries[pbatch->length++];
+	pentry->prec = prec;
+	pentry->nr   = nr;
+	pentry->fnr  = fnr;
+}
+
+#endif // LREC_BATCH_H
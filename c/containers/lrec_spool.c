@@ -0,0 +1,235 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "containers/lrec_spool.h"
+
+#define LREC_SPOOL_BUFFER_SIZE (1 << 16)
+
+// In the per-field flags byte, along with the record's quote flags.
+#define LREC_SPOOL_NULL_VALUE 0x80
+
+static void write_or_die(lrec_spool_t* pspool, void* pvdata, size_t length);
+static void read_or_die(lrec_spool_t* pspool, void* pvdata, size_t length);
+static int  put_varint(char* p, unsigned long long value);
+static unsigned long long get_varint(char** pp);
+static unsigned long long read_varint_or_die(lrec_spool_t* pspool);
+
+// ----------------------------------------------------------------
+lrec_spool_t* lrec_spool_alloc(char* tmpdir) {
+	int fd = lrec_spool_create_temp_file(tmpdir);
+	FILE* fp = fdopen(fd, "w+b");
+	if (fp == NULL) {
+		fprintf(stderr, "%s: could not open temporary file: %s.\n", MLR_GLOBALS.bargv0, strerror(errno));
+		exit(1);
+	}
+	setvbuf(fp, NULL, _IOFBF, LREC_SPOOL_BUFFER_SIZE);
+
+	lrec_spool_t* pspool = mlr_malloc_or_die(sizeof(lrec_spool_t));
+	pspool->fp          = fp;
+	pspool->num_records = 0LL;
+	pspool->num_read    = 0LL;
+	pspool->read_offset = 0LL;
+	pspool->is_reading  = FALSE;
+	pspool->pencoding   = NULL;
+	pspool->encoding_capacity = 0;
+	return pspool;
+}
+
+int lrec_spool_create_temp_file(char* tmpdir) {
+	if (tmpdir == NULL)
+		tmpdir = getenv("TMPDIR");
+	if (tmpdir == NULL)
+		tmpdir = "/tmp";
+
+	// This template will be overwritten by mkstemp
+	char* path = mlr_paste_2_strings(tmpdir, "/mlr.spool.XXXXXX");
+	int fd = mkstemp(path);
+	if (fd < 0) {
+		fprintf(stderr, "%s: could not create temporary file in \"%s\": %s.\n",
+			MLR_GLOBALS.bargv0, tmpdir, strerror(errno));
+		exit(1);
+	}
+	unlink(path);
+	free(path);
+	return fd;
+}
+
+void lrec_spool_free(lrec_spool_t* pspool) {
+	if (pspool == NULL)
+		return;
+	fclose(pspool->fp);
+	free(pspool->pencoding);
+	free(pspool);
+}
+
+// ----------------------------------------------------------------
+void lrec_spool_write(lrec_spool_t* pspool, lrec_t* prec) {
+	MLR_INTERNAL_CODING_ERROR_IF(pspool->is_reading);
+
+	// Encode the fields first, after room for the length prefix, since the
+	// prefix isn't known until they're done.
+	size_t length = lrec_spool_encode(prec, &pspool->pencoding, &pspool->encoding_capacity, 10);
+	char* pstart = pspool->pencoding + 10;
+
+	char prefix[10];
+	int prefix_length = put_varint(prefix, length);
+	pstart -= prefix_length;
+	memcpy(pstart, prefix, prefix_length);
+	write_or_die(pspool, pstart, prefix_length + length);
+	pspool->num_records++;
+}
+
+// ----------------------------------------------------------------
+size_t lrec_spool_encode(lrec_t* prec, char** ppbuffer, size_t* pcapacity, size_t offset) {
+	// Field count, then flags byte, key, and value per field; the varint is at
+	// most ten bytes.
+	size_t max_length = 10;
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext)
+		max_length += 1 + strlen(pe->key) + 1 + (pe->value == NULL ? 0 : strlen(pe->value)) + 1;
+	if (offset + max_length > *pcapacity) {
+		*pcapacity = 2 * (offset + max_length);
+		*ppbuffer = mlr_realloc_or_die(*ppbuffer, *pcapacity);
+	}
+
+	char* pstart = *ppbuffer + offset;
+	char* p = pstart;
+	p += put_varint(p, prec->field_count);
+	for (lrece_t* pe = prec->phead; pe != NULL; pe = pe->pnext) {
+		*p++ = (pe->value == NULL) ? (pe->quote_flags | LREC_SPOOL_NULL_VALUE) : pe->quote_flags;
+		size_t key_length = strlen(pe->key) + 1;
+		memcpy(p, pe->key, key_length);
+		p += key_length;
+		if (pe->value == NULL) {
+			*p++ = 0;
+		} else {
+			size_t value_length = strlen(pe->value) + 1;
+			memcpy(p, pe->value, value_length);
+			p += value_length;
+		}
+	}
+	return p - pstart;
+}
+
+// ----------------------------------------------------------------
+void lrec_spool_rewind(lrec_spool_t* pspool) {
+	if (fflush(pspool->fp) != 0 || fseeko(pspool->fp, 0, SEEK_SET) != 0) {
+		fprintf(stderr, "%s: could not rewind temporary file: %s.\n", MLR_GLOBALS.bargv0, strerror(errno));
+		exit(1);
+	}
+	pspool->num_read    = 0LL;
+	pspool->read_offset = 0LL;
+	pspool->is_reading  = TRUE;
+}
+
+// ----------------------------------------------------------------
+lrec_spool_position_t lrec_spool_tell(lrec_spool_t* pspool) {
+	MLR_INTERNAL_CODING_ERROR_UNLESS(pspool->is_reading);
+	lrec_spool_position_t position = { .offset = pspool->read_offset, .num_read = pspool->num_read };
+	return position;
+}
+
+void lrec_spool_seek(lrec_spool_t* pspool, lrec_spool_position_t position) {
+	MLR_INTERNAL_CODING_ERROR_UNLESS(pspool->is_reading);
+	if (fseeko(pspool->fp, position.offset, SEEK_SET) != 0) {
+		fprintf(stderr, "%s: could not seek temporary file: %s.\n", MLR_GLOBALS.bargv0, strerror(errno));
+		exit(1);
+	}
+	pspool->num_read    = position.num_read;
+	pspool->read_offset = position.offset;
+}
+
+// ----------------------------------------------------------------
+lrec_t* lrec_spool_read(lrec_spool_t* pspool) {
+	MLR_INTERNAL_CODING_ERROR_UNLESS(pspool->is_reading);
+	if (pspool->num_read >= pspool->num_records)
+		return NULL;
+
+	size_t length = read_varint_or_die(pspool);
+	char* pchars = mlr_malloc_or_die(length);
+	read_or_die(pspool, pchars, length);
+	pspool->num_read++;
+	pspool->read_offset += length;
+	return lrec_spool_decode(pchars);
+}
+
+// The record frees the strings as it would a DKVP line.
+lrec_t* lrec_spool_decode(char* pchars) {
+	char* p = pchars;
+	int field_count = get_varint(&p);
+	lrec_t* prec = lrec_dkvp_alloc(pchars);
+	lrec_reserve(prec, field_count);
+	for (int i = 0; i < field_count; i++) {
+		char flags = *p++;
+		char* key = p;
+		p += strlen(p) + 1;
+		char* value = p;
+		p += strlen(p) + 1;
+		if (flags & LREC_SPOOL_NULL_VALUE)
+			lrec_put_ext(prec, key, NULL, NO_FREE, flags & ~LREC_SPOOL_NULL_VALUE);
+		else
+			lrec_put_ext(prec, key, value, NO_FREE, flags);
+	}
+	return prec;
+}
+
+// ----------------------------------------------------------------
+static void write_or_die(lrec_spool_t* pspool, void* pvdata, size_t length) {
+	if (fwrite(pvdata, 1, length, pspool->fp) != length) {
+		fprintf(stderr, "%s: could not write temporary file: %s.\n", MLR_GLOBALS.bargv0, strerror(errno));
+		exit(1);
+	}
+}
+
+static void read_or_die(lrec_spool_t* pspool, void* pvdata, size_t length) {
+	if (fread(pvdata, 1, length, pspool->fp) != length) {
+		fprintf(stderr, "%s: could not read temporary file: %s.\n", MLR_GLOBALS.bargv0,
+			ferror(pspool->fp) ? strerror(errno) : "unexpected end of file");
+		exit(1);
+	}
+}
+
+// LEB128: seven bits per byte, low-order first, high bit set on all but the last.
+static int put_varint(char* p, unsigned long long value) {
+	int n = 0;
+	while (value >= 0x80) {
+		p[n++] = (char)((value & 0x7f) | 0x80);
+		value >>= 7;
+	}
+	p[n++] = (char)value;
+	return n;
+}
+
+static unsigned long long get_varint(char** pp) {
+	unsigned char* p = (unsigned char*)*pp;
+	unsigned long long value = 0;
+	int shift = 0;
+	while (*p & 0x80) {
+		value |= (unsigned long long)(*p++ & 0x7f) << shift;
+		shift += 7;
+	}
+	value |= (unsigned long long)*p++ << shift;
+	*pp = (char*)p;
+	return value;
+}
+
+static unsigned long long read_varint_or_die(lrec_spool_t* pspool) {
+	char bytes[10];
+	int n = 0;
+	while (TRUE) {
+		int c = getc(pspool->fp);
+		if (c == EOF || n == sizeof(bytes)) {
+			fprintf(stderr, "%s: could not read temporary file: unexpected end of file.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+		bytes[n++] = c;
+		if (!(c & 0x80))
+			break;
+	}
+	pspool->read_offset += n;
+	char* p = bytes;
+	return get_varint(&p);
+}
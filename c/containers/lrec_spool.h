@@ -0,0 +1,69 @@
+// ================================================================
+// Sequential temporary file of records, for verbs which hold on to more
+// records than fit in memory. Records are written one after another, then the
+// spool is rewound and they are read back in the same order.
+//
+// The encoding is binary and private to the process: per record, the varint
+// length of the rest, then the varint field count, then for each field a flags
+// byte and the NUL-terminated key and value. Reading a record back is one
+// malloc for all of its strings, which the record then owns.
+//
+// The file is unlinked as soon as it's created, so nothing is left behind if
+// Miller exits early.
+// ================================================================
+
+#ifndef LREC_SPOOL_H
+#define LREC_SPOOL_H
+
+#include <stdio.h>
+#include "containers/lrec.h"
+
+typedef struct _lrec_spool_t {
+	FILE*     fp;
+	long long num_records;
+	long long num_read;
+	long long read_offset; // Of the next record to read
+	int       is_reading;
+	char*     pencoding; // Scratch space for lrec_spool_write
+	size_t    encoding_capacity;
+} lrec_spool_t;
+
+// The temporary file goes in tmpdir; if that's null, in $TMPDIR, else /tmp.
+// Exits the process if the file can't be created.
+lrec_spool_t* lrec_spool_alloc(char* tmpdir);
+void lrec_spool_free(lrec_spool_t* pspool);
+
+// The caller retains ownership of the record. Exits the process on write
+// error, e.g. disk full.
+void lrec_spool_write(lrec_spool_t* pspool, lrec_t* prec);
+
+// Ends writing; subsequent reads start from the first record.
+void lrec_spool_rewind(lrec_spool_t* pspool);
+
+// Returns null after the last record. The caller owns the returned record.
+lrec_t* lrec_spool_read(lrec_spool_t* pspool);
+
+// While reading: where the next record is, for going back to it later.
+typedef struct _lrec_spool_position_t {
+	long long offset;
+	long long num_read;
+} lrec_spool_position_t;
+lrec_spool_position_t lrec_spool_tell(lrec_spool_t* pspool);
+void lrec_spool_seek(lrec_spool_t* pspool, lrec_spool_position_t position);
+
+// ----------------------------------------------------------------
+// The encoding of one record, without its length prefix, for other containers
+// holding records this way (see lrec_store.h).
+
+// Encodes the record at the given offset into the buffer, growing it as
+// needed. Returns the length of the encoding.
+size_t lrec_spool_encode(lrec_t* prec, char** ppbuffer, size_t* pcapacity, size_t offset);
+
+// Takes ownership of the malloced encoding, which the record then frees.
+lrec_t* lrec_spool_decode(char* pchars);
+
+// Returns the descriptor of a new, already unlinked, file in tmpdir as for
+// lrec_spool_alloc. Exits the process if the file can't be created.
+int lrec_spool_create_temp_file(char* tmpdir);
+
+#endif // LREC_SPOOL_H
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "containers/lrec_spool.h"
+#include "containers/lrec_store.h"
+
+// Bytes read from the file at a time, at least.
+#define LREC_STORE_WINDOW_SIZE (1 << 20)
+
+static void lrec_store_spill(lrec_store_t* pstore);
+static void lrec_store_load_window(lrec_store_t* pstore, long long offset, long long end);
+
+// ----------------------------------------------------------------
+lrec_store_t* lrec_store_alloc(long long mem_budget, char* tmpdir) {
+	lrec_store_t* pstore = mlr_malloc_or_die(sizeof(lrec_store_t));
+	pstore->num_records      = 0LL;
+	pstore->offsets_capacity = 1024;
+	pstore->poffsets         = mlr_malloc_or_die(pstore->offsets_capacity * sizeof(long long));
+	pstore->poffsets[0]      = 0LL;
+	pstore->pbuffer          = NULL;
+	pstore->buffer_length    = 0;
+	pstore->buffer_capacity  = 0;
+	pstore->mem_budget       = mem_budget;
+	pstore->tmpdir           = tmpdir;
+	pstore->fd               = -1;
+	pstore->spilled_length   = 0LL;
+	pstore->pwindow          = NULL;
+	pstore->window_start     = 0LL;
+	pstore->window_length    = 0;
+	pstore->window_capacity  = 0;
+	pstore->last_offset      = 0LL;
+	return pstore;
+}
+
+void lrec_store_free(lrec_store_t* pstore) {
+	if (pstore == NULL)
+		return;
+	if (pstore->fd >= 0)
+		close(pstore->fd);
+	free(pstore->poffsets);
+	free(pstore->pbuffer);
+	free(pstore->pwindow);
+	free(pstore);
+}
+
+// ----------------------------------------------------------------
+void lrec_store_append(lrec_store_t* pstore, lrec_t* prec) {
+	if (pstore->num_records + 1 >= pstore->offsets_capacity) {
+		pstore->offsets_capacity *= 2;
+		pstore->poffsets = mlr_realloc_or_die(pstore->poffsets, pstore->offsets_capacity * sizeof(long long));
+	}
+	size_t length = lrec_spool_encode(prec, &pstore->pbuffer, &pstore->buffer_capacity, pstore->buffer_length);
+	pstore->buffer_length += length;
+	pstore->num_records++;
+	pstore->poffsets[pstore->num_records] = pstore->poffsets[pstore->num_records - 1] + length;
+
+	if (pstore->mem_budget > 0LL && pstore->buffer_length > pstore->mem_budget)
+		lrec_store_spill(pstore);
+}
+
+// Appends the buffer to the file, leaving it empty.
+static void lrec_store_spill(lrec_store_t* pstore) {
+	if (pstore->fd < 0)
+		pstore->fd = lrec_spool_create_temp_file(pstore->tmpdir);
+	char* p = pstore->pbuffer;
+	size_t remaining = pstore->buffer_length;
+	while (remaining > 0) {
+		ssize_t n = write(pstore->fd, p, remaining);
+		if (n < 0) {
+			if (errno == EINTR)
+				continue;
+			fprintf(stderr, "%s: could not write temporary file: %s.\n", MLR_GLOBALS.bargv0, strerror(errno));
+			exit(1);
+		}
+		p += n;
+		remaining -= n;
+	}
+	pstore->spilled_length += pstore->buffer_length;
+	pstore->buffer_length = 0;
+}
+
+// ----------------------------------------------------------------
+lrec_t* lrec_store_get(lrec_store_t* pstore, long long index) {
+	MLR_INTERNAL_CODING_ERROR_IF(index < 0 || index >= pstore->num_records);
+	long long offset = pstore->poffsets[index];
+	long long end    = pstore->poffsets[index + 1];
+	char* pchars = mlr_malloc_or_die(end - offset);
+
+	if (offset >= pstore->spilled_length) {
+		memcpy(pchars, &pstore->pbuffer[offset - pstore->spilled_length], end - offset);
+	} else {
+		if (offset < pstore->window_start || end > pstore->window_start + (long long)pstore->window_length)
+			lrec_store_load_window(pstore, offset, end);
+		memcpy(pchars, &pstore->pwindow[offset - pstore->window_start], end - offset);
+	}
+	pstore->last_offset = offset;
+
+	return lrec_spool_decode(pchars);
+}
+
+// Reads from the file a window containing the bytes from offset to end. If
+// the last read was not far behind, the window starts at offset; if not far
+// ahead, it ends at end; otherwise reads look random, and it's just those
+// bytes.
+static void lrec_store_load_window(lrec_store_t* pstore, long long offset, long long end) {
+	long long length = end - offset;
+	long long start = offset;
+	if (length < LREC_STORE_WINDOW_SIZE) {
+		if (offset >= pstore->last_offset && offset - pstore->last_offset < LREC_STORE_WINDOW_SIZE) {
+			length = LREC_STORE_WINDOW_SIZE;
+		} else if (offset < pstore->last_offset && pstore->last_offset - offset < LREC_STORE_WINDOW_SIZE) {
+			length = LREC_STORE_WINDOW_SIZE;
+			start = end - length;
+		}
+	}
+	if (start < 0LL)
+		start = 0LL;
+	if (start + length > pstore->spilled_length)
+		length = pstore->spilled_length - start;
+
+	if (length > pstore->window_capacity) {
+		free(pstore->pwindow);
+		pstore->window_capacity = length;
+		pstore->pwindow = mlr_malloc_or_die(pstore->window_capacity);
+	}
+	long long num_read = 0LL;
+	while (num_read < length) {
+		ssize_t n = pread(pstore->fd, &pstore->pwindow[num_read], length - num_read, start + num_read);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0) {
+			fprintf(stderr, "%s: could not read temporary file: %s.\n", MLR_GLOBALS.bargv0,
+				(n < 0) ? strerror(errno) : "unexpected end of file");
+			exit(1);
+		}
+		num_read += n;
+	}
+	pstore->window_start  = start;
+	pstore->window_length = length;
+}
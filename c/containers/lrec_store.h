@@ -0,0 +1,57 @@
+// ================================================================
+// Store of records for verbs which retain their whole input before producing
+// output: tac, shuffle, bootstrap, fraction, count-similar, unsparsify.
+//
+// Records are held encoded as in lrec_spool.h, end to end in one buffer, which
+// costs little more than their text, rather than as lrec_t's with their
+// per-field allocations. Given a memory budget, whenever the buffer exceeds it
+// its contents are appended to a temporary file. Either way records are read
+// back by index -- in order, in reverse, or at random -- with sequential reads
+// from the file going through a window of it held in memory.
+//
+// Only the encodings are budgeted: an offset per record is always kept in
+// memory.
+// ================================================================
+
+#ifndef LREC_STORE_H
+#define LREC_STORE_H
+
+#include "containers/lrec.h"
+
+// Records per piece of output, for verbs returning them a piece at a time at
+// end of stream (see mapping/mapper.h).
+#define LREC_STORE_OUTPUT_PIECE_SIZE 1024
+
+typedef struct _lrec_store_t {
+	long long  num_records;
+	long long* poffsets;         // Per record, then one past the last
+	long long  offsets_capacity;
+
+	char*      pbuffer;          // The encodings from spilled_length on
+	size_t     buffer_length;
+	size_t     buffer_capacity;
+	long long  mem_budget;       // Bytes of encodings to hold; 0 for no limit
+	char*      tmpdir;           // Null for the default
+
+	int        fd;               // -1 until spilling
+	long long  spilled_length;   // Bytes in the file
+	char*      pwindow;          // Bytes of the file from window_start on
+	long long  window_start;
+	size_t     window_length;
+	size_t     window_capacity;
+	long long  last_offset;      // Of the last read, to tell which way reads are going
+} lrec_store_t;
+
+// The temporary file, if needed, goes in tmpdir as for lrec_spool_alloc.
+lrec_store_t* lrec_store_alloc(long long mem_budget, char* tmpdir);
+void lrec_store_free(lrec_store_t* pstore);
+
+// The caller retains ownership of the record. Exits the process on write
+// error, e.g. disk full.
+void lrec_store_append(lrec_store_t* pstore, lrec_t* prec);
+
+// Returns a copy of the record at the index, from 0 to num_records - 1. The
+// caller owns the returned record. Appending may continue after reading.
+lrec_t* lrec_store_get(lrec_store_t* pstore, long long index);
+
+#endif // LREC_STORE_H
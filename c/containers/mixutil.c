@@ -70,6 +70,39 @@ slls_t* mlr_reference_selected_values_from_record(lrec_t* prec, slls_t* pselecte
 	return pvalue_list;
 }
 
+// ----------------------------------------------------------------
+group_key_t* group_key_alloc(slls_t* pfield_names) {
+	group_key_t* pkey = mlr_malloc_or_die(sizeof(group_key_t));
+	pkey->pfield_names = pfield_names;
+	pkey->pvalues = slls_alloc();
+	for (sllse_t* pe = pfield_names->phead; pe != NULL; pe = pe->pnext)
+		slls_append_no_free(pkey->pvalues, NULL);
+	pkey->hash = 0;
+	return pkey;
+}
+
+void group_key_free(group_key_t* pkey) {
+	if (pkey == NULL)
+		return;
+	slls_free(pkey->pvalues);
+	free(pkey);
+}
+
+int group_key_select(group_key_t* pkey, lrec_t* prec) {
+	unsigned long long hash = 0ULL;
+	sllse_t* pv = pkey->pvalues->phead;
+	for (sllse_t* pn = pkey->pfield_names->phead; pn != NULL; pn = pn->pnext, pv = pv->pnext) {
+		char* value = lrec_get(prec, pn->value);
+		if (value == NULL)
+			return FALSE;
+		pv->value = value;
+		hash = mlr_string_hash_continue(value, hash);
+	}
+	pkey->hash = mlr_string_hash_finish(hash);
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
 // Makes an array with values pointing into the lrec's values.
 // string_array_free() will respect that and not corrupt the lrec. However,
 // the array's values will be invalid after the lrec is freed.
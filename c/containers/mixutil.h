@@ -28,6 +28,27 @@ slls_t* mlr_copy_keys_from_record(lrec_t* prec);
 // respect that and not corrupt the lrec. However, the slls values will be
 // invalid after the lrec is freed.
 slls_t* mlr_reference_selected_values_from_record(lrec_t* prec, slls_t* pselected_field_names);
+
+// ----------------------------------------------------------------
+// Group-by keys selected from record after record without allocating. The
+// values list has one node per field name, allocated once; group_key_select
+// repoints the nodes at the record's values and computes their slls_hash_func
+// hash along the way, for use with lhmslv_get_with_hash and
+// lhmslv_put_with_hash. As with mlr_reference_selected_values_from_record the
+// values are valid only as long as the record is, so use slls_copy on pvalues
+// when storing a new group.
+typedef struct _group_key_t {
+	slls_t* pfield_names; // Not owned
+	slls_t* pvalues;
+	int     hash;
+} group_key_t;
+
+group_key_t* group_key_alloc(slls_t* pfield_names);
+void group_key_free(group_key_t* pkey);
+// Returns FALSE if the record lacks any of the fields.
+int group_key_select(group_key_t* pkey, lrec_t* prec);
+
+// ----------------------------------------------------------------
 void mlr_reference_values_from_record_into_string_array(lrec_t* prec, string_array_t* pselected_field_names,
 	string_array_t* pvalues);
 int record_has_all_keys(lrec_t* prec, slls_t* pselected_field_names);
@@ -1,20 +1,53 @@
 #include <string.h>
 #include <stdlib.h>
+#include <math.h>
 #include "lib/mlrutil.h"
 #include "containers/percentile_keeper.h"
 #include "lib/mvfuncs.h"
 
 #define INITIAL_CAPACITY 10000
 #define GROWTH_FACTOR    2.0
+// Selections before giving up on them and sorting everything.
+#define MAX_SELECTIONS   16
+#define INSERTION_SORT_THRESHOLD 16
+
+static mv_t* get_value_at_rank(percentile_keeper_t* ppercentile_keeper, unsigned long long index);
 
 // ----------------------------------------------------------------
 percentile_keeper_t* percentile_keeper_alloc() {
-	unsigned long long capacity = INITIAL_CAPACITY;
+	return percentile_keeper_alloc_with_opts(NULL);
+}
+
+percentile_keeper_t* percentile_keeper_alloc_with_opts(percentile_keeper_opts_t* popts) {
+	percentile_keeper_mode_t mode = (popts == NULL) ? PERCENTILE_KEEPER_EXACT : popts->mode;
 	percentile_keeper_t* ppercentile_keeper = mlr_malloc_or_die(sizeof(percentile_keeper_t));
-	ppercentile_keeper->data     = mlr_malloc_or_die(capacity*sizeof(mv_t));
-	ppercentile_keeper->size     = 0LL;
-	ppercentile_keeper->capacity = capacity;
-	ppercentile_keeper->sorted   = FALSE;
+	ppercentile_keeper->data        = NULL;
+	ppercentile_keeper->size        = 0LL;
+	ppercentile_keeper->capacity    = 0LL;
+	ppercentile_keeper->sorted      = FALSE;
+	ppercentile_keeper->all_ints    = TRUE;
+	ppercentile_keeper->all_numbers = TRUE;
+	ppercentile_keeper->pselected   = NULL;
+	ppercentile_keeper->num_selected = 0;
+	ppercentile_keeper->mode        = mode;
+	ppercentile_keeper->ptdigest    = NULL;
+	ppercentile_keeper->pkll_sketch = NULL;
+
+	switch (mode) {
+	case PERCENTILE_KEEPER_TDIGEST:
+		ppercentile_keeper->ptdigest = tdigest_alloc((popts->sketch_size > 0.0)
+			? popts->sketch_size : TDIGEST_DEFAULT_COMPRESSION);
+		break;
+	case PERCENTILE_KEEPER_KLL:
+		ppercentile_keeper->pkll_sketch = kll_sketch_alloc((popts->sketch_size > 0.0)
+			? (int)popts->sketch_size : KLL_SKETCH_DEFAULT_K);
+		break;
+	default:
+		ppercentile_keeper->capacity = INITIAL_CAPACITY;
+		ppercentile_keeper->data     = mlr_malloc_or_die(ppercentile_keeper->capacity*sizeof(mv_t));
+		ppercentile_keeper->pselected = mlr_malloc_or_die(MAX_SELECTIONS*sizeof(unsigned long long));
+		break;
+	}
 	return ppercentile_keeper;
 }
 
@@ -22,10 +55,15 @@ percentile_keeper_t* percentile_keeper_alloc() {
 void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper) {
 	if (ppercentile_keeper == NULL)
 		return;
-	for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
-		mv_free(&ppercentile_keeper->data[i]);
+	if (ppercentile_keeper->mode == PERCENTILE_KEEPER_EXACT) {
+		for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
+			mv_free(&ppercentile_keeper->data[i]);
+		}
 	}
 	free(ppercentile_keeper->data);
+	free(ppercentile_keeper->pselected);
+	tdigest_free(ppercentile_keeper->ptdigest);
+	kll_sketch_free(ppercentile_keeper->pkll_sketch);
 	ppercentile_keeper->data = NULL;
 	ppercentile_keeper->size = 0LL;
 	ppercentile_keeper->capacity = 0LL;
@@ -34,6 +72,29 @@ void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper) {
 
 // ----------------------------------------------------------------
 void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t value) {
+	if (value.type != MT_INT) {
+		ppercentile_keeper->all_ints = FALSE;
+		if (value.type != MT_FLOAT)
+			ppercentile_keeper->all_numbers = FALSE;
+	}
+
+	if (ppercentile_keeper->mode != PERCENTILE_KEEPER_EXACT) {
+		double d;
+		if (value.type == MT_INT) {
+			d = (double)value.u.intv;
+		} else if (value.type == MT_FLOAT) {
+			d = value.u.fltv;
+		} else {
+			mv_free(&value);
+			return;
+		}
+		if (ppercentile_keeper->ptdigest != NULL)
+			tdigest_add(ppercentile_keeper->ptdigest, d);
+		else
+			kll_sketch_add(ppercentile_keeper->pkll_sketch, d);
+		ppercentile_keeper->size++;
+		return;
+	}
 	if (ppercentile_keeper->size >= ppercentile_keeper->capacity) {
 		ppercentile_keeper->capacity = (unsigned long long)(ppercentile_keeper->capacity * GROWTH_FACTOR);
 		ppercentile_keeper->data = (mv_t*)mlr_realloc_or_die(ppercentile_keeper->data,
@@ -41,6 +102,7 @@ void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t valu
 	}
 	ppercentile_keeper->data[ppercentile_keeper->size++] = value;
 	ppercentile_keeper->sorted = FALSE;
+	ppercentile_keeper->num_selected = 0;
 }
 
 // ================================================================
@@ -225,18 +287,19 @@ static unsigned long long compute_index_non_interpolated(unsigned long long n, d
 	return (unsigned long long)index;
 }
 
-static mv_t get_percentile_linearly_interpolated(mv_t* array, unsigned long long n, double p) {
+static mv_t get_percentile_linearly_interpolated(percentile_keeper_t* ppercentile_keeper, double p) {
+	unsigned long long n = ppercentile_keeper->size;
 	double findex = (p/100.0)*(n-1);
 	if (findex < 0)
 		findex = 0;
 	unsigned long long iindex = (unsigned long long)floor(findex);
 	if (iindex >= n-1) {
-		return array[iindex];
+		return *get_value_at_rank(ppercentile_keeper, iindex);
 	} else {
 		// array[iindex] + frac * (array[iindex+1] - array[iindex]);
 		mv_t frac = mv_from_float(findex - iindex);
-		mv_t* pa = &array[iindex];
-		mv_t* pb = &array[iindex+1];
+		mv_t* pa = get_value_at_rank(ppercentile_keeper, iindex);
+		mv_t* pb = get_value_at_rank(ppercentile_keeper, iindex+1);
 		mv_t diff = x_xx_minus_func(pb, pa);
 		mv_t prod = x_xx_times_func(&frac, &diff);
 		mv_t rv = x_xx_plus_func(pa, &prod);
@@ -244,32 +307,205 @@ static mv_t get_percentile_linearly_interpolated(mv_t* array, unsigned long long
 	}
 }
 
+// The ranks are as for exact percentiles. Non-interpolated percentiles of ints
+// are ints, as they are when exact; the t-digest's estimates between input
+// values are rounded.
+static mv_t emit_from_sketch(percentile_keeper_t* ppercentile_keeper, double percentile, int interpolate) {
+	double value = (ppercentile_keeper->ptdigest != NULL)
+		? tdigest_percentile(ppercentile_keeper->ptdigest, percentile, interpolate)
+		: kll_sketch_percentile(ppercentile_keeper->pkll_sketch, percentile, interpolate);
+	if (ppercentile_keeper->all_ints && !interpolate)
+		return mv_from_int(llround(value));
+	return mv_from_float(value);
+}
+
 // ----------------------------------------------------------------
 mv_t percentile_keeper_emit_non_interpolated(percentile_keeper_t* ppercentile_keeper, double percentile) {
 	if (ppercentile_keeper->size == 0) {
 		return mv_absent();
 	}
-	if (!ppercentile_keeper->sorted) {
-		qsort(ppercentile_keeper->data, ppercentile_keeper->size, sizeof(mv_t), mv_xx_comparator);
-		ppercentile_keeper->sorted = TRUE;
-	}
-	return ppercentile_keeper->data[compute_index_non_interpolated(ppercentile_keeper->size, percentile)];
+	if (ppercentile_keeper->mode != PERCENTILE_KEEPER_EXACT)
+		return emit_from_sketch(ppercentile_keeper, percentile, FALSE);
+	return *get_value_at_rank(ppercentile_keeper, compute_index_non_interpolated(ppercentile_keeper->size, percentile));
 }
 
 mv_t percentile_keeper_emit_linearly_interpolated(percentile_keeper_t* ppercentile_keeper, double percentile) {
 	if (ppercentile_keeper->size == 0) {
 		return mv_absent();
 	}
-	if (!ppercentile_keeper->sorted) {
-		qsort(ppercentile_keeper->data, ppercentile_keeper->size, sizeof(mv_t), mv_xx_comparator);
+	if (ppercentile_keeper->mode != PERCENTILE_KEEPER_EXACT)
+		return emit_from_sketch(ppercentile_keeper, percentile, TRUE);
+	return get_percentile_linearly_interpolated(ppercentile_keeper, percentile);
+}
+
+// ================================================================
+// Selection and sorting of all-numeric values. These compare by a 64-bit key
+// whose unsigned order is the numeric order: the int with its sign bit
+// flipped if all values are ints, else the IEEE bits of the double value
+// flipped so that negatives come first. (Mixed ints and floats compare as
+// doubles, as with mv_xx_comparator.)
+
+static inline unsigned long long numeric_sort_key(const mv_t* pv, int all_ints) {
+	if (all_ints)
+		return (unsigned long long)pv->u.intv ^ 0x8000000000000000ULL;
+	double d = (pv->type == MT_INT) ? (double)pv->u.intv : pv->u.fltv;
+	if (d == 0.0)
+		d = 0.0; // Fold minus zero into zero
+	unsigned long long bits;
+	memcpy(&bits, &d, sizeof(bits));
+	return (bits & 0x8000000000000000ULL) ? ~bits : bits ^ 0x8000000000000000ULL;
+}
+
+static inline void swap_values(mv_t* pa, mv_t* pb) {
+	mv_t t = *pa;
+	*pa = *pb;
+	*pb = t;
+}
+
+static void insertion_sort_numeric(mv_t* array, long long n, int all_ints) {
+	for (long long i = 1; i < n; i++) {
+		mv_t v = array[i];
+		unsigned long long key = numeric_sort_key(&v, all_ints);
+		long long j = i;
+		for ( ; j > 0 && numeric_sort_key(&array[j-1], all_ints) > key; j--)
+			array[j] = array[j-1];
+		array[j] = v;
+	}
+}
+
+// In-place MSD radix sort (American flag sort) on the byte of the key at
+// the given shift, then recursively on the next byte down within each
+// bucket.
+static void radix_sort_numeric(mv_t* array, long long n, int all_ints, int shift) {
+	if (n <= INSERTION_SORT_THRESHOLD) {
+		insertion_sort_numeric(array, n, all_ints);
+		return;
+	}
+	long long counts[256];
+	memset(counts, 0, sizeof(counts));
+	for (long long i = 0; i < n; i++)
+		counts[(numeric_sort_key(&array[i], all_ints) >> shift) & 0xff]++;
+
+	long long heads[256];
+	long long tails[256];
+	long long offset = 0;
+	for (int b = 0; b < 256; b++) {
+		heads[b] = offset;
+		offset += counts[b];
+		tails[b] = offset;
+	}
+	for (int b = 0; b < 256; b++) {
+		while (heads[b] < tails[b]) {
+			mv_t v = array[heads[b]];
+			int d = (numeric_sort_key(&v, all_ints) >> shift) & 0xff;
+			while (d != b) {
+				mv_t t = array[heads[d]];
+				array[heads[d]++] = v;
+				v = t;
+				d = (numeric_sort_key(&v, all_ints) >> shift) & 0xff;
+			}
+			array[heads[b]++] = v;
+		}
+	}
+
+	if (shift == 0)
+		return;
+	offset = 0;
+	for (int b = 0; b < 256; b++) {
+		if (counts[b] > 1)
+			radix_sort_numeric(&array[offset], counts[b], all_ints, shift - 8);
+		offset += counts[b];
+	}
+}
+
+// Quickselect with median-of-three pivots and three-way partitioning, so
+// that runs of equal values end it early. Leaves the value of rank k at k,
+// with none greater before it and none less after it. If the partitioning
+// goes badly, the range is radix-sorted instead, so time stays linear.
+static void select_numeric(mv_t* array, long long lo, long long hi, long long k, int all_ints) {
+	int depth_limit = 2;
+	for (long long m = hi - lo; m > 1; m >>= 1)
+		depth_limit += 2;
+
+	while (hi - lo > INSERTION_SORT_THRESHOLD) {
+		if (depth_limit-- == 0) {
+			radix_sort_numeric(&array[lo], hi - lo, all_ints, 56);
+			return;
+		}
+		long long mid = lo + (hi - lo) / 2;
+		if (numeric_sort_key(&array[mid], all_ints) < numeric_sort_key(&array[lo], all_ints))
+			swap_values(&array[mid], &array[lo]);
+		if (numeric_sort_key(&array[hi-1], all_ints) < numeric_sort_key(&array[mid], all_ints)) {
+			swap_values(&array[hi-1], &array[mid]);
+			if (numeric_sort_key(&array[mid], all_ints) < numeric_sort_key(&array[lo], all_ints))
+				swap_values(&array[mid], &array[lo]);
+		}
+		unsigned long long pivot = numeric_sort_key(&array[mid], all_ints);
+
+		// Less than the pivot: [lo, lt). Equal: [lt, i). Greater: (gt, hi).
+		long long lt = lo, i = lo, gt = hi - 1;
+		while (i <= gt) {
+			unsigned long long key = numeric_sort_key(&array[i], all_ints);
+			if (key < pivot)
+				swap_values(&array[lt++], &array[i++]);
+			else if (key > pivot)
+				swap_values(&array[i], &array[gt--]);
+			else
+				i++;
+		}
+		if (k < lt)
+			hi = lt;
+		else if (k > gt)
+			lo = gt + 1;
+		else
+			return;
+	}
+	insertion_sort_numeric(&array[lo], hi - lo, all_ints);
+}
+
+// Values at the ranks selected so far are in their sorted places, so the
+// value at another rank is found by selection between the nearest of those
+// either side of it.
+static mv_t* get_value_at_rank(percentile_keeper_t* ppercentile_keeper, unsigned long long index) {
+	mv_t* data = ppercentile_keeper->data;
+	if (ppercentile_keeper->sorted)
+		return &data[index];
+	if (!ppercentile_keeper->all_numbers) {
+		qsort(data, ppercentile_keeper->size, sizeof(mv_t), mv_xx_comparator);
 		ppercentile_keeper->sorted = TRUE;
+		return &data[index];
 	}
-	return get_percentile_linearly_interpolated(ppercentile_keeper->data, ppercentile_keeper->size, percentile);
+	int all_ints = ppercentile_keeper->all_ints;
+	if (ppercentile_keeper->num_selected >= MAX_SELECTIONS) {
+		radix_sort_numeric(data, ppercentile_keeper->size, all_ints, 56);
+		ppercentile_keeper->sorted = TRUE;
+		return &data[index];
+	}
+
+	unsigned long long* pselected = ppercentile_keeper->pselected;
+	int num_selected = ppercentile_keeper->num_selected;
+	int i = 0;
+	while (i < num_selected && pselected[i] < index)
+		i++;
+	if (i < num_selected && pselected[i] == index)
+		return &data[index];
+	long long lo = (i > 0) ? pselected[i-1] + 1 : 0;
+	long long hi = (i < num_selected) ? pselected[i] : ppercentile_keeper->size;
+	select_numeric(data, lo, hi, index, all_ints);
+
+	memmove(&pselected[i+1], &pselected[i], (num_selected - i) * sizeof(unsigned long long));
+	pselected[i] = index;
+	ppercentile_keeper->num_selected++;
+	return &data[index];
 }
 
 // ----------------------------------------------------------------
 void percentile_keeper_print(percentile_keeper_t* ppercentile_keeper) {
 	printf("percentile_keeper dump:\n");
+	if (ppercentile_keeper->mode != PERCENTILE_KEEPER_EXACT) {
+		printf("sketch of %llu values\n", ppercentile_keeper->size);
+		return;
+	}
 	for (unsigned long long i = 0; i < ppercentile_keeper->size; i++) {
 		mv_t* pa = &ppercentile_keeper->data[i];
 		if (pa->type == MT_FLOAT)
@@ -1,19 +1,52 @@
 // ================================================================
 // For mlr stats1 percentiles
+//
+// By default all values are kept, and percentiles are exact. When the values
+// are all numbers, each percentile is found by selection rather than by
+// sorting everything: a quickselect within the stretch between the nearest
+// ranks already selected. Past a few percentiles the values are instead
+// radix-sorted on an order-preserving integer key. With any non-numeric
+// values, they are sorted with the general comparator. Alternatively a
+// t-digest or KLL sketch may be kept instead, in memory bounded regardless
+// of the number of values: see containers/tdigest.h and
+// containers/kll_sketch.h. Sketches take only numeric values; others are
+// ignored.
 // ================================================================
 
 #ifndef PERCENTILE_KEEPER_H
 #define PERCENTILE_KEEPER_H
 #include "lib/mlrval.h"
+#include "containers/tdigest.h"
+#include "containers/kll_sketch.h"
+
+typedef enum _percentile_keeper_mode_t {
+	PERCENTILE_KEEPER_EXACT,
+	PERCENTILE_KEEPER_TDIGEST,
+	PERCENTILE_KEEPER_KLL,
+} percentile_keeper_mode_t;
+
+typedef struct _percentile_keeper_opts_t {
+	percentile_keeper_mode_t mode;
+	double sketch_size; // Compression for t-digest; k for KLL. 0 for the default.
+} percentile_keeper_opts_t;
 
 typedef struct _percentile_keeper_t {
 	mv_t* data;
 	unsigned long long size;
 	unsigned long long capacity;
 	int   sorted;
+	int   all_ints;
+	int   all_numbers;
+	unsigned long long* pselected; // Sorted ranks whose values are in place
+	int   num_selected;
+	percentile_keeper_mode_t mode;
+	tdigest_t*    ptdigest;
+	kll_sketch_t* pkll_sketch;
 } percentile_keeper_t;
 
 percentile_keeper_t* percentile_keeper_alloc();
+// NULL options are the same as exact mode.
+percentile_keeper_t* percentile_keeper_alloc_with_opts(percentile_keeper_opts_t* popts);
 void percentile_keeper_free(percentile_keeper_t* ppercentile_keeper);
 void percentile_keeper_ingest(percentile_keeper_t* ppercentile_keeper, mv_t value);
 
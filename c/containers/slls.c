@@ -181,18 +181,12 @@ void slls_reverse(slls_t* plist) {
 
 // ----------------------------------------------------------------
 int slls_hash_func(slls_t *plist) {
-	unsigned long hash = 5381;
-	int c;
-
-	for (sllse_t* pe = plist->phead; pe != NULL; pe = pe->pnext) {
-		char* str = pe->value;
-		while ((c = *str++) != 0)
-			hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-		// So that ["ab","c"] doesn't hash to the same as ["a","bc"]:
-		hash = ((hash << 5) + hash) + ',';
-	}
-
-	return (int)hash;
+	// Since each string's length is mixed in, ["ab","c"] doesn't hash to the
+	// same as ["a","bc"].
+	unsigned long long hash = 0ULL;
+	for (sllse_t* pe = plist->phead; pe != NULL; pe = pe->pnext)
+		hash = mlr_string_hash_continue(pe->value, hash);
+	return mlr_string_hash_finish(hash);
 }
 
 // ----------------------------------------------------------------
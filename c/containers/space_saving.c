@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include "lib/mlrutil.h"
+#include "containers/space_saving.h"
+
+static int  space_saving_find(space_saving_t* pss, slls_t* pkey, int hash);
+static void space_saving_table_insert(space_saving_t* pss, int counter_index);
+static void space_saving_table_remove(space_saving_t* pss, int counter_index);
+static void space_saving_sift_up(space_saving_t* pss, int heap_index);
+static void space_saving_sift_down(space_saving_t* pss, int heap_index);
+
+// ----------------------------------------------------------------
+space_saving_t* space_saving_alloc(int capacity) {
+	MLR_INTERNAL_CODING_ERROR_IF(capacity < 1);
+	space_saving_t* pss = mlr_malloc_or_die(sizeof(space_saving_t));
+	pss->capacity     = capacity;
+	pss->num_counters = 0;
+	pss->pcounters    = mlr_malloc_or_die(capacity * sizeof(space_saving_counter_t));
+	pss->pheap        = mlr_malloc_or_die(capacity * sizeof(int));
+
+	// At most half full, so probe sequences stay short.
+	int table_length = 4;
+	while (table_length < 2 * capacity)
+		table_length <<= 1;
+	pss->ptable = mlr_malloc_or_die(table_length * sizeof(int));
+	for (int i = 0; i < table_length; i++)
+		pss->ptable[i] = -1;
+	pss->table_mask = table_length - 1;
+
+	return pss;
+}
+
+void space_saving_free(space_saving_t* pss) {
+	if (pss == NULL)
+		return;
+	for (int i = 0; i < pss->num_counters; i++)
+		slls_free(pss->pcounters[i].pkey);
+	free(pss->pcounters);
+	free(pss->pheap);
+	free(pss->ptable);
+	free(pss);
+}
+
+// ----------------------------------------------------------------
+void space_saving_add(space_saving_t* pss, slls_t* pkey, int hash) {
+	int c = space_saving_find(pss, pkey, hash);
+	if (c >= 0) {
+		pss->pcounters[c].count++;
+		space_saving_sift_down(pss, pss->pcounters[c].heap_index);
+		return;
+	}
+
+	space_saving_counter_t* pcounter;
+	if (pss->num_counters < pss->capacity) {
+		c = pss->num_counters++;
+		pcounter = &pss->pcounters[c];
+		pcounter->count = 1LL;
+		pcounter->error = 0LL;
+		pcounter->heap_index = c;
+		pss->pheap[c] = c;
+		space_saving_sift_up(pss, c);
+	} else {
+		c = pss->pheap[0];
+		pcounter = &pss->pcounters[c];
+		space_saving_table_remove(pss, c);
+		slls_free(pcounter->pkey);
+		pcounter->error = pcounter->count;
+		pcounter->count++;
+		space_saving_sift_down(pss, 0);
+	}
+	pcounter->pkey = slls_copy(pkey);
+	pcounter->hash = hash;
+	space_saving_table_insert(pss, c);
+}
+
+// ----------------------------------------------------------------
+// The murmur3 32-bit finalizer, since slls_hash_func values are weak in their
+// low bits, which pick the slot.
+static inline int space_saving_slot(space_saving_t* pss, int hash) {
+	unsigned int h = (unsigned int)hash;
+	h ^= h >> 16;
+	h *= 0x85ebca6bU;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35U;
+	h ^= h >> 16;
+	return h & pss->table_mask;
+}
+
+static int space_saving_find(space_saving_t* pss, slls_t* pkey, int hash) {
+	for (int i = space_saving_slot(pss, hash); pss->ptable[i] >= 0; i = (i + 1) & pss->table_mask) {
+		space_saving_counter_t* pcounter = &pss->pcounters[pss->ptable[i]];
+		if (pcounter->hash == hash && slls_equals(pcounter->pkey, pkey))
+			return pss->ptable[i];
+	}
+	return -1;
+}
+
+static void space_saving_table_insert(space_saving_t* pss, int counter_index) {
+	int i = space_saving_slot(pss, pss->pcounters[counter_index].hash);
+	while (pss->ptable[i] >= 0)
+		i = (i + 1) & pss->table_mask;
+	pss->ptable[i] = counter_index;
+}
+
+// Linear probing without tombstones: after emptying a slot, later entries in
+// the same run are moved back into it unless that would put them before
+// their own home slots.
+static void space_saving_table_remove(space_saving_t* pss, int counter_index) {
+	int mask = pss->table_mask;
+	int i = space_saving_slot(pss, pss->pcounters[counter_index].hash);
+	while (pss->ptable[i] != counter_index)
+		i = (i + 1) & mask;
+	for (int j = (i + 1) & mask; pss->ptable[j] >= 0; j = (j + 1) & mask) {
+		int home = space_saving_slot(pss, pss->pcounters[pss->ptable[j]].hash);
+		// Distances going forward, with wraparound
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			pss->ptable[i] = pss->ptable[j];
+			i = j;
+		}
+	}
+	pss->ptable[i] = -1;
+}
+
+// ----------------------------------------------------------------
+static inline void space_saving_heap_swap(space_saving_t* pss, int a, int b) {
+	int ca = pss->pheap[a];
+	int cb = pss->pheap[b];
+	pss->pheap[a] = cb;
+	pss->pheap[b] = ca;
+	pss->pcounters[cb].heap_index = a;
+	pss->pcounters[ca].heap_index = b;
+}
+
+static void space_saving_sift_up(space_saving_t* pss, int heap_index) {
+	while (heap_index > 0) {
+		int parent = (heap_index - 1) / 2;
+		if (pss->pcounters[pss->pheap[parent]].count <= pss->pcounters[pss->pheap[heap_index]].count)
+			break;
+		space_saving_heap_swap(pss, parent, heap_index);
+		heap_index = parent;
+	}
+}
+
+static void space_saving_sift_down(space_saving_t* pss, int heap_index) {
+	int n = pss->num_counters;
+	while (TRUE) {
+		int smallest = heap_index;
+		int left = 2 * heap_index + 1;
+		int right = left + 1;
+		if (left < n && pss->pcounters[pss->pheap[left]].count < pss->pcounters[pss->pheap[smallest]].count)
+			smallest = left;
+		if (right < n && pss->pcounters[pss->pheap[right]].count < pss->pcounters[pss->pheap[smallest]].count)
+			smallest = right;
+		if (smallest == heap_index)
+			break;
+		space_saving_heap_swap(pss, smallest, heap_index);
+		heap_index = smallest;
+	}
+}
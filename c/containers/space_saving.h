@@ -0,0 +1,48 @@
+// ================================================================
+// Space-Saving: approximate most-frequent keys in bounded memory (Metwally,
+// Agrawal, and El Abbadi, "Efficient computation of frequent and top-k
+// elements in data streams", 2005).
+//
+// At most k keys are counted. A key not already counted, when all k counters
+// are in use, takes over the counter with the smallest count c: its count
+// becomes c+1, and its error c, since up to c of those may have been for
+// other keys. So each count is an upper bound on the key's true count, and
+// count minus error a lower bound. Any key occurring more than n/k times in n
+// is sure to be counted; while there are no more than k distinct keys, all
+// counts are exact.
+//
+// The counters are kept in a min-heap on count, for finding the smallest, and
+// indexed by an open-addressing hash table, for finding a key's counter.
+// Keys are string lists with their slls_hash_func values, as from
+// group_key_select.
+// ================================================================
+
+#ifndef SPACE_SAVING_H
+#define SPACE_SAVING_H
+
+#include "containers/slls.h"
+
+typedef struct _space_saving_counter_t {
+	slls_t*   pkey;
+	int       hash;
+	int       heap_index;
+	long long count;
+	long long error;
+} space_saving_counter_t;
+
+typedef struct _space_saving_t {
+	int       capacity;
+	int       num_counters;
+	space_saving_counter_t* pcounters;
+	int*      pheap;       // Counter indices, smallest count first
+	int*      ptable;      // Counter indices, or -1 for empty slots
+	int       table_mask;
+} space_saving_t;
+
+space_saving_t* space_saving_alloc(int capacity);
+void space_saving_free(space_saving_t* pss);
+
+// The key is copied if it isn't already being counted.
+void space_saving_add(space_saving_t* pss, slls_t* pkey, int hash);
+
+#endif // SPACE_SAVING_H
@@ -0,0 +1,94 @@
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "containers/spsc_queue.h"
+
+// How many times to re-check before going to sleep.
+#define SPSC_QUEUE_SPIN_COUNT 100
+
+// ----------------------------------------------------------------
+spsc_queue_t* spsc_queue_alloc(unsigned long capacity) {
+	spsc_queue_t* pqueue = mlr_malloc_or_die(sizeof(spsc_queue_t));
+	pqueue->ring             = mlr_malloc_or_die(capacity * sizeof(void*));
+	pqueue->capacity         = capacity;
+	pqueue->head             = 0;
+	pqueue->tail             = 0;
+	pqueue->consumer_waiting = FALSE;
+	pqueue->producer_waiting = FALSE;
+	pthread_mutex_init(&pqueue->mutex, NULL);
+	pthread_cond_init(&pqueue->cond, NULL);
+	return pqueue;
+}
+
+void spsc_queue_free(spsc_queue_t* pqueue) {
+	if (pqueue == NULL)
+		return;
+	pthread_cond_destroy(&pqueue->cond);
+	pthread_mutex_destroy(&pqueue->mutex);
+	free(pqueue->ring);
+	free(pqueue);
+}
+
+// ----------------------------------------------------------------
+// The waiting flag is set, and the queue re-checked, under the mutex; the
+// other side stores its index and then checks the flag. Since both use
+// sequentially consistent atomics, at least one of them sees the other's
+// write: either the waiter sees the progress and doesn't sleep, or the other
+// side sees the flag and signals.
+
+static int spsc_queue_is_full(spsc_queue_t* pqueue) {
+	return __atomic_load_n(&pqueue->tail, __ATOMIC_SEQ_CST) - __atomic_load_n(&pqueue->head, __ATOMIC_SEQ_CST)
+		== pqueue->capacity;
+}
+
+static int spsc_queue_is_empty(spsc_queue_t* pqueue) {
+	return __atomic_load_n(&pqueue->tail, __ATOMIC_SEQ_CST) == __atomic_load_n(&pqueue->head, __ATOMIC_SEQ_CST);
+}
+
+static void spsc_queue_wake(spsc_queue_t* pqueue, int* pwaiting) {
+	if (__atomic_load_n(pwaiting, __ATOMIC_SEQ_CST)) {
+		pthread_mutex_lock(&pqueue->mutex);
+		pthread_cond_signal(&pqueue->cond);
+		pthread_mutex_unlock(&pqueue->mutex);
+	}
+}
+
+// ----------------------------------------------------------------
+void spsc_queue_push(spsc_queue_t* pqueue, void* pvitem) {
+	for (int i = 0; spsc_queue_is_full(pqueue); i++) {
+		if (i < SPSC_QUEUE_SPIN_COUNT)
+			continue;
+		pthread_mutex_lock(&pqueue->mutex);
+		__atomic_store_n(&pqueue->producer_waiting, TRUE, __ATOMIC_SEQ_CST);
+		while (spsc_queue_is_full(pqueue))
+			pthread_cond_wait(&pqueue->cond, &pqueue->mutex);
+		__atomic_store_n(&pqueue->producer_waiting, FALSE, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&pqueue->mutex);
+		break;
+	}
+
+	unsigned long tail = pqueue->tail;
+	pqueue->ring[tail % pqueue->capacity] = pvitem;
+	__atomic_store_n(&pqueue->tail, tail + 1, __ATOMIC_SEQ_CST);
+	spsc_queue_wake(pqueue, &pqueue->consumer_waiting);
+}
+
+// ----------------------------------------------------------------
+void* spsc_queue_pop(spsc_queue_t* pqueue) {
+	for (int i = 0; spsc_queue_is_empty(pqueue); i++) {
+		if (i < SPSC_QUEUE_SPIN_COUNT)
+			continue;
+		pthread_mutex_lock(&pqueue->mutex);
+		__atomic_store_n(&pqueue->consumer_waiting, TRUE, __ATOMIC_SEQ_CST);
+		while (spsc_queue_is_empty(pqueue))
+			pthread_cond_wait(&pqueue->cond, &pqueue->mutex);
+		__atomic_store_n(&pqueue->consumer_waiting, FALSE, __ATOMIC_SEQ_CST);
+		pthread_mutex_unlock(&pqueue->mutex);
+		break;
+	}
+
+	unsigned long head = pqueue->head;
+	void* pvitem = pqueue->ring[head % pqueue->capacity];
+	__atomic_store_n(&pqueue->head, head + 1, __ATOMIC_SEQ_CST);
+	spsc_queue_wake(pqueue, &pqueue->producer_waiting);
+	return pvitem;
+}
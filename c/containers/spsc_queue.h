@@ -0,0 +1,42 @@
+// ================================================================
+// Bounded single-producer, single-consumer queue of void-star pointers, for
+// passing data between two threads.
+//
+// The ring indices are updated with atomic loads and stores, so while the
+// queue is neither empty nor full, push and pop take no locks. A thread which
+// finds the queue empty (or full) spins briefly, then sleeps on a condition
+// variable until the other side makes progress.
+// ================================================================
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <pthread.h>
+
+typedef struct _spsc_queue_t {
+	void** ring;
+	unsigned long capacity;
+
+	// Each index is written by one side only, and they are kept on separate
+	// cache lines so that the two threads don't contend over them.
+	char pad0[64];
+	unsigned long head; // Next slot to pop; written by the consumer
+	char pad1[64];
+	unsigned long tail; // Next slot to push; written by the producer
+	char pad2[64];
+
+	int consumer_waiting;
+	int producer_waiting;
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+} spsc_queue_t;
+
+spsc_queue_t* spsc_queue_alloc(unsigned long capacity);
+void spsc_queue_free(spsc_queue_t* pqueue);
+
+// Blocks while the queue is full.
+void spsc_queue_push(spsc_queue_t* pqueue, void* pvitem);
+// Blocks while the queue is empty.
+void* spsc_queue_pop(spsc_queue_t* pqueue);
+
+#endif // SPSC_QUEUE_H
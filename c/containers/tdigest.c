@@ -0,0 +1,220 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "lib/mlrutil.h"
+#include "containers/tdigest.h"
+
+// Values buffered before a merge, per unit of compression.
+#define TDIGEST_BUFFER_FACTOR 5
+// Starting small keeps many small digests, e.g. one per group, small.
+#define TDIGEST_INITIAL_CAPACITY 16
+
+static void tdigest_buffer(tdigest_t* ptdigest, double mean, double weight);
+static void tdigest_compress(tdigest_t* ptdigest);
+static int  centroid_comparator(const void* pva, const void* pvb);
+
+// ----------------------------------------------------------------
+tdigest_t* tdigest_alloc(double compression) {
+	tdigest_t* ptdigest = mlr_malloc_or_die(sizeof(tdigest_t));
+	if (compression < 10)
+		compression = 10;
+	ptdigest->compression        = compression;
+	ptdigest->centroids_capacity = TDIGEST_INITIAL_CAPACITY;
+	ptdigest->pcentroids         = mlr_malloc_or_die(ptdigest->centroids_capacity * sizeof(tdigest_centroid_t));
+	ptdigest->num_centroids      = 0;
+	ptdigest->buffer_capacity    = TDIGEST_INITIAL_CAPACITY;
+	ptdigest->buffer_limit       = TDIGEST_BUFFER_FACTOR * (int)ceil(compression);
+	ptdigest->pbuffer            = mlr_malloc_or_die(ptdigest->buffer_capacity * sizeof(tdigest_centroid_t));
+	ptdigest->buffer_length      = 0;
+	ptdigest->total_weight       = 0.0;
+	ptdigest->min                = INFINITY;
+	ptdigest->max                = -INFINITY;
+	return ptdigest;
+}
+
+void tdigest_free(tdigest_t* ptdigest) {
+	if (ptdigest == NULL)
+		return;
+	free(ptdigest->pcentroids);
+	free(ptdigest->pbuffer);
+	free(ptdigest);
+}
+
+// ----------------------------------------------------------------
+void tdigest_add(tdigest_t* ptdigest, double value) {
+	if (isnan(value))
+		return;
+	tdigest_buffer(ptdigest, value, 1.0);
+	if (value < ptdigest->min)
+		ptdigest->min = value;
+	if (value > ptdigest->max)
+		ptdigest->max = value;
+}
+
+void tdigest_merge(tdigest_t* ptdigest, tdigest_t* pother) {
+	for (int i = 0; i < pother->num_centroids; i++)
+		tdigest_buffer(ptdigest, pother->pcentroids[i].mean, pother->pcentroids[i].weight);
+	for (int i = 0; i < pother->buffer_length; i++)
+		tdigest_buffer(ptdigest, pother->pbuffer[i].mean, pother->pbuffer[i].weight);
+	if (pother->min < ptdigest->min)
+		ptdigest->min = pother->min;
+	if (pother->max > ptdigest->max)
+		ptdigest->max = pother->max;
+}
+
+long long tdigest_count(tdigest_t* ptdigest) {
+	return (long long)ptdigest->total_weight;
+}
+
+static void tdigest_buffer(tdigest_t* ptdigest, double mean, double weight) {
+	if (ptdigest->buffer_length >= ptdigest->buffer_capacity) {
+		if (ptdigest->buffer_capacity < ptdigest->buffer_limit) {
+			ptdigest->buffer_capacity *= 2;
+			if (ptdigest->buffer_capacity > ptdigest->buffer_limit)
+				ptdigest->buffer_capacity = ptdigest->buffer_limit;
+			ptdigest->pbuffer = mlr_realloc_or_die(ptdigest->pbuffer,
+				ptdigest->buffer_capacity * sizeof(tdigest_centroid_t));
+		} else {
+			tdigest_compress(ptdigest);
+		}
+	}
+	ptdigest->pbuffer[ptdigest->buffer_length].mean   = mean;
+	ptdigest->pbuffer[ptdigest->buffer_length].weight = weight;
+	ptdigest->buffer_length++;
+	ptdigest->total_weight += weight;
+}
+
+// ----------------------------------------------------------------
+// The k1 scale function and its inverse: a centroid may span at most one unit
+// of k, which is steep near q = 0 and q = 1 and shallow in the middle.
+static inline double tdigest_k(double q, double compression) {
+	return compression / (2.0 * M_PI) * asin(2.0 * q - 1.0);
+}
+static inline double tdigest_q(double k, double compression) {
+	if (k >= compression / 4.0)
+		return 1.0;
+	return (sin(k * 2.0 * M_PI / compression) + 1.0) / 2.0;
+}
+
+// Merges the buffer into the centroids: everything is sorted by mean, then
+// neighbors are combined as far as the scale function allows.
+static void tdigest_compress(tdigest_t* ptdigest) {
+	if (ptdigest->buffer_length == 0)
+		return;
+	int n = ptdigest->num_centroids + ptdigest->buffer_length;
+	tdigest_centroid_t* pall = mlr_malloc_or_die(n * sizeof(tdigest_centroid_t));
+	memcpy(pall, ptdigest->pcentroids, ptdigest->num_centroids * sizeof(tdigest_centroid_t));
+	memcpy(&pall[ptdigest->num_centroids], ptdigest->pbuffer, ptdigest->buffer_length * sizeof(tdigest_centroid_t));
+	qsort(pall, n, sizeof(tdigest_centroid_t), centroid_comparator);
+
+	double total_weight = ptdigest->total_weight;
+	double compression = ptdigest->compression;
+	tdigest_centroid_t* pcentroids = ptdigest->pcentroids;
+	int m = 0;
+	pcentroids[0] = pall[0];
+	double weight_so_far = 0.0;
+	double weight_limit = tdigest_q(tdigest_k(0.0, compression) + 1.0, compression) * total_weight;
+	for (int i = 1; i < n; i++) {
+		if (weight_so_far + pcentroids[m].weight + pall[i].weight <= weight_limit) {
+			pcentroids[m].weight += pall[i].weight;
+			pcentroids[m].mean += (pall[i].mean - pcentroids[m].mean) * pall[i].weight / pcentroids[m].weight;
+		} else {
+			weight_so_far += pcentroids[m].weight;
+			double k = tdigest_k(weight_so_far / total_weight, compression);
+			weight_limit = tdigest_q(k + 1.0, compression) * total_weight;
+			if (++m >= ptdigest->centroids_capacity) {
+				ptdigest->centroids_capacity *= 2;
+				ptdigest->pcentroids = mlr_realloc_or_die(ptdigest->pcentroids,
+					ptdigest->centroids_capacity * sizeof(tdigest_centroid_t));
+				pcentroids = ptdigest->pcentroids;
+			}
+			pcentroids[m] = pall[i];
+		}
+	}
+	ptdigest->num_centroids = m + 1;
+	ptdigest->buffer_length = 0;
+	free(pall);
+}
+
+static int centroid_comparator(const void* pva, const void* pvb) {
+	const tdigest_centroid_t* pa = pva;
+	const tdigest_centroid_t* pb = pvb;
+	return (pa->mean < pb->mean) ? -1 : (pa->mean > pb->mean) ? 1 : 0;
+}
+
+// ----------------------------------------------------------------
+// Each centroid's mean is taken to be at the middle of its weight, with
+// linear interpolation between neighbors, and between the outermost ones and
+// the minimum and maximum. Singletons are exact values, so there's no
+// interpolating across their half-units of weight.
+double tdigest_quantile(tdigest_t* ptdigest, double q) {
+	tdigest_compress(ptdigest);
+	int n = ptdigest->num_centroids;
+	if (n == 0)
+		return NAN;
+	if (q <= 0.0)
+		return ptdigest->min;
+	if (q >= 1.0)
+		return ptdigest->max;
+	if (n == 1)
+		return ptdigest->pcentroids[0].mean;
+
+	tdigest_centroid_t* pc = ptdigest->pcentroids;
+	double total_weight = ptdigest->total_weight;
+	double index = q * total_weight;
+
+	if (index < pc[0].weight / 2.0) {
+		if (pc[0].weight <= 1.0)
+			return pc[0].mean;
+		return ptdigest->min + (pc[0].mean - ptdigest->min) * index / (pc[0].weight / 2.0);
+	}
+	if (index > total_weight - pc[n-1].weight / 2.0) {
+		if (pc[n-1].weight <= 1.0)
+			return pc[n-1].mean;
+		double z = total_weight - index;
+		return ptdigest->max - (ptdigest->max - pc[n-1].mean) * z / (pc[n-1].weight / 2.0);
+	}
+
+	double weight_so_far = pc[0].weight / 2.0;
+	for (int i = 0; i < n - 1; i++) {
+		double dw = (pc[i].weight + pc[i+1].weight) / 2.0;
+		if (weight_so_far + dw >= index) {
+			double z1 = index - weight_so_far - ((pc[i].weight == 1.0) ? 0.5 : 0.0);
+			double z2 = weight_so_far + dw - index - ((pc[i+1].weight == 1.0) ? 0.5 : 0.0);
+			if (z1 <= 0.0)
+				return pc[i].mean;
+			if (z2 <= 0.0)
+				return pc[i+1].mean;
+			return (pc[i].mean * z2 + pc[i+1].mean * z1) / (z1 + z2);
+		}
+		weight_so_far += dw;
+	}
+	return pc[n-1].mean;
+}
+
+// ----------------------------------------------------------------
+static double tdigest_value_at_rank(tdigest_t* ptdigest, long long index, long long n) {
+	if (index <= 0LL)
+		return ptdigest->min;
+	if (index >= n - 1)
+		return ptdigest->max;
+	return tdigest_quantile(ptdigest, (index + 0.5) / n);
+}
+
+double tdigest_percentile(tdigest_t* ptdigest, double p, int interpolate) {
+	long long n = tdigest_count(ptdigest);
+	if (n == 0LL)
+		return NAN;
+	if (!interpolate)
+		return tdigest_value_at_rank(ptdigest, (long long)(p*n/100.0), n);
+
+	double findex = (p/100.0)*(n-1);
+	if (findex < 0.0)
+		findex = 0.0;
+	long long iindex = (long long)floor(findex);
+	double a = tdigest_value_at_rank(ptdigest, iindex, n);
+	if (iindex >= n-1)
+		return a;
+	double b = tdigest_value_at_rank(ptdigest, iindex + 1, n);
+	return a + (findex - iindex) * (b - a);
+}
@@ -173,6 +173,10 @@ rval_evaluator_t* rval_evaluator_alloc_from_s_xs_func(
 	rval_evaluator_t* parg1,
 	rval_evaluator_t* parg2);
 
+rval_evaluator_t* rval_evaluator_alloc_from_fmtnum_func(
+	rval_evaluator_t* parg1,
+	rval_evaluator_t* parg2);
+
 rval_evaluator_t* rval_evaluator_alloc_from_s_sss_func(mv_ternary_func_t* pfunc,
 	rval_evaluator_t* parg1, rval_evaluator_t* parg2, rval_evaluator_t* parg3);
 
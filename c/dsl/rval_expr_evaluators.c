@@ -3,6 +3,7 @@
 #include <math.h>
 #include <ctype.h> // for tolower(), toupper()
 #include "lib/mlr_globals.h"
+#include "lib/mlr_arch.h"
 #include "lib/mlrutil.h"
 #include "lib/mlrregex.h"
 #include "lib/mtrand.h"
@@ -720,14 +721,16 @@ mv_t rval_evaluator_environment_func(void* pvstate, variables_t* pvars) {
 	}
 	char free_flags;
 	char* strname = mv_format_val(&mvname, &free_flags);
-	char* strvalue = getenv(strname);
+	// Copied since an ENV assignment on another thread (with --pipeline) may
+	// replace the value.
+	char* strvalue = mlr_arch_getenv_copy(strname);
 	if (strvalue == NULL) {
 		mv_free(&mvname);
 		if (free_flags & FREE_ENTRY_VALUE)
 			free(strname);
 		return mv_empty();
 	}
-	mv_t rv = mv_from_string(strvalue, NO_FREE);
+	mv_t rv = mv_from_string(strvalue, FREE_ENTRY_VALUE);
 	mv_free(&mvname);
 	if (free_flags & FREE_ENTRY_VALUE)
 		free(strname);
@@ -1244,6 +1244,56 @@ rval_evaluator_t* rval_evaluator_alloc_from_s_xs_func(mv_binary_func_t* pfunc,
 	return pevaluator;
 }
 
+// ----------------------------------------------------------------
+// The fmtnum format is nearly always the same from one record to the next, so
+// it's examined only when it changes, rather than on every call.
+typedef struct _rval_evaluator_fmtnum_state_t {
+	rval_evaluator_t* parg1;
+	rval_evaluator_t* parg2;
+	char*             fmt; // Copy of the last format seen; NULL before the first
+	double_format_t   format;
+} rval_evaluator_fmtnum_state_t;
+
+static mv_t rval_evaluator_fmtnum_func(void* pvstate, variables_t* pvars) {
+	rval_evaluator_fmtnum_state_t* pstate = pvstate;
+	mv_t val1 = pstate->parg1->pprocess_func(pstate->parg1->pvstate, pvars);
+	mv_t val2 = pstate->parg2->pprocess_func(pstate->parg2->pvstate, pvars);
+	NULL_OR_ERROR_OUT_FOR_STRINGS(val2);
+	if (!mv_is_string_or_empty(&val2))
+		return mv_error();
+
+	if (pstate->fmt == NULL || !streq(pstate->fmt, val2.u.strv)) {
+		free(pstate->fmt);
+		pstate->fmt = mlr_strdup_or_die(val2.u.strv);
+		mlr_double_format_init(&pstate->format, pstate->fmt);
+	}
+	mv_free(&val2);
+
+	return s_xf_fmtnum_precomp_func(&val1, &pstate->format);
+}
+static void rval_evaluator_fmtnum_free(rval_evaluator_t* pevaluator) {
+	rval_evaluator_fmtnum_state_t* pstate = pevaluator->pvstate;
+	pstate->parg1->pfree_func(pstate->parg1);
+	pstate->parg2->pfree_func(pstate->parg2);
+	free(pstate->fmt);
+	free(pstate);
+	free(pevaluator);
+}
+
+rval_evaluator_t* rval_evaluator_alloc_from_fmtnum_func(rval_evaluator_t* parg1, rval_evaluator_t* parg2) {
+	rval_evaluator_fmtnum_state_t* pstate = mlr_malloc_or_die(sizeof(rval_evaluator_fmtnum_state_t));
+	pstate->parg1 = parg1;
+	pstate->parg2 = parg2;
+	pstate->fmt   = NULL;
+
+	rval_evaluator_t* pevaluator = mlr_malloc_or_die(sizeof(rval_evaluator_t));
+	pevaluator->pvstate = pstate;
+	pevaluator->pprocess_func = rval_evaluator_fmtnum_func;
+	pevaluator->pfree_func = rval_evaluator_fmtnum_free;
+
+	return pevaluator;
+}
+
 // ----------------------------------------------------------------
 typedef struct _rval_evaluator_s_sss_state_t {
 	mv_ternary_func_t* pfunc;
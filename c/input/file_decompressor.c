@@ -0,0 +1,164 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <zlib.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "input/read_ahead_stream.h"
+#include "input/file_decompressor.h"
+
+#define DECOMPRESSOR_NUM_BUFFERS 4
+#define DECOMPRESSOR_BUFFER_SIZE (1 << 17)
+#define DECOMPRESSOR_INPUT_SIZE  (1 << 16)
+
+typedef struct _file_decompressor_t {
+	FILE*          input_stream; // Compressed
+	z_stream       zstream;
+	unsigned char* inbuf;
+	int            at_input_eof;
+	int            at_stream_end;
+} file_decompressor_t;
+
+static file_decompression_t file_decompression_mode = FILE_DECOMPRESSION_AUTO;
+
+static file_decompression_t file_decompressor_detect(int fd, char* filename);
+static FILE* file_decompressor_open(FILE* input_stream, char* filename, file_decompression_t kind);
+static size_t file_decompressor_fill(void* pvsource, char* buf, size_t size, char** perror_message);
+static void file_decompressor_close(void* pvsource);
+
+// ----------------------------------------------------------------
+void file_decompressor_set_mode(file_decompression_t mode) {
+	file_decompression_mode = mode;
+}
+
+// ----------------------------------------------------------------
+FILE* file_decompressor_wrap(FILE* input_stream, char* filename) {
+	file_decompression_t kind = file_decompression_mode;
+	if (kind == FILE_DECOMPRESSION_AUTO) {
+		kind = file_decompressor_detect(fileno(input_stream), filename);
+		if (kind == FILE_DECOMPRESSION_AUTO)
+			return input_stream;
+	}
+	return file_decompressor_open(input_stream, filename, kind);
+}
+
+int file_decompressor_applies(int fd, char* filename) {
+	return file_decompression_mode != FILE_DECOMPRESSION_AUTO
+		|| file_decompressor_detect(fd, filename) != FILE_DECOMPRESSION_AUTO;
+}
+
+// ----------------------------------------------------------------
+// Looks at the first few bytes of the file without consuming them. Returns
+// FILE_DECOMPRESSION_AUTO if the file isn't compressed, or if it can't be
+// peeked at since it isn't seekable.
+static file_decompression_t file_decompressor_detect(int fd, char* filename) {
+	unsigned char magic[4];
+	if (fd < 0)
+		return FILE_DECOMPRESSION_AUTO;
+	ssize_t n = pread(fd, magic, sizeof(magic), 0);
+	if (n < 2)
+		return FILE_DECOMPRESSION_AUTO;
+
+	if (magic[0] == 0x1f && magic[1] == 0x8b)
+		return FILE_DECOMPRESSION_GZIP;
+
+	// A zlib header is only two bytes with a check value, so it's easily
+	// matched by plain text (e.g. "x^"): also require the file-name suffix.
+	int len = strlen(filename);
+	if (len > 2 && streq(&filename[len-2], ".z")) {
+		if ((magic[0] & 0x0f) == Z_DEFLATED && (magic[0] >> 4) <= 7 && ((magic[0] << 8) | magic[1]) % 31 == 0)
+			return FILE_DECOMPRESSION_ZLIB;
+	}
+
+	if (n == 4 && magic[0] == 0x28 && magic[1] == 0xb5 && magic[2] == 0x2f && magic[3] == 0xfd) {
+		fprintf(stderr, "%s: file \"%s\" is zstd-compressed, which isn't supported natively.\n",
+			MLR_GLOBALS.bargv0, filename);
+		fprintf(stderr, "Please use --prepipe 'zstd -dc'.\n");
+		exit(1);
+	}
+
+	return FILE_DECOMPRESSION_AUTO;
+}
+
+// ----------------------------------------------------------------
+static FILE* file_decompressor_open(FILE* input_stream, char* filename, file_decompression_t kind) {
+	file_decompressor_t* pstate = mlr_malloc_or_die(sizeof(file_decompressor_t));
+	pstate->input_stream  = input_stream;
+	pstate->inbuf         = mlr_malloc_or_die(DECOMPRESSOR_INPUT_SIZE);
+	pstate->at_input_eof  = FALSE;
+	pstate->at_stream_end = FALSE;
+
+	char* kind_name = (kind == FILE_DECOMPRESSION_GZIP) ? "gzip decompression" : "zlib decompression";
+	memset(&pstate->zstream, 0, sizeof(pstate->zstream));
+	// Window bits 15 for zlib format; adding 16 selects gzip format.
+	int window_bits = (kind == FILE_DECOMPRESSION_GZIP) ? 15 + 16 : 15;
+	if (inflateInit2(&pstate->zstream, window_bits) != Z_OK) {
+		fprintf(stderr, "%s: could not initialize %s for \"%s\".\n",
+			MLR_GLOBALS.bargv0, kind_name, filename);
+		exit(1);
+	}
+
+	return read_ahead_stream_open(file_decompressor_fill, file_decompressor_close, pstate,
+		DECOMPRESSOR_NUM_BUFFERS, DECOMPRESSOR_BUFFER_SIZE, filename, kind_name);
+}
+
+// ----------------------------------------------------------------
+// Runs on the read-ahead stream's helper thread. Fills the output buffer
+// unless the input runs out first.
+static size_t file_decompressor_fill(void* pvsource, char* buf, size_t size, char** perror_message) {
+	file_decompressor_t* pstate = pvsource;
+	z_stream* pz = &pstate->zstream;
+	pz->next_out  = (unsigned char*)buf;
+	pz->avail_out = size;
+
+	while (pz->avail_out > 0) {
+		if (pz->avail_in == 0 && !pstate->at_input_eof) {
+			size_t nread = fread(pstate->inbuf, 1, DECOMPRESSOR_INPUT_SIZE, pstate->input_stream);
+			if (nread == 0) {
+				if (ferror(pstate->input_stream)) {
+					*perror_message = strerror(errno);
+					break;
+				}
+				pstate->at_input_eof = TRUE;
+			}
+			pz->next_in  = pstate->inbuf;
+			pz->avail_in = nread;
+		}
+		if (pz->avail_in == 0 && pstate->at_input_eof) {
+			if (!pstate->at_stream_end)
+				*perror_message = "unexpected end of file";
+			break;
+		}
+		int rc = inflate(pz, Z_NO_FLUSH);
+		if (rc == Z_STREAM_END) {
+			// Concatenated gzip members are decompressed as one stream, as by gunzip.
+			pstate->at_stream_end = TRUE;
+			inflateReset(pz);
+		} else if (rc == Z_OK) {
+			pstate->at_stream_end = FALSE;
+		} else if (rc == Z_BUF_ERROR) {
+			// No progress possible until there's more input.
+		} else if (pstate->at_stream_end) {
+			// Trailing garbage after the last member is ignored, as by gunzip.
+			pz->avail_in = 0;
+			pstate->at_input_eof = TRUE;
+		} else {
+			*perror_message = (pz->msg != NULL) ? pz->msg : "corrupt input";
+			break;
+		}
+	}
+
+	return size - pz->avail_out;
+}
+
+// ----------------------------------------------------------------
+static void file_decompressor_close(void* pvsource) {
+	file_decompressor_t* pstate = pvsource;
+	inflateEnd(&pstate->zstream);
+	if (pstate->input_stream != stdin)
+		fclose(pstate->input_stream);
+	free(pstate->inbuf);
+	free(pstate);
+}
@@ -0,0 +1,40 @@
+// ================================================================
+// Native decompression of gzip- and zlib-compressed input files.
+//
+// file_decompressor_wrap takes a stream opened for read and, if the input is
+// compressed, returns a stream from which the decompressed bytes can be read;
+// else it returns the stream as-is. Decompression runs on the helper thread of
+// a read-ahead stream (see read_ahead_stream.h), so it overlaps with record
+// parsing on the main thread.
+//
+// Closing the returned stream with fclose stops the helper thread and closes
+// the underlying stream (unless that is stdin).
+//
+// By default compression is detected from the first bytes of the file: gzip
+// by its magic number, and zlib by its header if the file name ends in ".z".
+// Detection requires a seekable input; for pipes and terminals, or to
+// override detection, the mode may be forced to gzip or zlib.
+// ================================================================
+
+#ifndef FILE_DECOMPRESSOR_H
+#define FILE_DECOMPRESSOR_H
+
+#include <stdio.h>
+
+typedef enum _file_decompression_t {
+	FILE_DECOMPRESSION_AUTO,
+	FILE_DECOMPRESSION_GZIP,
+	FILE_DECOMPRESSION_ZLIB,
+} file_decompression_t;
+
+// Applies to all input files opened after the call. Defaults to auto-detect.
+void file_decompressor_set_mode(file_decompression_t mode);
+
+FILE* file_decompressor_wrap(FILE* input_stream, char* filename);
+
+// True if the file open on the descriptor would be decompressed by
+// file_decompressor_wrap. The mmap and multi-threaded readers use this to
+// leave compressed files to the stdio readers.
+int file_decompressor_applies(int fd, char* filename);
+
+#endif // FILE_DECOMPRESSOR_H
@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "input/file_decompressor.h"
+#include "input/file_reader_mmap.h"
+
+static void file_reader_mmap_reclaim(file_reader_mmap_state_t* phandle);
+static void file_reader_mmap_unmap_segment(file_reader_mmap_state_t* phandle, size_t index);
+static void file_reader_mmap_lrec_free_backing(lrec_t* prec);
+
+// ----------------------------------------------------------------
+static inline size_t file_reader_mmap_segment_index(file_reader_mmap_state_t* phandle, char* p) {
+	return (p - phandle->data) / FILE_READER_MMAP_SEGMENT_SIZE;
+}
+
+// ----------------------------------------------------------------
+file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name) {
+	if (prepipe != NULL || streq(file_name, "-"))
+		return NULL;
+
+	int fd = open(file_name, O_RDONLY);
+	if (fd < 0) {
+		fprintf(stderr, "%s: Couldn't open \"%s\" for read.\n", MLR_GLOBALS.bargv0, file_name);
+		perror(file_name);
+		exit(1);
+	}
+	struct stat stat;
+	if (fstat(fd, &stat) < 0) {
+		fprintf(stderr, "%s: Couldn't fstat \"%s\".\n", MLR_GLOBALS.bargv0, file_name);
+		perror(file_name);
+		exit(1);
+	}
+	// Pipes, FIFOs, character devices, etc. -- files too large to map on
+	// 32-bit systems, and compressed files -- are left to stdio.
+	if (!S_ISREG(stat.st_mode) || (unsigned long long)stat.st_size > (size_t)-1
+		|| file_decompressor_applies(fd, file_name))
+	{
+		close(fd);
+		return NULL;
+	}
+
+	size_t length = stat.st_size;
+	char* data = NULL;
+	if (length > 0) {
+		data = mmap(NULL, length, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+		if (data == MAP_FAILED) {
+			close(fd);
+			return NULL;
+		}
+#ifdef MADV_SEQUENTIAL
+		madvise(data, length, MADV_SEQUENTIAL);
+#endif
+	}
+	// The mapping remains valid after the descriptor is closed.
+	close(fd);
+
+	file_reader_mmap_state_t* phandle = mlr_malloc_or_die(sizeof(file_reader_mmap_state_t));
+	phandle->data   = data;
+	phandle->length = length;
+	phandle->sol    = data;
+	phandle->eof    = data + length;
+
+	phandle->num_segments = (length + FILE_READER_MMAP_SEGMENT_SIZE - 1) / FILE_READER_MMAP_SEGMENT_SIZE;
+	phandle->psegments = mlr_malloc_or_die((phandle->num_segments + 1) * sizeof(file_reader_mmap_segment_t));
+	for (size_t i = 0; i < phandle->num_segments; i++) {
+		phandle->psegments[i].phandle = phandle;
+		phandle->psegments[i].index = i;
+		phandle->psegments[i].num_live_records = 0LL;
+	}
+	phandle->num_segments_passed = 0;
+	phandle->num_segments_pinned = 0;
+	phandle->num_live_records    = 0LL;
+	phandle->reclaim_pending     = FALSE;
+	phandle->copy_lines          = FALSE;
+	phandle->is_closed           = FALSE;
+
+	return phandle;
+}
+
+// ----------------------------------------------------------------
+// The handle is freed here if no records point into it; else, when the last
+// such record is freed.
+void file_reader_mmap_close(file_reader_mmap_state_t* phandle) {
+	phandle->is_closed = TRUE;
+	file_reader_mmap_reclaim(phandle);
+	if (phandle->num_live_records == 0LL) {
+		free(phandle->psegments);
+		free(phandle);
+	}
+}
+
+// ----------------------------------------------------------------
+void* file_reader_mmap_vopen(void* pvstate, char* prepipe, char* file_name) {
+	return file_reader_mmap_open(prepipe, file_name);
+}
+
+void file_reader_mmap_vclose(void* pvstate, void* pvhandle, char* prepipe) {
+	file_reader_mmap_close(pvhandle);
+}
+
+// ----------------------------------------------------------------
+// Unmaps the segments which the reader has newly moved past, other than those
+// which live records point into: those are unmapped as their last records are
+// freed.
+static void file_reader_mmap_reclaim(file_reader_mmap_state_t* phandle) {
+	size_t reader_segment = (phandle->is_closed || phandle->sol >= phandle->eof)
+		? phandle->num_segments
+		: file_reader_mmap_segment_index(phandle, phandle->sol);
+
+	for (size_t i = phandle->num_segments_passed; i < reader_segment; i++) {
+		if (phandle->psegments[i].num_live_records == 0LL)
+			file_reader_mmap_unmap_segment(phandle, i);
+		else
+			phandle->num_segments_pinned++;
+	}
+	if (reader_segment > phandle->num_segments_passed)
+		phandle->num_segments_passed = reader_segment;
+
+	if (phandle->num_segments_pinned > FILE_READER_MMAP_MAX_PINNED_SEGMENTS)
+		phandle->copy_lines = TRUE;
+}
+
+static void file_reader_mmap_unmap_segment(file_reader_mmap_state_t* phandle, size_t index) {
+	char* start = phandle->data + index * FILE_READER_MMAP_SEGMENT_SIZE;
+	char* end = (index + 1 == phandle->num_segments)
+		? phandle->data + phandle->length
+		: start + FILE_READER_MMAP_SEGMENT_SIZE;
+	if (munmap(start, end - start) != 0) {
+		perror("munmap");
+		exit(1);
+	}
+}
+
+// ----------------------------------------------------------------
+void file_reader_mmap_attach_lrec(file_reader_mmap_segment_t* psegment, lrec_t* prec) {
+	if (psegment == NULL)
+		return;
+	prec->psingle_line = NULL;
+	prec->pvmmap_segment = psegment;
+	prec->pfree_backing_func = file_reader_mmap_lrec_free_backing;
+	psegment->num_live_records++;
+	psegment->phandle->num_live_records++;
+}
+
+static void file_reader_mmap_lrec_free_backing(lrec_t* prec) {
+	file_reader_mmap_segment_t* psegment = prec->pvmmap_segment;
+	file_reader_mmap_state_t* phandle = psegment->phandle;
+	psegment->num_live_records--;
+	phandle->num_live_records--;
+	if (psegment->num_live_records == 0LL && psegment->index < phandle->num_segments_passed) {
+		file_reader_mmap_unmap_segment(phandle, psegment->index);
+		phandle->num_segments_pinned--;
+	}
+	if (phandle->is_closed && phandle->num_live_records == 0LL) {
+		free(phandle->psegments);
+		free(phandle);
+	}
+}
+
+// ----------------------------------------------------------------
+static char* file_reader_mmap_copy_line(char* start, char* end) {
+	size_t length = end - start;
+	char* copy = mlr_malloc_or_die(length + 1);
+	memcpy(copy, start, length);
+	copy[length] = 0;
+	return copy;
+}
+
+// A line whose terminator is in a later segment than its start is copied out,
+// so that a record never needs more than the one segment it holds a
+// reference on.
+static inline int file_reader_mmap_must_copy(file_reader_mmap_state_t* phandle, size_t segment_index,
+	char* terminator)
+{
+	return phandle->copy_lines || file_reader_mmap_segment_index(phandle, terminator) != segment_index;
+}
+
+// ----------------------------------------------------------------
+char* file_reader_mmap_read_line_single_delimiter(
+	file_reader_mmap_state_t*    phandle,
+	char                         delimiter,
+	int                          do_auto_line_term,
+	comment_handling_t           comment_handling,
+	char*                        comment_string,
+	int*                         pnum_lines_comment_skipped,
+	file_reader_mmap_segment_t** ppsegment,
+	context_t*                   pctx)
+{
+	if (pnum_lines_comment_skipped != NULL)
+		*pnum_lines_comment_skipped = 0;
+
+	while (TRUE) {
+		// The previous line has by now been attached to its record (or
+		// discarded), so the segments behind it may be unmapped.
+		if (phandle->reclaim_pending) {
+			file_reader_mmap_reclaim(phandle);
+			phandle->reclaim_pending = FALSE;
+		}
+		char* line = phandle->sol;
+		if (line >= phandle->eof)
+			return NULL;
+		size_t segment_index = file_reader_mmap_segment_index(phandle, line);
+		file_reader_mmap_segment_t* psegment = NULL;
+
+		// memchr is vectorized in most C libraries; this is the bulk of the line-reading work.
+		char* p = memchr(line, delimiter, phandle->eof - line);
+		if (p != NULL && !file_reader_mmap_must_copy(phandle, segment_index, p)) {
+			*p = 0;
+			phandle->sol = p + 1;
+			psegment = &phandle->psegments[segment_index];
+		} else {
+			char* end = (p != NULL) ? p : phandle->eof;
+			phandle->sol = (p != NULL) ? p + 1 : phandle->eof;
+			size_t length = end - line;
+			line = file_reader_mmap_copy_line(line, end);
+			p = line + length;
+		}
+
+		if (do_auto_line_term) {
+			if (p > line && p[-1] == '\r') {
+				p[-1] = 0;
+				context_set_autodetected_crlf(pctx);
+			} else {
+				context_set_autodetected_lf(pctx);
+			}
+		}
+
+		if (phandle->sol >= phandle->eof || file_reader_mmap_segment_index(phandle, phandle->sol) != segment_index)
+			phandle->reclaim_pending = TRUE;
+
+		if (comment_handling != COMMENTS_ARE_DATA && string_starts_with(line, comment_string)) {
+			if (pnum_lines_comment_skipped != NULL)
+				(*pnum_lines_comment_skipped)++;
+			if (comment_handling == PASS_COMMENTS) {
+				fputs(line, stdout);
+				if (do_auto_line_term) {
+					fputs(pctx->auto_line_term, stdout);
+				} else {
+					fputc(delimiter, stdout);
+				}
+				fflush(stdout);
+			}
+			if (psegment == NULL)
+				free(line);
+			continue;
+		}
+
+		*ppsegment = psegment;
+		return line;
+	}
+}
+
+// ----------------------------------------------------------------
+char* file_reader_mmap_read_line_multiple_delimiter(
+	file_reader_mmap_state_t*    phandle,
+	char*                        delimiter,
+	int                          delimiter_length,
+	comment_handling_t           comment_handling,
+	char*                        comment_string,
+	int*                         pnum_lines_comment_skipped,
+	file_reader_mmap_segment_t** ppsegment)
+{
+	if (pnum_lines_comment_skipped != NULL)
+		*pnum_lines_comment_skipped = 0;
+
+	while (TRUE) {
+		// The previous line has by now been attached to its record (or
+		// discarded), so the segments behind it may be unmapped.
+		if (phandle->reclaim_pending) {
+			file_reader_mmap_reclaim(phandle);
+			phandle->reclaim_pending = FALSE;
+		}
+		char* line = phandle->sol;
+		if (line >= phandle->eof)
+			return NULL;
+		size_t segment_index = file_reader_mmap_segment_index(phandle, line);
+		file_reader_mmap_segment_t* psegment = NULL;
+
+		// Find the first character of the delimiter, then check for the rest of it.
+		char* p = line;
+		while (TRUE) {
+			p = memchr(p, delimiter[0], phandle->eof - p);
+			if (p == NULL)
+				break;
+			if (phandle->eof - p >= delimiter_length && memcmp(p, delimiter, delimiter_length) == 0)
+				break;
+			p++;
+		}
+
+		if (p != NULL && !file_reader_mmap_must_copy(phandle, segment_index, p)) {
+			*p = 0;
+			phandle->sol = p + delimiter_length;
+			psegment = &phandle->psegments[segment_index];
+		} else {
+			char* end = (p != NULL) ? p : phandle->eof;
+			phandle->sol = (p != NULL) ? p + delimiter_length : phandle->eof;
+			line = file_reader_mmap_copy_line(line, end);
+		}
+
+		if (phandle->sol >= phandle->eof || file_reader_mmap_segment_index(phandle, phandle->sol) != segment_index)
+			phandle->reclaim_pending = TRUE;
+
+		if (comment_handling != COMMENTS_ARE_DATA && string_starts_with(line, comment_string)) {
+			if (pnum_lines_comment_skipped != NULL)
+				(*pnum_lines_comment_skipped)++;
+			if (comment_handling == PASS_COMMENTS) {
+				fputs(line, stdout);
+				fputs(delimiter, stdout);
+				fflush(stdout);
+			}
+			if (psegment == NULL)
+				free(line);
+			continue;
+		}
+
+		*ppsegment = psegment;
+		return line;
+	}
+}
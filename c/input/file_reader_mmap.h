@@ -0,0 +1,115 @@
+// ================================================================
+// Abstraction layer for mmap file-read logic.
+//
+// Regular files are mapped MAP_PRIVATE and read-write: line terminators are
+// overwritten with null characters in place, and the record-splitters then
+// null-terminate keys and values in place, so lrec keys and values point
+// directly into the mapped pages with NO_FREE flags. Writes only touch the
+// process' private copy of each page; the file on disk is never modified.
+//
+// Lifetime: some mappers (tac, sort, top, etc.) retain records past the point
+// where the reader has moved on, and mapper join keeps its left-file reader
+// open alongside the main one. So the mapping isn't torn down when the file is
+// closed; rather, the file is divided into fixed-size segments, each record
+// holds a reference on the segment its line starts in, and each segment is
+// unmapped as soon as the reader has moved past it and all of its records
+// have been freed. Since written-to private pages can't be dropped by the
+// kernel, though, a single retained record keeps its whole segment resident.
+// So once more than a few segments behind the reader are pinned this way,
+// the reader stops handing out pointers into the mapping for the rest of the
+// file: each line is copied out to the heap, as with the stdio reader, and
+// the mapping is only read. This keeps resident memory within a few segments
+// of what stdio would use, whatever the mappers keep.
+//
+// Records are released from the same thread which reads them, so this isn't
+// used with --pipeline, where they're freed on the mappers' threads.
+//
+// Non-regular files (stdin, pipes, FIFOs, process substitution) and --prepipe
+// can't be mapped; for those, file_reader_mmap_open returns NULL and the
+// caller should fall back to the stdio reader. See lrec_reader_mmap_or_stdio.
+// ================================================================
+
+#ifndef FILE_READER_MMAP_H
+#define FILE_READER_MMAP_H
+
+#include <stddef.h>
+#include "cli/comment_handling.h"
+#include "lib/context.h"
+#include "containers/lrec.h"
+
+// Must be a multiple of the page size.
+#define FILE_READER_MMAP_SEGMENT_SIZE (1 << 20)
+// Segments behind the reader which may be kept mapped by retained records
+// before the reader switches to copying lines out.
+#define FILE_READER_MMAP_MAX_PINNED_SEGMENTS 8
+
+struct _file_reader_mmap_state_t; // forward reference
+
+typedef struct _file_reader_mmap_segment_t {
+	struct _file_reader_mmap_state_t* phandle;
+	size_t    index;
+	long long num_live_records;
+} file_reader_mmap_segment_t;
+
+typedef struct _file_reader_mmap_state_t {
+	char*  sol; // Start of the next line to be read
+	char*  eof; // One past the last byte of file data
+	char*  data;
+	size_t length;
+
+	file_reader_mmap_segment_t* psegments;
+	size_t    num_segments;
+	size_t    num_segments_passed; // Those before this are behind the reader
+	size_t    num_segments_pinned; // Behind the reader but with live records
+	long long num_live_records;
+	int       reclaim_pending; // Set when the reader crosses a segment boundary
+	int       copy_lines;      // Set when too many segments are pinned
+	int       is_closed;
+} file_reader_mmap_state_t;
+
+// Returns NULL if the input can't be mapped, in which case the caller should
+// use stdio instead.
+file_reader_mmap_state_t* file_reader_mmap_open(char* prepipe, char* file_name);
+void file_reader_mmap_close(file_reader_mmap_state_t* phandle);
+
+void* file_reader_mmap_vopen(void* pvstate, char* prepipe, char* file_name);
+void file_reader_mmap_vclose(void* pvstate, void* pvhandle, char* prepipe);
+
+// Notes:
+// * The return value is null-terminated in place, with the line-terminator
+//   not included. Null is returned at EOF.
+// * *ppsegment is set to the segment the line starts in, for use with
+//   file_reader_mmap_attach_lrec once the line has been split into a record.
+// * If the file's final line has no terminator, there is no room in the
+//   mapping to null-terminate it; and after the switch to copying lines out
+//   (see above), no line is null-terminated in place. Then a mallocked copy
+//   is returned, and *ppsegment is set to NULL: the copy is to be owned by the
+//   lrec as with the stdio readers.
+// * With comment handling other than COMMENTS_ARE_DATA, comment lines are
+//   skipped (and printed, for PASS_COMMENTS). If pnum_lines_comment_skipped is
+//   non-null, the number of skipped lines is written there.
+char* file_reader_mmap_read_line_single_delimiter(
+	file_reader_mmap_state_t*    phandle,
+	char                         delimiter,
+	int                          do_auto_line_term,
+	comment_handling_t           comment_handling,
+	char*                        comment_string,
+	int*                         pnum_lines_comment_skipped,
+	file_reader_mmap_segment_t** ppsegment,
+	context_t*                   pctx);
+
+char* file_reader_mmap_read_line_multiple_delimiter(
+	file_reader_mmap_state_t*    phandle,
+	char*                        delimiter,
+	int                          delimiter_length,
+	comment_handling_t           comment_handling,
+	char*                        comment_string,
+	int*                         pnum_lines_comment_skipped,
+	file_reader_mmap_segment_t** ppsegment);
+
+// Makes the record hold a reference on the segment, replacing the
+// single-line backing set up by the line-splitter. A null segment (see above)
+// leaves the record as-is.
+void file_reader_mmap_attach_lrec(file_reader_mmap_segment_t* psegment, lrec_t* prec);
+
+#endif // FILE_READER_MMAP_H
@@ -7,6 +7,8 @@
 #include "lib/mlrutil.h"
 #include "lib/mlrescape.h"
 #include "lib/mlr_globals.h"
+#include "input/file_decompressor.h"
+#include "input/read_ahead_stream.h"
 #include "file_reader_stdio.h"
 
 // ----------------------------------------------------------------
@@ -22,6 +24,7 @@ void* file_reader_stdio_vopen(void* pvstate, char* prepipe, char* filename) {
 				exit(1);
 			}
 		}
+		input_stream = read_ahead_wrap(file_decompressor_wrap(input_stream, filename), filename);
 	} else {
 		char* escaped_filename = alloc_file_name_escaped_for_popen(filename);
 		char* command = mlr_malloc_or_die(strlen(prepipe) + 3 + strlen(escaped_filename) + 1);
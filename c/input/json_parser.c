@@ -641,6 +641,9 @@ json_value_t * json_parse(
 										break;
 									}
 
+									// Counted here on the first pass; added to the string value on the
+									// second pass by the loop above.
+									integer_sval_add(&state, ptop, b);
 									flags |= FLAG_NUM_NEGATIVE;
 									continue;
 								} else {
@@ -705,6 +708,7 @@ json_value_t * json_parse(
 							} else {
 								flags |= FLAG_NUM_E_GOT_SIGN;
 								num_e = (num_e * 10) + (b - '0');
+								dbl_sval_add(&state, ptop, b);
 								continue;
 							}
 
@@ -724,6 +728,7 @@ json_value_t * json_parse(
 							if (b == '-')
 								flags |= FLAG_NUM_E_NEGATIVE;
 
+							dbl_sval_add(&state, ptop, b);
 							continue;
 						}
 					} else if (b == '.' && ptop->type == JSON_INTEGER) {
@@ -756,8 +761,8 @@ json_value_t * json_parse(
 								ptop->type = JSON_DOUBLE;
 								ptop->u.dbl.length = ptop->u.integer.length;
 								ptop->u.dbl.sval = ptop->u.integer.sval;
-								dbl_sval_add(&state, ptop, b);
 							}
+							dbl_sval_add(&state, ptop, b);
 
 							num_digits = 0;
 							flags &= ~ FLAG_NUM_ZERO;
@@ -0,0 +1,215 @@
+// ================================================================
+// This is the mmap counterpart of lrec_reader_stdio_csvlite.c; see that file
+// for notes on header-keepers and on multi-file cases. Header lines are copied
+// out of the mapped file data since header-keepers outlive the file; data
+// lines are split in place.  Non-mappable input is handled by the stdio
+// reader: see lrec_reader_mmap_or_stdio.c.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cli/comment_handling.h"
+#include "lib/mlr_globals.h"
+#include "lib/mlrutil.h"
+#include "containers/slls.h"
+#include "containers/lhmslv.h"
+#include "input/file_reader_mmap.h"
+#include "input/lrec_readers.h"
+
+typedef struct _lrec_reader_mmap_csvlite_state_t {
+	long long  ifnr;
+	long long  ilno; // Line-level, not record-level as in context_t
+	char*  irs;
+	char*  ifs;
+	int    irslen;
+	int    ifslen;
+	int    allow_repeat_ifs;
+	int    do_auto_line_term;
+	int    use_implicit_csv_header;
+	int    allow_ragged_csv_input;
+	comment_handling_t comment_handling;
+	char*  comment_string;
+
+	int  expect_header_line_next;
+	header_keeper_t* pheader_keeper;
+	lhmslv_t*     pheader_keepers;
+} lrec_reader_mmap_csvlite_state_t;
+
+static void    lrec_reader_mmap_csvlite_free(lrec_reader_t* preader);
+static void    lrec_reader_mmap_csvlite_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_mmap_csvlite_process(void* pvstate, void* pvhandle, context_t* pctx);
+static char*   lrec_reader_mmap_csvlite_read_line(lrec_reader_mmap_csvlite_state_t* pstate,
+	file_reader_mmap_state_t* phandle, int* pnum_lines_comment_skipped, file_reader_mmap_segment_t** ppsegment,
+	context_t* pctx);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_mmap_csvlite_alloc(char* irs, char* ifs, int allow_repeat_ifs, int use_implicit_csv_header,
+	int allow_ragged_csv_input, comment_handling_t comment_handling, char* comment_string)
+{
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_mmap_csvlite_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_mmap_csvlite_state_t));
+	pstate->ifnr                    = 0LL;
+	pstate->ilno                    = 0LL;
+	pstate->irs                     = irs;
+	pstate->ifs                     = ifs;
+	pstate->irslen                  = strlen(irs);
+	pstate->ifslen                  = strlen(ifs);
+	pstate->allow_repeat_ifs        = allow_repeat_ifs;
+	pstate->do_auto_line_term       = FALSE;
+	pstate->use_implicit_csv_header = use_implicit_csv_header;
+	pstate->allow_ragged_csv_input  = allow_ragged_csv_input;
+	pstate->comment_handling        = comment_handling;
+	pstate->comment_string          = comment_string;
+
+	pstate->expect_header_line_next = use_implicit_csv_header  ? FALSE : TRUE;
+	pstate->pheader_keeper          = NULL;
+	pstate->pheader_keepers         = lhmslv_alloc();
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_mmap_vopen;
+	plrec_reader->pclose_func   = file_reader_mmap_vclose;
+	if (streq(irs, "auto")) {
+		// Auto means either lines end in "\n" or "\r\n" (LF or CRLF).  In
+		// either case the final character is "\n". Then for autodetect we
+		// simply check if there's a character in the line before the '\n', and
+		// if that is '\r'.
+		pstate->irs = "\n";
+		pstate->irslen = 1;
+		pstate->do_auto_line_term = TRUE;
+	}
+	plrec_reader->pprocess_func = lrec_reader_mmap_csvlite_process;
+	plrec_reader->psof_func     = lrec_reader_mmap_csvlite_sof;
+	plrec_reader->pfree_func    = lrec_reader_mmap_csvlite_free;
+
+	return plrec_reader;
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_mmap_csvlite_free(lrec_reader_t* preader) {
+	lrec_reader_mmap_csvlite_state_t* pstate = preader->pvstate;
+	for (lhmslve_t* pe = pstate->pheader_keepers->phead; pe != NULL; pe = pe->pnext) {
+		header_keeper_t* pheader_keeper = pe->pvvalue;
+		header_keeper_free(pheader_keeper);
+	}
+	lhmslv_free(pstate->pheader_keepers);
+	free(pstate);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_mmap_csvlite_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_mmap_csvlite_state_t* pstate = pvstate;
+	pstate->ifnr = 0LL;
+	pstate->ilno = 0LL;
+	pstate->expect_header_line_next = pstate->use_implicit_csv_header ? FALSE : TRUE;
+}
+
+// ----------------------------------------------------------------
+static char* lrec_reader_mmap_csvlite_read_line(lrec_reader_mmap_csvlite_state_t* pstate,
+	file_reader_mmap_state_t* phandle, int* pnum_lines_comment_skipped, file_reader_mmap_segment_t** ppsegment,
+	context_t* pctx)
+{
+	if (pstate->irslen == 1)
+		return file_reader_mmap_read_line_single_delimiter(phandle, pstate->irs[0], pstate->do_auto_line_term,
+			pstate->comment_handling, pstate->comment_string, pnum_lines_comment_skipped, ppsegment, pctx);
+	else
+		return file_reader_mmap_read_line_multiple_delimiter(phandle, pstate->irs, pstate->irslen,
+			pstate->comment_handling, pstate->comment_string, pnum_lines_comment_skipped, ppsegment);
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_mmap_csvlite_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	file_reader_mmap_state_t* phandle = pvhandle;
+	lrec_reader_mmap_csvlite_state_t* pstate = pvstate;
+	file_reader_mmap_segment_t* psegment = NULL;
+	int num_lines_comment_skipped = 0;
+
+	while (TRUE) {
+		if (pstate->expect_header_line_next) {
+			while (TRUE) {
+				char* hline = lrec_reader_mmap_csvlite_read_line(pstate, phandle, &num_lines_comment_skipped,
+					&psegment, pctx);
+				pstate->ilno += num_lines_comment_skipped;
+				if (hline == NULL) // EOF
+					return NULL;
+				pstate->ilno++;
+				// The header-keeper owns its line, and outlives the mapping.
+				if (psegment != NULL)
+					hline = mlr_strdup_or_die(hline);
+
+				slls_t* pheader_fields = (pstate->ifslen == 1)
+					? split_csvlite_header_line_single_ifs(hline, pstate->ifs[0], pstate->allow_repeat_ifs)
+					: split_csvlite_header_line_multi_ifs(hline, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs);
+				if (pheader_fields->length == 0) {
+					pstate->expect_header_line_next = TRUE;
+					if (pstate->pheader_keeper != NULL) {
+						pstate->pheader_keeper = NULL;
+					}
+					slls_free(pheader_fields);
+					free(hline);
+				} else {
+					for (sllse_t* pe = pheader_fields->phead; pe != NULL; pe = pe->pnext) {
+						if (*pe->value == 0) {
+							fprintf(stderr, "%s: unacceptable empty CSV key at file \"%s\" line %lld.\n",
+								MLR_GLOBALS.bargv0, pctx->filename, pstate->ilno);
+							exit(1);
+						}
+					}
+
+					pstate->expect_header_line_next = FALSE;
+
+					pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
+					if (pstate->pheader_keeper == NULL) {
+						pstate->pheader_keeper = header_keeper_alloc(hline, pheader_fields);
+						lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
+							NO_FREE); // freed by header-keeper
+					} else { // Re-use the header-keeper in the header cache
+						slls_free(pheader_fields);
+						free(hline);
+					}
+					break;
+				}
+			}
+		}
+
+		char* line = lrec_reader_mmap_csvlite_read_line(pstate, phandle, &num_lines_comment_skipped,
+			&psegment, pctx);
+		pstate->ilno += num_lines_comment_skipped;
+		if (line == NULL) // EOF
+			return NULL;
+		pstate->ilno++;
+
+		if (!*line) {
+			// Blank line: schema change
+			if (psegment == NULL)
+				free(line);
+			if (pstate->pheader_keeper != NULL) {
+				pstate->pheader_keeper = NULL;
+				pstate->expect_header_line_next = TRUE;
+			}
+			continue;
+		}
+
+		pstate->ifnr++;
+		lrec_t* prec = NULL;
+		if (pstate->ifslen == 1) {
+			prec = pstate->use_implicit_csv_header
+				? lrec_parse_stdio_csvlite_data_line_single_ifs_implicit_header(
+					pstate->pheader_keeper, pctx->filename, pstate->ilno, line,
+					pstate->ifs[0], pstate->allow_repeat_ifs)
+				: lrec_parse_stdio_csvlite_data_line_single_ifs(pstate->pheader_keeper, pctx->filename,
+					pstate->ilno, line, pstate->ifs[0], pstate->allow_repeat_ifs, pstate->allow_ragged_csv_input);
+		} else {
+			prec = pstate->use_implicit_csv_header
+				? lrec_parse_stdio_csvlite_data_line_multi_ifs_implicit_header(
+					pstate->pheader_keeper, pctx->filename, pstate->ilno, line,
+					pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs)
+				: lrec_parse_stdio_csvlite_data_line_multi_ifs(pstate->pheader_keeper, pctx->filename,
+					pstate->ilno, line, pstate->ifs, pstate->ifslen, pstate->allow_repeat_ifs,
+					pstate->allow_ragged_csv_input);
+		}
+		file_reader_mmap_attach_lrec(psegment, prec);
+		return prec;
+	}
+}
@@ -0,0 +1,169 @@
+// ================================================================
+// Note: there are multiple process methods with a lot of code duplication.
+// This is intentional. Much of Miller's measured processing time is in the
+// lrec-reader process methods. This is code which needs to execute on every
+// byte of input and even moving a single runtime if-statement into a
+// function-pointer assignment at alloc time can have noticeable effects on
+// performance (5-10% in some cases).
+//
+// Lines are found and null-terminated in the mapped file data, then split
+// using the same line-splitters as the stdio reader. Non-mappable input is
+// handled by the stdio reader: see lrec_reader_mmap_or_stdio.c.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "cli/comment_handling.h"
+#include "lib/mlrutil.h"
+#include "input/file_reader_mmap.h"
+#include "input/lrec_readers.h"
+
+typedef struct _lrec_reader_mmap_dkvp_state_t {
+	char*  irs;
+	char*  ifs;
+	char*  ips;
+	int    irslen;
+	int    ifslen;
+	int    ipslen;
+	int    allow_repeat_ifs;
+	int    do_auto_line_term;
+	comment_handling_t comment_handling;
+	char*  comment_string;
+} lrec_reader_mmap_dkvp_state_t;
+
+static void    lrec_reader_mmap_dkvp_free(lrec_reader_t* preader);
+static void    lrec_reader_mmap_dkvp_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_single_others(void* pvstate, void* pvhandle,
+	context_t* pctx);
+static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_multi_others(void* pvstate, void* pvhandle,
+	context_t* pctx);
+static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_single_others(void* pvstate, void* pvhandle,
+	context_t* pctx);
+static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_multi_others(void* pvstate, void* pvhandle,
+	context_t* pctx);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
+	comment_handling_t comment_handling, char* comment_string)
+{
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_mmap_dkvp_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_mmap_dkvp_state_t));
+	pstate->irs               = irs;
+	pstate->ifs               = ifs;
+	pstate->ips               = ips;
+	pstate->irslen            = strlen(irs);
+	pstate->ifslen            = strlen(ifs);
+	pstate->ipslen            = strlen(ips);
+	pstate->allow_repeat_ifs  = allow_repeat_ifs;
+	pstate->do_auto_line_term = FALSE;
+	pstate->comment_handling  = comment_handling;
+	pstate->comment_string    = comment_string;
+
+	if (streq(irs, "auto")) {
+		// Auto means either lines end in "\n" or "\r\n" (LF or CRLF).  In
+		// either case the final character is "\n". Then for autodetect we
+		// simply check if there's a character in the line before the '\n', and
+		// if that is '\r'.
+		pstate->irs = "\n";
+		pstate->irslen = 1;
+		pstate->do_auto_line_term = TRUE;
+	}
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = file_reader_mmap_vopen;
+	plrec_reader->pclose_func   = file_reader_mmap_vclose;
+	if (pstate->irslen == 1) {
+		plrec_reader->pprocess_func = (pstate->ifslen == 1 && pstate->ipslen == 1)
+			? lrec_reader_mmap_dkvp_process_single_irs_single_others
+			: lrec_reader_mmap_dkvp_process_single_irs_multi_others;
+	} else {
+		plrec_reader->pprocess_func = (pstate->ifslen == 1 && pstate->ipslen == 1)
+			? lrec_reader_mmap_dkvp_process_multi_irs_single_others
+			: lrec_reader_mmap_dkvp_process_multi_irs_multi_others;
+	}
+	plrec_reader->psof_func     = lrec_reader_mmap_dkvp_sof;
+	plrec_reader->pfree_func    = lrec_reader_mmap_dkvp_free;
+
+	return plrec_reader;
+}
+
+static void lrec_reader_mmap_dkvp_free(lrec_reader_t* preader) {
+	free(preader->pvstate);
+	free(preader);
+}
+
+// No-op for stateless readers such as this one.
+static void lrec_reader_mmap_dkvp_sof(void* pvstate, void* pvhandle) {
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_single_others(void* pvstate, void* pvhandle,
+	context_t* pctx)
+{
+	file_reader_mmap_state_t* phandle = pvhandle;
+	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
+	file_reader_mmap_segment_t* psegment = NULL;
+
+	char* line = file_reader_mmap_read_line_single_delimiter(phandle, pstate->irs[0], pstate->do_auto_line_term,
+		pstate->comment_handling, pstate->comment_string, NULL, &psegment, pctx);
+	if (line == NULL)
+		return NULL;
+
+	lrec_t* prec = lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+	file_reader_mmap_attach_lrec(psegment, prec);
+	return prec;
+}
+
+static lrec_t* lrec_reader_mmap_dkvp_process_single_irs_multi_others(void* pvstate, void* pvhandle,
+	context_t* pctx)
+{
+	file_reader_mmap_state_t* phandle = pvhandle;
+	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
+	file_reader_mmap_segment_t* psegment = NULL;
+
+	char* line = file_reader_mmap_read_line_single_delimiter(phandle, pstate->irs[0], pstate->do_auto_line_term,
+		pstate->comment_handling, pstate->comment_string, NULL, &psegment, pctx);
+	if (line == NULL)
+		return NULL;
+
+	lrec_t* prec = lrec_parse_stdio_dkvp_multi_sep(line, pstate->ifs, pstate->ips, pstate->ifslen, pstate->ipslen,
+		pstate->allow_repeat_ifs);
+	file_reader_mmap_attach_lrec(psegment, prec);
+	return prec;
+}
+
+static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_single_others(void* pvstate, void* pvhandle,
+	context_t* pctx)
+{
+	file_reader_mmap_state_t* phandle = pvhandle;
+	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
+	file_reader_mmap_segment_t* psegment = NULL;
+
+	char* line = file_reader_mmap_read_line_multiple_delimiter(phandle, pstate->irs, pstate->irslen,
+		pstate->comment_handling, pstate->comment_string, NULL, &psegment);
+	if (line == NULL)
+		return NULL;
+
+	lrec_t* prec = lrec_parse_stdio_dkvp_single_sep(line, pstate->ifs[0], pstate->ips[0], pstate->allow_repeat_ifs);
+	file_reader_mmap_attach_lrec(psegment, prec);
+	return prec;
+}
+
+static lrec_t* lrec_reader_mmap_dkvp_process_multi_irs_multi_others(void* pvstate, void* pvhandle,
+	context_t* pctx)
+{
+	file_reader_mmap_state_t* phandle = pvhandle;
+	lrec_reader_mmap_dkvp_state_t* pstate = pvstate;
+	file_reader_mmap_segment_t* psegment = NULL;
+
+	char* line = file_reader_mmap_read_line_multiple_delimiter(phandle, pstate->irs, pstate->irslen,
+		pstate->comment_handling, pstate->comment_string, NULL, &psegment);
+	if (line == NULL)
+		return NULL;
+
+	lrec_t* prec = lrec_parse_stdio_dkvp_multi_sep(line, pstate->ifs, pstate->ips, pstate->ifslen, pstate->ipslen,
+		pstate->allow_repeat_ifs);
+	file_reader_mmap_attach_lrec(psegment, prec);
+	return prec;
+}
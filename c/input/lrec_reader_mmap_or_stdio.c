@@ -0,0 +1,81 @@
+// ================================================================
+// Delegates to an mmap reader for regular files, and to a stdio reader for
+// everything else: --prepipe, standard input, pipes, FIFOs, etc. This is
+// decided per file at open time; see file_reader_mmap_open.
+// ================================================================
+
+#include <stdlib.h>
+#include "lib/mlrutil.h"
+#include "input/lrec_readers.h"
+
+typedef struct _lrec_reader_mmap_or_stdio_state_t {
+	lrec_reader_t* pmmap_reader;
+	lrec_reader_t* pstdio_reader;
+	lrec_reader_t* pcurrent_reader; // Whichever opened the current file
+} lrec_reader_mmap_or_stdio_state_t;
+
+static void*   lrec_reader_mmap_or_stdio_open(void* pvstate, char* prepipe, char* filename);
+static void    lrec_reader_mmap_or_stdio_close(void* pvstate, void* pvhandle, char* prepipe);
+static void    lrec_reader_mmap_or_stdio_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_mmap_or_stdio_process(void* pvstate, void* pvhandle, context_t* pctx);
+static void    lrec_reader_mmap_or_stdio_free(lrec_reader_t* preader);
+
+// ----------------------------------------------------------------
+// The mmap reader's open function must return NULL for non-mappable input.
+lrec_reader_t* lrec_reader_mmap_or_stdio_alloc(lrec_reader_t* pmmap_reader, lrec_reader_t* pstdio_reader) {
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_mmap_or_stdio_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_mmap_or_stdio_state_t));
+	pstate->pmmap_reader    = pmmap_reader;
+	pstate->pstdio_reader   = pstdio_reader;
+	pstate->pcurrent_reader = NULL;
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = lrec_reader_mmap_or_stdio_open;
+	plrec_reader->pclose_func   = lrec_reader_mmap_or_stdio_close;
+	plrec_reader->pprocess_func = lrec_reader_mmap_or_stdio_process;
+	plrec_reader->psof_func     = lrec_reader_mmap_or_stdio_sof;
+	plrec_reader->pfree_func    = lrec_reader_mmap_or_stdio_free;
+
+	return plrec_reader;
+}
+
+static void lrec_reader_mmap_or_stdio_free(lrec_reader_t* preader) {
+	lrec_reader_mmap_or_stdio_state_t* pstate = preader->pvstate;
+	pstate->pmmap_reader->pfree_func(pstate->pmmap_reader);
+	pstate->pstdio_reader->pfree_func(pstate->pstdio_reader);
+	free(pstate);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+static void* lrec_reader_mmap_or_stdio_open(void* pvstate, char* prepipe, char* filename) {
+	lrec_reader_mmap_or_stdio_state_t* pstate = pvstate;
+	lrec_reader_t* pmmap_reader = pstate->pmmap_reader;
+	void* pvhandle = pmmap_reader->popen_func(pmmap_reader->pvstate, prepipe, filename);
+	if (pvhandle != NULL) {
+		pstate->pcurrent_reader = pmmap_reader;
+		return pvhandle;
+	}
+	pstate->pcurrent_reader = pstate->pstdio_reader;
+	return pstate->pstdio_reader->popen_func(pstate->pstdio_reader->pvstate, prepipe, filename);
+}
+
+static void lrec_reader_mmap_or_stdio_close(void* pvstate, void* pvhandle, char* prepipe) {
+	lrec_reader_mmap_or_stdio_state_t* pstate = pvstate;
+	lrec_reader_t* pcurrent_reader = pstate->pcurrent_reader;
+	pcurrent_reader->pclose_func(pcurrent_reader->pvstate, pvhandle, prepipe);
+	pstate->pcurrent_reader = NULL;
+}
+
+static void lrec_reader_mmap_or_stdio_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_mmap_or_stdio_state_t* pstate = pvstate;
+	lrec_reader_t* pcurrent_reader = pstate->pcurrent_reader;
+	pcurrent_reader->psof_func(pcurrent_reader->pvstate, pvhandle);
+}
+
+static lrec_t* lrec_reader_mmap_or_stdio_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_mmap_or_stdio_state_t* pstate = pvstate;
+	lrec_reader_t* pcurrent_reader = pstate->pcurrent_reader;
+	return pcurrent_reader->pprocess_func(pcurrent_reader->pvstate, pvhandle, pctx);
+}
@@ -0,0 +1,741 @@
+// ================================================================
+// Multi-threaded parsing of a single input file, for --nr-threads.
+//
+// The main thread reads the file in chunks of a quarter megabyte or so, each
+// ending on a record boundary: after an IRS for the line-oriented formats, or after an
+// IRS outside of double quotes for CSV. Worker threads parse the chunks into
+// lists of records, each worker using a stdio reader of its own on an
+// in-memory stream. The main thread hands the records out in their original
+// order, so the caller sees the same records, with the same NR and FNR, as
+// from the serial reader.
+//
+// For CSV and CSV-lite, a chunk's text is preceded by the header line which is
+// in effect at the start of the chunk, so that the worker's reader sees a
+// self-contained file. The main thread keeps track of that header as it looks
+// for chunk boundaries, including CSV-lite's schema changes after blank lines.
+// It also counts lines (for CSV, records) so that error messages from the
+// workers have the same line numbers as from the serial reader. (Since the
+// readers exit on parse errors, though, the error may be reported before the
+// records preceding it are written.)
+//
+// Standard input, --prepipe, compressed files, and other non-regular files are
+// handed to the serial reader, a file at a time.
+// ================================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "cli/comment_handling.h"
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "lib/byte_scan.h"
+#include "containers/sllv.h"
+#include "input/lrec_readers.h"
+#include "input/file_decompressor.h"
+
+#define PARALLEL_CHUNK_SIZE (1 << 18)
+#define PARALLEL_JOBS_PER_THREAD 2
+
+#define UTF8_BOM "\xef\xbb\xbf"
+#define UTF8_BOM_LENGTH 3
+
+typedef enum _parallel_format_t {
+	PARALLEL_FORMAT_LINES, // DKVP and NIDX
+	PARALLEL_FORMAT_CSVLITE,
+	PARALLEL_FORMAT_CSV,
+} parallel_format_t;
+
+typedef enum _parallel_job_status_t {
+	JOB_FREE,
+	JOB_PENDING,
+	JOB_RUNNING,
+	JOB_DONE,
+} parallel_job_status_t;
+
+typedef struct _parallel_job_t {
+	parallel_job_status_t status;
+	char*     text;     // The header if any, then the chunk
+	size_t    length;
+	long long ilno;     // Lines (for CSV, records) in the file before the text
+	context_t ctx;      // The worker's copy, for error messages and LF/CRLF autodetect
+	sllv_t*   precords;
+} parallel_job_t;
+
+struct _lrec_reader_parallel_state_t;
+
+typedef struct _parallel_worker_t {
+	struct _lrec_reader_parallel_state_t* pstate;
+	lrec_reader_t* preader;
+	pthread_t      thread;
+} parallel_worker_t;
+
+typedef struct _lrec_reader_parallel_state_t {
+	parallel_format_t  format;
+	char               irs;
+	char               ifs;
+	int                do_auto_line_term;
+	int                allow_repeat_ifs;
+	int                use_implicit_csv_header;
+	comment_handling_t comment_handling;
+	char*              comment_string;
+	int                comment_string_length;
+	const byte_scanner_t* pscanner;
+
+	void (*pscan_func)(struct _lrec_reader_parallel_state_t* pstate);
+	void (*pset_ilno_func)(lrec_reader_t* preader, long long ilno);
+
+	lrec_reader_t*     pserial_reader;
+	int                is_serial;   // For the current file
+
+	// Worker threads, each with its own reader
+	int                nr_threads;
+	parallel_worker_t* pworkers;
+	pthread_mutex_t    mutex;
+	pthread_cond_t     job_pending_cond;
+	pthread_cond_t     job_done_cond;
+	int                shutting_down;
+
+	// Job i is pjobs[i % num_jobs]. Jobs from next_deliver up to next_submit
+	// are in progress.
+	parallel_job_t*    pjobs;
+	int                num_jobs;
+	long long          next_submit;
+	long long          next_deliver;
+	sllv_t*            precords; // Being handed out
+
+	// Chunking of the current file. The buffer is null-terminated for the
+	// byte-scanner.
+	int                fd;
+	int                at_eof;
+	char*              buf;
+	size_t             buf_alloc;
+	size_t             buf_length;
+	size_t             scan_offset;      // Bytes before this have been scanned
+	size_t             boundary;         // End of the last complete record scanned
+	long long          ilno_at_start;    // Lines (for CSV, records) before the buffer
+	long long          ilno_at_boundary;
+	int                at_file_start;
+
+	// The header in effect at the start of the buffer, and at the boundary.
+	// NULL while a header line is expected.
+	char*              chunk_header;
+	size_t             chunk_header_length;
+	char*              header;
+	size_t             header_length;
+	int                expect_header;
+
+	// CSV quoting state at scan_offset
+	int                in_dquotes;
+	int                at_field_start;
+	size_t             record_start;
+} lrec_reader_parallel_state_t;
+
+static void    lrec_reader_parallel_free(lrec_reader_t* preader);
+static void*   lrec_reader_parallel_open(void* pvstate, char* prepipe, char* filename);
+static void    lrec_reader_parallel_close(void* pvstate, void* pvhandle, char* prepipe);
+static void    lrec_reader_parallel_sof(void* pvstate, void* pvhandle);
+static lrec_t* lrec_reader_parallel_process(void* pvstate, void* pvhandle, context_t* pctx);
+
+static void    parallel_start_workers(lrec_reader_parallel_state_t* pstate, cli_reader_opts_t* popts);
+static void*   parallel_worker_main(void* pvworker);
+static int     parallel_submit_next_chunk(lrec_reader_parallel_state_t* pstate, context_t* pctx);
+static void    parallel_scan_lines(lrec_reader_parallel_state_t* pstate);
+static void    parallel_scan_csvlite(lrec_reader_parallel_state_t* pstate);
+static void    parallel_scan_csv(lrec_reader_parallel_state_t* pstate);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_parallel_alloc(cli_reader_opts_t* popts, lrec_reader_t* pserial_reader) {
+	parallel_format_t format;
+	if (streq(popts->ifile_fmt, "dkvp") || streq(popts->ifile_fmt, "nidx"))
+		format = PARALLEL_FORMAT_LINES;
+	else if (streq(popts->ifile_fmt, "csvlite"))
+		format = PARALLEL_FORMAT_CSVLITE;
+	else if (streq(popts->ifile_fmt, "csv"))
+		format = PARALLEL_FORMAT_CSV;
+	else
+		return NULL;
+
+	// Comment lines are printed as they're read, which would be out of order
+	// with respect to the records.
+	if (popts->comment_handling == PASS_COMMENTS)
+		return NULL;
+	char* irs = streq(popts->irs, "auto") ? "\n" : popts->irs;
+	if (strlen(irs) != 1 || strlen(popts->ifs) != 1)
+		return NULL;
+
+	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
+
+	lrec_reader_parallel_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_parallel_state_t));
+	memset(pstate, 0, sizeof(lrec_reader_parallel_state_t));
+	pstate->format                  = format;
+	pstate->irs                     = irs[0];
+	pstate->ifs                     = popts->ifs[0];
+	pstate->do_auto_line_term       = streq(popts->irs, "auto");
+	pstate->allow_repeat_ifs        = popts->allow_repeat_ifs;
+	pstate->use_implicit_csv_header = popts->use_implicit_csv_header;
+	pstate->comment_handling        = popts->comment_handling;
+	pstate->comment_string          = popts->comment_string;
+	pstate->comment_string_length   = popts->comment_string == NULL ? 0 : strlen(popts->comment_string);
+	pstate->pscanner                = byte_scanner_get();
+
+	switch (format) {
+	case PARALLEL_FORMAT_LINES:
+		pstate->pscan_func     = parallel_scan_lines;
+		pstate->pset_ilno_func = NULL;
+		break;
+	case PARALLEL_FORMAT_CSVLITE:
+		pstate->pscan_func     = parallel_scan_csvlite;
+		pstate->pset_ilno_func = lrec_reader_stdio_csvlite_set_ilno;
+		break;
+	case PARALLEL_FORMAT_CSV:
+		pstate->pscan_func     = parallel_scan_csv;
+		pstate->pset_ilno_func = lrec_reader_stdio_csv_set_ilno;
+		break;
+	}
+
+	pstate->pserial_reader = pserial_reader;
+	pstate->is_serial      = FALSE;
+
+	pstate->nr_threads = popts->nr_threads;
+	pthread_mutex_init(&pstate->mutex, NULL);
+	pthread_cond_init(&pstate->job_pending_cond, NULL);
+	pthread_cond_init(&pstate->job_done_cond, NULL);
+	parallel_start_workers(pstate, popts);
+
+	pstate->num_jobs = PARALLEL_JOBS_PER_THREAD * pstate->nr_threads;
+	pstate->pjobs = mlr_malloc_or_die(pstate->num_jobs * sizeof(parallel_job_t));
+	for (int i = 0; i < pstate->num_jobs; i++) {
+		pstate->pjobs[i].status   = JOB_FREE;
+		pstate->pjobs[i].text     = NULL;
+		pstate->pjobs[i].precords = NULL;
+	}
+
+	pstate->fd        = -1;
+	pstate->buf_alloc = 2 * PARALLEL_CHUNK_SIZE;
+	pstate->buf       = mlr_malloc_or_die(pstate->buf_alloc + 1);
+
+	plrec_reader->pvstate       = (void*)pstate;
+	plrec_reader->popen_func    = lrec_reader_parallel_open;
+	plrec_reader->pclose_func   = lrec_reader_parallel_close;
+	plrec_reader->pprocess_func = lrec_reader_parallel_process;
+	plrec_reader->psof_func     = lrec_reader_parallel_sof;
+	plrec_reader->pfree_func    = lrec_reader_parallel_free;
+
+	return plrec_reader;
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_parallel_free(lrec_reader_t* preader) {
+	lrec_reader_parallel_state_t* pstate = preader->pvstate;
+
+	pthread_mutex_lock(&pstate->mutex);
+	pstate->shutting_down = TRUE;
+	pthread_cond_broadcast(&pstate->job_pending_cond);
+	pthread_mutex_unlock(&pstate->mutex);
+	for (int i = 0; i < pstate->nr_threads; i++) {
+		pthread_join(pstate->pworkers[i].thread, NULL);
+		lrec_reader_t* pworker_reader = pstate->pworkers[i].preader;
+		pworker_reader->pfree_func(pworker_reader);
+	}
+	pthread_mutex_destroy(&pstate->mutex);
+	pthread_cond_destroy(&pstate->job_pending_cond);
+	pthread_cond_destroy(&pstate->job_done_cond);
+
+	pstate->pserial_reader->pfree_func(pstate->pserial_reader);
+	free(pstate->pworkers);
+	free(pstate->pjobs);
+	free(pstate->buf);
+	free(pstate);
+	free(preader);
+}
+
+// ----------------------------------------------------------------
+static void parallel_start_workers(lrec_reader_parallel_state_t* pstate, cli_reader_opts_t* popts) {
+	pstate->pworkers = mlr_malloc_or_die(pstate->nr_threads * sizeof(parallel_worker_t));
+	for (int i = 0; i < pstate->nr_threads; i++) {
+		parallel_worker_t* pworker = &pstate->pworkers[i];
+		pworker->pstate = pstate;
+		switch (pstate->format) {
+		case PARALLEL_FORMAT_LINES:
+			pworker->preader = streq(popts->ifile_fmt, "dkvp")
+				? lrec_reader_stdio_dkvp_alloc(popts->irs, popts->ifs, popts->ips, popts->allow_repeat_ifs,
+					popts->comment_handling, popts->comment_string)
+				: lrec_reader_stdio_nidx_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
+					popts->comment_handling, popts->comment_string);
+			break;
+		case PARALLEL_FORMAT_CSVLITE:
+			pworker->preader = lrec_reader_stdio_csvlite_alloc(popts->irs, popts->ifs,
+				popts->allow_repeat_ifs, popts->use_implicit_csv_header, popts->allow_ragged_csv_input,
+				popts->comment_handling, popts->comment_string);
+			break;
+		case PARALLEL_FORMAT_CSV:
+			pworker->preader = lrec_reader_stdio_csv_alloc(popts->irs, popts->ifs,
+				popts->use_implicit_csv_header, popts->allow_ragged_csv_input,
+				popts->comment_handling, popts->comment_string);
+			break;
+		}
+		int rc = pthread_create(&pworker->thread, NULL, parallel_worker_main, pworker);
+		if (rc != 0) {
+			fprintf(stderr, "%s: could not create thread: %s.\n", MLR_GLOBALS.bargv0, strerror(rc));
+			exit(1);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// Regular files are read in parallel; everything else by the serial reader.
+static void* lrec_reader_parallel_open(void* pvstate, char* prepipe, char* filename) {
+	lrec_reader_parallel_state_t* pstate = pvstate;
+
+	struct stat stat_buf;
+	if (prepipe != NULL || streq(filename, "-") || stat(filename, &stat_buf) != 0 || !S_ISREG(stat_buf.st_mode)) {
+		pstate->is_serial = TRUE;
+		return pstate->pserial_reader->popen_func(pstate->pserial_reader->pvstate, prepipe, filename);
+	}
+	pstate->is_serial = FALSE;
+
+	pstate->fd = open(filename, O_RDONLY);
+	if (pstate->fd < 0) {
+		fprintf(stderr, "%s: Couldn't open \"%s\" for read.\n", MLR_GLOBALS.bargv0, filename);
+		perror(filename);
+		exit(1);
+	}
+	if (file_decompressor_applies(pstate->fd, filename)) {
+		close(pstate->fd);
+		pstate->is_serial = TRUE;
+		return pstate->pserial_reader->popen_func(pstate->pserial_reader->pvstate, prepipe, filename);
+	}
+
+	pstate->at_eof              = FALSE;
+	pstate->buf_length          = 0;
+	*pstate->buf                = 0;
+	pstate->scan_offset         = 0;
+	pstate->boundary            = 0;
+	pstate->ilno_at_start       = 0LL;
+	pstate->ilno_at_boundary    = 0LL;
+	pstate->at_file_start       = TRUE;
+	pstate->chunk_header        = NULL;
+	pstate->chunk_header_length = 0;
+	pstate->header              = NULL;
+	pstate->header_length       = 0;
+	pstate->expect_header       = pstate->format != PARALLEL_FORMAT_LINES && !pstate->use_implicit_csv_header;
+	pstate->in_dquotes          = FALSE;
+	pstate->at_field_start      = TRUE;
+	pstate->record_start        = 0;
+	pstate->next_submit         = 0LL;
+	pstate->next_deliver        = 0LL;
+	pstate->precords            = NULL;
+
+	return pstate;
+}
+
+// ----------------------------------------------------------------
+// Also called on early exit, e.g. for mlr head, with chunks still being
+// parsed: these are waited for, and their records discarded.
+static void lrec_reader_parallel_close(void* pvstate, void* pvhandle, char* prepipe) {
+	lrec_reader_parallel_state_t* pstate = pvstate;
+	if (pstate->is_serial) {
+		pstate->pserial_reader->pclose_func(pstate->pserial_reader->pvstate, pvhandle, prepipe);
+		return;
+	}
+
+	pthread_mutex_lock(&pstate->mutex);
+	for (long long i = pstate->next_deliver; i < pstate->next_submit; i++) {
+		parallel_job_t* pjob = &pstate->pjobs[i % pstate->num_jobs];
+		if (pjob->status == JOB_PENDING)
+			pjob->status = JOB_DONE;
+		while (pjob->status != JOB_DONE)
+			pthread_cond_wait(&pstate->job_done_cond, &pstate->mutex);
+	}
+	pthread_mutex_unlock(&pstate->mutex);
+
+	for (long long i = pstate->next_deliver; i < pstate->next_submit; i++) {
+		parallel_job_t* pjob = &pstate->pjobs[i % pstate->num_jobs];
+		if (pjob->precords != NULL) {
+			for (sllve_t* pe = pjob->precords->phead; pe != NULL; pe = pe->pnext)
+				lrec_free(pe->pvvalue);
+			sllv_free(pjob->precords);
+			pjob->precords = NULL;
+		}
+		free(pjob->text);
+		pjob->text = NULL;
+		pjob->status = JOB_FREE;
+	}
+	if (pstate->precords != NULL) {
+		for (sllve_t* pe = pstate->precords->phead; pe != NULL; pe = pe->pnext)
+			lrec_free(pe->pvvalue);
+		sllv_free(pstate->precords);
+		pstate->precords = NULL;
+	}
+
+	close(pstate->fd);
+	pstate->fd = -1;
+	free(pstate->chunk_header);
+	free(pstate->header);
+	pstate->chunk_header = NULL;
+	pstate->header = NULL;
+}
+
+// ----------------------------------------------------------------
+static void lrec_reader_parallel_sof(void* pvstate, void* pvhandle) {
+	lrec_reader_parallel_state_t* pstate = pvstate;
+	if (pstate->is_serial)
+		pstate->pserial_reader->psof_func(pstate->pserial_reader->pvstate, pvhandle);
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_reader_parallel_process(void* pvstate, void* pvhandle, context_t* pctx) {
+	lrec_reader_parallel_state_t* pstate = pvstate;
+	if (pstate->is_serial)
+		return pstate->pserial_reader->pprocess_func(pstate->pserial_reader->pvstate, pvhandle, pctx);
+
+	while (TRUE) {
+		if (pstate->precords != NULL) {
+			lrec_t* prec = sllv_pop(pstate->precords);
+			if (prec != NULL)
+				return prec;
+			sllv_free(pstate->precords);
+			pstate->precords = NULL;
+		}
+
+		// Keep the workers busy
+		while (pstate->next_submit - pstate->next_deliver < pstate->num_jobs) {
+			if (!parallel_submit_next_chunk(pstate, pctx))
+				break;
+		}
+		if (pstate->next_deliver == pstate->next_submit)
+			return NULL;
+
+		parallel_job_t* pjob = &pstate->pjobs[pstate->next_deliver % pstate->num_jobs];
+		pthread_mutex_lock(&pstate->mutex);
+		while (pjob->status != JOB_DONE)
+			pthread_cond_wait(&pstate->job_done_cond, &pstate->mutex);
+		pjob->status = JOB_FREE;
+		pstate->next_deliver++;
+		pthread_mutex_unlock(&pstate->mutex);
+
+		if (pjob->ctx.auto_line_term_detected)
+			context_set_autodetected_line_term(pctx, pjob->ctx.auto_line_term);
+		free(pjob->text);
+		pjob->text = NULL;
+		pstate->precords = pjob->precords;
+		pjob->precords = NULL;
+	}
+}
+
+// ================================================================
+// WORKER THREADS
+
+// Called with the mutex held.
+static parallel_job_t* parallel_next_pending_job(lrec_reader_parallel_state_t* pstate) {
+	for (long long i = pstate->next_deliver; i < pstate->next_submit; i++) {
+		parallel_job_t* pjob = &pstate->pjobs[i % pstate->num_jobs];
+		if (pjob->status == JOB_PENDING)
+			return pjob;
+	}
+	return NULL;
+}
+
+static void parallel_parse_chunk(lrec_reader_parallel_state_t* pstate, lrec_reader_t* preader,
+	parallel_job_t* pjob)
+{
+	FILE* input_stream = fmemopen(pjob->text, pjob->length, "r");
+	if (input_stream == NULL) {
+		perror("fmemopen");
+		fprintf(stderr, "%s: could not open in-memory stream for file \"%s\".\n",
+			MLR_GLOBALS.bargv0, pjob->ctx.filename);
+		exit(1);
+	}
+
+	preader->psof_func(preader->pvstate, input_stream);
+	if (pstate->pset_ilno_func != NULL)
+		pstate->pset_ilno_func(preader, pjob->ilno);
+
+	pjob->precords = sllv_alloc();
+	while (TRUE) {
+		lrec_t* prec = preader->pprocess_func(preader->pvstate, input_stream, &pjob->ctx);
+		if (prec == NULL)
+			break;
+		sllv_append(pjob->precords, prec);
+	}
+
+	fclose(input_stream);
+}
+
+static void* parallel_worker_main(void* pvworker) {
+	parallel_worker_t* pworker = pvworker;
+	lrec_reader_parallel_state_t* pstate = pworker->pstate;
+
+	pthread_mutex_lock(&pstate->mutex);
+	while (TRUE) {
+		parallel_job_t* pjob = NULL;
+		while (!pstate->shutting_down && (pjob = parallel_next_pending_job(pstate)) == NULL)
+			pthread_cond_wait(&pstate->job_pending_cond, &pstate->mutex);
+		if (pjob == NULL)
+			break;
+		pjob->status = JOB_RUNNING;
+		pthread_mutex_unlock(&pstate->mutex);
+
+		parallel_parse_chunk(pstate, pworker->preader, pjob);
+
+		pthread_mutex_lock(&pstate->mutex);
+		pjob->status = JOB_DONE;
+		pthread_cond_broadcast(&pstate->job_done_cond);
+	}
+	pthread_mutex_unlock(&pstate->mutex);
+	return NULL;
+}
+
+// ================================================================
+// CHUNKING
+
+// Reads more of the file, growing the buffer if it's full.
+static void parallel_fill(lrec_reader_parallel_state_t* pstate) {
+	if (pstate->buf_length == pstate->buf_alloc) {
+		pstate->buf_alloc *= 2;
+		pstate->buf = mlr_realloc_or_die(pstate->buf, pstate->buf_alloc + 1);
+	}
+	ssize_t nread;
+	do {
+		nread = read(pstate->fd, pstate->buf + pstate->buf_length, pstate->buf_alloc - pstate->buf_length);
+	} while (nread < 0 && errno == EINTR);
+	if (nread < 0) {
+		perror("read");
+		fprintf(stderr, "%s: read error.\n", MLR_GLOBALS.bargv0);
+		exit(1);
+	}
+	if (nread == 0)
+		pstate->at_eof = TRUE;
+	pstate->buf_length += nread;
+	pstate->buf[pstate->buf_length] = 0;
+}
+
+// Makes a job of the next chunk of the file, returning FALSE if there's none.
+static int parallel_submit_next_chunk(lrec_reader_parallel_state_t* pstate, context_t* pctx) {
+	size_t end = 0;
+	while (TRUE) {
+		pstate->pscan_func(pstate);
+		if (pstate->at_eof) {
+			end = pstate->buf_length;
+			break;
+		}
+		if (pstate->boundary > 0 && pstate->buf_length >= PARALLEL_CHUNK_SIZE) {
+			end = pstate->boundary;
+			break;
+		}
+		parallel_fill(pstate);
+	}
+	if (end == 0)
+		return FALSE;
+
+	parallel_job_t* pjob = &pstate->pjobs[pstate->next_submit % pstate->num_jobs];
+	size_t header_length = (pstate->chunk_header != NULL) ? pstate->chunk_header_length : 0;
+	pjob->length = header_length + end;
+	pjob->text = mlr_malloc_or_die(pjob->length);
+	if (header_length > 0)
+		memcpy(pjob->text, pstate->chunk_header, header_length);
+	memcpy(pjob->text + header_length, pstate->buf, end);
+	// The worker's reader counts the header line too.
+	pjob->ilno = pstate->ilno_at_start - ((pstate->chunk_header != NULL) ? 1 : 0);
+	pjob->ctx = *pctx;
+	pjob->ctx.auto_line_term_detected = FALSE;
+	pjob->precords = NULL;
+
+	// Carry the rest over to the next chunk
+	memmove(pstate->buf, pstate->buf + end, pstate->buf_length - end);
+	pstate->buf_length -= end;
+	pstate->buf[pstate->buf_length] = 0;
+	pstate->scan_offset  = (pstate->scan_offset  > end) ? pstate->scan_offset  - end : 0;
+	pstate->record_start = (pstate->record_start > end) ? pstate->record_start - end : 0;
+	pstate->boundary = 0;
+	pstate->ilno_at_start = pstate->ilno_at_boundary;
+	free(pstate->chunk_header);
+	pstate->chunk_header = NULL;
+	if (pstate->header != NULL) {
+		pstate->chunk_header = mlr_malloc_or_die(pstate->header_length);
+		memcpy(pstate->chunk_header, pstate->header, pstate->header_length);
+		pstate->chunk_header_length = pstate->header_length;
+	}
+
+	pthread_mutex_lock(&pstate->mutex);
+	pjob->status = JOB_PENDING;
+	pstate->next_submit++;
+	pthread_cond_signal(&pstate->job_pending_cond);
+	pthread_mutex_unlock(&pstate->mutex);
+	return TRUE;
+}
+
+// ----------------------------------------------------------------
+static void parallel_set_header(lrec_reader_parallel_state_t* pstate, char* start, size_t length) {
+	free(pstate->header);
+	pstate->header = mlr_malloc_or_die(length);
+	memcpy(pstate->header, start, length);
+	pstate->header_length = length;
+	pstate->expect_header = FALSE;
+}
+
+static int parallel_starts_with_comment(lrec_reader_parallel_state_t* pstate, char* start, char* end) {
+	return pstate->comment_handling != COMMENTS_ARE_DATA
+		&& end - start >= pstate->comment_string_length
+		&& memcmp(start, pstate->comment_string, pstate->comment_string_length) == 0;
+}
+
+// ----------------------------------------------------------------
+// DKVP and NIDX: chunks end after the last IRS.
+static void parallel_scan_lines(lrec_reader_parallel_state_t* pstate) {
+	char* start = pstate->buf + pstate->scan_offset;
+	for (char* p = pstate->buf + pstate->buf_length; p > start; ) {
+		p--;
+		if (*p == pstate->irs) {
+			pstate->boundary = p + 1 - pstate->buf;
+			break;
+		}
+	}
+	pstate->scan_offset = pstate->buf_length;
+}
+
+// ----------------------------------------------------------------
+// CSV-lite: as for DKVP and NIDX, but line by line so as to follow the header
+// and count lines as the CSV-lite reader does. Past the header, comment lines
+// aren't counted; a blank line means a new header follows.
+static void parallel_scan_csvlite(lrec_reader_parallel_state_t* pstate) {
+	char* buf  = pstate->buf;
+	char* end  = buf + pstate->buf_length;
+	char* line = buf + pstate->scan_offset;
+
+	while (line < end) {
+		char* eol = memchr(line, pstate->irs, end - line);
+		if (eol == NULL)
+			break;
+		char* content_end = eol;
+		if (pstate->do_auto_line_term && content_end > line && content_end[-1] == '\r')
+			content_end--;
+		int is_comment = parallel_starts_with_comment(pstate, line, content_end);
+
+		if (pstate->expect_header) {
+			pstate->ilno_at_boundary++;
+			// Lines with no fields, e.g. more blank lines, are skipped over.
+			char* p = line;
+			if (pstate->allow_repeat_ifs) {
+				while (p < content_end && *p == pstate->ifs)
+					p++;
+			}
+			if (!is_comment && p < content_end)
+				parallel_set_header(pstate, line, eol + 1 - line);
+		} else if (!is_comment) {
+			pstate->ilno_at_boundary++;
+			if (line == content_end && !pstate->use_implicit_csv_header) {
+				free(pstate->header);
+				pstate->header = NULL;
+				pstate->expect_header = TRUE;
+			}
+		}
+
+		line = eol + 1;
+		pstate->boundary = line - buf;
+	}
+	pstate->scan_offset = line - buf;
+}
+
+// ----------------------------------------------------------------
+// CSV: chunks end after an IRS which isn't within a double-quoted field,
+// following the quoting rules of the CSV reader's block parser. The header is
+// the first record which isn't a comment.
+static void parallel_csv_end_record(lrec_reader_parallel_state_t* pstate, char* end) {
+	char* start = pstate->buf + pstate->record_start;
+	pstate->ilno_at_boundary++;
+	if (pstate->expect_header) {
+		// Comments are checked for in the first field's value.
+		char* p = start;
+		if (end - p >= UTF8_BOM_LENGTH && memcmp(p, UTF8_BOM, UTF8_BOM_LENGTH) == 0)
+			p += UTF8_BOM_LENGTH;
+		if (p < end && *p == '"')
+			p++;
+		if (!parallel_starts_with_comment(pstate, p, end))
+			parallel_set_header(pstate, start, end - start);
+	}
+	pstate->record_start = end - pstate->buf;
+	pstate->boundary = pstate->record_start;
+	pstate->at_field_start = TRUE;
+}
+
+static void parallel_scan_csv(lrec_reader_parallel_state_t* pstate) {
+	const byte_scanner_t* pscanner = pstate->pscanner;
+	char  ifs = pstate->ifs;
+	char  irs = pstate->irs;
+	char* buf = pstate->buf;
+	char* end = buf + pstate->buf_length;
+	char* p   = buf + pstate->scan_offset;
+
+	if (pstate->at_file_start) {
+		if (end - p < UTF8_BOM_LENGTH && !pstate->at_eof)
+			return;
+		if (end - p >= UTF8_BOM_LENGTH && memcmp(p, UTF8_BOM, UTF8_BOM_LENGTH) == 0)
+			p += UTF8_BOM_LENGTH;
+		pstate->at_file_start = FALSE;
+	}
+
+	while (p < end) {
+		if (!pstate->in_dquotes) {
+			if (pstate->at_field_start && *p == '"') {
+				pstate->in_dquotes = TRUE;
+				pstate->at_field_start = FALSE;
+				p++;
+				continue;
+			}
+			pstate->at_field_start = FALSE;
+			p = byte_scan_find3(pscanner, p, ifs, irs, '"');
+			if (p == end)
+				break;
+			if (*p == ifs) {
+				pstate->at_field_start = TRUE;
+			} else if (*p == irs) {
+				parallel_csv_end_record(pstate, p + 1);
+			}
+			// Else a double quote within an unquoted field, which the worker
+			// will report as an error; or a null byte in the data.
+			p++;
+
+		} else {
+			p = byte_scan_find3(pscanner, p, '"', '"', '"');
+			if (p == end)
+				break;
+			if (*p != '"') { // Null byte in the data
+				p++;
+				continue;
+			}
+			char* q = p + 1;
+			if (q == end && !pstate->at_eof) // Need to see what follows
+				break;
+			if (*q == '"') {
+				p = q + 1;
+			} else if (*q == ifs) {
+				pstate->in_dquotes = FALSE;
+				pstate->at_field_start = TRUE;
+				p = q + 1;
+			} else if (*q == irs) {
+				pstate->in_dquotes = FALSE;
+				parallel_csv_end_record(pstate, q + 1);
+				p = q + 1;
+			} else if (pstate->do_auto_line_term && *q == '\r') {
+				if (q + 1 == end && !pstate->at_eof)
+					break;
+				if (q[1] == '\n') {
+					pstate->in_dquotes = FALSE;
+					parallel_csv_end_record(pstate, q + 2);
+					p = q + 2;
+				} else {
+					p = q;
+				}
+			} else { // A double quote not followed by any of the above is data
+				p = q;
+			}
+		}
+	}
+	pstate->scan_offset = p - buf;
+}
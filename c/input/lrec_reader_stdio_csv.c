@@ -10,10 +10,13 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
+#include <unistd.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
 #include "lib/string_builder.h"
+#include "lib/byte_scan.h"
 #include "input/file_reader_stdio.h"
 #include "input/byte_readers.h"
 #include "input/lrec_readers.h"
@@ -32,8 +35,26 @@
 // to header_keeper object. The current pheader_keeper is a pointer into one of
 // those.  Then when the reader is freed, all the header-keepers are freed.
 
+// The block parser: for single-character IFS and IRS (including the default
+// LF/CRLF autodetect), input is read in large blocks rather than a byte at a
+// time through the peek-file-reader, and each field's end is found using
+// vectorized search for IFS, IRS, and double quote (see lib/byte_scan.h). Once
+// a record is complete its text is copied, once, to a buffer which the lrec
+// (or header-keeper) takes ownership of, and fields are null-terminated in
+// place. Only fields containing "" need any further work, and that's done in
+// place too since unescaping only shortens them. Records spanning the end of
+// the input buffer are re-scanned after the buffer is refilled.
+//
+// Quoting semantics are the same as for the peek-file-reader parser: in
+// particular, a double quote inside a double-quoted field which isn't followed
+// by another double quote, IFS, IRS, or end of file is kept as data. This is
+// why we scan field by field rather than tracking in-quote state by parity of
+// double-quote counts.
+
 // ----------------------------------------------------------------
 #define STRING_BUILDER_INIT_SIZE 1024
+#define CSV_BLOCK_SIZE (1 << 16)
+#define CSV_SPANS_INIT_SIZE 64
 
 #define EOF_TOKEN           0x2000
 #define IRS_TOKEN           0x2001
@@ -53,6 +74,14 @@
 //#define DEBUG_PARSER
 
 // ----------------------------------------------------------------
+// Offsets are from the start of the record within the input buffer.
+typedef struct _csv_field_span_t {
+	int  start;
+	int  end;
+	char quote_flag;
+	char has_dquote_dquote;
+} csv_field_span_t;
+
 typedef struct _lrec_reader_stdio_csv_state_t {
 	// Input line number is not the same as the record-counter in context_t,
 	// which counts records.
@@ -90,6 +119,27 @@ typedef struct _lrec_reader_stdio_csv_state_t {
 	header_keeper_t*    pheader_keeper;
 	lhmslv_t*           pheader_keepers;
 
+	int (*pget_fields_func)(struct _lrec_reader_stdio_csv_state_t* pstate, rslls_t* pfields,
+		context_t* pctx, int is_header);
+
+	// For the block parser
+	char                  ifs_char;
+	char                  irs_char;
+	const byte_scanner_t* pscanner;
+	FILE*                 input_stream;
+	char*                 buf;
+	size_t                buf_alloc;
+	char*                 sob; // Start of unconsumed input
+	char*                 eob; // End of input read so far; always null-terminated
+	int                   at_eof;
+	csv_field_span_t*     pspans;
+	int                   num_spans;
+	int                   spans_alloc;
+
+	// Backing for the field values in pfields, if any: to be owned by the lrec
+	// or header-keeper they're transferred to.
+	char*                 pfields_backing;
+
 } lrec_reader_stdio_csv_state_t;
 
 static void    lrec_reader_stdio_csv_free(lrec_reader_t* preader);
@@ -97,6 +147,8 @@ static void    lrec_reader_stdio_csv_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, context_t* pctx);
 static int     lrec_reader_stdio_csv_get_fields(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pfields,
 	context_t* pctx, int is_header);
+static int     lrec_reader_stdio_csv_get_fields_block(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pfields,
+	context_t* pctx, int is_header);
 static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
 	context_t* pctx);
 static lrec_t* paste_header_and_data_ragged(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
@@ -105,6 +157,8 @@ static lrec_t* paste_header_and_data_rectangular(lrec_reader_stdio_csv_state_t*
 	context_t* pctx);
 static void*   lrec_reader_stdio_csv_open(void* pvstate, char* prepipe, char* filename);
 static void    lrec_reader_stdio_csv_close(void* pvstate, void* pvhandle, char* prepipe);
+static void*   lrec_reader_stdio_csv_block_open(void* pvstate, char* prepipe, char* filename);
+static void    lrec_reader_stdio_csv_block_close(void* pvstate, void* pvhandle, char* prepipe);
 
 // ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implicit_csv_header,
@@ -183,9 +237,31 @@ lrec_reader_t* lrec_reader_stdio_csv_alloc(char* irs, char* ifs, int use_implici
 	pstate->pheader_keeper            = NULL;
 	pstate->pheader_keepers           = lhmslv_alloc();
 
+	pstate->ifs_char        = pstate->ifs[0];
+	pstate->irs_char        = pstate->irs[0];
+	pstate->pscanner        = byte_scanner_get();
+	pstate->input_stream    = NULL;
+	pstate->buf_alloc       = CSV_BLOCK_SIZE;
+	pstate->buf             = mlr_malloc_or_die(pstate->buf_alloc + 1);
+	pstate->sob             = pstate->buf;
+	pstate->eob             = pstate->buf;
+	*pstate->eob            = 0;
+	pstate->at_eof          = FALSE;
+	pstate->spans_alloc     = CSV_SPANS_INIT_SIZE;
+	pstate->pspans          = mlr_malloc_or_die(pstate->spans_alloc * sizeof(csv_field_span_t));
+	pstate->num_spans       = 0;
+	pstate->pfields_backing = NULL;
+
 	plrec_reader->pvstate       = (void*)pstate;
-	plrec_reader->popen_func    = lrec_reader_stdio_csv_open;
-	plrec_reader->pclose_func   = lrec_reader_stdio_csv_close;
+	if (strlen(pstate->ifs) == 1 && strlen(pstate->irs) == 1) {
+		pstate->pget_fields_func  = lrec_reader_stdio_csv_get_fields_block;
+		plrec_reader->popen_func  = lrec_reader_stdio_csv_block_open;
+		plrec_reader->pclose_func = lrec_reader_stdio_csv_block_close;
+	} else {
+		pstate->pget_fields_func  = lrec_reader_stdio_csv_get_fields;
+		plrec_reader->popen_func  = lrec_reader_stdio_csv_open;
+		plrec_reader->pclose_func = lrec_reader_stdio_csv_close;
+	}
 	plrec_reader->pprocess_func = lrec_reader_stdio_csv_process;
 	plrec_reader->psof_func     = lrec_reader_stdio_csv_sof;
 	plrec_reader->pfree_func    = lrec_reader_stdio_csv_free;
@@ -212,6 +288,8 @@ static void lrec_reader_stdio_csv_free(lrec_reader_t* preader) {
 	free(pstate->dquote_irs);
 	free(pstate->dquote_irs2);
 	free(pstate->dquote_ifs);
+	free(pstate->buf);
+	free(pstate->pspans);
 	free(pstate);
 	free(preader);
 }
@@ -221,6 +299,20 @@ static void lrec_reader_stdio_csv_sof(void* pvstate, void* pvhandle) {
 	lrec_reader_stdio_csv_state_t* pstate = pvstate;
 	pstate->ilno = 0LL;
 	pstate->expect_header_line_next = pstate->use_implicit_csv_header ? FALSE : TRUE;
+
+	// The block parser's handle is its input stream; the other parser's is NULL.
+	pstate->input_stream = pvhandle;
+	pstate->sob = pstate->buf;
+	pstate->eob = pstate->buf;
+	*pstate->eob = 0;
+	pstate->at_eof = FALSE;
+}
+
+// For --nr-threads, where each piece of a file is read as a separate stream:
+// sets the record number which the next one read will follow.
+void lrec_reader_stdio_csv_set_ilno(lrec_reader_t* preader, long long ilno) {
+	lrec_reader_stdio_csv_state_t* pstate = preader->pvstate;
+	pstate->ilno = ilno;
 }
 
 // ----------------------------------------------------------------
@@ -230,7 +322,7 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 	// Ingest the next header line, if expected
 	if (pstate->expect_header_line_next) {
 		while (TRUE) {
-			if (!lrec_reader_stdio_csv_get_fields(pstate, pstate->pfields, pctx, TRUE))
+			if (!pstate->pget_fields_func(pstate, pstate->pfields, pctx, TRUE))
 				return NULL;
 			pstate->ilno++;
 
@@ -256,6 +348,8 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 						}
 					}
 					rslls_reset(pstate->pfields);
+					free(pstate->pfields_backing);
+					pstate->pfields_backing = NULL;
 					continue;
 				}
 			}
@@ -277,12 +371,14 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 
 			pstate->pheader_keeper = lhmslv_get(pstate->pheader_keepers, pheader_fields);
 			if (pstate->pheader_keeper == NULL) {
-				pstate->pheader_keeper = header_keeper_alloc(NULL, pheader_fields);
+				pstate->pheader_keeper = header_keeper_alloc(pstate->pfields_backing, pheader_fields);
 				lhmslv_put(pstate->pheader_keepers, pheader_fields, pstate->pheader_keeper,
 					NO_FREE); // freed by header-keeper
 			} else { // Re-use the header-keeper in the header cache
 				slls_free(pheader_fields);
+				free(pstate->pfields_backing);
 			}
+			pstate->pfields_backing = NULL;
 
 			pstate->expect_header_line_next = FALSE;
 			break;
@@ -291,7 +387,7 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 
 	// Ingest the next data line, if expected
 	while (TRUE) {
-		int rc = lrec_reader_stdio_csv_get_fields(pstate, pstate->pfields, pctx, FALSE);
+		int rc = pstate->pget_fields_func(pstate, pstate->pfields, pctx, FALSE);
 		pstate->ilno++;
 		if (rc == FALSE) // EOF
 			return NULL;
@@ -318,6 +414,8 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 					}
 				}
 				rslls_reset(pstate->pfields);
+				free(pstate->pfields_backing);
+				pstate->pfields_backing = NULL;
 				continue;
 			}
 		}
@@ -329,6 +427,7 @@ static lrec_t* lrec_reader_stdio_csv_process(void* pvstate, void* pvhandle, cont
 			? paste_header_and_data_ragged(pstate, pstate->pfields, pctx)
 			: paste_header_and_data_rectangular(pstate, pstate->pfields, pctx);
 		rslls_reset(pstate->pfields);
+		pstate->pfields_backing = NULL; // Now owned by the lrec
 		return prec;
 	}
 }
@@ -531,11 +630,237 @@ static int lrec_reader_stdio_csv_get_fields(lrec_reader_stdio_csv_state_t* pstat
 	return TRUE;
 }
 
+// ----------------------------------------------------------------
+// Moves the unconsumed input to the start of the buffer, growing the buffer if
+// there's no room left, and reads more. A single read is done, not a loop
+// until the buffer is full, so that records from a pipe are processed as they
+// arrive.
+static void csv_block_fill(lrec_reader_stdio_csv_state_t* pstate) {
+	size_t used = pstate->eob - pstate->sob;
+	if (pstate->sob > pstate->buf) {
+		memmove(pstate->buf, pstate->sob, used);
+		pstate->sob = pstate->buf;
+		pstate->eob = pstate->buf + used;
+	}
+	if (used == pstate->buf_alloc) {
+		pstate->buf_alloc *= 2;
+		pstate->buf = mlr_realloc_or_die(pstate->buf, pstate->buf_alloc + 1);
+		pstate->sob = pstate->buf;
+		pstate->eob = pstate->buf + used;
+	}
+
+	ssize_t nread;
+	int fd = fileno(pstate->input_stream);
+	if (fd < 0) { // E.g. in-memory streams from fmemopen, or decompressing streams
+		nread = fread(pstate->eob, 1, pstate->buf_alloc - used, pstate->input_stream);
+		if (nread == 0 && ferror(pstate->input_stream))
+			nread = -1;
+	} else {
+		do {
+			nread = read(fd, pstate->eob, pstate->buf_alloc - used);
+		} while (nread < 0 && errno == EINTR);
+	}
+	if (nread < 0) {
+		perror("read");
+		fprintf(stderr, "%s: read error at line %lld.\n", MLR_GLOBALS.bargv0, pstate->ilno);
+		exit(1);
+	}
+	if (nread == 0)
+		pstate->at_eof = TRUE;
+	pstate->eob += nread;
+	*pstate->eob = 0;
+}
+
+static inline csv_field_span_t* csv_block_new_span(lrec_reader_stdio_csv_state_t* pstate, char* sob, char* start,
+	char quote_flag)
+{
+	if (pstate->num_spans >= pstate->spans_alloc) {
+		pstate->spans_alloc *= 2;
+		pstate->pspans = mlr_realloc_or_die(pstate->pspans, pstate->spans_alloc * sizeof(csv_field_span_t));
+	}
+	csv_field_span_t* pspan = &pstate->pspans[pstate->num_spans++];
+	pspan->start = start - sob;
+	pspan->end = pspan->start;
+	pspan->quote_flag = quote_flag;
+	pspan->has_dquote_dquote = FALSE;
+	return pspan;
+}
+
+// The line-ending '\n' isn't included in the field; with LF/CRLF autodetect, a
+// trailing '\r' is removed as well.
+static inline char* csv_block_strip_cr(lrec_reader_stdio_csv_state_t* pstate, char* start, char* end,
+	context_t* pctx)
+{
+	if (pstate->do_auto_line_term) {
+		if (end > start && end[-1] == '\r') {
+			end--;
+			context_set_autodetected_crlf(pctx);
+		} else {
+			context_set_autodetected_lf(pctx);
+		}
+	}
+	return end;
+}
+
+// ----------------------------------------------------------------
+// Finds the field boundaries of the record starting at pstate->sob. Returns
+// FALSE if the record doesn't end within the buffered input, in which case
+// the caller reads more and calls again. Otherwise returns TRUE with *pend
+// pointing just past the record's line ending (if any).
+static int csv_block_scan_record(lrec_reader_stdio_csv_state_t* pstate, char** pend, context_t* pctx) {
+	const byte_scanner_t* pscanner = pstate->pscanner;
+	char  ifs    = pstate->ifs_char;
+	char  irs    = pstate->irs_char;
+	char* sob    = pstate->sob;
+	char* eob    = pstate->eob;
+	int   at_eof = pstate->at_eof;
+	char* p      = sob;
+
+	pstate->num_spans = 0;
+
+	// Loop over fields in record
+	while (TRUE) {
+		if (*p != '"') { // NOT DOUBLE-QUOTED (including end of buffer)
+			csv_field_span_t* pspan = csv_block_new_span(pstate, sob, p, 0);
+			while (TRUE) {
+				p = byte_scan_find3(pscanner, p, ifs, irs, '"');
+				if (p == eob) {
+					if (!at_eof)
+						return FALSE;
+					pspan->end = p - sob;
+					*pend = p;
+					return TRUE;
+				}
+				char c = *p;
+				if (c == ifs) {
+					pspan->end = p - sob;
+					p++;
+					break;
+				} else if (c == irs) {
+					pspan->end = csv_block_strip_cr(pstate, sob + pspan->start, p, pctx) - sob;
+					*pend = p + 1;
+					return TRUE;
+				} else if (c == '"') {
+					// CSV syntax error: fields containing quotes must be fully wrapped in quotes
+					fprintf(stderr, "%s: syntax error: unwrapped double quote at line %lld.\n",
+						MLR_GLOBALS.bargv0, pstate->ilno);
+					exit(1);
+				} else { // Null byte in the data
+					p++;
+				}
+			}
+
+		} else { // DOUBLE-QUOTED
+			p++;
+			csv_field_span_t* pspan = csv_block_new_span(pstate, sob, p, FIELD_QUOTED_ON_INPUT);
+			while (TRUE) {
+				p = byte_scan_find3(pscanner, p, '"', '"', '"');
+				if (p == eob) {
+					if (!at_eof)
+						return FALSE;
+					fprintf(stderr, "%s: unmatched double quote at line %lld.\n",
+						MLR_GLOBALS.bargv0, pstate->ilno);
+					exit(1);
+				}
+				if (*p != '"') { // Null byte in the data
+					p++;
+					continue;
+				}
+
+				char* q = p + 1;
+				if (q == eob) {
+					if (!at_eof)
+						return FALSE;
+					pspan->end = p - sob;
+					*pend = q;
+					return TRUE;
+				}
+				if (*q == '"') { // RFC-4180 CSV: "" inside a dquoted field is an escape for "
+					pspan->has_dquote_dquote = TRUE;
+					p = q + 1;
+				} else if (*q == ifs) {
+					pspan->end = p - sob;
+					p = q + 1;
+					break;
+				} else if (*q == irs) {
+					pspan->end = csv_block_strip_cr(pstate, sob + pspan->start, p, pctx) - sob;
+					*pend = q + 1;
+					return TRUE;
+				} else if (pstate->do_auto_line_term && *q == '\r') {
+					if (q + 1 == eob && !at_eof)
+						return FALSE;
+					if (q[1] == '\n') {
+						pspan->end = csv_block_strip_cr(pstate, sob + pspan->start, p, pctx) - sob;
+						*pend = q + 2;
+						return TRUE;
+					}
+					p = q;
+				} else { // A double quote not followed by any of the above is data
+					p = q;
+				}
+			}
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// Unescapes "" to " in place. Other double quotes are data.
+static void csv_block_unescape_dquote_dquote(char* field) {
+	char* pr = field;
+	char* pw = field;
+	while (*pr) {
+		if (pr[0] == '"' && pr[1] == '"')
+			pr++;
+		*pw++ = *pr++;
+	}
+	*pw = 0;
+}
+
+// ----------------------------------------------------------------
+static int lrec_reader_stdio_csv_get_fields_block(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pfields,
+	context_t* pctx, int is_header)
+{
+	// The UTF-8 BOM needs up to three bytes of lookahead; the end-of-file
+	// check needs one.
+	while (!pstate->at_eof && pstate->eob - pstate->sob < (is_header ? UTF8_BOM_LENGTH : 1))
+		csv_block_fill(pstate);
+	if (pstate->sob == pstate->eob)
+		return FALSE;
+	if (is_header && pstate->eob - pstate->sob >= UTF8_BOM_LENGTH
+		&& memcmp(pstate->sob, UTF8_BOM, UTF8_BOM_LENGTH) == 0)
+	{
+		pstate->sob += UTF8_BOM_LENGTH;
+	}
+
+	char* end = NULL;
+	while (!csv_block_scan_record(pstate, &end, pctx))
+		csv_block_fill(pstate);
+
+	size_t length = end - pstate->sob;
+	char* backing = mlr_malloc_or_die(length + 1);
+	memcpy(backing, pstate->sob, length);
+	backing[length] = 0;
+	pstate->sob = end;
+
+	for (int i = 0; i < pstate->num_spans; i++) {
+		csv_field_span_t* pspan = &pstate->pspans[i];
+		char* field = backing + pspan->start;
+		backing[pspan->end] = 0;
+		if (pspan->has_dquote_dquote)
+			csv_block_unescape_dquote_dquote(field);
+		rslls_append(pfields, field, NO_FREE, pspan->quote_flag);
+	}
+	pstate->pfields_backing = backing;
+
+	return TRUE;
+}
+
 // ----------------------------------------------------------------
 static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
 	context_t* pctx)
 {
-	lrec_t* prec = lrec_unbacked_alloc();
+	lrec_t* prec = lrec_csv_alloc(pstate->pfields_backing);
+	lrec_reserve(prec, pdata_fields->length);
 	int idx = 0;
 	for (rsllse_t* pd = pdata_fields->phead; pd != NULL; pd = pd->pnext) {
 		idx++;
@@ -553,12 +878,13 @@ static lrec_t* paste_indices_and_data(lrec_reader_stdio_csv_state_t* pstate, rsl
 static lrec_t* paste_header_and_data_ragged(lrec_reader_stdio_csv_state_t* pstate, rslls_t* pdata_fields,
 	context_t* pctx)
 {
-	lrec_t* prec = lrec_unbacked_alloc();
+	lrec_t* prec = lrec_csv_alloc(pstate->pfields_backing);
 	sllse_t* ph  = pstate->pheader_keeper->pkeys->phead;
 	rsllse_t* pd = pdata_fields->phead;
 	int idx = 0;
 	int hlen = pstate->pheader_keeper->pkeys->length;
 	int dlen = pdata_fields->length;
+	lrec_reserve(prec, hlen > dlen ? hlen : dlen);
 
 	// Process fields up to minimum of header length and data length
 	// Note that pd->pnext can be non-null due to pointer-reuse semantics of rslls,
@@ -603,7 +929,8 @@ static lrec_t* paste_header_and_data_rectangular(lrec_reader_stdio_csv_state_t*
 			pctx->filename, pstate->ilno);
 		exit(1);
 	}
-	lrec_t* prec = lrec_unbacked_alloc();
+	lrec_t* prec = lrec_csv_alloc(pstate->pfields_backing);
+	lrec_reserve(prec, pdata_fields->length);
 	sllse_t* ph = pstate->pheader_keeper->pkeys->phead;
 	rsllse_t* pd = pdata_fields->phead;
 	for ( ; ph != NULL && pd != NULL; ph = ph->pnext, pd = pd->pnext) {
@@ -628,3 +955,14 @@ static void lrec_reader_stdio_csv_close(void* pvstate, void* pvhandle, char* pre
 	lrec_reader_stdio_csv_state_t* pstate = pvstate;
 	pstate->pfr->pbr->pclose_func(pstate->pfr->pbr, prepipe);
 }
+
+// ----------------------------------------------------------------
+static void* lrec_reader_stdio_csv_block_open(void* pvstate, char* prepipe, char* filename) {
+	return file_reader_stdio_vopen(NULL, prepipe, filename);
+}
+
+static void lrec_reader_stdio_csv_block_close(void* pvstate, void* pvhandle, char* prepipe) {
+	lrec_reader_stdio_csv_state_t* pstate = pvstate;
+	file_reader_stdio_vclose(NULL, pvhandle, prepipe);
+	pstate->input_stream = NULL;
+}
@@ -134,6 +134,13 @@ static void lrec_reader_stdio_sof(void* pvstate, void* pvhandle) {
 	pstate->expect_header_line_next = pstate->use_implicit_csv_header ? FALSE : TRUE;
 }
 
+// For --nr-threads, where each piece of a file is read as a separate stream:
+// sets the line number which the next line read will follow.
+void lrec_reader_stdio_csvlite_set_ilno(lrec_reader_t* preader, long long ilno) {
+	lrec_reader_stdio_csvlite_state_t* pstate = preader->pvstate;
+	pstate->ilno = ilno;
+}
+
 // ----------------------------------------------------------------
 static lrec_t* lrec_reader_stdio_csvlite_process(void* pvstate, void* pvhandle, context_t* pctx) {
 	FILE* input_stream = pvhandle;
@@ -326,6 +333,7 @@ lrec_t* lrec_parse_stdio_csvlite_data_line_single_ifs(header_keeper_t* pheader_k
 	char* data_line, char ifs, int allow_repeat_ifs, int allow_ragged_csv_input)
 {
 	lrec_t* prec = lrec_csvlite_alloc(data_line);
+	lrec_reserve(prec, pheader_keeper->pkeys->length);
 	char* p = data_line;
 
 	if (allow_repeat_ifs) {
@@ -406,6 +414,7 @@ lrec_t* lrec_parse_stdio_csvlite_data_line_multi_ifs(header_keeper_t* pheader_ke
 	char* data_line, char* ifs, int ifslen, int allow_repeat_ifs, int allow_ragged_csv_input)
 {
 	lrec_t* prec = lrec_csvlite_alloc(data_line);
+	lrec_reserve(prec, pheader_keeper->pkeys->length);
 	char* p = data_line;
 
 	if (allow_repeat_ifs) {
@@ -8,44 +8,78 @@
 // ================================================================
 
 // ================================================================
-// Note: this is a non-streaming JSON reader which reads the entire input file
-// into memory and gets a pointer to it.  At some future point we may implement
-// a streaming JSON parser at which point this would change dramatically.
+// This is a streaming JSON reader: input is read in blocks, and each
+// top-level object -- or each element of a top-level array -- is parsed and
+// handed off as an lrec as soon as it has been read. Memory use is bounded by
+// the size of the largest single object, not by the size of the input, and
+// e.g. 'mlr --ijson head -n 10' doesn't need to read all its input.
+//
+// Finding where an object ends needs only bracket depth and whether we're
+// inside a string; that's done here. The object's text is then given to
+// json_parse, and the lrec takes ownership of the parsed JSON since its keys
+// and values point into it.
 //
 // See also https://github.com/johnkerl/miller/issues/99
 // ================================================================
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
+#include <unistd.h>
 #include "cli/comment_handling.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
-#include "input/file_ingestor_stdio.h"
+#include "lib/byte_scan.h"
+#include "input/file_reader_stdio.h"
 #include "input/lrec_readers.h"
 #include "input/json_parser.h"
 #include "input/mlr_json_adapter.h"
 
+#define JSON_BLOCK_SIZE (1 << 16)
+
+#define UTF8_BOM "\xef\xbb\xbf"
+#define UTF8_BOM_LENGTH 3
+
 typedef struct _lrec_reader_stdio_json_state_t {
-	// The list of top-level JSON objects is backed by the file contents. The records are in turn
-	// backed by the top-level JSON objects. This means the latter should not be freed while
-	// the records are in used. (This is done to reduce data copies, for performance: we can
-	// manipulate pointers to strings rather than copying strings.)
-	//
-	// In particular, in the multifile-input case, we need to keep *all* parsed JSON (and
-	// not free one file's data when we proceed to the next) since records with pointers
-	// into the parsed JSON may still be in use -- e.g. mlr sort.
-	sllv_t* ptop_level_json_objects;
 	sllv_t* precords;
 	char* input_json_flatten_separator;
 	json_array_ingest_t json_array_ingest;
 	char* specified_line_term;
 	int do_auto_line_term;
 	char* detected_line_term;
+	int line_term_detected;
 	comment_handling_t comment_handling;
 	char* comment_string;
+
+	const byte_scanner_t* pscanner;
+	FILE*  input_stream;
+	char*  buf;
+	size_t buf_alloc;
+	char*  sob;          // Start of unconsumed input
+	char*  eob;          // End of input read so far; always null-terminated
+	int    at_eof;
+	int    at_sof;       // For the UTF-8 BOM
+	char   last_char_read;
+
+	// Input before this offset from sob has had comment lines blanked out. Comment
+	// handling is done only on complete lines, so the item-scanner doesn't look
+	// past this unless comments are data.
+	size_t comments_done_offset;
+
+	// Between the '[' and ']' of a top-level array
+	int in_top_level_array;
+
+	// Scan state for the item starting at sob, so that scanning can resume
+	// where it left off after more input is read
+	size_t scan_offset;
+	int    scan_depth;
+	int    scan_in_string;
+	int    scan_escaped;
 } lrec_reader_stdio_json_state_t;
 
 static void    lrec_reader_stdio_json_free(lrec_reader_t* preader);
+static void*   lrec_reader_stdio_json_open(void* pvstate, char* prepipe, char* filename);
+static void    lrec_reader_stdio_json_close(void* pvstate, void* pvhandle, char* prepipe);
 static void    lrec_reader_stdio_json_sof(void* pvstate, void* pvhandle);
 static lrec_t* lrec_reader_stdio_json_process(void* pvstate, void* pvhandle, context_t* pctx);
 
@@ -56,13 +90,13 @@ lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator,
 	lrec_reader_t* plrec_reader = mlr_malloc_or_die(sizeof(lrec_reader_t));
 
 	lrec_reader_stdio_json_state_t* pstate = mlr_malloc_or_die(sizeof(lrec_reader_stdio_json_state_t));
-	pstate->ptop_level_json_objects      = sllv_alloc();
 	pstate->precords                     = sllv_alloc();
 	pstate->input_json_flatten_separator = input_json_flatten_separator;
 	pstate->json_array_ingest            = json_array_ingest;
 	pstate->specified_line_term          = line_term;
 	pstate->do_auto_line_term            = FALSE;
 	pstate->detected_line_term           = "\n"; // xxx adapt to MLR_GLOBALS/ctx-const for Windows port
+	pstate->line_term_detected           = FALSE;
 	pstate->comment_handling             = comment_handling;
 	pstate->comment_string               = comment_string;
 
@@ -70,9 +104,17 @@ lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator,
 		pstate->do_auto_line_term = TRUE;
 	}
 
+	pstate->pscanner     = byte_scanner_get();
+	pstate->input_stream = NULL;
+	pstate->buf_alloc    = JSON_BLOCK_SIZE;
+	pstate->buf          = mlr_malloc_or_die(pstate->buf_alloc + 1);
+	pstate->sob          = pstate->buf;
+	pstate->eob          = pstate->buf;
+	*pstate->eob         = 0;
+
 	plrec_reader->pvstate       = (void*)pstate;
-	plrec_reader->popen_func    = file_ingestor_stdio_vopen;
-	plrec_reader->pclose_func   = file_ingestor_stdio_nop_vclose;
+	plrec_reader->popen_func    = lrec_reader_stdio_json_open;
+	plrec_reader->pclose_func   = lrec_reader_stdio_json_close;
 	plrec_reader->pprocess_func = lrec_reader_stdio_json_process;
 	plrec_reader->psof_func     = lrec_reader_stdio_json_sof;
 	plrec_reader->pfree_func    = lrec_reader_stdio_json_free;
@@ -83,11 +125,6 @@ lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator,
 static void lrec_reader_stdio_json_free(lrec_reader_t* preader) {
 	lrec_reader_stdio_json_state_t* pstate = preader->pvstate;
 
-	for (sllve_t* pe = pstate->ptop_level_json_objects->phead; pe != NULL; pe = pe->pnext) {
-		json_value_t* top_level_json_object = pe->pvvalue;
-		json_free_value(top_level_json_object);
-	}
-	sllv_free(pstate->ptop_level_json_objects);
 	for (sllve_t* pf = pstate->precords->phead; pf != NULL; pf = pf->pnext) {
 		lrec_t* prec = pf->pvvalue;
 		lrec_free(prec);
@@ -95,119 +132,288 @@ static void lrec_reader_stdio_json_free(lrec_reader_t* preader) {
 	sllv_free(pstate->precords);
 	pstate->precords = NULL;
 
+	free(pstate->buf);
 	free(pstate);
 	free(preader);
 }
 
-// The stdio-JSON lrec-reader is non-streaming: we ingest all records here in the start-of-file hook.
-// Then in the process method we pop one lrec off the list at a time, until they are all exhausted.
-// This is in contrast to other Miller lrec-readers.
-//
-// It would be possible to extend the streaming framework to also have an end-of-file hook
-// which we could use here to free parsed-JSON data. However, we simply leverage the start-of-file
-// hook for the *next* file (if any) or the free method (if not): these free parsed-JSON structures
-// from the previous file (if any).
+// ----------------------------------------------------------------
+static void* lrec_reader_stdio_json_open(void* pvstate, char* prepipe, char* filename) {
+	lrec_reader_stdio_json_state_t* pstate = pvstate;
+	pstate->input_stream = file_reader_stdio_vopen(NULL, prepipe, filename);
+	return pstate->input_stream;
+}
+
+static void lrec_reader_stdio_json_close(void* pvstate, void* pvhandle, char* prepipe) {
+	lrec_reader_stdio_json_state_t* pstate = pvstate;
+	file_reader_stdio_vclose(NULL, pstate->input_stream, prepipe);
+	pstate->input_stream = NULL;
+}
+
 static void lrec_reader_stdio_json_sof(void* pvstate, void* pvhandle) {
 	lrec_reader_stdio_json_state_t* pstate = pvstate;
-	file_ingestor_stdio_state_t* phandle = pvhandle;
-	json_char* json_input = (json_char*)phandle->sof;
-	json_value_t* parsed_top_level_json;
-	json_char error_buf[JSON_ERROR_MAX];
+	pstate->sob                  = pstate->buf;
+	pstate->eob                  = pstate->buf;
+	*pstate->eob                 = 0;
+	pstate->at_eof               = FALSE;
+	pstate->at_sof               = TRUE;
+	pstate->last_char_read       = 0;
+	pstate->comments_done_offset = 0;
+	pstate->in_top_level_array   = FALSE;
+	pstate->scan_offset          = 0;
+	pstate->scan_depth           = 0;
+	pstate->scan_in_string       = FALSE;
+	pstate->scan_escaped         = FALSE;
+}
 
-	// This enables us to handle input of the form
-	//
-	//   { "a" : 1 }
-	//   { "b" : 2 }
-	//   { "c" : 3 }
-	//
-	// in addition to
-	//
-	// [
-	//   { "a" : 1 }
-	//   { "b" : 2 }
-	//   { "c" : 3 }
-	// ]
-	//
-	// This is in line with what jq can handle. In this case, json_parse will return
-	// once for each top-level item and will give us back a pointer to the start of
-	// the rest of the input stream, so we can call json_parse on the rest until it is
-	// all exhausted.
-
-	json_char* item_start = json_input;
-	int length = phandle->eof - phandle->sof;
-	char* detected_line_term = NULL;
-
-	if (pstate->do_auto_line_term) {
-		// Find the first line-ending sequence (if any): LF or CRLF.
-		for (char* p = phandle->sof; p < phandle->eof; p++) {
-			if (p[0] == '\n') {
-				if (p > phandle->sof && p[-1] == '\r') {
-					detected_line_term = "\r\n";
-				} else {
-					detected_line_term = "\n";
-				}
-				break;
-			}
+// ----------------------------------------------------------------
+// Returns a pointer just past the last line terminator in [from, to), or from
+// if there is none.
+static char* json_last_line_end(char* from, char* to, char* line_term) {
+	int line_term_length = strlen(line_term);
+	for (char* p = to - line_term_length; p >= from; p--) {
+		if (memcmp(p, line_term, line_term_length) == 0)
+			return p + line_term_length;
+	}
+	return from;
+}
+
+// Moves the unconsumed input to the start of the buffer, growing the buffer if
+// there's no room left, and reads more. Then does line-ending detection and
+// comment-stripping on whatever complete lines are now available.
+static void json_block_fill(lrec_reader_stdio_json_state_t* pstate) {
+	size_t used = pstate->eob - pstate->sob;
+	if (pstate->sob > pstate->buf) {
+		memmove(pstate->buf, pstate->sob, used);
+		pstate->sob = pstate->buf;
+		pstate->eob = pstate->buf + used;
+	}
+	if (used == pstate->buf_alloc) {
+		pstate->buf_alloc *= 2;
+		pstate->buf = mlr_realloc_or_die(pstate->buf, pstate->buf_alloc + 1);
+		pstate->sob = pstate->buf;
+		pstate->eob = pstate->buf + used;
+	}
+
+	ssize_t nread;
+	int fd = fileno(pstate->input_stream);
+	if (fd < 0) { // E.g. decompressing streams
+		nread = fread(pstate->eob, 1, pstate->buf_alloc - used, pstate->input_stream);
+		if (nread == 0 && ferror(pstate->input_stream))
+			nread = -1;
+	} else {
+		do {
+			nread = read(fd, pstate->eob, pstate->buf_alloc - used);
+		} while (nread < 0 && errno == EINTR);
+	}
+	if (nread < 0) {
+		perror("read");
+		fprintf(stderr, "%s: Unable to read JSON data.\n", MLR_GLOBALS.bargv0);
+		exit(1);
+	}
+	if (nread == 0)
+		pstate->at_eof = TRUE;
+	char* pnew = pstate->eob;
+	pstate->eob += nread;
+	*pstate->eob = 0;
+
+	// Find the first line-ending sequence (if any): LF or CRLF.
+	if (pstate->do_auto_line_term && !pstate->line_term_detected && nread > 0) {
+		char* p = memchr(pnew, '\n', nread);
+		if (p != NULL) {
+			char prev = (p > pstate->buf) ? p[-1] : pstate->last_char_read;
+			pstate->detected_line_term = (prev == '\r') ? "\r\n" : "\n";
+			pstate->line_term_detected = TRUE;
 		}
 	}
+	if (nread > 0)
+		pstate->last_char_read = pstate->eob[-1];
 
-	// Skip comments. For JSON, we ingest the entire blob, this is a matter of finding and iterating over lines.
 	// Miller data comments must be at start of line.
 	if (pstate->comment_handling != COMMENTS_ARE_DATA) {
-		char* line_term = pstate->specified_line_term;
-		if (pstate->do_auto_line_term && detected_line_term != NULL)
-			line_term = detected_line_term;
-		mlr_json_strip_comments(phandle->sof, phandle->eof,
-			pstate->comment_handling, pstate->comment_string, line_term);
+		char* line_term = pstate->do_auto_line_term ? pstate->detected_line_term : pstate->specified_line_term;
+		char* from = pstate->sob + pstate->comments_done_offset;
+		char* to = pstate->at_eof ? pstate->eob : json_last_line_end(from, pstate->eob, line_term);
+		if (to > from) {
+			mlr_json_strip_comments(from, to, pstate->comment_handling, pstate->comment_string, line_term);
+			pstate->comments_done_offset = to - pstate->sob;
+		}
 	}
-	mlr_json_end_strip(phandle->sof, &phandle->eof);
-	length = phandle->eof - phandle->sof;
+}
 
-	if (length > 0) {
-		while (TRUE) {
+// ----------------------------------------------------------------
+static inline void json_advance_to(lrec_reader_stdio_json_state_t* pstate, char* p) {
+	if (pstate->comment_handling != COMMENTS_ARE_DATA)
+		pstate->comments_done_offset -= p - pstate->sob;
+	pstate->sob = p;
+}
 
-			parsed_top_level_json = json_parse(item_start, length, error_buf, &item_start);
+// Finds the next top-level object, or element of a top-level array, returning
+// FALSE at end of input. The item isn't checked for validity here, beyond
+// knowing where it ends: that's left to json_parse. Truncated items are
+// returned as-is at end of input, for json_parse to report on.
+static int json_next_item(lrec_reader_stdio_json_state_t* pstate, char** pitem, size_t* plength) {
+	while (TRUE) {
+		char* limit = (pstate->comment_handling == COMMENTS_ARE_DATA)
+			? pstate->eob
+			: pstate->sob + pstate->comments_done_offset;
+		int have_all = pstate->at_eof && limit == pstate->eob;
 
-			if (parsed_top_level_json == NULL) {
-				fprintf(stderr, "%s: Unable to parse JSON data: %s\n", MLR_GLOBALS.bargv0, error_buf);
-				exit(1);
+		if (pstate->at_sof) {
+			if (limit - pstate->sob < UTF8_BOM_LENGTH && !have_all) {
+				json_block_fill(pstate);
+				continue;
 			}
+			if (limit - pstate->sob >= UTF8_BOM_LENGTH && memcmp(pstate->sob, UTF8_BOM, UTF8_BOM_LENGTH) == 0)
+				json_advance_to(pstate, pstate->sob + UTF8_BOM_LENGTH);
+			pstate->at_sof = FALSE;
+		}
 
-			// The lrecs have their string pointers pointing into the parsed-JSON objects (for
-			// efficiency) so it's important we not free the latter until our free method.
-			if (!reference_json_objects_as_lrecs(pstate->precords, parsed_top_level_json,
-				pstate->input_json_flatten_separator, pstate->json_array_ingest))
-			{
-				fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
-				exit(1);
+		// Skip over whitespace and separators between items.
+		if (pstate->scan_offset == 0) {
+			char* p = pstate->sob;
+			for ( ; p < limit; p++) {
+				char c = *p;
+				if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ',') {
+					continue;
+				} else if (c == '[' && !pstate->in_top_level_array) {
+					pstate->in_top_level_array = TRUE;
+				} else if (c == ']' && pstate->in_top_level_array) {
+					pstate->in_top_level_array = FALSE;
+				} else {
+					break;
+				}
+			}
+			json_advance_to(pstate, p);
+			if (p == limit) {
+				if (have_all) {
+					if (pstate->in_top_level_array) {
+						fprintf(stderr, "%s: Unable to parse JSON data: unterminated top-level array.\n",
+							MLR_GLOBALS.bargv0);
+						exit(1);
+					}
+					return FALSE;
+				}
+				json_block_fill(pstate);
+				continue;
 			}
+		}
 
-			if (item_start == NULL)
-				break;
-			if (*item_start == 0)
-				break;
-			length -= (item_start - json_input);
-			json_input = item_start;
-			// json_parse goes up to the '\r' or '\n' (whichever is found first) on the first
-			// parse, then keeps going from there on the next. E.g. in the CRLF case it
-			// consumes the CR at the end of the first read and consumes the LF at the start
-			// of the second, and so on. After the very last parse, we need to here consume
-			// the final '\n' which is (by itself) a parse error.
-			if (length == 1 && *(char*)json_input == '\n') {
-				break;
+		char* p = pstate->sob + pstate->scan_offset;
+		int done = FALSE;
+		if (*pstate->sob == '{' || *pstate->sob == '[') {
+			while (p < limit) {
+				if (pstate->scan_in_string) {
+					if (pstate->scan_escaped) {
+						pstate->scan_escaped = FALSE;
+						p++;
+						continue;
+					}
+					char* q = byte_scan_find3(pstate->pscanner, p, '"', '\\', '"');
+					if (q >= limit) {
+						p = limit;
+					} else if (*q == '"') {
+						pstate->scan_in_string = FALSE;
+						p = q + 1;
+					} else if (*q == '\\') {
+						pstate->scan_escaped = TRUE;
+						p = q + 1;
+					} else { // Null byte in the data
+						p = q + 1;
+					}
+				} else {
+					char c = *p++;
+					if (c == '"') {
+						pstate->scan_in_string = TRUE;
+					} else if (c == '{' || c == '[') {
+						pstate->scan_depth++;
+					} else if (c == '}' || c == ']') {
+						if (--pstate->scan_depth == 0) {
+							done = TRUE;
+							break;
+						}
+					}
+				}
+			}
+		} else {
+			// Something other than an object or array: a scalar, or junk. Either way
+			// json_parse will have something to say about it.
+			if (p == pstate->sob)
+				p++;
+			for ( ; p < limit; p++) {
+				char c = *p;
+				if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == ','
+					|| c == '{' || c == '}' || c == '[' || c == ']')
+				{
+					done = TRUE;
+					break;
+				}
 			}
 		}
-	}
-	if (detected_line_term != NULL) {
-		pstate->detected_line_term = detected_line_term;
+
+		if (done || have_all) {
+			*pitem = pstate->sob;
+			*plength = p - pstate->sob;
+			json_advance_to(pstate, p);
+			pstate->scan_offset    = 0;
+			pstate->scan_depth     = 0;
+			pstate->scan_in_string = FALSE;
+			pstate->scan_escaped   = FALSE;
+			return TRUE;
+		}
+		pstate->scan_offset = p - pstate->sob;
+		json_block_fill(pstate);
 	}
 }
 
 // ----------------------------------------------------------------
 static lrec_t* lrec_reader_stdio_json_process(void* pvstate, void* pvhandle, context_t* pctx) {
 	lrec_reader_stdio_json_state_t* pstate = pvstate;
-	if (pstate->do_auto_line_term) {
-		context_set_autodetected_line_term(pctx, pstate->detected_line_term);
+	json_char error_buf[JSON_ERROR_MAX];
+
+	while (TRUE) {
+		lrec_t* prec = sllv_pop(pstate->precords);
+		if (prec != NULL) {
+			if (pstate->do_auto_line_term) {
+				context_set_autodetected_line_term(pctx, pstate->detected_line_term);
+			}
+			return prec;
+		}
+
+		char* item = NULL;
+		size_t length = 0;
+		if (!json_next_item(pstate, &item, &length))
+			return NULL;
+		// Read only now, since json_next_item may just have consumed the opening
+		// bracket of the top-level array.
+		int is_array_element = pstate->in_top_level_array;
+
+		json_char* item_end = NULL;
+		json_value_t* parsed_json = json_parse(item, length, error_buf, &item_end);
+		if (parsed_json == NULL) {
+			fprintf(stderr, "%s: Unable to parse JSON data: %s\n", MLR_GLOBALS.bargv0, error_buf);
+			exit(1);
+		}
+		if (is_array_element && parsed_json->type != JSON_OBJECT) {
+			fprintf(stderr,
+				"%s: found non-object (type %s) within top-level array. This is valid but unmillerable JSON.\n",
+				MLR_GLOBALS.bargv0, json_describe_type(parsed_json->type));
+			exit(1);
+		}
+
+		// Since top-level arrays are taken apart here, each parsed item is a
+		// single object and makes a single record, which owns the parsed JSON.
+		if (!reference_json_objects_as_lrecs(pstate->precords, parsed_json,
+			pstate->input_json_flatten_separator, pstate->json_array_ingest))
+		{
+			fprintf(stderr, "%s: Unable to parse JSON data.\n", MLR_GLOBALS.bargv0);
+			exit(1);
+		}
+		if (pstate->precords->phead == NULL) {
+			// Nothing to own the parsed JSON, e.g. for an empty array.
+			json_free_value(parsed_json);
+			continue;
+		}
+		mlr_json_lrec_attach_backing(pstate->precords->phead->pvvalue, parsed_json);
 	}
-	return sllv_pop(pstate->precords);
 }
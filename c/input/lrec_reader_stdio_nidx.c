@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include "cli/comment_handling.h"
 #include "lib/mlrutil.h"
+#include "lib/byte_scan.h"
 #include "input/file_reader_stdio.h"
 #include "input/line_readers.h"
 #include "input/lrec_readers.h"
@@ -186,7 +187,34 @@ static lrec_t* lrec_reader_stdio_nidx_process_multi_irs_multi_ifs(void* pvstate,
 }
 
 // ----------------------------------------------------------------
+// Where available, SSE2/AVX2 is used to check 16 or 32 bytes at a time for IFS:
+// see lib/byte_scan.h. The byte-at-a-time versions are kept for other CPUs.
+
+static lrec_t* lrec_parse_stdio_nidx_single_sep_bytewise(char* line, char ifs, int allow_repeat_ifs);
+static lrec_t* lrec_parse_stdio_nidx_single_sep_vectorized(const byte_scanner_t* pscanner,
+	char* line, char ifs, int allow_repeat_ifs);
+static lrec_t* lrec_parse_stdio_nidx_multi_sep_bytewise(char* line, char* ifs, int ifslen, int allow_repeat_ifs);
+static lrec_t* lrec_parse_stdio_nidx_multi_sep_vectorized(const byte_scanner_t* pscanner,
+	char* line, char* ifs, int ifslen, int allow_repeat_ifs);
+
 lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_ifs) {
+	const byte_scanner_t* pscanner = byte_scanner_get();
+	if (pscanner != NULL)
+		return lrec_parse_stdio_nidx_single_sep_vectorized(pscanner, line, ifs, allow_repeat_ifs);
+	else
+		return lrec_parse_stdio_nidx_single_sep_bytewise(line, ifs, allow_repeat_ifs);
+}
+
+lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int allow_repeat_ifs) {
+	const byte_scanner_t* pscanner = byte_scanner_get();
+	if (pscanner != NULL)
+		return lrec_parse_stdio_nidx_multi_sep_vectorized(pscanner, line, ifs, ifslen, allow_repeat_ifs);
+	else
+		return lrec_parse_stdio_nidx_multi_sep_bytewise(line, ifs, ifslen, allow_repeat_ifs);
+}
+
+// ----------------------------------------------------------------
+static lrec_t* lrec_parse_stdio_nidx_single_sep_bytewise(char* line, char ifs, int allow_repeat_ifs) {
 	lrec_t* prec = lrec_nidx_alloc(line);
 
 	int idx = 0;
@@ -230,7 +258,7 @@ lrec_t* lrec_parse_stdio_nidx_single_sep(char* line, char ifs, int allow_repeat_
 }
 
 // ----------------------------------------------------------------
-lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int allow_repeat_ifs) {
+static lrec_t* lrec_parse_stdio_nidx_multi_sep_bytewise(char* line, char* ifs, int ifslen, int allow_repeat_ifs) {
 	lrec_t* prec = lrec_nidx_alloc(line);
 
 	int  idx = 0;
@@ -272,3 +300,112 @@ lrec_t* lrec_parse_stdio_nidx_multi_sep(char* line, char* ifs, int ifslen, int a
 
 	return prec;
 }
+
+// ----------------------------------------------------------------
+// Runs of IFS are collapsed by skipping an IFS which is at the very start of a
+// field.
+static lrec_t* lrec_parse_stdio_nidx_single_sep_vectorized(const byte_scanner_t* pscanner,
+	char* line, char ifs, int allow_repeat_ifs)
+{
+	lrec_t* prec = lrec_nidx_alloc(line);
+
+	int idx = 0;
+	char  free_flags = 0;
+
+	char* key   = NULL;
+	char* value = line;
+
+	const char* block = byte_scan_block_start(pscanner, line);
+	unsigned int mask = byte_scan_first_mask(pscanner, block, line, ifs, ifs);
+
+	while (TRUE) {
+		while (mask == 0) {
+			block += pscanner->block_size;
+			mask = pscanner->pblock_func(block, ifs, ifs);
+		}
+		char* p = (char*)block + byte_scan_lowest_bit(mask);
+		mask &= mask - 1;
+
+		if (*p == 0)
+			break;
+		if (allow_repeat_ifs && p == value) {
+			value = p + 1;
+			continue;
+		}
+		*p = 0;
+
+		idx++;
+		key = low_int_to_string(idx, &free_flags);
+		lrec_put(prec, key, value, free_flags);
+
+		value = p + 1;
+	}
+	idx++;
+
+	if (allow_repeat_ifs && *value == 0) {
+		; // OK
+	} else {
+		key = low_int_to_string(idx, &free_flags);
+		lrec_put(prec, key, value, free_flags);
+	}
+
+	return prec;
+}
+
+// ----------------------------------------------------------------
+// Here we scan for the first character of IFS, then check for the rest.
+// Candidates inside an already-matched separator are skipped.
+static lrec_t* lrec_parse_stdio_nidx_multi_sep_vectorized(const byte_scanner_t* pscanner,
+	char* line, char* ifs, int ifslen, int allow_repeat_ifs)
+{
+	lrec_t* prec = lrec_nidx_alloc(line);
+
+	int  idx = 0;
+	char free_flags = 0;
+
+	char* key   = NULL;
+	char* value = line;
+	char* next  = line;
+
+	const char* block = byte_scan_block_start(pscanner, line);
+	unsigned int mask = byte_scan_first_mask(pscanner, block, line, ifs[0], ifs[0]);
+
+	while (TRUE) {
+		while (mask == 0) {
+			block += pscanner->block_size;
+			mask = pscanner->pblock_func(block, ifs[0], ifs[0]);
+		}
+		char* p = (char*)block + byte_scan_lowest_bit(mask);
+		mask &= mask - 1;
+
+		if (p < next)
+			continue;
+		if (*p == 0)
+			break;
+		if (!streqn(p, ifs, ifslen))
+			continue;
+
+		next = p + ifslen;
+		if (allow_repeat_ifs && p == value) {
+			value = next;
+			continue;
+		}
+		*p = 0;
+
+		idx++;
+		key = low_int_to_string(idx, &free_flags);
+		lrec_put(prec, key, value, free_flags);
+
+		value = next;
+	}
+	idx++;
+
+	if (allow_repeat_ifs && *value == 0) {
+		; // OK
+	} else {
+		key = low_int_to_string(idx, &free_flags);
+		lrec_put(prec, key, value, free_flags);
+	}
+
+	return prec;
+}
@@ -4,23 +4,54 @@
 #include "input/lrec_readers.h"
 #include "input/byte_readers.h"
 
-lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts) {
+static lrec_reader_t* lrec_reader_serial_alloc(cli_reader_opts_t* popts);
+
+// ----------------------------------------------------------------
+lrec_reader_t* lrec_reader_alloc(cli_reader_opts_t* popts) {
+	lrec_reader_t* pserial_reader = lrec_reader_serial_alloc(popts);
+	if (pserial_reader == NULL || popts->nr_threads <= 1)
+		return pserial_reader;
+	lrec_reader_t* pparallel_reader = lrec_reader_parallel_alloc(popts, pserial_reader);
+	return (pparallel_reader != NULL) ? pparallel_reader : pserial_reader;
+}
+
+// ----------------------------------------------------------------
+static lrec_reader_t* lrec_reader_serial_alloc(cli_reader_opts_t* popts) {
 	if (streq(popts->ifile_fmt, "gen")) {
 		generator_opts_t* pgopts = &popts->generator_opts;
 		return lrec_reader_gen_alloc(pgopts->field_name, pgopts->start, pgopts->stop, pgopts->step);
 	} else if (streq(popts->ifile_fmt, "dkvp")) {
-		return lrec_reader_stdio_dkvp_alloc(popts->irs, popts->ifs, popts->ips, popts->allow_repeat_ifs,
-			popts->comment_handling, popts->comment_string);
+		lrec_reader_t* pstdio_reader = lrec_reader_stdio_dkvp_alloc(popts->irs, popts->ifs, popts->ips,
+			popts->allow_repeat_ifs, popts->comment_handling, popts->comment_string);
+		if (!popts->use_mmap_for_read)
+			return pstdio_reader;
+		return lrec_reader_mmap_or_stdio_alloc(
+			lrec_reader_mmap_dkvp_alloc(popts->irs, popts->ifs, popts->ips, popts->allow_repeat_ifs,
+				popts->comment_handling, popts->comment_string),
+			pstdio_reader);
 	} else if (streq(popts->ifile_fmt, "csv")) {
 		return lrec_reader_stdio_csv_alloc(popts->irs, popts->ifs, popts->use_implicit_csv_header,
 			popts->allow_ragged_csv_input, popts->comment_handling, popts->comment_string);
 	} else if (streq(popts->ifile_fmt, "csvlite")) {
-		return lrec_reader_stdio_csvlite_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
-			popts->use_implicit_csv_header, popts->allow_ragged_csv_input, popts->comment_handling,
-			popts->comment_string);
-	} else if (streq(popts->ifile_fmt, "nidx")) {
-		return lrec_reader_stdio_nidx_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
+		lrec_reader_t* pstdio_reader = lrec_reader_stdio_csvlite_alloc(popts->irs, popts->ifs,
+			popts->allow_repeat_ifs, popts->use_implicit_csv_header, popts->allow_ragged_csv_input,
 			popts->comment_handling, popts->comment_string);
+		if (!popts->use_mmap_for_read)
+			return pstdio_reader;
+		return lrec_reader_mmap_or_stdio_alloc(
+			lrec_reader_mmap_csvlite_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
+				popts->use_implicit_csv_header, popts->allow_ragged_csv_input, popts->comment_handling,
+				popts->comment_string),
+			pstdio_reader);
+	} else if (streq(popts->ifile_fmt, "nidx")) {
+		lrec_reader_t* pstdio_reader = lrec_reader_stdio_nidx_alloc(popts->irs, popts->ifs,
+			popts->allow_repeat_ifs, popts->comment_handling, popts->comment_string);
+		if (!popts->use_mmap_for_read)
+			return pstdio_reader;
+		return lrec_reader_mmap_or_stdio_alloc(
+			lrec_reader_mmap_nidx_alloc(popts->irs, popts->ifs, popts->allow_repeat_ifs,
+				popts->comment_handling, popts->comment_string),
+			pstdio_reader);
 	} else if (streq(popts->ifile_fmt, "xtab")) {
 		return lrec_reader_stdio_xtab_alloc(popts->ifs, popts->ips, popts->allow_repeat_ips,
 			popts->comment_handling, popts->comment_string);
@@ -32,6 +63,7 @@ lrec_reader_t*  lrec_reader_alloc(cli_reader_opts_t* popts) {
 	}
 }
 
+// ----------------------------------------------------------------
 lrec_reader_t* lrec_reader_alloc_or_die(cli_reader_opts_t* popts) {
 	lrec_reader_t* plrec_reader = lrec_reader_alloc(popts);
 	if (plrec_reader == NULL) {
@@ -24,8 +24,27 @@ lrec_reader_t* lrec_reader_stdio_xtab_alloc(char* ifs, char* ips, int allow_repe
 lrec_reader_t* lrec_reader_stdio_json_alloc(char* input_json_flatten_separator, json_array_ingest_t json_array_ingest, char* line_term,
 	comment_handling_t comment_handling, char* comment_string);
 
+lrec_reader_t* lrec_reader_mmap_csvlite_alloc(char* irs, char* ifs, int allow_repeat_ifs, int use_implicit_csv_header,
+	int allow_ragged_csv_input, comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_mmap_dkvp_alloc(char* irs, char* ifs, char* ips, int allow_repeat_ifs,
+	comment_handling_t comment_handling, char* comment_string);
+lrec_reader_t* lrec_reader_mmap_nidx_alloc(char* irs, char* ifs, int allow_repeat_ifs,
+	comment_handling_t comment_handling, char* comment_string);
+
+// Uses the mmap reader for regular files, else the stdio reader. Takes ownership of both.
+lrec_reader_t* lrec_reader_mmap_or_stdio_alloc(lrec_reader_t* pmmap_reader, lrec_reader_t* pstdio_reader);
+
+// Parses regular files in chunks on nr_threads worker threads, delivering records in order; uses the serial
+// reader for everything else. Takes ownership of the serial reader. Returns NULL, having done nothing, if
+// the input format or options aren't supported: see lrec_reader_parallel.c.
+lrec_reader_t* lrec_reader_parallel_alloc(cli_reader_opts_t* popts, lrec_reader_t* pserial_reader);
+
 lrec_reader_t* lrec_reader_in_memory_alloc(sllv_t* precords);
 
+// For the parallel reader
+void lrec_reader_stdio_csv_set_ilno(lrec_reader_t* preader, long long ilno);
+void lrec_reader_stdio_csvlite_set_ilno(lrec_reader_t* preader, long long ilno);
+
 // ----------------------------------------------------------------
 // These entry points are made public for unit test
 
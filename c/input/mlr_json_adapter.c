@@ -272,6 +272,16 @@ static int populate_from_nested_array(lrec_t* prec, json_value_t* pjson_array, c
 	return TRUE;
 }
 
+// ----------------------------------------------------------------
+static void mlr_json_lrec_free_backing(lrec_t* prec) {
+	json_free_value(prec->pvjson_value);
+}
+
+void mlr_json_lrec_attach_backing(lrec_t* prec, json_value_t* pjson) {
+	prec->pvjson_value = pjson;
+	prec->pfree_backing_func = mlr_json_lrec_free_backing;
+}
+
 // ----------------------------------------------------------------
 // * The buffer is an entire JSON blob, e.g. contents from stdio read; peof-psof is the file size so peof is one
 //   byte *after* the last valid file byte.
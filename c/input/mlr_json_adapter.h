@@ -16,6 +16,10 @@
 int reference_json_objects_as_lrecs(sllv_t* precords, json_value_t* ptop_level_json, char* flatten_sep,
 	json_array_ingest_t json_array_ingest);
 
+// For streaming input, where each parsed top-level object backs exactly one lrec: the lrec takes over
+// ownership of the parsed JSON, which is freed along with the lrec.
+void mlr_json_lrec_attach_backing(lrec_t* prec, json_value_t* pjson);
+
 // * The buffer is an entire JSON blob, e.g. contents from stdio read; peof-psof is the file size so peof is one
 //   byte *after* the last valid file byte.
 // * The buffer is not assumed to be null-terminated.
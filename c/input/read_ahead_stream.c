@@ -0,0 +1,256 @@
+// fopencookie is a GNU extension.
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "input/read_ahead_stream.h"
+
+#if defined(__GLIBC__)
+#define READ_AHEAD_HAVE_FOPENCOOKIE
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__)
+#define READ_AHEAD_HAVE_FUNOPEN
+#endif
+
+typedef struct _read_ahead_stream_t {
+	read_ahead_fill_func_t*  pfill_func;
+	read_ahead_close_func_t* pclose_func;
+	void*                    pvsource;
+	char*                    filename;
+	char*                    error_context;
+
+	pthread_t       thread;
+	pthread_mutex_t mutex;
+	pthread_cond_t  filled_cond;
+	pthread_cond_t  emptied_cond;
+
+	// Ring of buffers. The helper thread fills them in order, and the reader
+	// consumes them in order.
+	int     num_buffers;
+	size_t  buffer_size;
+	char**  buffers;
+	size_t* lengths;
+	int     fill_index;
+	int     read_index;
+	int     num_filled;
+	size_t  read_offset;   // Within the buffer at read_index
+
+	int     is_done;       // Set by the helper thread at end of input or on error
+	int     is_closing;    // Set by the reader to stop the helper thread early
+	char*   error_message; // Null unless the fill function failed
+} read_ahead_stream_t;
+
+static void* read_ahead_stream_main(void* pvarg);
+static ssize_t read_ahead_stream_read(void* pvcookie, char* buf, size_t size);
+static int read_ahead_stream_close(void* pvcookie);
+
+// ----------------------------------------------------------------
+FILE* read_ahead_stream_open(read_ahead_fill_func_t* pfill_func, read_ahead_close_func_t* pclose_func,
+	void* pvsource, int num_buffers, size_t buffer_size, char* filename, char* error_context)
+{
+#if !defined(READ_AHEAD_HAVE_FOPENCOOKIE) && !defined(READ_AHEAD_HAVE_FUNOPEN)
+	fprintf(stderr, "%s: %s of \"%s\" isn't supported on this platform.\n",
+		MLR_GLOBALS.bargv0, error_context, filename);
+	exit(1);
+#else
+	read_ahead_stream_t* pstate = mlr_malloc_or_die(sizeof(read_ahead_stream_t));
+	pstate->pfill_func    = pfill_func;
+	pstate->pclose_func   = pclose_func;
+	pstate->pvsource      = pvsource;
+	pstate->filename      = mlr_strdup_or_die(filename);
+	pstate->error_context = error_context;
+
+	pthread_mutex_init(&pstate->mutex, NULL);
+	pthread_cond_init(&pstate->filled_cond, NULL);
+	pthread_cond_init(&pstate->emptied_cond, NULL);
+
+	pstate->num_buffers = num_buffers;
+	pstate->buffer_size = buffer_size;
+	pstate->buffers     = mlr_malloc_or_die(num_buffers * sizeof(char*));
+	pstate->lengths     = mlr_malloc_or_die(num_buffers * sizeof(size_t));
+	for (int i = 0; i < num_buffers; i++) {
+		pstate->buffers[i] = mlr_malloc_or_die(buffer_size);
+		pstate->lengths[i] = 0;
+	}
+	pstate->fill_index    = 0;
+	pstate->read_index    = 0;
+	pstate->num_filled    = 0;
+	pstate->read_offset   = 0;
+	pstate->is_done       = FALSE;
+	pstate->is_closing    = FALSE;
+	pstate->error_message = NULL;
+
+	int rc = pthread_create(&pstate->thread, NULL, read_ahead_stream_main, pstate);
+	if (rc != 0) {
+		fprintf(stderr, "%s: could not create %s thread: %s.\n", MLR_GLOBALS.bargv0, error_context, strerror(rc));
+		exit(1);
+	}
+
+#ifdef READ_AHEAD_HAVE_FOPENCOOKIE
+	cookie_io_functions_t funcs = {
+		.read  = read_ahead_stream_read,
+		.write = NULL,
+		.seek  = NULL,
+		.close = read_ahead_stream_close,
+	};
+	FILE* output_stream = fopencookie(pstate, "r", funcs);
+#else
+	FILE* output_stream = funopen(pstate, (int (*)(void*, char*, int))read_ahead_stream_read, NULL, NULL,
+		read_ahead_stream_close);
+#endif
+	if (output_stream == NULL) {
+		perror("fopencookie");
+		fprintf(stderr, "%s: could not open %s stream for \"%s\".\n", MLR_GLOBALS.bargv0, error_context, filename);
+		exit(1);
+	}
+	return output_stream;
+#endif
+}
+
+// ----------------------------------------------------------------
+// Helper thread: fills buffers, blocking while all of them are waiting to be
+// read.
+static void* read_ahead_stream_main(void* pvarg) {
+	read_ahead_stream_t* pstate = pvarg;
+
+	while (TRUE) {
+		pthread_mutex_lock(&pstate->mutex);
+		while (pstate->num_filled == pstate->num_buffers && !pstate->is_closing)
+			pthread_cond_wait(&pstate->emptied_cond, &pstate->mutex);
+		int is_closing = pstate->is_closing;
+		pthread_mutex_unlock(&pstate->mutex);
+		if (is_closing)
+			break;
+
+		// Only this thread touches the buffer at fill_index until it's counted as filled.
+		char* error_message = NULL;
+		size_t length = pstate->pfill_func(pstate->pvsource, pstate->buffers[pstate->fill_index],
+			pstate->buffer_size, &error_message);
+		int is_done = (length == 0 || error_message != NULL);
+
+		pthread_mutex_lock(&pstate->mutex);
+		if (length > 0) {
+			pstate->lengths[pstate->fill_index] = length;
+			pstate->fill_index = (pstate->fill_index + 1) % pstate->num_buffers;
+			pstate->num_filled++;
+		}
+		if (is_done) {
+			pstate->error_message = error_message;
+			pstate->is_done = TRUE;
+		}
+		pthread_cond_signal(&pstate->filled_cond);
+		pthread_mutex_unlock(&pstate->mutex);
+		if (is_done)
+			break;
+	}
+
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static ssize_t read_ahead_stream_read(void* pvcookie, char* buf, size_t size) {
+	read_ahead_stream_t* pstate = pvcookie;
+
+	pthread_mutex_lock(&pstate->mutex);
+	while (pstate->num_filled == 0 && !pstate->is_done)
+		pthread_cond_wait(&pstate->filled_cond, &pstate->mutex);
+	if (pstate->num_filled == 0) {
+		char* error_message = pstate->error_message;
+		pthread_mutex_unlock(&pstate->mutex);
+		if (error_message != NULL) {
+			fprintf(stderr, "%s: %s error on file \"%s\": %s.\n",
+				MLR_GLOBALS.bargv0, pstate->error_context, pstate->filename, error_message);
+			exit(1);
+		}
+		return 0;
+	}
+	pthread_mutex_unlock(&pstate->mutex);
+
+	// The buffer at read_index is filled and won't be touched by the helper
+	// thread until it's released below.
+	size_t available = pstate->lengths[pstate->read_index] - pstate->read_offset;
+	size_t n = (size < available) ? size : available;
+	memcpy(buf, pstate->buffers[pstate->read_index] + pstate->read_offset, n);
+	pstate->read_offset += n;
+
+	if (pstate->read_offset == pstate->lengths[pstate->read_index]) {
+		pthread_mutex_lock(&pstate->mutex);
+		pstate->read_index = (pstate->read_index + 1) % pstate->num_buffers;
+		pstate->read_offset = 0;
+		pstate->num_filled--;
+		pthread_cond_signal(&pstate->emptied_cond);
+		pthread_mutex_unlock(&pstate->mutex);
+	}
+	return n;
+}
+
+// ----------------------------------------------------------------
+static int read_ahead_stream_close(void* pvcookie) {
+	read_ahead_stream_t* pstate = pvcookie;
+
+	pthread_mutex_lock(&pstate->mutex);
+	pstate->is_closing = TRUE;
+	pthread_cond_signal(&pstate->emptied_cond);
+	pthread_mutex_unlock(&pstate->mutex);
+	pthread_join(pstate->thread, NULL);
+
+	pstate->pclose_func(pstate->pvsource);
+	for (int i = 0; i < pstate->num_buffers; i++)
+		free(pstate->buffers[i]);
+	free(pstate->buffers);
+	free(pstate->lengths);
+	pthread_cond_destroy(&pstate->emptied_cond);
+	pthread_cond_destroy(&pstate->filled_cond);
+	pthread_mutex_destroy(&pstate->mutex);
+	free(pstate->filename);
+	free(pstate);
+	return 0;
+}
+
+// ================================================================
+// --read-ahead: the fill function is a plain read.
+
+static int    read_ahead_num_buffers = 0;
+static size_t read_ahead_buffer_size = READ_AHEAD_DEFAULT_BLOCK_SIZE;
+
+static size_t read_ahead_fill(void* pvsource, char* buf, size_t size, char** perror_message);
+static void read_ahead_close(void* pvsource);
+
+void read_ahead_set_options(int num_buffers, size_t buffer_size) {
+	read_ahead_num_buffers = num_buffers;
+	read_ahead_buffer_size = buffer_size;
+}
+
+FILE* read_ahead_wrap(FILE* input_stream, char* filename) {
+	if (read_ahead_num_buffers == 0 || fileno(input_stream) < 0)
+		return input_stream;
+	return read_ahead_stream_open(read_ahead_fill, read_ahead_close, input_stream,
+		read_ahead_num_buffers, read_ahead_buffer_size, filename, "read");
+}
+
+// A single read: for regular files this fills the buffer, and for pipes and
+// terminals it returns what's available so that records aren't held back
+// waiting for more input.
+static size_t read_ahead_fill(void* pvsource, char* buf, size_t size, char** perror_message) {
+	FILE* input_stream = pvsource;
+	int fd = fileno(input_stream);
+	ssize_t nread;
+	do {
+		nread = read(fd, buf, size);
+	} while (nread < 0 && errno == EINTR);
+	if (nread < 0) {
+		*perror_message = strerror(errno);
+		return 0;
+	}
+	return nread;
+}
+
+static void read_ahead_close(void* pvsource) {
+	FILE* input_stream = pvsource;
+	if (input_stream != stdin)
+		fclose(input_stream);
+}
@@ -0,0 +1,41 @@
+// ================================================================
+// Input streams filled ahead of the reader by a helper thread.
+//
+// The helper thread fills a ring of large buffers by calling a fill function
+// -- a plain read() for --read-ahead, or zlib inflate for compressed input --
+// while the main thread parses records out of the buffers already filled.
+// This overlaps I/O (or decompression) with record processing; the bytes are
+// delivered in order, so record order is unaffected.
+//
+// The result is a stdio stream, so the stdio-based readers need no changes.
+// Closing it with fclose stops the helper thread, then calls the close
+// function to release the source.
+// ================================================================
+
+#ifndef READ_AHEAD_STREAM_H
+#define READ_AHEAD_STREAM_H
+
+#include <stdio.h>
+
+// Returns the number of bytes put into buf, which may be fewer than size;
+// zero means end of input. On error, sets *perror_message and returns the
+// number of bytes obtained before the error.
+typedef size_t read_ahead_fill_func_t(void* pvsource, char* buf, size_t size, char** perror_message);
+typedef void read_ahead_close_func_t(void* pvsource);
+
+// The error_context is for error messages, e.g. "gzip decompression".
+FILE* read_ahead_stream_open(read_ahead_fill_func_t* pfill_func, read_ahead_close_func_t* pclose_func,
+	void* pvsource, int num_buffers, size_t buffer_size, char* filename, char* error_context);
+
+// ----------------------------------------------------------------
+// For --read-ahead: num_buffers of zero (the default) disables read-ahead.
+#define READ_AHEAD_DEFAULT_BLOCK_SIZE (1 << 20)
+void read_ahead_set_options(int num_buffers, size_t buffer_size);
+
+// Returns a read-ahead stream on the given stream if read-ahead is enabled,
+// else the stream as-is. Streams without a file descriptor (such as those
+// from the file decompressor, which has a helper thread of its own) are also
+// returned as-is.
+FILE* read_ahead_wrap(FILE* input_stream, char* filename);
+
+#endif // READ_AHEAD_STREAM_H
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "input/byte_readers.h"
+#include "input/file_decompressor.h"
+#include "input/read_ahead_stream.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlr_arch.h"
 #include "lib/mlrutil.h"
@@ -52,6 +54,7 @@ static int stdio_byte_reader_open_func(struct _byte_reader_t* pbr, char* prepipe
 				exit(1);
 			}
 		}
+		pstate->fp = read_ahead_wrap(file_decompressor_wrap(pstate->fp, filename), filename);
 	} else {
 		char* escaped_filename = alloc_file_name_escaped_for_popen(filename);
 		char* command = mlr_malloc_or_die(strlen(prepipe) + 3 + strlen(escaped_filename) + 1);
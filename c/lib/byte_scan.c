@@ -0,0 +1,108 @@
+#include <stdlib.h>
+#include <pthread.h>
+#include "lib/mlrutil.h"
+#include "lib/byte_scan.h"
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define BYTE_SCAN_HAVE_X86
+#include <immintrin.h>
+#endif
+
+#ifdef BYTE_SCAN_HAVE_X86
+
+// Loading a whole aligned block may read past the end of a heap allocation,
+// though never past the end of its page: see byte_scan.h.
+#if defined(__SANITIZE_ADDRESS__)
+#define BYTE_SCAN_NO_ASAN __attribute__((no_sanitize_address))
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define BYTE_SCAN_NO_ASAN __attribute__((no_sanitize_address))
+#endif
+#endif
+#ifndef BYTE_SCAN_NO_ASAN
+#define BYTE_SCAN_NO_ASAN
+#endif
+
+// ----------------------------------------------------------------
+BYTE_SCAN_NO_ASAN
+static unsigned int byte_scan_block_sse2(const char* block, char c1, char c2) {
+	__m128i v = _mm_load_si128((const __m128i*)block);
+	__m128i m = _mm_or_si128(
+		_mm_or_si128(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(c1)),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(c2))),
+		_mm_cmpeq_epi8(v, _mm_setzero_si128()));
+	return (unsigned int)_mm_movemask_epi8(m);
+}
+
+BYTE_SCAN_NO_ASAN
+static unsigned int byte_scan_block3_sse2(const char* block, char c1, char c2, char c3) {
+	__m128i v = _mm_load_si128((const __m128i*)block);
+	__m128i m = _mm_or_si128(
+		_mm_or_si128(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(c1)),
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(c2))),
+		_mm_or_si128(
+			_mm_cmpeq_epi8(v, _mm_set1_epi8(c3)),
+			_mm_cmpeq_epi8(v, _mm_setzero_si128())));
+	return (unsigned int)_mm_movemask_epi8(m);
+}
+
+// Compiled for AVX2 regardless of -march; only called if the CPU has it.
+__attribute__((target("avx2"))) BYTE_SCAN_NO_ASAN
+static unsigned int byte_scan_block_avx2(const char* block, char c1, char c2) {
+	__m256i v = _mm256_load_si256((const __m256i*)block);
+	__m256i m = _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c1)),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c2))),
+		_mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+	return (unsigned int)_mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2"))) BYTE_SCAN_NO_ASAN
+static unsigned int byte_scan_block3_avx2(const char* block, char c1, char c2, char c3) {
+	__m256i v = _mm256_load_si256((const __m256i*)block);
+	__m256i m = _mm256_or_si256(
+		_mm256_or_si256(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c1)),
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c2))),
+		_mm256_or_si256(
+			_mm256_cmpeq_epi8(v, _mm256_set1_epi8(c3)),
+			_mm256_cmpeq_epi8(v, _mm256_setzero_si256())));
+	return (unsigned int)_mm256_movemask_epi8(m);
+}
+
+static const byte_scanner_t byte_scanner_sse2 = { "sse2", 16, byte_scan_block_sse2, byte_scan_block3_sse2 };
+static const byte_scanner_t byte_scanner_avx2 = { "avx2", 32, byte_scan_block_avx2, byte_scan_block3_avx2 };
+
+#endif // BYTE_SCAN_HAVE_X86
+
+// ----------------------------------------------------------------
+const byte_scanner_t* byte_scanner_get_by_name(char* name) {
+#ifdef BYTE_SCAN_HAVE_X86
+	__builtin_cpu_init();
+	if (streq(name, "sse2"))
+		return &byte_scanner_sse2;
+	if (streq(name, "avx2") && __builtin_cpu_supports("avx2"))
+		return &byte_scanner_avx2;
+#endif
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+// Resolved on first use, which may be from several --nr-threads workers at
+// once.
+static pthread_once_t byte_scanner_once = PTHREAD_ONCE_INIT;
+static const byte_scanner_t* pbest_scanner = NULL;
+
+static void byte_scanner_resolve() {
+	pbest_scanner = byte_scanner_get_by_name("avx2");
+	if (pbest_scanner == NULL)
+		pbest_scanner = byte_scanner_get_by_name("sse2");
+}
+
+const byte_scanner_t* byte_scanner_get() {
+	pthread_once(&byte_scanner_once, byte_scanner_resolve);
+	return pbest_scanner;
+}
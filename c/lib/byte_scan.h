@@ -0,0 +1,82 @@
+// ================================================================
+// Vectorized separator-finding for the DKVP, NIDX, and CSV record-splitters.
+//
+// A block function compares one aligned block of 16 or 32 bytes against two
+// (or three) separator characters and against the null terminator, and
+// returns a bitmask with bit i set iff byte i of the block matched. The
+// splitters then walk the set bits rather than every byte of the line.
+//
+// Blocks are aligned to their own size, so a block load never crosses a page
+// boundary: it's safe to load the block containing the null terminator even
+// though it may extend past the end of the line's allocation.
+//
+// The implementation (SSE2 or AVX2) is chosen once at runtime based on CPU
+// support. On other architectures, or CPUs without SSE2, byte_scanner_get
+// returns NULL and the splitters use their byte-at-a-time code.
+// ================================================================
+
+#ifndef BYTE_SCAN_H
+#define BYTE_SCAN_H
+
+typedef unsigned int byte_scan_block_func_t(const char* block, char c1, char c2);
+typedef unsigned int byte_scan_block3_func_t(const char* block, char c1, char c2, char c3);
+
+typedef struct _byte_scanner_t {
+	char* name;
+	int   block_size; // 16 or 32
+	byte_scan_block_func_t*  pblock_func;
+	byte_scan_block3_func_t* pblock3_func;
+} byte_scanner_t;
+
+// The best implementation for this CPU, or NULL if there is none.
+const byte_scanner_t* byte_scanner_get();
+
+// For unit tests and benchmarking: "sse2" or "avx2". Returns NULL if the
+// named implementation isn't compiled in or isn't supported by this CPU.
+const byte_scanner_t* byte_scanner_get_by_name(char* name);
+
+// ----------------------------------------------------------------
+static inline const char* byte_scan_block_start(const byte_scanner_t* pscanner, const char* p) {
+	return (const char*)((unsigned long)p & ~(unsigned long)(pscanner->block_size - 1));
+}
+
+// Match-mask for the block containing p, with bits for bytes before p cleared.
+static inline unsigned int byte_scan_first_mask(const byte_scanner_t* pscanner, const char* block, const char* p,
+	char c1, char c2)
+{
+	return pscanner->pblock_func(block, c1, c2) & (~0U << (p - block));
+}
+
+// Index of the lowest set bit; the mask must be nonzero.
+static inline int byte_scan_lowest_bit(unsigned int mask) {
+#ifdef __GNUC__
+	return __builtin_ctz(mask);
+#else
+	int i = 0;
+	while (!(mask & 1)) {
+		mask >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+// ----------------------------------------------------------------
+// Returns a pointer to the first byte at or after p which is c1, c2, c3, or
+// null. With a NULL scanner this is a byte-at-a-time loop.
+static inline char* byte_scan_find3(const byte_scanner_t* pscanner, char* p, char c1, char c2, char c3) {
+	if (pscanner == NULL) {
+		while (*p && *p != c1 && *p != c2 && *p != c3)
+			p++;
+		return p;
+	}
+	const char* block = byte_scan_block_start(pscanner, p);
+	unsigned int mask = pscanner->pblock3_func(block, c1, c2, c3) & (~0U << (p - block));
+	while (mask == 0) {
+		block += pscanner->block_size;
+		mask = pscanner->pblock3_func(block, c1, c2, c3);
+	}
+	return (char*)block + byte_scan_lowest_bit(mask);
+}
+
+#endif // BYTE_SCAN_H
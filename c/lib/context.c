@@ -29,6 +29,7 @@ void context_init_from_opts(context_t* pctx, void* pvopts) {
 	pctx->filenum   = 0;
 	pctx->filename  = NULL;
 	pctx->force_eof = 0;
+	pctx->more_output = 0;
 
 	pctx->ips       = popts->reader_opts.ips;
 	pctx->ifs       = popts->reader_opts.ifs;
@@ -9,6 +9,7 @@ typedef struct _context_t {
 	int       filenum;
 	char*     filename;
 	int       force_eof; // e.g. mlr head
+	int       more_output; // Set by a mapper at end of stream; see mapping/mapper.h
 
 	char*     ips;
 	char*     ifs;
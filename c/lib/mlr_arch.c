@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include "mlr_globals.h"
 #include "mlr_arch.h"
 #include "mlrutil.h"
@@ -10,13 +11,22 @@
 // For some Linux distros, in spite of including time.h:
 char *strptime(const char *s, const char *format, struct tm *ptm);
 
+// ----------------------------------------------------------------
+// With --pipeline, verbs run on separate threads. The environment (in
+// particular TZ, which DSL ENV assignments may change) is shared process
+// state, so writes to it and the libc calls which read it are serialized here.
+static pthread_mutex_t env_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 // ----------------------------------------------------------------
 int mlr_arch_setenv(const char *name, const char *value) {
 #ifdef MLR_ON_MSYS2
 	fprintf(stderr, "%s: setenv is not supported on this architecture.\n", MLR_GLOBALS.bargv0);
 	exit(1);
 #else
-	return setenv(name, value, 1 /*overwrite*/);
+	pthread_mutex_lock(&env_mutex);
+	int rc = setenv(name, value, 1 /*overwrite*/);
+	pthread_mutex_unlock(&env_mutex);
+	return rc;
 #endif
 }
 
@@ -26,10 +36,22 @@ int mlr_arch_unsetenv(const char *name) {
 	fprintf(stderr, "%s: unsetenv is not supported on this architecture.\n", MLR_GLOBALS.bargv0);
 	exit(1);
 #else
-	return unsetenv(name);
+	pthread_mutex_lock(&env_mutex);
+	int rc = unsetenv(name);
+	pthread_mutex_unlock(&env_mutex);
+	return rc;
 #endif
 }
 
+// ----------------------------------------------------------------
+char* mlr_arch_getenv_copy(const char *name) {
+	pthread_mutex_lock(&env_mutex);
+	char* value = getenv(name);
+	char* copy = (value == NULL) ? NULL : mlr_strdup_or_die(value);
+	pthread_mutex_unlock(&env_mutex);
+	return copy;
+}
+
 // ----------------------------------------------------------------
 char *mlr_arch_strptime(const char *s, const char *format, struct tm *ptm) {
 #ifdef MLR_ON_MSYS2
@@ -40,7 +62,27 @@ char *mlr_arch_strptime(const char *s, const char *format, struct tm *ptm) {
 }
 
 // ----------------------------------------------------------------
-// See the GNU timegm manpage -- this is what it does.
+struct tm* mlr_arch_localtime_r(const time_t* pseconds, struct tm* ptm) {
+	struct tm* ret;
+	pthread_mutex_lock(&env_mutex);
+#ifdef MLR_ON_MSYS2
+	ret = localtime(pseconds); // No localtime_r on Windows; the mutex makes the copy safe.
+	if (ret != NULL) {
+		*ptm = *ret;
+		ret = ptm;
+	}
+#else
+	tzset(); // localtime_r need not notice TZ changes on its own.
+	ret = localtime_r(pseconds, ptm);
+#endif
+	pthread_mutex_unlock(&env_mutex);
+	return ret;
+}
+
+// ----------------------------------------------------------------
+// GMT uses timegm, which neither reads nor writes TZ. (Swapping TZ around a
+// mktime call, as the GNU timegm manpage suggests, races with localtime_r
+// and getenv on other threads under --pipeline.)
 time_t mlr_arch_timegmlocal(struct tm* ptm, timezone_handling_t timezone_handling) {
 #ifdef MLR_ON_MSYS2
 	// Crap, we're offering limited Windows support :(
@@ -54,18 +96,12 @@ time_t mlr_arch_timegmlocal(struct tm* ptm, timezone_handling_t timezone_handlin
 	time_t ret;
 
 	if (timezone_handling == TIMEZONE_HANDLING_GMT) {
-		char* tz = getenv("TZ");
-		mlr_arch_setenv("TZ", "GMT0");
-		tzset();
-		ret = mktime(ptm);
-		if (tz) {
-			mlr_arch_setenv("TZ", tz);
-		} else {
-			mlr_arch_unsetenv("TZ");
-		}
-		tzset();
+		ret = timegm(ptm);
 	} else {
+		pthread_mutex_lock(&env_mutex);
+		tzset();
 		ret = mktime(ptm);
+		pthread_mutex_unlock(&env_mutex);
 	}
 
 	return ret;
@@ -26,6 +26,10 @@
 // ----------------------------------------------------------------
 int mlr_arch_setenv(const char *name, const char *value);
 int mlr_arch_unsetenv(const char *name);
+// Returns a malloced copy of the value, or NULL if the variable is unset.
+char* mlr_arch_getenv_copy(const char *name);
+
+struct tm* mlr_arch_localtime_r(const time_t* pseconds, struct tm* ptm);
 
 char *mlr_arch_strptime(const char *s, const char *format, struct tm *ptm);
 time_t mlr_arch_timegmlocal(struct tm* ptm, timezone_handling_t timezone_handling);
@@ -2,8 +2,13 @@
 #include <libgen.h>
 #include "lib/mlr_globals.h"
 
-mlr_globals_t MLR_GLOBALS = { .bargv0 = "mlr-globals-uninit", .ofmt = NULL };
+mlr_globals_t MLR_GLOBALS = {
+	.bargv0 = "mlr-globals-uninit",
+	.ofmt = NULL,
+	.ofmt_format = { .fmt = NULL, .fixed_precision = -1 },
+};
 void mlr_global_init(char* argv0, char* ofmt) {
 	MLR_GLOBALS.bargv0 = basename(argv0);
 	MLR_GLOBALS.ofmt   = ofmt;
+	mlr_double_format_init(&MLR_GLOBALS.ofmt_format, ofmt);
 }
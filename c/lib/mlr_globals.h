@@ -1,9 +1,12 @@
 #ifndef MLR_GLOBALS_H
 #define MLR_GLOBALS_H
 
+#include "lib/mlrutil.h"
+
 typedef struct _mlr_globals_t {
 	char* bargv0; // basename of argv0
 	char* ofmt;
+	double_format_t ofmt_format; // ofmt, examined once
 } mlr_globals_t;
 extern mlr_globals_t MLR_GLOBALS;
 void mlr_global_init(char* argv0, char* ofmt);
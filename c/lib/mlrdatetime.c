@@ -38,10 +38,14 @@ char* mlr_alloc_time_string_from_seconds(double seconds_since_the_epoch, char* f
 	struct tm tm;
 	switch(timezone_handling) {
 	case TIMEZONE_HANDLING_GMT:
+#ifdef MLR_ON_MSYS2
 		tm = *gmtime(&iseconds); // No gmtime_r on Windows so just use gmtime.
+#else
+		gmtime_r(&iseconds, &tm); // Reentrant since verbs may be on separate threads with --pipeline.
+#endif
 		break;
 	case TIMEZONE_HANDLING_LOCAL:
-		tm = *localtime(&iseconds); // No gmtime_r on Windows so just use gmtime.
+		mlr_arch_localtime_r(&iseconds, &tm); // Serialized against TZ changes on other threads.
 		break;
 	default:
 		fprintf(stderr, "%s: internal coding error detected in file %s at line %d.\n",
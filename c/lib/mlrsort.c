@@ -0,0 +1,352 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "lib/mlrutil.h"
+#include "lib/mlrsort.h"
+
+// Below this many items per thread, threads cost more than they save.
+#define MLR_SORT_MIN_ITEMS_PER_THREAD 16384
+// Runs this short are insertion-sorted before merging starts.
+#define MLR_SORT_INSERTION_WIDTH 16
+// Radix-sort partitions this short are insertion-sorted instead.
+#define MLR_RADIX_INSERTION_MAX 32
+
+// Sorts items on one thread, using scratch space of the same length.
+typedef void chunk_sort_func_t(void** items, void** scratch, long long n, mlr_sort_comparator_t* pcomparator,
+	void* pvcontext);
+
+typedef struct _sort_job_t {
+	chunk_sort_func_t*     pchunk_sort_func;
+	mlr_sort_comparator_t* pcomparator;
+	void*      pvcontext;
+	void**     psrc;
+	void**     pdst;
+	// For chunk sorts: the chunk. For merges: the two runs, adjacent in psrc.
+	long long  lo;
+	long long  mid;
+	long long  hi;
+	// For merges: this job's part of the output, relative to lo.
+	long long  out_lo;
+	long long  out_hi;
+} sort_job_t;
+
+static void  sort_in_chunks(void** items, long long num_items, mlr_sort_comparator_t* pcomparator,
+	void* pvcontext, int num_threads, chunk_sort_func_t* pchunk_sort_func);
+static void  sort_serial(void** items, void** scratch, long long n, mlr_sort_comparator_t* pcomparator,
+	void* pvcontext);
+static void  radix_sort(void** items, void** scratch, long long n, mlr_sort_comparator_t* _, void* __);
+static void  insertion_sort(void** items, long long n, mlr_sort_comparator_t* pcomparator, void* pvcontext);
+static int   compare_keys(void* pva, void* pvb, void* _);
+static void  merge_runs(void** pa, long long na, void** pb, long long nb, void** pdst,
+	mlr_sort_comparator_t* pcomparator, void* pvcontext);
+static long long co_rank(long long k, void** pa, long long na, void** pb, long long nb,
+	mlr_sort_comparator_t* pcomparator, void* pvcontext);
+static void* sort_chunk_job(void* pvjob);
+static void* merge_part_job(void* pvjob);
+static void  run_jobs(sort_job_t* pjobs, int num_jobs, void* (*pjob_func)(void*));
+
+// ----------------------------------------------------------------
+void mlr_sort_pointers(void** items, long long num_items, mlr_sort_comparator_t* pcomparator,
+	void* pvcontext, int num_threads)
+{
+	sort_in_chunks(items, num_items, pcomparator, pvcontext, num_threads, sort_serial);
+}
+
+void mlr_sort_pointers_by_key(void** items, long long num_items, int num_threads) {
+	sort_in_chunks(items, num_items, compare_keys, NULL, num_threads, radix_sort);
+}
+
+// ----------------------------------------------------------------
+void mlr_sort_key_set(mlr_sort_key_t* pkey, unsigned char* bytes, size_t length) {
+	unsigned long long prefix = 0ULL;
+	for (size_t i = 0; i < 8; i++)
+		prefix = (prefix << 8) | (i < length ? bytes[i] : 0);
+	pkey->prefix = prefix;
+	pkey->bytes  = bytes;
+	pkey->length = length;
+}
+
+// Zero-padding means equal prefixes leave it to the lengths whenever either
+// key is eight bytes or less.
+int mlr_sort_key_compare(mlr_sort_key_t* pa, mlr_sort_key_t* pb) {
+	if (pa->prefix != pb->prefix)
+		return (pa->prefix < pb->prefix) ? -1 : 1;
+	size_t min_length = (pa->length < pb->length) ? pa->length : pb->length;
+	if (min_length > 8) {
+		int s = memcmp(pa->bytes + 8, pb->bytes + 8, min_length - 8);
+		if (s != 0)
+			return s;
+	}
+	return (pa->length < pb->length) ? -1 : (pa->length > pb->length) ? 1 : 0;
+}
+
+static int compare_keys(void* pva, void* pvb, void* _) {
+	return mlr_sort_key_compare(pva, pvb);
+}
+
+// ----------------------------------------------------------------
+static void sort_in_chunks(void** items, long long num_items, mlr_sort_comparator_t* pcomparator,
+	void* pvcontext, int num_threads, chunk_sort_func_t* pchunk_sort_func)
+{
+	if (num_items < 2)
+		return;
+	void** scratch = mlr_malloc_or_die(num_items * sizeof(void*));
+
+	long long max_threads = num_items / MLR_SORT_MIN_ITEMS_PER_THREAD;
+	if (num_threads > max_threads)
+		num_threads = max_threads;
+	if (num_threads <= 1) {
+		pchunk_sort_func(items, scratch, num_items, pcomparator, pvcontext);
+		free(scratch);
+		return;
+	}
+
+	// Sort the chunks, each on its own thread.
+	long long* bounds = mlr_malloc_or_die((num_threads + 1) * sizeof(long long));
+	sort_job_t* pjobs = mlr_malloc_or_die(2 * num_threads * sizeof(sort_job_t));
+	for (int i = 0; i <= num_threads; i++)
+		bounds[i] = num_items * i / num_threads;
+	for (int i = 0; i < num_threads; i++) {
+		pjobs[i] = (sort_job_t) {
+			.pchunk_sort_func = pchunk_sort_func, .pcomparator = pcomparator, .pvcontext = pvcontext,
+			.psrc = items, .pdst = scratch, .lo = bounds[i], .hi = bounds[i+1],
+		};
+	}
+	run_jobs(pjobs, num_threads, sort_chunk_job);
+
+	// Merge pairs of runs until there is one. Each merge is split into parts
+	// in proportion to its length, so every round keeps all threads busy.
+	int num_runs = num_threads;
+	void** psrc = items;
+	void** pdst = scratch;
+	while (num_runs > 1) {
+		int num_jobs = 0;
+		int num_merged_runs = 0;
+		for (int r = 0; r < num_runs; r += 2) {
+			long long lo  = bounds[r];
+			long long mid = bounds[r+1];
+			long long hi  = (r + 1 < num_runs) ? bounds[r+2] : mid;
+			int num_parts = (int)((hi - lo) * num_threads / num_items);
+			if (num_parts < 1)
+				num_parts = 1;
+			for (int p = 0; p < num_parts; p++) {
+				pjobs[num_jobs++] = (sort_job_t) {
+					.pcomparator = pcomparator, .pvcontext = pvcontext,
+					.psrc = psrc, .pdst = pdst, .lo = lo, .mid = mid, .hi = hi,
+					.out_lo = (hi - lo) * p / num_parts, .out_hi = (hi - lo) * (p + 1) / num_parts,
+				};
+			}
+			bounds[num_merged_runs++] = lo;
+		}
+		bounds[num_merged_runs] = num_items;
+		run_jobs(pjobs, num_jobs, merge_part_job);
+
+		num_runs = num_merged_runs;
+		void** ptemp = psrc;
+		psrc = pdst;
+		pdst = ptemp;
+	}
+	if (psrc != items)
+		memcpy(items, psrc, num_items * sizeof(void*));
+
+	free(pjobs);
+	free(bounds);
+	free(scratch);
+}
+
+// ----------------------------------------------------------------
+// Bottom-up merge sort, going back and forth between the items and the
+// scratch space. The result ends up in the items.
+static void sort_serial(void** items, void** scratch, long long n, mlr_sort_comparator_t* pcomparator,
+	void* pvcontext)
+{
+	for (long long lo = 0; lo < n; lo += MLR_SORT_INSERTION_WIDTH) {
+		long long width = (n - lo < MLR_SORT_INSERTION_WIDTH) ? n - lo : MLR_SORT_INSERTION_WIDTH;
+		insertion_sort(&items[lo], width, pcomparator, pvcontext);
+	}
+
+	void** psrc = items;
+	void** pdst = scratch;
+	for (long long width = MLR_SORT_INSERTION_WIDTH; width < n; width *= 2) {
+		for (long long lo = 0; lo < n; lo += 2 * width) {
+			long long mid = lo + width;
+			long long hi  = lo + 2 * width;
+			if (mid > n)
+				mid = n;
+			if (hi > n)
+				hi = n;
+			merge_runs(&psrc[lo], mid - lo, &psrc[mid], hi - mid, &pdst[lo], pcomparator, pvcontext);
+		}
+		void** ptemp = psrc;
+		psrc = pdst;
+		pdst = ptemp;
+	}
+	if (psrc != items)
+		memcpy(items, psrc, n * sizeof(void*));
+}
+
+static void insertion_sort(void** items, long long n, mlr_sort_comparator_t* pcomparator, void* pvcontext) {
+	for (long long i = 1; i < n; i++) {
+		void* pv = items[i];
+		long long j = i;
+		for ( ; j > 0 && pcomparator(items[j-1], pv, pvcontext) > 0; j--)
+			items[j] = items[j-1];
+		items[j] = pv;
+	}
+}
+
+// ----------------------------------------------------------------
+// MSD radix sort on the items' keys, one byte per pass. Each pass distributes
+// a partition of the items into 257 sub-partitions -- keys which have ended,
+// then one per byte value -- by way of the scratch space, which keeps it
+// stable. Pending partitions are kept on a stack rather than recursed into,
+// since keys sharing long prefixes would recurse deeply.
+
+typedef struct _radix_partition_t {
+	long long lo;
+	long long n;
+	size_t    depth;
+} radix_partition_t;
+
+static inline int radix_digit(mlr_sort_key_t* pkey, size_t depth) {
+	if (depth >= pkey->length)
+		return 0;
+	if (depth < 8)
+		return 1 + (int)((pkey->prefix >> (56 - 8 * depth)) & 0xff);
+	return 1 + pkey->bytes[depth];
+}
+
+static void radix_sort(void** items, void** scratch, long long n, mlr_sort_comparator_t* _, void* __) {
+	long long counts[257];
+	long long stack_capacity = 256;
+	long long stack_size = 0;
+	radix_partition_t* pstack = mlr_malloc_or_die(stack_capacity * sizeof(radix_partition_t));
+	pstack[stack_size++] = (radix_partition_t) { .lo = 0, .n = n, .depth = 0 };
+
+	while (stack_size > 0) {
+		radix_partition_t partition = pstack[--stack_size];
+		void** pitems = &items[partition.lo];
+		long long pn = partition.n;
+		size_t depth = partition.depth;
+		if (pn <= MLR_RADIX_INSERTION_MAX) {
+			insertion_sort(pitems, pn, compare_keys, NULL);
+			continue;
+		}
+
+		// Skip over bytes which all the keys have in common.
+		int digit;
+		while (TRUE) {
+			memset(counts, 0, sizeof(counts));
+			for (long long i = 0; i < pn; i++)
+				counts[radix_digit(pitems[i], depth)]++;
+			digit = radix_digit(pitems[0], depth);
+			if (counts[digit] != pn || digit == 0)
+				break;
+			depth++;
+		}
+		if (counts[digit] == pn) // All the keys are the same
+			continue;
+
+		long long offsets[257];
+		long long offset = 0;
+		for (int d = 0; d < 257; d++) {
+			offsets[d] = offset;
+			offset += counts[d];
+		}
+		void** pscratch = &scratch[partition.lo];
+		for (long long i = 0; i < pn; i++)
+			pscratch[offsets[radix_digit(pitems[i], depth)]++] = pitems[i];
+		memcpy(pitems, pscratch, pn * sizeof(void*));
+
+		// Keys which have ended are all equal, and in order already.
+		if (stack_size + 256 > stack_capacity) {
+			stack_capacity *= 2;
+			pstack = mlr_realloc_or_die(pstack, stack_capacity * sizeof(radix_partition_t));
+		}
+		offset = counts[0];
+		for (int d = 1; d < 257; d++) {
+			if (counts[d] > 1)
+				pstack[stack_size++] = (radix_partition_t) {
+					.lo = partition.lo + offset, .n = counts[d], .depth = depth + 1
+				};
+			offset += counts[d];
+		}
+	}
+	free(pstack);
+}
+
+// ----------------------------------------------------------------
+// Ties go to the first run, for stability.
+static void merge_runs(void** pa, long long na, void** pb, long long nb, void** pdst,
+	mlr_sort_comparator_t* pcomparator, void* pvcontext)
+{
+	long long i = 0, j = 0;
+	while (i < na && j < nb) {
+		if (pcomparator(pb[j], pa[i], pvcontext) < 0)
+			*pdst++ = pb[j++];
+		else
+			*pdst++ = pa[i++];
+	}
+	memcpy(pdst, &pa[i], (na - i) * sizeof(void*));
+	pdst += na - i;
+	memcpy(pdst, &pb[j], (nb - j) * sizeof(void*));
+}
+
+// How many of the first k outputs of merging runs a and b come from a. Binary
+// search for the largest such count whose last item from a sorts no later
+// than the next item from b.
+static long long co_rank(long long k, void** pa, long long na, void** pb, long long nb,
+	mlr_sort_comparator_t* pcomparator, void* pvcontext)
+{
+	long long lo = (k > nb) ? k - nb : 0;
+	long long hi = (k < na) ? k : na;
+	while (lo < hi) {
+		long long i = lo + (hi - lo + 1) / 2;
+		if (pcomparator(pa[i-1], pb[k-i], pvcontext) <= 0)
+			lo = i;
+		else
+			hi = i - 1;
+	}
+	return lo;
+}
+
+// ----------------------------------------------------------------
+static void* sort_chunk_job(void* pvjob) {
+	sort_job_t* pjob = pvjob;
+	pjob->pchunk_sort_func(&pjob->psrc[pjob->lo], &pjob->pdst[pjob->lo], pjob->hi - pjob->lo,
+		pjob->pcomparator, pjob->pvcontext);
+	return NULL;
+}
+
+static void* merge_part_job(void* pvjob) {
+	sort_job_t* pjob = pvjob;
+	void** pa = &pjob->psrc[pjob->lo];
+	void** pb = &pjob->psrc[pjob->mid];
+	long long na = pjob->mid - pjob->lo;
+	long long nb = pjob->hi - pjob->mid;
+	long long ia_lo = co_rank(pjob->out_lo, pa, na, pb, nb, pjob->pcomparator, pjob->pvcontext);
+	long long ia_hi = co_rank(pjob->out_hi, pa, na, pb, nb, pjob->pcomparator, pjob->pvcontext);
+	long long ib_lo = pjob->out_lo - ia_lo;
+	long long ib_hi = pjob->out_hi - ia_hi;
+	merge_runs(&pa[ia_lo], ia_hi - ia_lo, &pb[ib_lo], ib_hi - ib_lo, &pjob->pdst[pjob->lo + pjob->out_lo],
+		pjob->pcomparator, pjob->pvcontext);
+	return NULL;
+}
+
+// Runs the last job on the calling thread, and any job whose thread can't be
+// started there too.
+static void run_jobs(sort_job_t* pjobs, int num_jobs, void* (*pjob_func)(void*)) {
+	pthread_t* pthreads = mlr_malloc_or_die(num_jobs * sizeof(pthread_t));
+	int* pstarted = mlr_malloc_or_die(num_jobs * sizeof(int));
+	for (int i = 0; i < num_jobs - 1; i++) {
+		pstarted[i] = pthread_create(&pthreads[i], NULL, pjob_func, &pjobs[i]) == 0;
+		if (!pstarted[i])
+			pjob_func(&pjobs[i]);
+	}
+	pjob_func(&pjobs[num_jobs - 1]);
+	for (int i = 0; i < num_jobs - 1; i++)
+		if (pstarted[i])
+			pthread_join(pthreads[i], NULL);
+	free(pstarted);
+	free(pthreads);
+}
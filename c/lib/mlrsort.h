@@ -0,0 +1,44 @@
+// ================================================================
+// Stable sort of an array of pointers, optionally on several threads.
+//
+// Unlike qsort, the comparator gets a context pointer, so there are no globals
+// and sorts can run concurrently. Items which compare equal keep their
+// original order. On n threads the array is cut into n chunks, each sorted on
+// its own thread; then pairs of sorted chunks are merged, with each merge
+// itself split across the threads, until one run is left.
+// ================================================================
+
+#ifndef MLRSORT_H
+#define MLRSORT_H
+
+#include <stddef.h>
+
+// Same contract as for qsort: negative, zero, or positive.
+typedef int mlr_sort_comparator_t(void* pva, void* pvb, void* pvcontext);
+
+// Small arrays are sorted on the calling thread regardless of num_threads.
+void mlr_sort_pointers(void** items, long long num_items, mlr_sort_comparator_t* pcomparator,
+	void* pvcontext, int num_threads);
+
+// ----------------------------------------------------------------
+// Normalized sort key: a byte string which compares as by memcmp, with a key
+// sorting before any longer key it's a prefix of. Callers encode whatever they
+// sort on this way, so that one comparison, or a radix sort, does for all of
+// it. The first eight bytes are kept inline, so that most comparisons needn't
+// look at the bytes at all.
+typedef struct _mlr_sort_key_t {
+	unsigned long long prefix; // First eight bytes, big-endian, zero-padded
+	unsigned char*     bytes;
+	size_t             length;
+} mlr_sort_key_t;
+
+// The bytes remain owned by the caller.
+void mlr_sort_key_set(mlr_sort_key_t* pkey, unsigned char* bytes, size_t length);
+int  mlr_sort_key_compare(mlr_sort_key_t* pa, mlr_sort_key_t* pb);
+
+// Stable sort of pointers to items each starting with an mlr_sort_key_t: MSD
+// radix sort, then on more than one thread the same merging of chunks as
+// above.
+void mlr_sort_pointers_by_key(void** items, long long num_items, int num_threads);
+
+#endif // MLRSORT_H
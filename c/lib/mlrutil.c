@@ -2,6 +2,10 @@
 #include <string.h>
 #include <unistd.h>
 #include <ctype.h>
+#include <float.h>
+#include <math.h>
+#include <strings.h>
+#include <limits.h>
 #include <sys/stat.h>
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
@@ -124,24 +128,197 @@ char * mlr_strdup_quoted_or_die(const char *s1) {
 // ----------------------------------------------------------------
 // The caller should free the return value from each of these.
 
-char* mlr_alloc_string_from_double(double value, char* fmt) {
-	int n = snprintf(NULL, 0, fmt, value);
+// ----------------------------------------------------------------
+// Number-formatting for output. Nearly every computed value goes through here.
+//
+// Ints are written digit by digit. Doubles with fixed-point formats such as the
+// default "%lf", or "%.4lf", are formatted without printf: a finite double is
+// M * 2^k with M a 53-bit integer, so for k <= 0 the value times 10^precision
+// is the 128-bit product M * 10^precision shifted right by -k, and the
+// shifted-out bits say exactly how to round. Ties round to even as glibc's
+// printf does. Other formats, and doubles of magnitude 2^53 and above, go to
+// snprintf. Either way the string is written to a buffer on the stack and
+// allocated once at the right size.
+
+#define FIXED_FORMAT_MAX_PRECISION 18
+#define FORMAT_BUFFER_SIZE         64
+
+static const unsigned long long ull_powers_of_ten[] = {
+	1ULL,
+	10ULL,
+	100ULL,
+	1000ULL,
+	10000ULL,
+	100000ULL,
+	1000000ULL,
+	10000000ULL,
+	100000000ULL,
+	1000000000ULL,
+	10000000000ULL,
+	100000000000ULL,
+	1000000000000ULL,
+	10000000000000ULL,
+	100000000000000ULL,
+	1000000000000000ULL,
+	10000000000000000ULL,
+	100000000000000000ULL,
+	1000000000000000000ULL,
+};
+
+void mlr_double_format_init(double_format_t* pformat, char* fmt) {
+	pformat->fmt = fmt;
+	pformat->fixed_precision = -1;
+#ifdef __SIZEOF_INT128__
+	if (fmt == NULL || fmt[0] != '%')
+		return;
+	char* p = &fmt[1];
+	int precision = 6;
+	if (*p == '.') {
+		p++;
+		if (!isdigit((unsigned char)*p))
+			return;
+		precision = 0;
+		for ( ; isdigit((unsigned char)*p); p++) {
+			precision = 10 * precision + (*p - '0');
+			if (precision > FIXED_FORMAT_MAX_PRECISION)
+				return;
+		}
+	}
+	if (*p == 'l')
+		p++;
+	if (p[0] == 'f' && p[1] == 0)
+		pformat->fixed_precision = precision;
+#endif
+}
+
+// Writes digits right-justified ending just before pend; returns the start.
+static char* write_ull_backward(char* pend, unsigned long long value) {
+	char* p = pend;
+	do {
+		*--p = '0' + (value % 10);
+		value /= 10;
+	} while (value != 0ULL);
+	return p;
+}
+
+static int write_ull(char* buf, unsigned long long value) {
+	char digits[24];
+	char* pend = &digits[sizeof(digits)];
+	char* pstart = write_ull_backward(pend, value);
+	int n = pend - pstart;
+	memcpy(buf, pstart, n);
+	buf[n] = 0;
+	return n;
+}
+
+static int write_ll(char* buf, long long value) {
+	if (value < 0LL) {
+		buf[0] = '-';
+		return 1 + write_ull(&buf[1], -(unsigned long long)value);
+	} else {
+		return write_ull(buf, value);
+	}
+}
+
+// Returns the string length, or -1 if the value needs snprintf.
+static int write_double_fixed(char* buf, double value, int precision) {
+#ifdef __SIZEOF_INT128__
+	if (!isfinite(value))
+		return -1;
+	double magnitude = fabs(value);
+	if (magnitude >= 9007199254740992.0) // 2^53
+		return -1;
+
+	unsigned long long scale = ull_powers_of_ten[precision];
+	unsigned long long scaled_integer_part, scaled_fraction;
+	if (magnitude == 0.0) {
+		scaled_integer_part = 0ULL;
+		scaled_fraction = 0ULL;
+	} else {
+		int exponent;
+		double f = frexp(magnitude, &exponent);     // magnitude = f * 2^exponent, 0.5 <= f < 1
+		unsigned long long mantissa = (unsigned long long)ldexp(f, 53);
+		int shift = 53 - exponent;                  // magnitude = mantissa / 2^shift, shift >= 0
+
+		unsigned __int128 product = (unsigned __int128)mantissa * scale;
+		unsigned __int128 q;
+		if (shift == 0) {
+			q = product;
+		} else if (shift >= 128) {
+			q = 0; // product < 2^113 so this is less than half a unit
+		} else {
+			q = product >> shift;
+			unsigned __int128 remainder = product - (q << shift);
+			unsigned __int128 half = (unsigned __int128)1 << (shift - 1);
+			if (remainder > half || (remainder == half && (q & 1)))
+				q++;
+		}
+		scaled_integer_part = (unsigned long long)(q / scale);
+		scaled_fraction = (unsigned long long)(q % scale);
+	}
+
+	char* p = buf;
+	if (signbit(value))
+		*p++ = '-';
+	p += write_ull(p, scaled_integer_part);
+	if (precision > 0) {
+		*p++ = '.';
+		char* pend = p + precision;
+		char* pstart = write_ull_backward(pend, scaled_fraction);
+		while (pstart > p)
+			*--pstart = '0';
+		p = pend;
+	}
+	*p = 0;
+	return p - buf;
+#else
+	return -1;
+#endif
+}
+
+int mlr_write_double(char* buf, int bufsize, double value, double_format_t* pformat) {
+	if (pformat->fixed_precision >= 0 && bufsize >= FORMAT_BUFFER_SIZE) {
+		int n = write_double_fixed(buf, value, pformat->fixed_precision);
+		if (n >= 0)
+			return n;
+	}
+	return snprintf(buf, bufsize, pformat->fmt, value);
+}
+
+char* mlr_alloc_string_from_double_with_format(double value, double_format_t* pformat) {
+	char buf[FORMAT_BUFFER_SIZE];
+	int n = mlr_write_double(buf, sizeof(buf), value, pformat);
 	char* string = mlr_malloc_or_die(n+1);
-	sprintf(string, fmt, value);
+	if (n < (int)sizeof(buf))
+		memcpy(string, buf, n+1);
+	else
+		sprintf(string, pformat->fmt, value);
 	return string;
 }
 
+char* mlr_alloc_string_from_double(double value, char* fmt) {
+	if (fmt == MLR_GLOBALS.ofmt) {
+		return mlr_alloc_string_from_double_with_format(value, &MLR_GLOBALS.ofmt_format);
+	} else {
+		double_format_t format;
+		mlr_double_format_init(&format, fmt);
+		return mlr_alloc_string_from_double_with_format(value, &format);
+	}
+}
+
 char* mlr_alloc_string_from_ull(unsigned long long value) {
-	int n = snprintf(NULL, 0, "%llu", value);
+	char buf[FORMAT_BUFFER_SIZE];
+	int n = write_ull(buf, value);
 	char* string = mlr_malloc_or_die(n+1);
-	sprintf(string, "%llu", value);
+	memcpy(string, buf, n+1);
 	return string;
 }
 
 char* mlr_alloc_string_from_ll(long long value) {
-	int n = snprintf(NULL, 0, "%lld", value);
+	char buf[FORMAT_BUFFER_SIZE];
+	int n = write_ll(buf, value);
 	char* string = mlr_malloc_or_die(n+1);
-	sprintf(string, "%lld", value);
+	memcpy(string, buf, n+1);
 	return string;
 }
 
@@ -153,10 +330,7 @@ char* mlr_alloc_string_from_ll_and_format(long long value, char* fmt) {
 }
 
 char* mlr_alloc_string_from_int(int value) {
-	int n = snprintf(NULL, 0, "%d", value);
-	char* string = mlr_malloc_or_die(n+1);
-	sprintf(string, "%d", value);
-	return string;
+	return mlr_alloc_string_from_ll(value);
 }
 
 char* mlr_alloc_string_from_char_range(char* start, int num_bytes) {
@@ -180,6 +354,194 @@ char* mlr_alloc_string_from_string_and_format(char* old_value, char* fmt) {
 	return new_value;
 }
 
+// ----------------------------------------------------------------
+// Number-parsing for type inference. Every field value which is used as a
+// number comes through here, so the usual forms are scanned by hand rather
+// than via sscanf's format-string interpreter:
+//
+// * Decimal ints with optional sign and no leading zero, of up to 18 digits.
+// * Hex ints "0x..." of up to 16 hex digits, which wrap to negative when the
+//   high bit is set, as with "%llx".
+// * Decimal floats with optional sign, fraction, and exponent. If the
+//   significand fits in 53 bits and the power of ten is at most 22 in
+//   magnitude, both are exact doubles and a single multiply or divide gives the
+//   correctly rounded result (Clinger's fast path). Other decimal floats go to
+//   strtod, which is also correctly rounded.
+//
+// Anything else -- leading whitespace, leading-zero octal, int overflow, hex
+// floats, inf/NaN, and partial forms such as "1e" -- goes to sscanf as before,
+// so the accepted strings are exactly the ones "%lli", "%llx" and "%lf" accept.
+
+#define FAST_INT_MAX_DIGITS   18
+#define FAST_HEX_MAX_DIGITS   16
+#define FAST_FLOAT_MAX_DIGITS 19
+#define FAST_FLOAT_MAX_POW10  22
+
+#define FAST_NO    0
+#define FAST_YES   1
+#define FAST_PUNT -1 // Let sscanf decide
+
+static const double exact_powers_of_ten[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline int is_decimal_digit(char c) {
+	return '0' <= c && c <= '9';
+}
+
+static inline int hex_digit_value(char c) {
+	if ('0' <= c && c <= '9')
+		return c - '0';
+	if ('a' <= c && c <= 'f')
+		return c - 'a' + 10;
+	if ('A' <= c && c <= 'F')
+		return c - 'A' + 10;
+	return -1;
+}
+
+static int try_int_from_string_fast(char* string, long long* pval) {
+	char* p = string;
+
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) {
+		unsigned long long u = 0ULL;
+		int ndigits = 0;
+		for (p += 2; *p; p++, ndigits++) {
+			int d = hex_digit_value(*p);
+			if (d < 0)
+				return ndigits == 0 ? FAST_PUNT : FAST_NO;
+			if (ndigits == FAST_HEX_MAX_DIGITS)
+				return FAST_PUNT;
+			u = (u << 4) | d;
+		}
+		if (ndigits == 0)
+			return FAST_PUNT;
+		*pval = (long long)u;
+		return FAST_YES;
+	}
+
+	int negate = FALSE;
+	if (*p == '-') {
+		negate = TRUE;
+		p++;
+	} else if (*p == '+') {
+		p++;
+	} else if (isspace((unsigned char)*p)) {
+		return FAST_PUNT;
+	}
+	if (!is_decimal_digit(*p))
+		return FAST_NO;
+	if (p[0] == '0' && p[1] != 0) // Octal, or hex after a sign
+		return FAST_PUNT;
+
+	long long v = 0LL;
+	int ndigits = 0;
+	for ( ; *p; p++, ndigits++) {
+		if (!is_decimal_digit(*p))
+			return FAST_NO;
+		if (ndigits == FAST_INT_MAX_DIGITS)
+			return FAST_PUNT;
+		v = 10 * v + (*p - '0');
+	}
+	*pval = negate ? -v : v;
+	return FAST_YES;
+}
+
+static int try_float_from_string_fast(char* string, double* pval) {
+	char* p = string;
+
+	int negate = FALSE;
+	if (*p == '-') {
+		negate = TRUE;
+		p++;
+	} else if (*p == '+') {
+		p++;
+	} else if (isspace((unsigned char)*p)) {
+		return FAST_PUNT;
+	}
+
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+		return FAST_PUNT;
+	if (!is_decimal_digit(*p) && *p != '.') {
+		if (strncasecmp(p, "inf", 3) == 0 || strncasecmp(p, "nan", 3) == 0)
+			return FAST_PUNT;
+		return FAST_NO;
+	}
+
+	// Significand, with leading zeroes skipped
+	unsigned long long mantissa = 0ULL;
+	int num_significant_digits = 0;
+	int num_mantissa_digits = 0;
+	int is_exact = TRUE;
+	int exponent = 0;
+	int seen_point = FALSE;
+	for ( ; ; p++) {
+		if (is_decimal_digit(*p)) {
+			num_mantissa_digits++;
+			if (mantissa == 0ULL && *p == '0') {
+				if (seen_point)
+					exponent--;
+			} else if (num_significant_digits < FAST_FLOAT_MAX_DIGITS) {
+				mantissa = 10 * mantissa + (*p - '0');
+				num_significant_digits++;
+				if (seen_point)
+					exponent--;
+			} else {
+				is_exact = FALSE;
+			}
+		} else if (*p == '.' && !seen_point) {
+			seen_point = TRUE;
+		} else {
+			break;
+		}
+	}
+	if (num_mantissa_digits == 0)
+		return FAST_PUNT;
+
+	if (*p == 'e' || *p == 'E') {
+		p++;
+		int negate_exponent = FALSE;
+		if (*p == '-') {
+			negate_exponent = TRUE;
+			p++;
+		} else if (*p == '+') {
+			p++;
+		}
+		if (!is_decimal_digit(*p))
+			return FAST_PUNT;
+		int e = 0;
+		for ( ; is_decimal_digit(*p); p++) {
+			if (e < 100000)
+				e = 10 * e + (*p - '0');
+		}
+		exponent += negate_exponent ? -e : e;
+	}
+
+	if (*p != 0) // Trailing garbage
+		return FAST_NO;
+
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+	if (is_exact && mantissa <= (1ULL << 53)
+		&& -FAST_FLOAT_MAX_POW10 <= exponent && exponent <= FAST_FLOAT_MAX_POW10)
+	{
+		double d = (double)mantissa;
+		if (exponent < 0)
+			d /= exact_powers_of_ten[-exponent];
+		else
+			d *= exact_powers_of_ten[exponent];
+		*pval = negate ? -d : d;
+		return FAST_YES;
+	}
+#endif
+
+	char* endptr = NULL;
+	double d = strtod(string, &endptr);
+	if (*endptr != 0)
+		return FAST_PUNT;
+	*pval = d;
+	return FAST_YES;
+}
+
 double mlr_double_from_string_or_die(char* string) {
 	double d;
 	if (!mlr_try_float_from_string(string, &d)) {
@@ -192,6 +554,10 @@ double mlr_double_from_string_or_die(char* string) {
 
 // E.g. "300" is a number; "300ms" is not.
 int mlr_try_float_from_string(char* string, double* pval) {
+	int rv = try_float_from_string_fast(string, pval);
+	if (rv != FAST_PUNT)
+		return rv;
+
 	int num_bytes_scanned;
 	int rc = sscanf(string, "%lf%n", pval, &num_bytes_scanned);
 	if (rc != 1)
@@ -212,6 +578,10 @@ long long mlr_int_from_string_or_die(char* string) {
 
 // E.g. "300" is a number; "300ms" is not.
 int mlr_try_int_from_string(char* string, long long* pval) {
+	int rv = try_int_from_string_fast(string, pval);
+	if (rv != FAST_PUNT)
+		return rv;
+
 	int num_bytes_scanned, rc;
 	// sscanf with %li / %lli doesn't scan correctly when the high bit is set
 	// on hex input; it just returns max signed. So we need to special-case hex
@@ -228,6 +598,31 @@ int mlr_try_int_from_string(char* string, long long* pval) {
 	return 1;
 }
 
+// ----------------------------------------------------------------
+int mlr_try_byte_count_from_string(char* string, long long* pval) {
+	char* p = string;
+	long long value = 0LL;
+	if (!isdigit((unsigned char)*p))
+		return FALSE;
+	for ( ; isdigit((unsigned char)*p); p++) {
+		if (value > (LLONG_MAX - 9) / 10)
+			return FALSE;
+		value = 10 * value + (*p - '0');
+	}
+
+	int shift = 0;
+	switch (*p) {
+	case 'k': case 'K': shift = 10; p++; break;
+	case 'm': case 'M': shift = 20; p++; break;
+	case 'g': case 'G': shift = 30; p++; break;
+	case 't': case 'T': shift = 40; p++; break;
+	}
+	if (*p != 0 || value == 0LL || value > (LLONG_MAX >> shift))
+		return FALSE;
+	*pval = value << shift;
+	return TRUE;
+}
+
 // ----------------------------------------------------------------
 static char* low_int_to_string_data[] = {
 	"0",   "1",  "2",  "3",  "4",  "5",  "6",  "7",  "8",  "9",
@@ -304,27 +699,95 @@ char* mlr_paste_5_strings(char* s1, char* s2, char* s3, char* s4, char* s5) {
 }
 
 // ----------------------------------------------------------------
-// This is djb2.
-int mlr_string_hash_func(char *str) {
-	unsigned long hash = 5381;
-	int c;
+// String hashing for the hash maps in c/containers. The bytes are read eight
+// at a time and mixed with 64x64-to-128-bit multiplies, in the manner of
+// wyhash. This is much faster than a byte-at-a-time hash on long keys, and
+// well-distributed enough in the low bits for the maps' linear probing.
+
+#define HASH_SEED 0xa0761d6478bd642fULL
+#define HASH_K1   0xe7037ed1a0b428dbULL
+#define HASH_K2   0x8ebc6af09c88c6e3ULL
+
+static inline unsigned long long hash_mix(unsigned long long a, unsigned long long b) {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 r = (unsigned __int128)a * b;
+	return (unsigned long long)r ^ (unsigned long long)(r >> 64);
+#else
+	unsigned long long ha = a >> 32, la = (unsigned int)a, hb = b >> 32, lb = (unsigned int)b;
+	unsigned long long rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+	unsigned long long t = rl + (rm0 << 32);
+	unsigned long long c = t < rl;
+	unsigned long long lo = t + (rm1 << 32);
+	c += lo < t;
+	unsigned long long hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+	return lo ^ hi;
+#endif
+}
 
-	while ((c = *str++) != 0)
-		hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+static inline unsigned long long hash_read8(const char* p) {
+	unsigned long long v;
+	memcpy(&v, p, 8);
+	return v;
+}
 
-	return (int)hash;
+static inline unsigned long long hash_read4(const char* p) {
+	unsigned int v;
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static unsigned long long hash_bytes(const char* p, size_t len, unsigned long long seed) {
+	unsigned long long a, b;
+	seed ^= hash_mix(seed ^ HASH_SEED, len ^ HASH_K1);
+	if (len <= 16) {
+		if (len >= 8) {
+			a = hash_read8(p);
+			b = hash_read8(p + len - 8);
+		} else if (len >= 4) {
+			a = hash_read4(p);
+			b = hash_read4(p + len - 4);
+		} else if (len > 0) {
+			a = ((unsigned long long)(unsigned char)p[0] << 16)
+				| ((unsigned long long)(unsigned char)p[len >> 1] << 8)
+				| (unsigned char)p[len - 1];
+			b = 0ULL;
+		} else {
+			a = b = 0ULL;
+		}
+	} else {
+		size_t i = len;
+		while (i > 16) {
+			seed = hash_mix(hash_read8(p) ^ HASH_K1, hash_read8(p + 8) ^ seed);
+			p += 16;
+			i -= 16;
+		}
+		a = hash_read8(p + i - 16);
+		b = hash_read8(p + i - 8);
+	}
+	return hash_mix(HASH_K1 ^ len, hash_mix(a ^ HASH_K1, b ^ seed) ^ HASH_K2);
+}
+
+static inline int hash_to_int(unsigned long long h) {
+	return (int)(h ^ (h >> 32));
+}
+
+int mlr_string_hash_func(char *str) {
+	return hash_to_int(hash_bytes(str, strlen(str), 0ULL));
 }
 
 int mlr_string_pair_hash_func(char* str1, char* str2) {
-	unsigned long hash = 5381;
-	int c;
+	unsigned long long h = hash_bytes(str1, strlen(str1), 0ULL);
+	return hash_to_int(hash_bytes(str2, strlen(str2), h));
+}
 
-	while ((c = *str1++) != 0)
-		hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
-	while ((c = *str2++) != 0)
-		hash = ((hash << 5) + hash) + c; /* hash * 33 + c */
+// For keys made of several strings, e.g. group-by values: hash each in turn,
+// seeding with the hash so far. The seed for the first is zero.
+unsigned long long mlr_string_hash_continue(char* str, unsigned long long seed) {
+	return hash_bytes(str, strlen(str), seed);
+}
 
-	return (int)hash;
+int mlr_string_hash_finish(unsigned long long hash) {
+	return hash_to_int(hash);
 }
 
 // ----------------------------------------------------------------
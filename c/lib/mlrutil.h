@@ -96,8 +96,20 @@ static inline char * mlr_strdup_or_die(const char *s1) {
 }
 char * mlr_strdup_quoted_or_die(const char *s1);
 
+// A printf-style format for doubles, e.g. from --ofmt or fmtnum, examined once
+// so that fixed-point formats such as "%lf" or "%.4lf" can be written without
+// printf.
+typedef struct _double_format_t {
+	char* fmt;
+	int   fixed_precision; // -1 if fmt isn't fixed-point
+} double_format_t;
+void mlr_double_format_init(double_format_t* pformat, char* fmt);
+// Same return value as snprintf.
+int mlr_write_double(char* buf, int bufsize, double value, double_format_t* pformat);
+
 // The caller should free the return values from each of these.
 char* mlr_alloc_string_from_double(double value, char* fmt);
+char* mlr_alloc_string_from_double_with_format(double value, double_format_t* pformat);
 char* mlr_alloc_string_from_ull(unsigned long long value);
 char* mlr_alloc_string_from_ll(long long value);
 char* mlr_alloc_string_from_ll_and_format(long long value, char* fmt);
@@ -112,6 +124,8 @@ double mlr_double_from_string_or_die(char* string);
 long long mlr_int_from_string_or_die(char* string);
 int    mlr_try_float_from_string(char* string, double* pval);
 int    mlr_try_int_from_string(char* string, long long* pval);
+// E.g. "500", "64k", "500M", or "4G", with suffixes in powers of 1024. Must be positive.
+int    mlr_try_byte_count_from_string(char* string, long long* pval);
 
 // For small integers (as of this writing, 0 .. 100) returns a static string representation.
 // For other values, returns a dynamically allocated string representation.
@@ -125,6 +139,9 @@ char* mlr_paste_5_strings(char* s1, char* s2, char* s3, char* s4, char* s5);
 
 int mlr_string_hash_func(char *str);
 int mlr_string_pair_hash_func(char* str1, char* str2);
+// For hashing a sequence of strings: start with a seed of zero.
+unsigned long long mlr_string_hash_continue(char* str, unsigned long long seed);
+int mlr_string_hash_finish(unsigned long long hash);
 
 int strlen_for_utf8_display(char* str);
 int string_starts_with(char* string, char* prefix);
@@ -42,6 +42,7 @@
 #include <stdio.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <pthread.h>
 #include "lib/mtrand.h"
 
 // ----------------------------------------------------------------
@@ -55,6 +56,13 @@
 static unsigned mt[N];        // the array for the state vector
 static int mti=N+1;           // mti==N+1 means mt[N] is not initialized
 
+// With --pipeline, verbs (and DSL urand calls) on separate threads share the
+// one generator, so the state is locked.
+static pthread_mutex_t mt_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void mtrand_init_unlocked(unsigned s);
+static unsigned get_mtrand_int32_unlocked(void);
+
 // ----------------------------------------------------------------
 void mtrand_init_default()
 {
@@ -66,6 +74,13 @@ void mtrand_init_default()
 // ----------------------------------------------------------------
 // Initializes mt[N] with a seed.
 void mtrand_init(unsigned s)
+{
+	pthread_mutex_lock(&mt_mutex);
+	mtrand_init_unlocked(s);
+	pthread_mutex_unlock(&mt_mutex);
+}
+
+static void mtrand_init_unlocked(unsigned s)
 {
 	mt[0]= s & 0xffffffff;
 	for (mti=1; mti<N; mti++) {
@@ -85,7 +100,8 @@ void mtrand_init(unsigned s)
 void mtrand_init_from_array(unsigned init_key[], int key_length)
 {
 	int i, j, k;
-	mtrand_init(19650218);
+	pthread_mutex_lock(&mt_mutex);
+	mtrand_init_unlocked(19650218);
 	i=1; j=0;
 	k = (N>key_length ? N : key_length);
 	for (; k; k--) {
@@ -105,11 +121,20 @@ void mtrand_init_from_array(unsigned init_key[], int key_length)
 	}
 
 	mt[0] = 0x80000000; // MSB is 1, ensuring non-zero initial array
+	pthread_mutex_unlock(&mt_mutex);
 }
 
 // ----------------------------------------------------------------
 // Generates a uniformly distributed 32-bit integer.
 unsigned get_mtrand_int32(void)
+{
+	pthread_mutex_lock(&mt_mutex);
+	unsigned y = get_mtrand_int32_unlocked();
+	pthread_mutex_unlock(&mt_mutex);
+	return y;
+}
+
+static unsigned get_mtrand_int32_unlocked(void)
 {
 	unsigned y;
 	static unsigned mag01[2]={0x0, MATRIX_A};
@@ -119,7 +144,7 @@ unsigned get_mtrand_int32(void)
 		int kk;
 
 		if (mti == N+1)   // If mtrand_init() has not been called,
-			mtrand_init(5489); // a default initial seed is used.
+			mtrand_init_unlocked(5489); // a default initial seed is used.
 
 		for (kk=0;kk<N-M;kk++) {
 			y = (mt[kk]&UPPER_MASK)|(mt[kk+1]&LOWER_MASK);
@@ -165,7 +190,10 @@ double get_mtrand_float(void)
 // Generates a random number on [0,1) with 53-bit resolution.
 double get_mtrand_double(void)
 {
-	unsigned a = get_mtrand_int32() >> 5;
-	unsigned b = get_mtrand_int32() >> 6;
+	// Both halves under one lock so another thread can't take a draw between them.
+	pthread_mutex_lock(&mt_mutex);
+	unsigned a = get_mtrand_int32_unlocked() >> 5;
+	unsigned b = get_mtrand_int32_unlocked() >> 6;
+	pthread_mutex_unlock(&mt_mutex);
 	return (a*67108864.0+b) * (1.0/9007199254740992.0);
 }
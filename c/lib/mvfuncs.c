@@ -2094,6 +2094,17 @@ static mv_binary_func_t* fmtnum_dispositions[MT_DIM] = {
 
 mv_t s_xs_fmtnum_func(mv_t* pval1, mv_t* pval2) { return (fmtnum_dispositions[pval1->type])(pval1, pval2); }
 
+mv_t s_xf_fmtnum_precomp_func(mv_t* pval1, double_format_t* pformat) {
+	switch (pval1->type) {
+	case MT_INT:
+		return mv_from_string_with_free(mlr_alloc_string_from_ll_and_format(pval1->u.intv, pformat->fmt));
+	case MT_FLOAT:
+		return mv_from_string_with_free(mlr_alloc_string_from_double_with_format(pval1->u.fltv, pformat));
+	default:
+		return (fmtnum_dispositions[pval1->type])(pval1, NULL);
+	}
+}
+
 // ----------------------------------------------------------------
 static mv_t eq_b_ii(mv_t* pa, mv_t* pb) { return mv_from_bool(pa->u.intv == pb->u.intv); }
 static mv_t ne_b_ii(mv_t* pa, mv_t* pb) { return mv_from_bool(pa->u.intv != pb->u.intv); }
@@ -150,6 +150,8 @@ mv_t s_x_string_func(mv_t* pval1);
 mv_t s_sii_substr_func(mv_t* pval1, mv_t* pval2, mv_t* pval3);
 mv_t s_x_hexfmt_func(mv_t* pval1);
 mv_t s_xs_fmtnum_func(mv_t* pval1, mv_t* pval2);
+// With the format examined ahead of time: see mlr_double_format_init.
+mv_t s_xf_fmtnum_precomp_func(mv_t* pval1, double_format_t* pformat);
 
 // ----------------------------------------------------------------
 static inline mv_t f_ff_atan2_func(mv_t* pval1, mv_t* pval2) {
@@ -6,6 +6,7 @@
 #include "cli/mlrcli.h"
 #include "containers/lrec.h"
 #include "containers/sllv.h"
+#include "containers/lrec_batch.h"
 
 // See ../README.md for memory-management conventions.
 
@@ -15,14 +16,30 @@
 struct _mapper_t; // forward reference for method declarations
 
 // Returns linked list of records (lrec_t*).
+//
+// At end of stream (null input record) a mapper with a lot of output, e.g. an
+// external sort, may return it a piece at a time: it sets pctx->more_output,
+// leaves the null off the end of the list, and is called again with null for
+// the next piece.
 typedef sllv_t* mapper_process_func_t(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
+// Optional batch entry point, used by stream.c when every mapper in the chain
+// has one. Appends the output records for all of pinbatch to poutbatch, in the
+// order the single-record entry point would have produced them, each with the
+// NR and FNR of the input record it came from. The input records are never
+// null: end of stream is always sent through pprocess_func. The context has
+// FILENAME etc. for the batch; mappers needing NR or FNR take them from the
+// batch entries.
+typedef void mapper_process_batch_func_t(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch, context_t* pctx,
+	void* pvstate);
+
 typedef void mapper_free_func_t(struct _mapper_t* pmapper, context_t* pctx);
 
 typedef struct _mapper_t {
 	void* pvstate;
-	mapper_process_func_t* pprocess_func;
-	mapper_free_func_t*    pfree_func; // virtual destructor
+	mapper_process_func_t*       pprocess_func;
+	mapper_process_batch_func_t* pprocess_batch_func; // null if not supported
+	mapper_free_func_t*          pfree_func; // virtual destructor
 } mapper_t;
 
 // ----------------------------------------------------------------
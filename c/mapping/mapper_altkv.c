@@ -61,6 +61,7 @@ static mapper_t* mapper_altkv_alloc(ap_state_t* pargp) {
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_altkv_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_altkv_free;
 
 	return pmapper;
@@ -168,6 +168,7 @@ static mapper_t* mapper_bar_alloc(ap_state_t* pargp, string_array_t* pfield_name
 		? mapper_bar_process_auto
 		: mapper_bar_process_no_auto;
 	pmapper->pvstate    = (void*)pstate;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_bar_free;
 
 	return pmapper;
@@ -3,19 +3,22 @@
 #include "lib/mlrutil.h"
 #include "lib/mtrand.h"
 #include "containers/sllv.h"
+#include "containers/lrec_store.h"
 #include "mapping/mappers.h"
 
 #define NOUT_EQUALS_NIN -1
 typedef struct _mapper_bootstrap_state_t {
-	ap_state_t* pargp;
-	int nout;
-	sllv_t* records;
+	ap_state_t*   pargp;
+	int           nout;
+	lrec_store_t* pstore;
+	long long*    indices;    // The sample, at end of stream
+	long long     num_output; // At end of stream
 } mapper_bootstrap_state_t;
 
 static void      mapper_bootstrap_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_bootstrap_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
-static mapper_t* mapper_bootstrap_alloc(int nout, ap_state_t* pargp);
+static mapper_t* mapper_bootstrap_alloc(int nout, ap_state_t* pargp, long long mem_budget, char* tmpdir);
 static void      mapper_bootstrap_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_bootstrap_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -34,6 +37,9 @@ static void mapper_bootstrap_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "Options:\n");
 	fprintf(o, "-n {number} Number of samples to output. Defaults to number of input records.\n");
 	fprintf(o, "            Must be non-negative.\n");
+	fprintf(o, "--mem {size}   Memory budget for the records held, e.g. 500M or 4G. Past it,\n");
+	fprintf(o, "               they are written to a temporary file. Default: no limit.\n");
+	fprintf(o, "--tmpdir {dir} Directory for that file. Default: $TMPDIR, else /tmp.\n");
 	fprintf(o, "See also %s sample and %s shuffle.\n", argv0, argv0);
 }
 
@@ -41,6 +47,9 @@ static mapper_t* mapper_bootstrap_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __)
 {
 	int nout = NOUT_EQUALS_NIN;
+	char* mem_budget_string = NULL;
+	char* tmpdir = NULL;
+	long long mem_budget = 0LL;
 	if ((argc - *pargi) < 1) {
 		mapper_bootstrap_usage(stderr, argv[0], argv[*pargi]);
 		return NULL;
@@ -50,7 +59,9 @@ static mapper_t* mapper_bootstrap_parse_cli(int* pargi, int argc, char** argv,
 	*pargi += 1;
 
 	ap_state_t* pstate = ap_alloc();
-	ap_define_int_flag(pstate, "-n", &nout);
+	ap_define_int_flag(pstate,    "-n",       &nout);
+	ap_define_string_flag(pstate, "--mem",    &mem_budget_string);
+	ap_define_string_flag(pstate, "--tmpdir", &tmpdir);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_bootstrap_usage(stderr, argv[0], verb);
@@ -61,22 +72,29 @@ static mapper_t* mapper_bootstrap_parse_cli(int* pargi, int argc, char** argv,
 		mapper_bootstrap_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (mem_budget_string != NULL && !mlr_try_byte_count_from_string(mem_budget_string, &mem_budget)) {
+		mapper_bootstrap_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
-	mapper_t* pmapper = mapper_bootstrap_alloc(nout, pstate);
+	mapper_t* pmapper = mapper_bootstrap_alloc(nout, pstate, mem_budget, tmpdir);
 	return pmapper;
 }
 
 // ----------------------------------------------------------------
-static mapper_t* mapper_bootstrap_alloc(int nout, ap_state_t* pargp) {
+static mapper_t* mapper_bootstrap_alloc(int nout, ap_state_t* pargp, long long mem_budget, char* tmpdir) {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
 	mapper_bootstrap_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_bootstrap_state_t));
-	pstate->nout    = nout;
-	pstate->pargp   = pargp;
-	pstate->records = sllv_alloc();
+	pstate->nout       = nout;
+	pstate->pargp      = pargp;
+	pstate->pstore     = lrec_store_alloc(mem_budget, tmpdir);
+	pstate->indices    = NULL;
+	pstate->num_output = 0LL;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_bootstrap_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_bootstrap_free;
 
 	return pmapper;
@@ -84,8 +102,8 @@ static mapper_t* mapper_bootstrap_alloc(int nout, ap_state_t* pargp) {
 
 static void mapper_bootstrap_free(mapper_t* pmapper, context_t* _) {
 	mapper_bootstrap_state_t* pstate = pmapper->pvstate;
-	// Free the container
-	sllv_free(pstate->records);
+	lrec_store_free(pstate->pstore);
+	free(pstate->indices);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -95,66 +113,38 @@ static void mapper_bootstrap_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_bootstrap_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_bootstrap_state_t* pstate = pvstate;
 	if (pinrec != NULL) { // Not end of input stream: consume an input record.
-		// The caller will free the outrecs
-		sllv_append(pstate->records, pinrec);
+		lrec_store_append(pstate->pstore, pinrec);
+		lrec_free(pinrec);
 		return NULL;
 	}
 
-	// This is entirely straightforward except for memory management. The
-	// Miller contract to respect is that each routine frees records or passes
-	// them on.  This means lrec-writers will free lrecs they receive, after
-	// writing them.  This also means we must free lrecs we don't pass on.
-	//
-	// Given nin input records, we produce nout output records, but sampling with replacement.
-	// The memory-management criteria above mean:
-	// * If an input lrec is not output at all, we must free it.
-	// * If an input lrec is output once, we pass it on through and let the write free it.
-	// * If an input lrec is output more than once, it would get double-freed (which is not OK)
-	//   so for all repetitions past the first we must make a copy.
-	// A used_flags[] array allows us to handle all of this.
-
-	sllv_t* poutrecs = sllv_alloc();
-	int nin = pstate->records->length;
-	int nout = (pstate->nout == NOUT_EQUALS_NIN) ? nin : pstate->nout;
-	if (nin == 0) {
-		sllv_append(poutrecs, NULL);
-		return poutrecs;
-	}
-
-	// Make an array of pointers into the input list. Mark each lrec as not yet output.
-	lrec_t** record_array = mlr_malloc_or_die(nin * sizeof(lrec_t**));
-	char* used_flags = mlr_malloc_or_die(nin * sizeof(char));
-	sllve_t* pe = pstate->records->phead;
-	for (int i = 0; i < nin; i++, pe = pe->pnext) {
-		record_array[i] = pe->pvvalue;
-		used_flags[i] = FALSE;
-	}
-
-	// Do the sample-with-replacment, reading from random indices in the input
-	// array and appending to the output list.
-	for (int i = 0; i < nout; i++) {
-		int index = nin * get_mtrand_double();
-		if (index >= nin)
-			index = nin - 1;
-		lrec_t* prec = record_array[index];
-		if (used_flags[index]) { // Copy for repeated output.
-			prec = lrec_copy(prec);
-		} else { // First output of this record; remember it.
-			used_flags[index] = TRUE;
+	// Given nin input records, we produce nout output records, but sampling
+	// with replacement. Since each read from the store is a new copy of the
+	// record, records output more than once need no special handling.
+	long long nin = pstate->pstore->num_records;
+	long long nout = (pstate->nout == NOUT_EQUALS_NIN) ? nin : pstate->nout;
+	if (nin == 0)
+		return sllv_single(NULL);
+
+	// Do the sample-with-replacement all at once, so that output is the same
+	// whatever else downstream draws random numbers between the pieces.
+	if (pstate->indices == NULL) {
+		pstate->indices = mlr_malloc_or_die((nout + 1) * sizeof(long long));
+		for (long long i = 0; i < nout; i++) {
+			long long index = nin * get_mtrand_double();
+			if (index >= nin)
+				index = nin - 1;
+			pstate->indices[i] = index;
 		}
-		sllv_append(poutrecs, prec);
 	}
 
-	// Free non-output records
-	pe = pstate->records->phead;
-	for (int i = 0; i < nin; i++, pe = pe->pnext)
-		if (!used_flags[i])
-			lrec_free(record_array[i]);
-	free(used_flags);
-	// Free the temp array
-	free(record_array);
-
-	// Null-terminate the output list to signify end of stream.
-	sllv_append(poutrecs, NULL);
+	// Output is a piece at a time.
+	sllv_t* poutrecs = sllv_alloc();
+	while (pstate->num_output < nout && poutrecs->length < LREC_STORE_OUTPUT_PIECE_SIZE)
+		sllv_append(poutrecs, lrec_store_get(pstate->pstore, pstate->indices[pstate->num_output++]));
+	if (pstate->num_output < nout)
+		pctx->more_output = TRUE;
+	else
+		sllv_append(poutrecs, NULL); // Null-terminate the output list to signify end of stream.
 	return poutrecs;
 }
@@ -11,6 +11,7 @@ typedef struct _mapper_cat_state_t {
 	char* counter_field_name;
 	unsigned long long counter;
 	slls_t* pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	lhmslv_t* pcounters_by_group;
 } mapper_cat_state_t;
 
@@ -25,6 +26,10 @@ static void      mapper_cat_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_cat_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_catn_process_ungrouped(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_catn_process_grouped(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_cat_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch, context_t* pctx,
+	void* pvstate);
+static void      mapper_catn_process_ungrouped_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_cat_setup = {
@@ -93,20 +98,24 @@ static mapper_t* mapper_cat_alloc(ap_state_t* pargp, int do_counters, int verbos
 	pstate->pargp                 = pargp;
 	pstate->verbose               = verbose;
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
+	pstate->pgroup_key            = group_key_alloc(pgroup_by_field_names);
 	pstate->counter_field_name    = counter_field_name;
 	pstate->counter               = 0LL;
 	pstate->pcounters_by_group    = lhmslv_alloc();
 	pmapper->pvstate              = pstate;
 
 	pmapper->pprocess_func = NULL;
+	pmapper->pprocess_batch_func = NULL;
 	if (do_counters) {
 		if (pgroup_by_field_names->length == 0) {
 			pmapper->pprocess_func = mapper_catn_process_ungrouped;
+			pmapper->pprocess_batch_func = mapper_catn_process_ungrouped_batch;
 		} else {
 			pmapper->pprocess_func = mapper_catn_process_grouped;
 		}
 	} else {
 		pmapper->pprocess_func = mapper_cat_process;
+		pmapper->pprocess_batch_func = mapper_cat_process_batch;
 	}
 
 	pmapper->pfree_func           = mapper_cat_free;
@@ -115,6 +124,7 @@ static mapper_t* mapper_cat_alloc(ap_state_t* pargp, int do_counters, int verbos
 static void mapper_cat_free(mapper_t* pmapper, context_t* _) {
 	mapper_cat_state_t* pstate = pmapper->pvstate;
 	slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 	for (lhmslve_t* pe = pstate->pcounters_by_group->phead; pe != NULL; pe = pe->pnext) {
 		free(pe->pvvalue);
 	}
@@ -136,6 +146,19 @@ static sllv_t* mapper_cat_process(lrec_t* pinrec, context_t* pctx, void* pvstate
 		return sllv_single(NULL);
 }
 
+static void mapper_cat_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch, context_t* pctx,
+	void* pvstate)
+{
+	mapper_cat_state_t* pstate = (mapper_cat_state_t*)pvstate;
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		if (pstate->verbose) {
+			lrec_dump_fp(pentry->prec, stderr);
+		}
+		lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+	}
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_catn_process_ungrouped(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_cat_state_t* pstate = (mapper_cat_state_t*)pvstate;
@@ -151,6 +174,21 @@ static sllv_t* mapper_catn_process_ungrouped(lrec_t* pinrec, context_t* pctx, vo
 	}
 }
 
+static void mapper_catn_process_ungrouped_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	mapper_cat_state_t* pstate = (mapper_cat_state_t*)pvstate;
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		if (pstate->verbose) {
+			lrec_dump_fp(pentry->prec, stderr);
+		}
+		char* counter_field_value = mlr_alloc_string_from_ull(++pstate->counter);
+		lrec_prepend(pentry->prec, pstate->counter_field_name, counter_field_value, FREE_ENTRY_VALUE);
+		lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+	}
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_catn_process_grouped(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_cat_state_t* pstate = (mapper_cat_state_t*)pvstate;
@@ -161,20 +199,18 @@ static sllv_t* mapper_catn_process_grouped(lrec_t* pinrec, context_t* pctx, void
 
 		unsigned long long counter = 0LL;
 
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values == NULL) { // Treat as unkeyed
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (!group_key_select(pgroup_key, pinrec)) { // Treat as unkeyed
 			counter = ++pstate->counter;
 		} else {
-			unsigned long long* pcount_for_group = lhmslv_get(pstate->pcounters_by_group,
-				pgroup_by_field_values);
+			unsigned long long* pcount_for_group = lhmslv_get_with_hash(pstate->pcounters_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (pcount_for_group == NULL) {
 				pcount_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount_for_group = 0LL;
-				lhmslv_put(pstate->pcounters_by_group, slls_copy(pgroup_by_field_values),
+				lhmslv_put_with_hash(pstate->pcounters_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
 					pcount_for_group, FREE_ENTRY_KEY);
 			}
-			slls_free(pgroup_by_field_values);
 			(*pcount_for_group)++;
 			counter = *pcount_for_group;
 		}
@@ -41,6 +41,7 @@ static mapper_t* mapper_check_alloc() {
 	mapper_t* pmapper      = mlr_malloc_or_die(sizeof(mapper_t));
 	pmapper->pvstate       = NULL;
 	pmapper->pprocess_func = mapper_check_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_check_free;
 	return pmapper;
 }
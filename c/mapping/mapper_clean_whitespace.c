@@ -91,6 +91,7 @@ static mapper_t* mapper_clean_whitespace_alloc(ap_state_t* pargp, int do_keys, i
 	} else if (do_values) {
 		pmapper->pprocess_func = mapper_clean_whitespace_vprocess;
 	}
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_clean_whitespace_free;
 
 	pmapper->pvstate = (void*)pstate;
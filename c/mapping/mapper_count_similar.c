@@ -9,17 +9,31 @@
 #include "containers/lhmsv.h"
 #include "containers/lhmsll.h"
 #include "containers/mixutil.h"
+#include "containers/lrec_store.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
 #define DEFAULT_OUTPUT_FIELD_NAME "count"
 
+// The group's records are in the store, at these indices.
+typedef struct _count_similar_group_t {
+	long long* pindices;
+	long long  count;
+	long long  capacity;
+} count_similar_group_t;
+
 typedef struct _mapper_count_similar_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
-	lhmslv_t* pcounts_by_group;
-	lhmslv_t* precord_lists_by_group;
+	group_key_t* pgroup_key;
+	lhmslv_t* pgroups; // count_similar_group_t*'s
+	lrec_store_t* pstore;
 	char* output_field_name;
+
+	// At end of stream, output is a piece at a time.
+	int        emitting;
+	lhmslve_t* pemitting_group;
+	long long  num_emitted_in_group;
 } mapper_count_similar_state_t;
 
 static void mapper_count_similar_usage(
@@ -37,7 +51,9 @@ static mapper_t* mapper_count_similar_parse_cli(
 static mapper_t* mapper_count_similar_alloc(
 	ap_state_t* pargp,
 	slls_t* pgroup_by_field_names,
-	char* output_field_name);
+	char* output_field_name,
+	long long mem_budget,
+	char* tmpdir);
 
 static void mapper_count_similar_free(
 	mapper_t* pmapper,
@@ -65,6 +81,9 @@ static void mapper_count_similar_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "-g {d,e,f} Group-by-field names for counts.\n");
 	fprintf(o, "-o {name}  Field name for output count. Default \"%s\".\n",
 		DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "--mem {size}   Memory budget for the records held, e.g. 500M or 4G. Past it,\n");
+	fprintf(o, "               they are written to a temporary file. Default: no limit.\n");
+	fprintf(o, "--tmpdir {dir} Directory for that file. Default: $TMPDIR, else /tmp.\n");
 }
 
 static mapper_t* mapper_count_similar_parse_cli(int* pargi, int argc, char** argv,
@@ -72,12 +91,17 @@ static mapper_t* mapper_count_similar_parse_cli(int* pargi, int argc, char** arg
 {
 	slls_t* pgroup_by_field_names = NULL;
 	char*   output_field_name = DEFAULT_OUTPUT_FIELD_NAME;
+	char*   mem_budget_string = NULL;
+	char*   tmpdir = NULL;
+	long long mem_budget = 0LL;
 
 	char* verb = argv[(*pargi)++];
 
 	ap_state_t* pstate = ap_alloc();
 	ap_define_string_list_flag(pstate, "-g", &pgroup_by_field_names);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
+	ap_define_string_flag(pstate,      "--mem",    &mem_budget_string);
+	ap_define_string_flag(pstate,      "--tmpdir", &tmpdir);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_count_similar_usage(stderr, argv[0], verb);
@@ -88,14 +112,18 @@ static mapper_t* mapper_count_similar_parse_cli(int* pargi, int argc, char** arg
 		mapper_count_similar_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (mem_budget_string != NULL && !mlr_try_byte_count_from_string(mem_budget_string, &mem_budget)) {
+		mapper_count_similar_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
 	return mapper_count_similar_alloc(pstate, pgroup_by_field_names,
-		output_field_name);
+		output_field_name, mem_budget, tmpdir);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_count_similar_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
-	char* output_field_name)
+	char* output_field_name, long long mem_budget, char* tmpdir)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -103,12 +131,17 @@ static mapper_t* mapper_count_similar_alloc(ap_state_t* pargp, slls_t* pgroup_by
 
 	pstate->pargp                  = pargp;
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
-	pstate->pcounts_by_group       = lhmslv_alloc();
-	pstate->precord_lists_by_group = lhmslv_alloc();
+	pstate->pgroup_key             = group_key_alloc(pgroup_by_field_names);
+	pstate->pgroups                = lhmslv_alloc();
+	pstate->pstore                 = lrec_store_alloc(mem_budget, tmpdir);
 	pstate->output_field_name      = output_field_name;
+	pstate->emitting               = FALSE;
+	pstate->pemitting_group        = NULL;
+	pstate->num_emitted_in_group   = 0LL;
 
 	pmapper->pvstate = pstate;
 	pmapper->pprocess_func = mapper_count_similar_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_count_similar_free;
 
 	return pmapper;
@@ -117,25 +150,19 @@ static mapper_t* mapper_count_similar_alloc(ap_state_t* pargp, slls_t* pgroup_by
 static void mapper_count_similar_free(mapper_t* pmapper, context_t* _) {
 	mapper_count_similar_state_t* pstate = pmapper->pvstate;
 	slls_free(pstate->pgroup_by_field_names);
-
-	// lhmslv_free will free the keys: we only need to free the void-star values.
-	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
-		unsigned long long* pcount = pa->pvvalue;
-		free(pcount);
-	}
-	lhmslv_free(pstate->pcounts_by_group);
+	group_key_free(pstate->pgroup_key);
 
 	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
-	for (lhmslve_t* pa = pstate->precord_lists_by_group->phead; pa != NULL; pa = pa->pnext) {
-		sllv_t* precord_list_for_group = pa->pvvalue;
-		// outrecs were freed by caller of mapper_tail_process. Here, just free
-		// the sllv container itself.
-		sllv_free(precord_list_for_group);
+	for (lhmslve_t* pa = pstate->pgroups->phead; pa != NULL; pa = pa->pnext) {
+		count_similar_group_t* pgroup = pa->pvvalue;
+		free(pgroup->pindices);
+		free(pgroup);
 	}
-	lhmslv_free(pstate->precord_lists_by_group);
+	lhmslv_free(pstate->pgroups);
+	lrec_store_free(pstate->pstore);
 
 	pstate->pgroup_by_field_names = NULL;
-	pstate->pcounts_by_group = NULL;
+	pstate->pgroups = NULL;
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -145,54 +172,56 @@ static void mapper_count_similar_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_count_similar_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_count_similar_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values == NULL) {
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (!group_key_select(pgroup_key, pinrec)) {
 			lrec_free(pinrec);
 			return NULL;
 		}
 
-		unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
-		if (pcount == NULL) {
-			pcount = mlr_malloc_or_die(sizeof(unsigned long long));
-			*pcount = 1LL;
-			lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
-		} else {
-			(*pcount)++;
+		count_similar_group_t* pgroup = lhmslv_get_with_hash(pstate->pgroups,
+			pgroup_key->pvalues, pgroup_key->hash);
+		if (pgroup == NULL) {
+			pgroup = mlr_malloc_or_die(sizeof(count_similar_group_t));
+			pgroup->count    = 0LL;
+			pgroup->capacity = 16LL;
+			pgroup->pindices = mlr_malloc_or_die(pgroup->capacity * sizeof(long long));
+			lhmslv_put_with_hash(pstate->pgroups, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+				pgroup, FREE_ENTRY_KEY);
+		} else if (pgroup->count >= pgroup->capacity) {
+			pgroup->capacity *= 2;
+			pgroup->pindices = mlr_realloc_or_die(pgroup->pindices, pgroup->capacity * sizeof(long long));
 		}
+		pgroup->pindices[pgroup->count++] = pstate->pstore->num_records;
+		lrec_store_append(pstate->pstore, pinrec);
+		lrec_free(pinrec);
 
-		sllv_t* precord_list_for_group = lhmslv_get(pstate->precord_lists_by_group, pgroup_by_field_values);
-		if (precord_list_for_group == NULL) {
-			precord_list_for_group = sllv_alloc();
-			lhmslv_put(pstate->precord_lists_by_group, slls_copy(pgroup_by_field_values), precord_list_for_group,
-				FREE_ENTRY_KEY);
-
-		}
-		sllv_append(precord_list_for_group, pinrec);
-
-		slls_free(pgroup_by_field_values);
 		return NULL;
 
 	} else {
+		if (!pstate->emitting) {
+			pstate->emitting = TRUE;
+			pstate->pemitting_group = pstate->pgroups->phead;
+		}
 		sllv_t* poutrecs = sllv_alloc();
-		for (lhmslve_t* pa = pstate->precord_lists_by_group->phead; pa != NULL; pa = pa->pnext) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pa->key);
-			if (pcount == NULL) {
-				fprintf(stderr, "%s: internal coding error detected in file %s at line %d.\n",
-					MLR_GLOBALS.bargv0, __FILE__, __LINE__);
-				exit(1);
+		while (poutrecs->length < LREC_STORE_OUTPUT_PIECE_SIZE) {
+			lhmslve_t* pa = pstate->pemitting_group;
+			if (pa == NULL) {
+				sllv_append(poutrecs, NULL);
+				return poutrecs;
 			}
-
-			sllv_t* precord_list_for_group = pa->pvvalue;
-			while (precord_list_for_group->phead != NULL) {
-				lrec_t* poutrec = sllv_pop(precord_list_for_group);
-
-				char* scount = mlr_alloc_string_from_ll(*pcount);
-				lrec_put(poutrec, pstate->output_field_name, scount, FREE_ENTRY_VALUE);
-				sllv_append(poutrecs, poutrec);
+			count_similar_group_t* pgroup = pa->pvvalue;
+			if (pstate->num_emitted_in_group >= pgroup->count) {
+				pstate->pemitting_group = pa->pnext;
+				pstate->num_emitted_in_group = 0LL;
+				continue;
 			}
+
+			lrec_t* poutrec = lrec_store_get(pstate->pstore, pgroup->pindices[pstate->num_emitted_in_group++]);
+			char* scount = mlr_alloc_string_from_ll(pgroup->count);
+			lrec_put(poutrec, pstate->output_field_name, scount, FREE_ENTRY_VALUE);
+			sllv_append(poutrecs, poutrec);
 		}
-		sllv_append(poutrecs, NULL);
+		pctx->more_output = TRUE;
 		return poutrecs;
 	}
 }
@@ -25,6 +25,12 @@ static mapper_t* mapper_cut_alloc(ap_state_t* pargp, slls_t* pfield_name_list,
 static void      mapper_cut_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_cut_process_no_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_cut_process_with_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_cut_process_no_regexes_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
+static void      mapper_cut_process_with_regexes_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
+static void      mapper_cut_no_regexes(lrec_t* pinrec, mapper_cut_state_t* pstate);
+static void      mapper_cut_with_regexes(lrec_t* pinrec, mapper_cut_state_t* pstate);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_cut_setup = {
@@ -100,6 +106,7 @@ static mapper_t* mapper_cut_alloc(ap_state_t* pargp, slls_t* pfield_name_list,
 		pstate->nregex             = 0;
 		pstate->regexes            = NULL;
 		pmapper->pprocess_func     = mapper_cut_process_no_regexes;
+		pmapper->pprocess_batch_func = mapper_cut_process_no_regexes_batch;
 	} else {
 		pstate->pfield_name_list   = NULL;
 		pstate->pfield_name_set    = NULL;
@@ -113,6 +120,7 @@ static mapper_t* mapper_cut_alloc(ap_state_t* pargp, slls_t* pfield_name_list,
 		}
 		slls_free(pfield_name_list);
 		pmapper->pprocess_func = mapper_cut_process_with_regexes;
+		pmapper->pprocess_batch_func = mapper_cut_process_with_regexes_batch;
 	}
 	pstate->do_arg_order  = do_arg_order;
 	pstate->do_complement = do_complement;
@@ -138,66 +146,91 @@ static void mapper_cut_free(mapper_t* pmapper, context_t* _) {
 // ----------------------------------------------------------------
 static sllv_t* mapper_cut_process_no_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	if (pinrec != NULL) {
-		mapper_cut_state_t* pstate = (mapper_cut_state_t*)pvstate;
-		if (!pstate->do_complement) {
-			// Loop over the record and free the fields not in the
-			// to-be-retained set, being careful about the fact that we're
-			// modifying what we're looping over.
-			for (lrece_t* pe = pinrec->phead; pe != NULL; /* next in loop */) {
-				if (!hss_has(pstate->pfield_name_set, pe->key)) {
-					lrece_t* pf = pe->pnext;
-					lrec_remove(pinrec, pe->key);
-					pe = pf;
-				} else {
-					pe = pe->pnext;
-				}
-			}
-			if (pstate->do_arg_order) {
-				// OK since the field-name list was reversed at construction time.
-				for (sllse_t* pe = pstate->pfield_name_list->phead; pe != NULL; pe = pe->pnext) {
-					char* field_name = pe->value;
-					lrec_move_to_head(pinrec, field_name);
-				}
-			}
-			return sllv_single(pinrec);
-		} else {
-			for (sllse_t* pe = pstate->pfield_name_list->phead; pe != NULL; pe = pe->pnext) {
-				char* field_name = pe->value;
-				lrec_remove(pinrec, field_name);
-			}
-			return sllv_single(pinrec);
-		}
+		mapper_cut_no_regexes(pinrec, pvstate);
+		return sllv_single(pinrec);
 	}
 	else {
 		return sllv_single(NULL);
 	}
 }
 
-// ----------------------------------------------------------------
-static sllv_t* mapper_cut_process_with_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate) {
-	if (pinrec != NULL) {
-		mapper_cut_state_t* pstate = (mapper_cut_state_t*)pvstate;
-		// Loop over the record and free the fields to be discarded, being
-		// careful about the fact that we're modifying what we're looping over.
+static void mapper_cut_process_no_regexes_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		mapper_cut_no_regexes(pentry->prec, pvstate);
+		lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+	}
+}
+
+static void mapper_cut_no_regexes(lrec_t* pinrec, mapper_cut_state_t* pstate) {
+	if (!pstate->do_complement) {
+		// Loop over the record and free the fields not in the
+		// to-be-retained set, being careful about the fact that we're
+		// modifying what we're looping over.
 		for (lrece_t* pe = pinrec->phead; pe != NULL; /* next in loop */) {
-			int matches_any = FALSE;
-			for (int i = 0; i < pstate->nregex; i++) {
-				if (regmatch_or_die(&pstate->regexes[i], pe->key, 0, NULL)) {
-					matches_any = TRUE;
-					break;
-				}
-			}
-			if (matches_any ^ pstate->do_complement) {
-				pe = pe->pnext;
-			} else {
+			if (!hss_has(pstate->pfield_name_set, pe->key)) {
 				lrece_t* pf = pe->pnext;
 				lrec_remove(pinrec, pe->key);
 				pe = pf;
+			} else {
+				pe = pe->pnext;
 			}
 		}
+		if (pstate->do_arg_order) {
+			// OK since the field-name list was reversed at construction time.
+			for (sllse_t* pe = pstate->pfield_name_list->phead; pe != NULL; pe = pe->pnext) {
+				char* field_name = pe->value;
+				lrec_move_to_head(pinrec, field_name);
+			}
+		}
+	} else {
+		for (sllse_t* pe = pstate->pfield_name_list->phead; pe != NULL; pe = pe->pnext) {
+			char* field_name = pe->value;
+			lrec_remove(pinrec, field_name);
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+static sllv_t* mapper_cut_process_with_regexes(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	if (pinrec != NULL) {
+		mapper_cut_with_regexes(pinrec, pvstate);
 		return sllv_single(pinrec);
 	}
 	else {
 		return sllv_single(NULL);
 	}
 }
+
+static void mapper_cut_process_with_regexes_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		mapper_cut_with_regexes(pentry->prec, pvstate);
+		lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+	}
+}
+
+static void mapper_cut_with_regexes(lrec_t* pinrec, mapper_cut_state_t* pstate) {
+	// Loop over the record and free the fields to be discarded, being
+	// careful about the fact that we're modifying what we're looping over.
+	for (lrece_t* pe = pinrec->phead; pe != NULL; /* next in loop */) {
+		int matches_any = FALSE;
+		for (int i = 0; i < pstate->nregex; i++) {
+			if (regmatch_or_die(&pstate->regexes[i], pe->key, 0, NULL)) {
+				matches_any = TRUE;
+				break;
+			}
+		}
+		if (matches_any ^ pstate->do_complement) {
+			pe = pe->pnext;
+		} else {
+			lrece_t* pf = pe->pnext;
+			lrec_remove(pinrec, pe->key);
+			pe = pf;
+		}
+	}
+}
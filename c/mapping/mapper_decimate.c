@@ -13,6 +13,7 @@
 typedef struct _mapper_decimate_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	unsigned long long decimate_count;
 	unsigned long long remainder_for_keep;
 	lhmslv_t* pcounts_by_group;
@@ -77,12 +78,14 @@ static mapper_t* mapper_decimate_alloc(ap_state_t* pargp, slls_t* pgroup_by_fiel
 
 	pstate->pargp                  = pargp;
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
+	pstate->pgroup_key             = group_key_alloc(pgroup_by_field_names);
 	pstate->decimate_count         = decimate_count;
 	pstate->remainder_for_keep     = keep_last ? decimate_count - 1 : 0;
 	pstate->pcounts_by_group = lhmslv_alloc();
 
 	pmapper->pvstate        = pstate;
 	pmapper->pprocess_func  = mapper_decimate_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func     = mapper_decimate_free;
 
 	return pmapper;
@@ -92,6 +95,7 @@ static void mapper_decimate_free(mapper_t* pmapper, context_t* _) {
 	mapper_decimate_state_t* pstate = pmapper->pvstate;
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
 	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
 		unsigned long long* pcount_for_group = pa->pvvalue;
@@ -107,27 +111,26 @@ static void mapper_decimate_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_decimate_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_decimate_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values == NULL) {
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (!group_key_select(pgroup_key, pinrec)) {
 			return NULL;
 		} else {
-			unsigned long long* pcount_for_group = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+			unsigned long long* pcount_for_group = lhmslv_get_with_hash(pstate->pcounts_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (pcount_for_group == NULL) {
 				pcount_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount_for_group = 0LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount_for_group,
-					FREE_ENTRY_KEY);
+				lhmslv_put_with_hash(pstate->pcounts_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+					pcount_for_group, FREE_ENTRY_KEY);
 			}
 
 			unsigned long long remainder = *pcount_for_group % pstate->decimate_count;
 			if (remainder == pstate->remainder_for_keep) {
 				(*pcount_for_group)++;
-				slls_free(pgroup_by_field_values);
 				return sllv_single(pinrec);
 			} else {
 				(*pcount_for_group)++;
 				lrec_free(pinrec);
-				slls_free(pgroup_by_field_values);
 				return NULL;
 			}
 		}
@@ -80,6 +80,7 @@ static mapper_t* mapper_fill_down_alloc(ap_state_t* pargp, slls_t* pfill_down_fi
 
 	pmapper->pvstate        = pstate;
 	pmapper->pprocess_func  = mapper_fill_down_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func     = mapper_fill_down_free;
 
 	return pmapper;
@@ -7,7 +7,7 @@ typedef struct _mapper_format_values_state_t {
 	ap_state_t* pargp;
 	char* string_format;
 	char* int_format;
-	char* float_format;
+	double_format_t float_format; // Examined once, not per value
 	int coerce_int_to_float;
 } mapper_format_values_state_t;
 
@@ -106,13 +106,14 @@ static mapper_t* mapper_format_values_alloc(ap_state_t* pargp,
 	pstate->pargp                 = pargp;
 	pstate->string_format         = string_format;
 	pstate->int_format            = int_format;
-	pstate->float_format          = float_format;
+	mlr_double_format_init(&pstate->float_format, float_format);
 	pstate->coerce_int_to_float   = coerce_int_to_float;
 	pmapper->pvstate              = pstate;
 
 	pmapper->pprocess_func        = NULL;
 	pmapper->pprocess_func        = mapper_format_values_process;
 
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func           = mapper_format_values_free;
 	return pmapper;
 }
@@ -139,12 +140,12 @@ static sllv_t* mapper_format_values_process(lrec_t* pinrec, context_t* pctx, voi
 
 		if (is_int) {
 			if (pstate->coerce_int_to_float) {
-				lrece_update_value(pe, mlr_alloc_string_from_double((double)int_value, pstate->float_format), TRUE);
+				lrece_update_value(pe, mlr_alloc_string_from_double_with_format((double)int_value, &pstate->float_format), TRUE);
 			} else {
 				lrece_update_value(pe, mlr_alloc_string_from_ll_and_format(int_value, pstate->int_format), TRUE);
 			}
 		} else if (is_float) {
-			lrece_update_value(pe, mlr_alloc_string_from_double(float_value, pstate->float_format), TRUE);
+			lrece_update_value(pe, mlr_alloc_string_from_double_with_format(float_value, &pstate->float_format), TRUE);
 		} else {
 			lrece_update_value(pe,
 				mlr_alloc_string_from_string_and_format(string_value, pstate->string_format),
@@ -8,6 +8,7 @@
 #include "containers/lhmslv.h"
 #include "containers/lhmsmv.h"
 #include "containers/mixutil.h"
+#include "containers/lrec_store.h"
 #include "lib/mvfuncs.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
@@ -16,7 +17,9 @@ typedef struct _mapper_fraction_state_t {
 	ap_state_t* pargp;
 	slls_t* pfraction_field_names;
 	slls_t* pgroup_by_field_names;
-	sllv_t* precords;
+	group_key_t* pgroup_key;
+	lrec_store_t* pstore;
+	long long num_output; // At end of stream
 	// Two-level map: lhmslv_t -> lhmsv. Group-by field names are the first keyset;
 	// the fraction field names are keys into the second.
 	lhmslv_t* psums;
@@ -31,7 +34,7 @@ static void      mapper_fraction_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_fraction_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_fraction_alloc(ap_state_t* pargp, slls_t* pfraction_field_names, slls_t* pgroup_by_field_names,
-	int do_percents, int do_cumu);
+	int do_percents, int do_cumu, long long mem_budget, char* tmpdir);
 static void      mapper_fraction_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_fraction_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -65,6 +68,9 @@ static void mapper_fraction_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "              E.g. with input records  x=1  x=2  x=3  and  x=4, emits output records\n");
 	fprintf(o, "              x=1,x_cumulative_fraction=0.1  x=2,x_cumulative_fraction=0.3\n");
 	fprintf(o, "              x=3,x_cumulative_fraction=0.6  and  x=4,x_cumulative_fraction=1.0\n");
+	fprintf(o, "--mem {size}  Memory budget for the records retained, e.g. 500M or 4G. Past it,\n");
+	fprintf(o, "              they are written to a temporary file. Default: no limit.\n");
+	fprintf(o, "--tmpdir {dir} Directory for that file. Default: $TMPDIR, else /tmp.\n");
 }
 
 static mapper_t* mapper_fraction_parse_cli(int* pargi, int argc, char** argv,
@@ -74,6 +80,9 @@ static mapper_t* mapper_fraction_parse_cli(int* pargi, int argc, char** argv,
 	slls_t* pgroup_by_field_names = slls_alloc();
 	int do_percents = FALSE;
 	int do_cumu = FALSE;
+	char* mem_budget_string = NULL;
+	char* tmpdir = NULL;
+	long long mem_budget = 0LL;
 
 	char* verb = argv[(*pargi)++];
 
@@ -82,6 +91,8 @@ static mapper_t* mapper_fraction_parse_cli(int* pargi, int argc, char** argv,
 	ap_define_string_list_flag(pstate, "-g", &pgroup_by_field_names);
 	ap_define_true_flag(pstate,        "-p", &do_percents);
 	ap_define_true_flag(pstate,        "-c", &do_cumu);
+	ap_define_string_flag(pstate,      "--mem",    &mem_budget_string);
+	ap_define_string_flag(pstate,      "--tmpdir", &tmpdir);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_fraction_usage(stderr, argv[0], verb);
@@ -92,13 +103,18 @@ static mapper_t* mapper_fraction_parse_cli(int* pargi, int argc, char** argv,
 		mapper_fraction_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (mem_budget_string != NULL && !mlr_try_byte_count_from_string(mem_budget_string, &mem_budget)) {
+		mapper_fraction_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
-	return mapper_fraction_alloc(pstate, pfraction_field_names, pgroup_by_field_names, do_percents, do_cumu);
+	return mapper_fraction_alloc(pstate, pfraction_field_names, pgroup_by_field_names, do_percents, do_cumu,
+		mem_budget, tmpdir);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_fraction_alloc(ap_state_t* pargp, slls_t* pfraction_field_names, slls_t* pgroup_by_field_names,
-	int do_percents, int do_cumu)
+	int do_percents, int do_cumu, long long mem_budget, char* tmpdir)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -107,7 +123,9 @@ static mapper_t* mapper_fraction_alloc(ap_state_t* pargp, slls_t* pfraction_fiel
 	pstate->pargp                   = pargp;
 	pstate->pfraction_field_names   = pfraction_field_names;
 	pstate->pgroup_by_field_names   = pgroup_by_field_names;
-	pstate->precords                = sllv_alloc();
+	pstate->pgroup_key              = group_key_alloc(pgroup_by_field_names);
+	pstate->pstore                  = lrec_store_alloc(mem_budget, tmpdir);
+	pstate->num_output              = 0LL;
 	pstate->psums                   = lhmslv_alloc();
 	pstate->pcumus                  = lhmslv_alloc();
 	if (do_percents) {
@@ -122,6 +140,7 @@ static mapper_t* mapper_fraction_alloc(ap_state_t* pargp, slls_t* pfraction_fiel
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_fraction_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_fraction_free;
 
 	return pmapper;
@@ -133,9 +152,9 @@ static void mapper_fraction_free(mapper_t* pmapper, context_t* _) {
 		slls_free(pstate->pfraction_field_names);
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 
-	// The process method will have emptied out the list. We just need to free the container.
-	sllv_free(pstate->precords);
+	lrec_store_free(pstate->pstore);
 
 	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
 	for (lhmslve_t* pa = pstate->psums->phead; pa != NULL; pa = pa->pnext) {
@@ -160,22 +179,20 @@ static sllv_t* mapper_fraction_process(lrec_t* pinrec, context_t* pctx, void* pv
 	mapper_fraction_state_t* pstate = pvstate;
 	if (pinrec != NULL) { // Not end of stream; pass 1
 
-		// Append records into a single output list (so that this verb is order-preserving).
-		sllv_append(pstate->precords, pinrec);
+		// Retain records in order (so that this verb is order-preserving).
+		lrec_store_append(pstate->pstore, pinrec);
 
 		// Accumulate sums of fraction-field values grouped by group-by field names
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-
-		if (pgroup_by_field_values != NULL) {
-			lhmsmv_t* psums_for_group = lhmslv_get(pstate->psums, pgroup_by_field_values);
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (group_key_select(pgroup_key, pinrec)) {
+			lhmsmv_t* psums_for_group = lhmslv_get_with_hash(pstate->psums, pgroup_key->pvalues, pgroup_key->hash);
 			lhmsmv_t* pcumus_for_group = NULL;
 			if (psums_for_group == NULL) {
 				psums_for_group = lhmsmv_alloc();
-				lhmslv_put(pstate->psums, slls_copy(pgroup_by_field_values),
+				lhmslv_put_with_hash(pstate->psums, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
 					psums_for_group, FREE_ENTRY_KEY);
 				pcumus_for_group = lhmsmv_alloc();
-				lhmslv_put(pstate->pcumus, slls_copy(pgroup_by_field_values),
+				lhmslv_put_with_hash(pstate->pcumus, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
 					pcumus_for_group, FREE_ENTRY_KEY);
 			}
 
@@ -193,24 +210,25 @@ static sllv_t* mapper_fraction_process(lrec_t* pinrec, context_t* pctx, void* pv
 					}
 				}
 			}
-
-			slls_free(pgroup_by_field_values);
 		}
 
+		lrec_free(pinrec);
 		return NULL;
 
-	} else { // End of stream; pass 2
+	} else { // End of stream; pass 2, a piece of output at a time
 		sllv_t* poutrecs = sllv_alloc();
 
 		// Iterate over the retained records, decorating them with fraction fields.
-		while (pstate->precords->phead != NULL) {
-			lrec_t* poutrec = sllv_pop(pstate->precords);
-
-			slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(poutrec,
-				pstate->pgroup_by_field_names);
-			if (pgroup_by_field_values != NULL) {
-				lhmsmv_t* psums_for_group = lhmslv_get(pstate->psums, pgroup_by_field_values);
-				lhmsmv_t* pcumus_for_group = lhmslv_get(pstate->pcumus, pgroup_by_field_values);
+		while (pstate->num_output < pstate->pstore->num_records
+			&& poutrecs->length < LREC_STORE_OUTPUT_PIECE_SIZE)
+		{
+			lrec_t* poutrec = lrec_store_get(pstate->pstore, pstate->num_output++);
+
+			group_key_t* pgroup_key = pstate->pgroup_key;
+			if (group_key_select(pgroup_key, poutrec)) {
+				lhmsmv_t* psums_for_group = lhmslv_get_with_hash(pstate->psums, pgroup_key->pvalues, pgroup_key->hash);
+				lhmsmv_t* pcumus_for_group = lhmslv_get_with_hash(pstate->pcumus, pgroup_key->pvalues,
+					pgroup_key->hash);
 				MLR_INTERNAL_CODING_ERROR_IF(psums_for_group == NULL); // should have populated on pass 1
 				for (sllse_t* pf = pstate->pfraction_field_names->phead; pf != NULL; pf = pf->pnext) {
 					char* fraction_field_name = pf->value;
@@ -245,13 +263,15 @@ static sllv_t* mapper_fraction_process(lrec_t* pinrec, context_t* pctx, void* pv
 						}
 					}
 				}
-				slls_free(pgroup_by_field_values);
 			}
 
 			sllv_append(poutrecs, poutrec);
 		}
 
-		sllv_append(poutrecs, NULL);
+		if (pstate->num_output < pstate->pstore->num_records)
+			pctx->more_output = TRUE;
+		else
+			sllv_append(poutrecs, NULL);
 		return poutrecs;
 	}
 }
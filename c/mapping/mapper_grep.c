@@ -99,6 +99,7 @@ static mapper_t* mapper_grep_alloc(ap_state_t* pargp, char* regex_string, int ex
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_grep_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_grep_free;
 	return pmapper;
 }
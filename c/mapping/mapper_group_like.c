@@ -55,6 +55,7 @@ static mapper_t* mapper_group_like_alloc() {
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_group_like_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_group_like_free;
 
 	return pmapper;
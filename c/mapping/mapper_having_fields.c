@@ -149,6 +149,7 @@ static mapper_t* mapper_having_fields_alloc(slls_t* pfield_names, char* regex_st
 	mapper_having_fields_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_having_fields_state_t));
 
 	pmapper->pvstate = (void*)pstate;
+	pmapper->pprocess_batch_func = NULL;
 
 	if (regex_string != NULL) {
 		pstate->pfield_names    = NULL;
@@ -13,6 +13,7 @@
 typedef struct _mapper_head_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	unsigned long long head_count;
 	unsigned long long unkeyed_record_count;
 	lhmslv_t* pcounts_by_group;
@@ -25,6 +26,11 @@ static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 static void      mapper_head_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_head_process_keyed(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_head_process_unkeyed_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
+static void      mapper_head_process_keyed_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
+static int       mapper_head_keyed_accepts(mapper_head_state_t* pstate, lrec_t* pinrec);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_head_setup = {
@@ -72,6 +78,7 @@ static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 
 	pstate->pargp                  = pargp;
 	pstate->pgroup_by_field_names  = pgroup_by_field_names;
+	pstate->pgroup_key             = group_key_alloc(pgroup_by_field_names);
 	pstate->head_count             = head_count;
 	pstate->unkeyed_record_count   = 0LL;
 	pstate->pcounts_by_group       = lhmslv_alloc();
@@ -80,6 +87,9 @@ static mapper_t* mapper_head_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 	pmapper->pprocess_func  = pgroup_by_field_names->length == 0
 		? mapper_head_process_unkeyed
 		: mapper_head_process_keyed;
+	pmapper->pprocess_batch_func = pgroup_by_field_names->length == 0
+		? mapper_head_process_unkeyed_batch
+		: mapper_head_process_keyed_batch;
 	pmapper->pfree_func     = mapper_head_free;
 
 	return pmapper;
@@ -89,6 +99,7 @@ static void mapper_head_free(mapper_t* pmapper, context_t* _) {
 	mapper_head_state_t* pstate = pmapper->pvstate;
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
 	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
 		unsigned long long* pcount_for_group = pa->pvvalue;
@@ -117,34 +128,67 @@ static sllv_t* mapper_head_process_unkeyed(lrec_t* pinrec, context_t* pctx, void
 	}
 }
 
+// Once the count is reached, the rest of the batch is discarded.
+static void mapper_head_process_unkeyed_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	mapper_head_state_t* pstate = pvstate;
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		pstate->unkeyed_record_count++;
+		if (pstate->unkeyed_record_count <= pstate->head_count) {
+			lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+		} else {
+			pctx->force_eof = TRUE;
+			lrec_free(pentry->prec);
+		}
+	}
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_head_process_keyed(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_head_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values == NULL) {
+		if (mapper_head_keyed_accepts(pstate, pinrec)) {
+			return sllv_single(pinrec);
+		} else {
 			lrec_free(pinrec);
 			return NULL;
-		} else {
-			unsigned long long* pcount_for_group = lhmslv_get(pstate->pcounts_by_group,
-				pgroup_by_field_values);
-			if (pcount_for_group == NULL) {
-				pcount_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
-				*pcount_for_group = 0LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values),
-					pcount_for_group, FREE_ENTRY_KEY);
-			}
-			slls_free(pgroup_by_field_values);
-			(*pcount_for_group)++;
-			if (*pcount_for_group <= pstate->head_count) {
-				return sllv_single(pinrec);
-			} else {
-				lrec_free(pinrec);
-				return NULL;
-			}
 		}
 	} else {
 		return sllv_single(NULL);
 	}
 }
+
+static void mapper_head_process_keyed_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	mapper_head_state_t* pstate = pvstate;
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		if (mapper_head_keyed_accepts(pstate, pentry->prec)) {
+			lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+		} else {
+			lrec_free(pentry->prec);
+		}
+	}
+}
+
+// Counts the record against its group, returning false if the record lacks a
+// group-by field or its group already has enough.
+static int mapper_head_keyed_accepts(mapper_head_state_t* pstate, lrec_t* pinrec) {
+	group_key_t* pgroup_key = pstate->pgroup_key;
+	if (!group_key_select(pgroup_key, pinrec))
+		return FALSE;
+
+	unsigned long long* pcount_for_group = lhmslv_get_with_hash(pstate->pcounts_by_group,
+		pgroup_key->pvalues, pgroup_key->hash);
+	if (pcount_for_group == NULL) {
+		pcount_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
+		*pcount_for_group = 0LL;
+		lhmslv_put_with_hash(pstate->pcounts_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+			pcount_for_group, FREE_ENTRY_KEY);
+	}
+	(*pcount_for_group)++;
+	return *pcount_for_group <= pstate->head_count;
+}
@@ -141,6 +141,7 @@ static mapper_t* mapper_histogram_alloc(ap_state_t* pargp, slls_t* value_field_n
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = do_auto ? mapper_histogram_process_auto : mapper_histogram_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_histogram_free;
 
 	return pmapper;
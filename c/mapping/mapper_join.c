@@ -3,12 +3,46 @@
 #include "containers/lrec.h"
 #include "containers/sllv.h"
 #include "containers/lhmslv.h"
+#include "containers/lrec_spool.h"
+#include "containers/bloom_filter.h"
 #include "containers/mixutil.h"
 #include "containers/join_bucket_keeper.h"
 #include "mapping/mappers.h"
 #include "input/lrec_readers.h"
 
 // ----------------------------------------------------------------
+// In unsorted mode the left file is held in memory. With a memory budget
+// (--mem), once the left records held exceed it, they and the rest of the
+// left file are partitioned to temporary files by a hash of their join-field
+// values, as are the right records with join fields. At end of stream each
+// left partition is loaded in turn and joined with its right partition -- or,
+// if it still doesn't fit, it and its right partition are partitioned again
+// on other bits of the hash. (This is a grace hash join.) Output is the same
+// as without the budget, except in order: pairs come out partition by
+// partition, then the left unpaireds of each partition after its pairs.
+//
+// Also in unsorted mode, optionally (--bloom), a Bloom filter is built from
+// the hashes of the left join-field values once the left file is loaded, and
+// right records whose hash it turns away are freed without a hash-map lookup.
+// That's for when most right records are unpaired and aren't being emitted:
+// with --ur they all have to be looked up anyway, and once partitioning, the
+// left values aren't all in memory to build it from.
+
+// Partitions per level, and the hash bits which pick them.
+#define JOIN_PARTITION_BITS  6
+#define JOIN_NUM_PARTITIONS  (1 << JOIN_PARTITION_BITS)
+// Past this, a partition is loaded however big it is: more likely than not,
+// it's mostly one join-field value.
+#define JOIN_MAX_PARTITION_LEVEL 4
+// Right records read per call at end of stream, when joining partitions.
+#define JOIN_OUTPUT_PIECE_SIZE 1024
+
+typedef struct _join_partition_t {
+	lrec_spool_t* pleft;  // Null until written to
+	lrec_spool_t* pright; // Null until written to
+	int           level;
+} join_partition_t;
+
 typedef struct _mapper_join_opts_t {
 	char*    left_prefix;
 	char*    right_prefix;
@@ -22,6 +56,9 @@ typedef struct _mapper_join_opts_t {
 	int      emit_pairables;
 	int      emit_left_unpairables;
 	int      emit_right_unpairables;
+	long long mem_budget; // Bytes of left records to hold before partitioning; 0 for no limit
+	char*    tmpdir;      // Null for the default
+	int      use_bloom_filter;
 
 	char*    prepipe;
 	char*    left_file_name;
@@ -42,8 +79,17 @@ typedef struct _mapper_join_state_t {
 	join_bucket_keeper_t* pjoin_bucket_keeper;
 
 	// For unsorted input
-	lhmslv_t* pleft_buckets_by_join_field_values;
-	sllv_t*   pleft_unpaired_records;
+	lhmslv_t*       pleft_buckets_by_join_field_values;
+	sllv_t*         pleft_unpaired_records;
+	group_key_t*    pright_key;    // Right join-field values, selected without copying
+	bloom_filter_t* pbloom_filter; // Of the left buckets' hashes; null unless --bloom
+
+	// For unsorted input with a memory budget
+	long long          mem_used;             // Approximate bytes of left records held
+	join_partition_t** ppartitions;          // Once partitioning; JOIN_NUM_PARTITIONS of them
+	sllv_t*            ppending_partitions;  // At end of stream, as join_partition_t*
+	join_partition_t*  pcurrent_partition;   // Loaded into the buckets
+	lrec_spool_t*      pleft_unpaired_spool; // Once partitioning, left records lacking join fields
 
 } mapper_join_state_t;
 
@@ -58,6 +104,18 @@ static void mapper_join_form_pairs(sllv_t* pleft_records, lrec_t* pright_rec, ma
 	sllv_t* pout_recs);
 static sllv_t* mapper_join_process_sorted(lrec_t* pright_rec, context_t* pctx, void* pvstate);
 static sllv_t* mapper_join_process_unsorted(lrec_t* pright_rec, context_t* pctx, void* pvstate);
+static sllv_t* mapper_join_probe(mapper_join_state_t* pstate, lrec_t* pright_rec);
+static void    mapper_join_put_left(mapper_join_state_t* pstate, slls_t* pleft_field_values, lrec_t* pleft_rec);
+static void    mapper_join_free_left_buckets(mapper_join_state_t* pstate);
+static void    mapper_join_partition_buckets(mapper_join_state_t* pstate, join_partition_t** ppartitions);
+static void    mapper_join_start_partitioning(mapper_join_state_t* pstate);
+static sllv_t* mapper_join_emit_partitioned(mapper_join_state_t* pstate, context_t* pctx);
+static int     mapper_join_load_partition(mapper_join_state_t* pstate, join_partition_t* ppartition);
+
+static join_partition_t** join_partitions_alloc(int level);
+static void join_partition_free(join_partition_t* ppartition);
+static void join_partition_write(join_partition_t** ppartitions, slls_t* pfield_values, lrec_t* prec,
+	int is_left, char* tmpdir);
 
 mapper_setup_t mapper_join_setup = {
 	.verb = "join",
@@ -93,6 +151,18 @@ static void mapper_join_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "               file which is too big to fit into system memory otherwise.\n");
 	fprintf(o, "  -u           Enable unsorted input. (This is the default even without -u.)\n");
 	fprintf(o, "               In this case, the entire left file will be loaded into memory.\n");
+	fprintf(o, "  --mem {size} For unsorted input: memory budget for the left records held,\n");
+	fprintf(o, "               e.g. 500M or 4G. Past it, left and right records are\n");
+	fprintf(o, "               partitioned to temporary files by join-field values, and the\n");
+	fprintf(o, "               partitions are joined pairwise at end of stream. Output records\n");
+	fprintf(o, "               are the same, but in a different order. Default: no limit.\n");
+	fprintf(o, "               Not compatible with -s.\n");
+	fprintf(o, "  --tmpdir {dir} Directory for those files. Default: $TMPDIR, else /tmp.\n");
+	fprintf(o, "  --bloom      For unsorted input: build a Bloom filter of the left join-field\n");
+	fprintf(o, "               values, to discard most unpaired right records without a\n");
+	fprintf(o, "               hash-map lookup. Worthwhile when most right records are\n");
+	fprintf(o, "               unpaired. Not used with --ur, or once partitioning with --mem.\n");
+	fprintf(o, "               Not compatible with -s.\n");
 
 	fprintf(o, "  --prepipe {command} As in main input options; see %s --help for details.\n",
 		MLR_GLOBALS.bargv0);
@@ -135,6 +205,9 @@ static mapper_t* mapper_join_parse_cli(int* pargi, int argc, char** argv,
 	popts->emit_left_unpairables               = FALSE;
 	popts->emit_right_unpairables              = FALSE;
 	popts->allow_unsorted_input                = TRUE;
+	popts->mem_budget                          = 0LL;
+	popts->tmpdir                              = NULL;
+	popts->use_bloom_filter                    = FALSE;
 
 	int argi = *pargi;
 	char* verb = argv[argi++];
@@ -206,6 +279,25 @@ static mapper_t* mapper_join_parse_cli(int* pargi, int argc, char** argv,
 			popts->right_prefix = argv[argi+1];
 			argi += 2;
 
+		} else if (streq(argv[argi], "--mem")) {
+			if ((argc - argi) < 2 || !mlr_try_byte_count_from_string(argv[argi+1], &popts->mem_budget)) {
+				mapper_join_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			argi += 2;
+
+		} else if (streq(argv[argi], "--tmpdir")) {
+			if ((argc - argi) < 2) {
+				mapper_join_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			popts->tmpdir = argv[argi+1];
+			argi += 2;
+
+		} else if (streq(argv[argi], "--bloom")) {
+			popts->use_bloom_filter = TRUE;
+			argi += 1;
+
 		} else if (streq(argv[argi], "--np")) {
 			popts->emit_pairables = FALSE;
 			argi += 1;
@@ -241,6 +333,14 @@ static mapper_t* mapper_join_parse_cli(int* pargi, int argc, char** argv,
 		return NULL;
 	}
 
+	// Sorted-input mode streams the left file rather than holding it, so there's
+	// nothing to budget or to build a filter from.
+	if (!popts->allow_unsorted_input && (popts->mem_budget > 0LL || popts->use_bloom_filter)) {
+		fprintf(stderr, "%s %s: %s is for unsorted input; not compatible with -s.\n",
+			MLR_GLOBALS.bargv0, verb, (popts->mem_budget > 0LL) ? "--mem" : "--bloom");
+		return NULL;
+	}
+
 	if (!popts->emit_pairables && !popts->emit_left_unpairables && !popts->emit_right_unpairables) {
 		fprintf(stderr, "%s %s: all emit flags are unset; no output is possible.\n",
 			MLR_GLOBALS.bargv0, verb);
@@ -293,6 +393,13 @@ static mapper_t* mapper_join_alloc(mapper_join_opts_t* popts) {
 
 	pstate->pleft_buckets_by_join_field_values = NULL;
 	pstate->pleft_unpaired_records             = NULL;
+	pstate->pright_key                         = group_key_alloc(popts->pright_join_field_names);
+	pstate->pbloom_filter                      = NULL;
+	pstate->mem_used                           = 0LL;
+	pstate->ppartitions                        = NULL;
+	pstate->ppending_partitions                = NULL;
+	pstate->pcurrent_partition                 = NULL;
+	pstate->pleft_unpaired_spool               = NULL;
 
 	pmapper->pvstate = (void*)pstate;
 	if (popts->allow_unsorted_input) {
@@ -300,6 +407,7 @@ static mapper_t* mapper_join_alloc(mapper_join_opts_t* popts) {
 	} else {
 		pmapper->pprocess_func = mapper_join_process_sorted;
 	}
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_join_free;
 
 	return pmapper;
@@ -310,17 +418,24 @@ static void mapper_join_free(mapper_t* pmapper, context_t* _) {
 	mapper_join_state_t* pstate = pmapper->pvstate;
 
 	if (pstate->pleft_buckets_by_join_field_values != NULL) {
-		for (lhmslve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
-			join_bucket_t* pbucket = pe->pvvalue;
-			slls_free(pbucket->pleft_field_values);
-			if (pbucket->precords)
-				while (pbucket->precords->phead)
-					lrec_free(sllv_pop(pbucket->precords));
-			sllv_free(pbucket->precords);
-			free(pbucket);
-		}
+		mapper_join_free_left_buckets(pstate);
 		lhmslv_free(pstate->pleft_buckets_by_join_field_values);
 	}
+	if (pstate->ppartitions != NULL) {
+		for (int i = 0; i < JOIN_NUM_PARTITIONS; i++)
+			join_partition_free(pstate->ppartitions[i]);
+		free(pstate->ppartitions);
+	}
+	if (pstate->ppending_partitions != NULL) {
+		while (pstate->ppending_partitions->phead != NULL)
+			join_partition_free(sllv_pop(pstate->ppending_partitions));
+		sllv_free(pstate->ppending_partitions);
+	}
+	if (pstate->pcurrent_partition != NULL)
+		join_partition_free(pstate->pcurrent_partition);
+	lrec_spool_free(pstate->pleft_unpaired_spool);
+	group_key_free(pstate->pright_key);
+	bloom_filter_free(pstate->pbloom_filter);
 
 	// The void-star payload, which is lrec_t*'s, should have been sllv_transferred out.
 	// Misses should be detected by valgrind --leak-check=full, e.g. reg_test/run --valgrind.
@@ -414,8 +529,40 @@ static sllv_t* mapper_join_process_unsorted(lrec_t* pright_rec, context_t* pctx,
 
 	// This can't be done in the CLI-parser since it requires information which
 	// isn't known until after the CLI-parser is called.
-	if (pstate->pleft_buckets_by_join_field_values == NULL) // First call
+	if (pstate->pleft_buckets_by_join_field_values == NULL) { // First call
 		ingest_left_file(pstate);
+		if (pstate->popts->use_bloom_filter && !pstate->popts->emit_right_unpairables
+			&& pstate->ppartitions == NULL)
+		{
+			lhmslv_t* pbuckets = pstate->pleft_buckets_by_join_field_values;
+			pstate->pbloom_filter = bloom_filter_alloc(pbuckets->num_occupied);
+			for (lhmslve_t* pe = pbuckets->phead; pe != NULL; pe = pe->pnext)
+				bloom_filter_add(pstate->pbloom_filter, pe->hash);
+		}
+	}
+
+	if (pstate->ppartitions != NULL) {
+		if (pright_rec == NULL) { // End of input record stream: join the partitions
+			pstate->ppending_partitions = sllv_alloc();
+			for (int i = 0; i < JOIN_NUM_PARTITIONS; i++)
+				sllv_append(pstate->ppending_partitions, pstate->ppartitions[i]);
+			free(pstate->ppartitions);
+			pstate->ppartitions = NULL;
+			lrec_spool_rewind(pstate->pleft_unpaired_spool);
+			return mapper_join_emit_partitioned(pstate, pctx);
+		}
+		slls_t* pright_field_values = mlr_reference_selected_values_from_record(pright_rec,
+			pstate->popts->pright_join_field_names);
+		if (pright_field_values != NULL) {
+			join_partition_write(pstate->ppartitions, pright_field_values, pright_rec, FALSE, pstate->popts->tmpdir);
+			slls_free(pright_field_values);
+			lrec_free(pright_rec);
+			return NULL;
+		}
+		// Else unpairable, as below.
+	} else if (pstate->ppending_partitions != NULL) {
+		return mapper_join_emit_partitioned(pstate, pctx);
+	}
 
 	if (pright_rec == NULL) { // End of input record stream
 		if (pstate->popts->emit_left_unpairables) {
@@ -440,11 +587,20 @@ static sllv_t* mapper_join_process_unsorted(lrec_t* pright_rec, context_t* pctx,
 		}
 	}
 
-	slls_t* pright_field_values = mlr_reference_selected_values_from_record(pright_rec,
-		pstate->popts->pright_join_field_names);
-	if (pright_field_values != NULL) {
-		join_bucket_t* pleft_bucket = lhmslv_get(pstate->pleft_buckets_by_join_field_values, pright_field_values);
-		slls_free(pright_field_values);
+	return mapper_join_probe(pstate, pright_rec);
+}
+
+// Pairs the right record with the left records in memory, returning what's
+// to be output, if anything.
+static sllv_t* mapper_join_probe(mapper_join_state_t* pstate, lrec_t* pright_rec) {
+	group_key_t* pright_key = pstate->pright_key;
+	if (group_key_select(pright_key, pright_rec)) {
+		if (pstate->pbloom_filter != NULL && !bloom_filter_might_contain(pstate->pbloom_filter, pright_key->hash)) {
+			lrec_free(pright_rec);
+			return NULL;
+		}
+		join_bucket_t* pleft_bucket = lhmslv_get_with_hash(pstate->pleft_buckets_by_join_field_values,
+			pright_key->pvalues, pright_key->hash);
 		if (pleft_bucket == NULL) {
 			if (pstate->popts->emit_right_unpairables) {
 				return sllv_single(pright_rec);
@@ -563,21 +719,19 @@ static void ingest_left_file(mapper_join_state_t* pstate) {
 
 		slls_t* pleft_field_values = mlr_reference_selected_values_from_record(pleft_copy,
 			pstate->popts->pleft_join_field_names);
-		if (pleft_field_values != NULL) {
-			join_bucket_t* pbucket = lhmslv_get(pstate->pleft_buckets_by_join_field_values, pleft_field_values);
-			if (pbucket == NULL) { // New key-field-value: new bucket and hash-map entry
-				slls_t* pkey_field_values_copy = slls_copy(pleft_field_values);
-				join_bucket_t* pbucket = mlr_malloc_or_die(sizeof(join_bucket_t));
-				pbucket->precords = sllv_alloc();
-				pbucket->was_paired = FALSE;
-				pbucket->pleft_field_values = slls_copy(pleft_field_values);
-				lhmslv_put(pstate->pleft_buckets_by_join_field_values, pkey_field_values_copy, pbucket,
-					FREE_ENTRY_KEY);
-				sllv_append(pbucket->precords, pleft_copy);
-			} else { // Previously seen key-field-value: append record to bucket
-				sllv_append(pbucket->precords, pleft_copy);
+		if (pstate->ppartitions != NULL) {
+			if (pleft_field_values != NULL) {
+				join_partition_write(pstate->ppartitions, pleft_field_values, pleft_copy, TRUE, popts->tmpdir);
+				slls_free(pleft_field_values);
+			} else {
+				lrec_spool_write(pstate->pleft_unpaired_spool, pleft_copy);
 			}
+			lrec_free(pleft_copy);
+		} else if (pleft_field_values != NULL) {
+			mapper_join_put_left(pstate, pleft_field_values, pleft_copy);
 			slls_free(pleft_field_values);
+			if (popts->mem_budget > 0LL && pstate->mem_used > popts->mem_budget)
+				mapper_join_start_partitioning(pstate);
 		} else {
 			sllv_append(pstate->pleft_unpaired_records, pleft_copy);
 		}
@@ -588,3 +742,215 @@ static void ingest_left_file(mapper_join_state_t* pstate) {
 
 	plrec_reader->pfree_func(plrec_reader);
 }
+
+// ----------------------------------------------------------------
+static void mapper_join_put_left(mapper_join_state_t* pstate, slls_t* pleft_field_values, lrec_t* pleft_rec) {
+	int count_memory = pstate->popts->mem_budget > 0LL;
+	join_bucket_t* pbucket = lhmslv_get(pstate->pleft_buckets_by_join_field_values, pleft_field_values);
+	if (pbucket == NULL) { // New key-field-value: new bucket and hash-map entry
+		slls_t* pkey_field_values_copy = slls_copy(pleft_field_values);
+		pbucket = mlr_malloc_or_die(sizeof(join_bucket_t));
+		pbucket->precords = sllv_alloc();
+		pbucket->was_paired = FALSE;
+		pbucket->pleft_field_values = slls_copy(pleft_field_values);
+		lhmslv_put(pstate->pleft_buckets_by_join_field_values, pkey_field_values_copy, pbucket,
+			FREE_ENTRY_KEY);
+		if (count_memory) {
+			// The field values are held twice: as hash-map key and in the bucket.
+			pstate->mem_used += sizeof(join_bucket_t) + sizeof(sllv_t) + sizeof(lhmslve_t) + 2 * sizeof(slls_t);
+			for (sllse_t* pe = pleft_field_values->phead; pe != NULL; pe = pe->pnext)
+				pstate->mem_used += 2 * (sizeof(sllse_t) + strlen(pe->value) + 1);
+		}
+	}
+	sllv_append(pbucket->precords, pleft_rec);
+	if (count_memory)
+		pstate->mem_used += sizeof(sllve_t) + lrec_approximate_size(pleft_rec);
+}
+
+// Frees the left buckets and their records, leaving the hash map empty.
+static void mapper_join_free_left_buckets(mapper_join_state_t* pstate) {
+	for (lhmslve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
+		join_bucket_t* pbucket = pe->pvvalue;
+		slls_free(pbucket->pleft_field_values);
+		if (pbucket->precords)
+			while (pbucket->precords->phead)
+				lrec_free(sllv_pop(pbucket->precords));
+		sllv_free(pbucket->precords);
+		free(pbucket);
+	}
+	lhmslv_free(pstate->pleft_buckets_by_join_field_values);
+	pstate->pleft_buckets_by_join_field_values = lhmslv_alloc();
+	pstate->mem_used = 0LL;
+}
+
+// Writes the left buckets' records to the partitions, leaving the hash map
+// empty.
+static void mapper_join_partition_buckets(mapper_join_state_t* pstate, join_partition_t** ppartitions) {
+	for (lhmslve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
+		join_bucket_t* pbucket = pe->pvvalue;
+		while (pbucket->precords->phead != NULL) {
+			lrec_t* pleft_rec = sllv_pop(pbucket->precords);
+			join_partition_write(ppartitions, pbucket->pleft_field_values, pleft_rec, TRUE, pstate->popts->tmpdir);
+			lrec_free(pleft_rec);
+		}
+	}
+	mapper_join_free_left_buckets(pstate);
+}
+
+// The left file has turned out not to fit in memory: from here on, left and
+// right records go to partitions on disk.
+static void mapper_join_start_partitioning(mapper_join_state_t* pstate) {
+	pstate->ppartitions = join_partitions_alloc(0);
+	mapper_join_partition_buckets(pstate, pstate->ppartitions);
+	pstate->pleft_unpaired_spool = lrec_spool_alloc(pstate->popts->tmpdir);
+	while (pstate->pleft_unpaired_records->phead != NULL) {
+		lrec_t* pleft_rec = sllv_pop(pstate->pleft_unpaired_records);
+		lrec_spool_write(pstate->pleft_unpaired_spool, pleft_rec);
+		lrec_free(pleft_rec);
+	}
+}
+
+// ----------------------------------------------------------------
+// Returns the next piece of output at end of stream, once partitioned: each
+// partition's pairs and unpaireds in turn, then the left records lacking join
+// fields.
+static sllv_t* mapper_join_emit_partitioned(mapper_join_state_t* pstate, context_t* pctx) {
+	mapper_join_opts_t* popts = pstate->popts;
+	sllv_t* poutrecs = sllv_alloc();
+
+	while (poutrecs->length < JOIN_OUTPUT_PIECE_SIZE) {
+		join_partition_t* ppartition = pstate->pcurrent_partition;
+		if (ppartition == NULL) {
+			if (pstate->ppending_partitions->phead == NULL) {
+				lrec_t* pleft_rec = popts->emit_left_unpairables
+					? lrec_spool_read(pstate->pleft_unpaired_spool)
+					: NULL;
+				if (pleft_rec == NULL) {
+					sllv_append(poutrecs, NULL);
+					return poutrecs;
+				}
+				sllv_append(poutrecs, pleft_rec);
+				continue;
+			}
+			ppartition = sllv_pop(pstate->ppending_partitions);
+			if (!mapper_join_load_partition(pstate, ppartition)) {
+				join_partition_free(ppartition);
+				continue;
+			}
+			if (ppartition->pright != NULL)
+				lrec_spool_rewind(ppartition->pright);
+			pstate->pcurrent_partition = ppartition;
+		}
+
+		lrec_t* pright_rec = (ppartition->pright != NULL) ? lrec_spool_read(ppartition->pright) : NULL;
+		if (pright_rec != NULL) {
+			sllv_t* pprobe_output = mapper_join_probe(pstate, pright_rec);
+			if (pprobe_output != NULL) {
+				sllv_transfer(poutrecs, pprobe_output);
+				sllv_free(pprobe_output);
+			}
+			continue;
+		}
+
+		// Done with the partition's right records
+		if (popts->emit_left_unpairables) {
+			for (lhmslve_t* pe = pstate->pleft_buckets_by_join_field_values->phead; pe != NULL; pe = pe->pnext) {
+				join_bucket_t* pbucket = pe->pvvalue;
+				if (!pbucket->was_paired) {
+					sllv_transfer(poutrecs, pbucket->precords);
+				}
+			}
+		}
+		mapper_join_free_left_buckets(pstate);
+		join_partition_free(ppartition);
+		pstate->pcurrent_partition = NULL;
+	}
+
+	pctx->more_output = TRUE;
+	return poutrecs;
+}
+
+// Loads the partition's left records into the buckets. If they don't fit, the
+// partition is split again on the next bits of the hash, its sub-partitions
+// take its place at the head of the pending list, and this returns false.
+static int mapper_join_load_partition(mapper_join_state_t* pstate, join_partition_t* ppartition) {
+	mapper_join_opts_t* popts = pstate->popts;
+	if (ppartition->pleft == NULL)
+		return TRUE;
+	lrec_spool_rewind(ppartition->pleft);
+
+	lrec_t* pleft_rec;
+	while ((pleft_rec = lrec_spool_read(ppartition->pleft)) != NULL) {
+		slls_t* pleft_field_values = mlr_reference_selected_values_from_record(pleft_rec,
+			popts->pleft_join_field_names);
+		MLR_INTERNAL_CODING_ERROR_IF(pleft_field_values == NULL);
+		mapper_join_put_left(pstate, pleft_field_values, pleft_rec);
+		slls_free(pleft_field_values);
+		if (pstate->mem_used > popts->mem_budget && ppartition->level < JOIN_MAX_PARTITION_LEVEL)
+			break;
+	}
+	if (pleft_rec == NULL)
+		return TRUE;
+
+	join_partition_t** psub_partitions = join_partitions_alloc(ppartition->level + 1);
+	mapper_join_partition_buckets(pstate, psub_partitions);
+	while ((pleft_rec = lrec_spool_read(ppartition->pleft)) != NULL) {
+		slls_t* pleft_field_values = mlr_reference_selected_values_from_record(pleft_rec,
+			popts->pleft_join_field_names);
+		join_partition_write(psub_partitions, pleft_field_values, pleft_rec, TRUE, popts->tmpdir);
+		slls_free(pleft_field_values);
+		lrec_free(pleft_rec);
+	}
+	if (ppartition->pright != NULL) {
+		lrec_spool_rewind(ppartition->pright);
+		lrec_t* pright_rec;
+		while ((pright_rec = lrec_spool_read(ppartition->pright)) != NULL) {
+			slls_t* pright_field_values = mlr_reference_selected_values_from_record(pright_rec,
+				popts->pright_join_field_names);
+			join_partition_write(psub_partitions, pright_field_values, pright_rec, FALSE, popts->tmpdir);
+			slls_free(pright_field_values);
+			lrec_free(pright_rec);
+		}
+	}
+	for (int i = JOIN_NUM_PARTITIONS - 1; i >= 0; i--)
+		sllv_push(pstate->ppending_partitions, psub_partitions[i]);
+	free(psub_partitions);
+	return FALSE;
+}
+
+// ----------------------------------------------------------------
+static join_partition_t** join_partitions_alloc(int level) {
+	join_partition_t** ppartitions = mlr_malloc_or_die(JOIN_NUM_PARTITIONS * sizeof(join_partition_t*));
+	for (int i = 0; i < JOIN_NUM_PARTITIONS; i++) {
+		ppartitions[i] = mlr_malloc_or_die(sizeof(join_partition_t));
+		ppartitions[i]->pleft  = NULL;
+		ppartitions[i]->pright = NULL;
+		ppartitions[i]->level  = level;
+	}
+	return ppartitions;
+}
+
+static void join_partition_free(join_partition_t* ppartition) {
+	lrec_spool_free(ppartition->pleft);
+	lrec_spool_free(ppartition->pright);
+	free(ppartition);
+}
+
+// Left and right records with the same join-field values hash alike. Each
+// level uses the next bits down from the top of the hash; hash maps use the
+// bottom ones.
+static void join_partition_write(join_partition_t** ppartitions, slls_t* pfield_values, lrec_t* prec,
+	int is_left, char* tmpdir)
+{
+	unsigned long long hash = 0ULL;
+	for (sllse_t* pe = pfield_values->phead; pe != NULL; pe = pe->pnext)
+		hash = mlr_string_hash_continue(pe->value, hash);
+	int level = ppartitions[0]->level;
+	int index = (hash >> (64 - JOIN_PARTITION_BITS * (level + 1))) & (JOIN_NUM_PARTITIONS - 1);
+
+	join_partition_t* ppartition = ppartitions[index];
+	lrec_spool_t** ppspool = is_left ? &ppartition->pleft : &ppartition->pright;
+	if (*ppspool == NULL)
+		*ppspool = lrec_spool_alloc(tmpdir);
+	lrec_spool_write(*ppspool, prec);
+}
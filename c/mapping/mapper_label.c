@@ -17,6 +17,8 @@ static mapper_t* mapper_label_parse_cli(int* pargi, int argc, char** argv,
 static mapper_t* mapper_label_alloc(slls_t* pnames_as_list, hss_t* pnames_as_set);
 static void      mapper_label_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_label_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_label_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_label_setup = {
@@ -74,6 +76,7 @@ static mapper_t* mapper_label_alloc(slls_t* pnames_as_list, hss_t* pnames_as_set
 
 	pmapper->pvstate       = (void*)pstate;
 	pmapper->pprocess_func = mapper_label_process;
+	pmapper->pprocess_batch_func = mapper_label_process_batch;
 	pmapper->pfree_func    = mapper_label_free;
 
 	return pmapper;
@@ -100,3 +103,14 @@ static sllv_t* mapper_label_process(lrec_t* pinrec, context_t* pctx, void* pvsta
 		return sllv_single(NULL);
 	}
 }
+
+static void mapper_label_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	mapper_label_state_t* pstate = (mapper_label_state_t*)pvstate;
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		lrec_label(pentry->prec, pstate->pnames_as_list, pstate->pnames_as_set);
+		lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+	}
+}
@@ -49,6 +49,7 @@ typedef struct _mapper_merge_fields_state_t {
 	char*    output_field_basename;
 	int      allow_int_float;
 	int      do_interpolated_percentiles;
+	percentile_keeper_opts_t percentile_opts;
 	int      keep_input_fields;
 	string_builder_t* psb;
 } mapper_merge_fields_state_t;
@@ -59,7 +60,7 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
 static mapper_t* mapper_merge_fields_alloc(slls_t* paccumulator_names, merge_by_t do_which,
 	slls_t* pvalue_field_names, char* output_field_basename, int allow_int_float, int do_interpolated_percentiles,
-	int keep_input_fields);
+	percentile_keeper_opts_t* ppercentile_opts, int keep_input_fields);
 static void      mapper_merge_fields_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_merge_fields_process_by_name_list(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_merge_fields_process_by_name_regex(lrec_t* pinrec, context_t* pctx, void* pvstate);
@@ -91,6 +92,9 @@ static void mapper_merge_fields_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "            examples below.\n");
 	fprintf(o, "-i          Use interpolated percentiles, like R's type=7; default like type=1.\n");
 	fprintf(o, "            Not sensical for string-valued fields.\n");
+	fprintf(o, "--tdigest   Approximate percentiles using a t-digest. See %s stats1 --help.\n", argv0);
+	fprintf(o, "--kll       Approximate percentiles using a KLL sketch.\n");
+	fprintf(o, "--sketch-size {n} Compression for --tdigest, or k for --kll.\n");
 	fprintf(o, "-o {name}   Output field basename for -f/-r.\n");
 	fprintf(o, "-k          Keep the input fields which contributed to the output statistics;\n");
 	fprintf(o, "            the default is to omit them.\n");
@@ -120,6 +124,7 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 	char*      output_field_basename       = NULL;
 	int        allow_int_float             = TRUE;
 	int        do_interpolated_percentiles = FALSE;
+	percentile_keeper_opts_t percentile_opts = { .mode = PERCENTILE_KEEPER_EXACT, .sketch_size = 0.0 };
 	int        keep_input_fields           = FALSE;
 	merge_by_t do_which                    = MERGE_UNSPECIFIED;
 
@@ -189,6 +194,18 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 		} else if (streq(argv[argi], "-i")) {
 			do_interpolated_percentiles = TRUE;
 			argi += 1;
+		} else if (streq(argv[argi], "--tdigest")) {
+			percentile_opts.mode = PERCENTILE_KEEPER_TDIGEST;
+			argi += 1;
+		} else if (streq(argv[argi], "--kll")) {
+			percentile_opts.mode = PERCENTILE_KEEPER_KLL;
+			argi += 1;
+		} else if (streq(argv[argi], "--sketch-size")) {
+			if (argc - argi < 2 || !mlr_try_float_from_string(argv[argi+1], &percentile_opts.sketch_size)) {
+				mapper_merge_fields_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			argi += 2;
 		} else {
 			mapper_merge_fields_usage(stderr, argv[0], verb);
 			return NULL;
@@ -214,13 +231,13 @@ static mapper_t* mapper_merge_fields_parse_cli(int* pargi, int argc, char** argv
 	*pargi = argi;
 	return mapper_merge_fields_alloc(paccumulator_names, do_which,
 		pvalue_field_names, output_field_basename, allow_int_float, do_interpolated_percentiles,
-		keep_input_fields);
+		&percentile_opts, keep_input_fields);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_merge_fields_alloc(slls_t* paccumulator_names, merge_by_t do_which,
 	slls_t* pvalue_field_names, char* output_field_basename, int allow_int_float, int do_interpolated_percentiles,
-	int keep_input_fields)
+	percentile_keeper_opts_t* ppercentile_opts, int keep_input_fields)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -238,6 +255,7 @@ static mapper_t* mapper_merge_fields_alloc(slls_t* paccumulator_names, merge_by_
 	pstate->output_field_basename       = output_field_basename;
 	pstate->allow_int_float             = allow_int_float;
 	pstate->do_interpolated_percentiles = do_interpolated_percentiles;
+	pstate->percentile_opts             = *ppercentile_opts;
 	pstate->keep_input_fields           = keep_input_fields;
 	pstate->psb                         = sb_alloc(SB_ALLOC_LENGTH);
 
@@ -245,6 +263,7 @@ static mapper_t* mapper_merge_fields_alloc(slls_t* paccumulator_names, merge_by_
 	pmapper->pprocess_func = (do_which == MERGE_BY_NAME_LIST) ? mapper_merge_fields_process_by_name_list :
 		(do_which == MERGE_BY_NAME_REGEX) ? mapper_merge_fields_process_by_name_regex :
 		mapper_merge_fields_process_by_collapsing;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_merge_fields_free;
 
 	return pmapper;
@@ -279,7 +298,7 @@ static sllv_t* mapper_merge_fields_process_by_name_list(lrec_t* pinrec, context_
 	lhmsv_t* poutaccs = lhmsv_alloc();
 
 	make_stats1_accs(pstate->output_field_basename, pstate->paccumulator_names,
-	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pinaccs, poutaccs);
+	    pstate->allow_int_float, pstate->do_interpolated_percentiles, &pstate->percentile_opts, pinaccs, poutaccs);
 
 	for (sllse_t* pb = pstate->pvalue_field_names->phead; pb != NULL; pb = pb->pnext) {
 		char* field_name = pb->value;
@@ -354,7 +373,7 @@ static sllv_t* mapper_merge_fields_process_by_name_regex(lrec_t* pinrec, context
 	lhmsv_t* poutaccs = lhmsv_alloc();
 
 	make_stats1_accs(pstate->output_field_basename, pstate->paccumulator_names,
-	    pstate->allow_int_float, pstate->do_interpolated_percentiles, pinaccs, poutaccs);
+	    pstate->allow_int_float, pstate->do_interpolated_percentiles, &pstate->percentile_opts, pinaccs, poutaccs);
 
 	for (lrece_t* pb = pinrec->phead; pb != NULL; /* increment inside loop */ ) {
 		char* field_name = pb->key;
@@ -461,7 +480,7 @@ static sllv_t* mapper_merge_fields_process_by_collapsing(lrec_t* pinrec, context
 					out_acc_map_for_short_name = lhmsv_alloc();
 
 					make_stats1_accs(short_name, pstate->paccumulator_names,
-						pstate->allow_int_float, pstate->do_interpolated_percentiles,
+						pstate->allow_int_float, pstate->do_interpolated_percentiles, &pstate->percentile_opts,
 						in_acc_map_for_short_name, out_acc_map_for_short_name);
 
 					lhmsv_put(short_names_to_in_acc_maps, mlr_strdup_or_die(short_name), in_acc_map_for_short_name,
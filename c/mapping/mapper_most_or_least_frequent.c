@@ -7,6 +7,7 @@
 #include "containers/lhmslv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
+#include "containers/space_saving.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
@@ -16,11 +17,14 @@
 typedef struct _mapper_most_or_least_frequent_state_t {
 	ap_state_t* pargp;
 	slls_t*     pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	lhmslv_t*   pcounts_by_group;
 	long long   max_output_length;
 	int         descending;
 	int         show_counts;
 	char*       output_field_name;
+	char*       error_field_name;
+	space_saving_t* psketch; // NULL for exact counting
 } mapper_most_or_least_frequent_state_t;
 
 static void mapper_most_frequent_usage(FILE*  o, char* argv0, char* verb);
@@ -31,7 +35,7 @@ static mapper_t* mapper_least_frequent_parse_cli(int* pargi, int argc, char** ar
 static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, char** argv, int descending);
 
 static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
-	long long max_output_length, int descending, int show_counts, char* output_field_name);
+	long long max_output_length, int descending, int show_counts, char* output_field_name, int max_counters);
 static void      mapper_most_or_least_frequent_free(mapper_t* pmapper, context_t* _);
 
 static sllv_t*   mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
@@ -43,6 +47,7 @@ static int ascending_vcmp(const void* pva, const void* pvb);
 typedef struct _sort_pair_t {
 	slls_t* pgroup_by_field_values;
 	long long count; // signed, not unsigned, for sort-cmp callback
+	long long error;
 } sort_pair_t;
 
 // ----------------------------------------------------------------
@@ -70,6 +75,13 @@ static void mapper_most_frequent_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "-n {count}. Optional flag defaulting to %lld.\n", DEFAULT_MAX_OUTPUT_LENGTH);
 	fprintf(o, "-b          Suppress counts; show only field values.\n");
 	fprintf(o, "-o {name}   Field name for output count. Default \"%s\".\n", DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "--max-counters {k} Count at most k distinct values at a time, using the\n");
+	fprintf(o, "            Space-Saving algorithm, in memory proportional to k rather than to\n");
+	fprintf(o, "            the number of distinct values. Any value occurring in more than 1/k\n");
+	fprintf(o, "            of the records is sure to be counted. Each count is an upper bound\n");
+	fprintf(o, "            and is followed by an error field, \"{name}_error\": count minus error\n");
+	fprintf(o, "            is a lower bound. While there are at most k distinct values, errors\n");
+	fprintf(o, "            are zero and counts are exact.\n");
 	fprintf(o, "See also \"%s %s\".\n", argv0, "least-frequent");
 }
 
@@ -82,6 +94,8 @@ static void mapper_least_frequent_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "-n {count}. Optional flag defaulting to %lld.\n", DEFAULT_MAX_OUTPUT_LENGTH);
 	fprintf(o, "-b          Suppress counts; show only field values.\n");
 	fprintf(o, "-o {name}   Field name for output count. Default \"%s\".\n", DEFAULT_OUTPUT_FIELD_NAME);
+	fprintf(o, "There is no --max-counters option as for most-frequent: rare values can't be\n");
+	fprintf(o, "told apart from each other without counting them all.\n");
 	fprintf(o, "See also \"%s %s\".\n", argv0, "most-frequent");
 }
 
@@ -102,32 +116,40 @@ static mapper_t* mapper_most_or_least_frequent_parse_cli(int* pargi, int argc, c
 	long long max_output_length     = DEFAULT_MAX_OUTPUT_LENGTH;
 	int       show_counts           = TRUE;
 	char*     output_field_name     = DEFAULT_OUTPUT_FIELD_NAME;
+	int       max_counters          = 0;
 
 	char* verb = argv[(*pargi)++];
+	mapper_usage_func_t* pusage_func = descending ? mapper_most_frequent_usage : mapper_least_frequent_usage;
 
 	ap_state_t* pstate = ap_alloc();
 	ap_define_string_list_flag(pstate, "-f", &pgroup_by_field_names);
 	ap_define_long_long_flag(pstate,   "-n", &max_output_length);
 	ap_define_false_flag(pstate,       "-b", &show_counts);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
+	if (descending)
+		ap_define_int_flag(pstate,     "--max-counters", &max_counters);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
-		mapper_most_frequent_usage(stderr, argv[0], verb);
+		pusage_func(stderr, argv[0], verb);
 		return NULL;
 	}
 
 	if (pgroup_by_field_names == NULL) {
-		mapper_most_frequent_usage(stderr, argv[0], verb);
+		pusage_func(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (max_counters < 0) {
+		pusage_func(stderr, argv[0], verb);
 		return NULL;
 	}
 
 	return mapper_most_or_least_frequent_alloc(pstate, pgroup_by_field_names, max_output_length, descending,
-		show_counts, output_field_name);
+		show_counts, output_field_name, max_counters);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_names,
-	long long max_output_length, int descending, int show_counts, char* output_field_name)
+	long long max_output_length, int descending, int show_counts, char* output_field_name, int max_counters)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -135,14 +157,18 @@ static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t*
 
 	pstate->pargp                 = pargp;
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
+	pstate->pgroup_key            = group_key_alloc(pgroup_by_field_names);
 	pstate->pcounts_by_group      = lhmslv_alloc();
 	pstate->max_output_length     = max_output_length;
 	pstate->descending            = descending;
 	pstate->show_counts           = show_counts;
 	pstate->output_field_name     = output_field_name;
+	pstate->error_field_name      = mlr_paste_2_strings(output_field_name, "_error");
+	pstate->psketch               = (max_counters == 0) ? NULL : space_saving_alloc(max_counters);
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_most_or_least_frequent_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_most_or_least_frequent_free;
 
 	return pmapper;
@@ -151,12 +177,15 @@ static mapper_t* mapper_most_or_least_frequent_alloc(ap_state_t* pargp, slls_t*
 static void mapper_most_or_least_frequent_free(mapper_t* pmapper, context_t* _) {
 	mapper_most_or_least_frequent_state_t* pstate = pmapper->pvstate;
 	slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 	// lhmslv_free will free the keys: we only need to free the void-star values.
 	for (lhmslve_t* pa = pstate->pcounts_by_group->phead; pa != NULL; pa = pa->pnext) {
 		unsigned long long* pcount = pa->pvvalue;
 		free(pcount);
 	}
 	lhmslv_free(pstate->pcounts_by_group);
+	space_saving_free(pstate->psketch);
+	free(pstate->error_field_name);
 	pstate->pgroup_by_field_names = NULL;
 	pstate->pcounts_by_group = NULL;
 	ap_free(pstate->pargp);
@@ -169,32 +198,45 @@ static sllv_t* mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t*
 	mapper_most_or_least_frequent_state_t* pstate = pvstate;
 
 	if (pinrec != NULL) { // Not end of input record stream
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (pstate->psketch != NULL) {
+			if (group_key_select(pgroup_key, pinrec))
+				space_saving_add(pstate->psketch, pgroup_key->pvalues, pgroup_key->hash);
+		} else if (group_key_select(pgroup_key, pinrec)) {
+			unsigned long long* pcount = lhmslv_get_with_hash(pstate->pcounts_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (pcount == NULL) {
 				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+				lhmslv_put_with_hash(pstate->pcounts_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+					pcount, FREE_ENTRY_KEY);
 			} else {
 				(*pcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
 
 	} else { // End of input record stream
 
-		// Copy keys and counters from hashmap to array for sorting
-		int input_length = pstate->pcounts_by_group->num_occupied;
+		// Copy keys and counters from hashmap, or sketch, to array for sorting
+		space_saving_t* psketch = pstate->psketch;
+		int input_length = (psketch != NULL) ? psketch->num_counters : pstate->pcounts_by_group->num_occupied;
 		sort_pair_t* sort_pairs = mlr_malloc_or_die(input_length * sizeof(sort_pair_t));
 		int i = 0;
-		for (lhmslve_t* pe = pstate->pcounts_by_group->phead; pe != NULL; pe = pe->pnext) {
-			sort_pairs[i].pgroup_by_field_values = pe->key;
-			sort_pairs[i].count = *(long long *)pe->pvvalue;
-			i++;
+		if (psketch != NULL) {
+			for ( ; i < input_length; i++) {
+				sort_pairs[i].pgroup_by_field_values = psketch->pcounters[i].pkey;
+				sort_pairs[i].count = psketch->pcounters[i].count;
+				sort_pairs[i].error = psketch->pcounters[i].error;
+			}
+		} else {
+			for (lhmslve_t* pe = pstate->pcounts_by_group->phead; pe != NULL; pe = pe->pnext) {
+				sort_pairs[i].pgroup_by_field_values = pe->key;
+				sort_pairs[i].count = *(long long *)pe->pvvalue;
+				sort_pairs[i].error = 0LL;
+				i++;
+			}
 		}
 
 		// Sort by count
@@ -215,6 +257,9 @@ static sllv_t* mapper_most_or_least_frequent_process(lrec_t* pinrec, context_t*
 			if (pstate->show_counts) {
 				lrec_put(poutrec, pstate->output_field_name,
 					mlr_alloc_string_from_ull(sort_pairs[i].count), FREE_ENTRY_VALUE);
+				if (psketch != NULL)
+					lrec_put(poutrec, pstate->error_field_name,
+						mlr_alloc_string_from_ll(sort_pairs[i].error), FREE_ENTRY_VALUE);
 			}
 			sllv_append(poutrecs, poutrec);
 		}
@@ -226,6 +226,7 @@ static mapper_t* mapper_nest_alloc(ap_state_t* pargp, char* argv0,
 	regcomp_or_die(&pstate->regex, pattern, REG_NOSUB);
 	free(pattern);
 
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_nest_free;
 
 	pmapper->pvstate = (void*)pstate;
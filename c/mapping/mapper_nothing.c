@@ -42,6 +42,7 @@ static mapper_t* mapper_nothing_alloc(ap_state_t* pargp, int do_counters, char*
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 	pmapper->pvstate       = NULL;
 	pmapper->pprocess_func = mapper_nothing_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_nothing_free;
 	return pmapper;
 }
@@ -34,6 +34,8 @@ typedef struct _mapper_put_or_filter_state_t {
 	int            put_output_disabled; // mlr put -q
 	int            do_final_filter;     // mlr filter
 	int            negate_final_filter; // mlr filter -x
+
+	sllv_t*        pbatch_outrecs;      // Reused across records in batch mode
 } mapper_put_or_filter_state_t;
 
 typedef struct _expression_info_t {
@@ -74,6 +76,13 @@ static mapper_t* mapper_put_or_filter_alloc(
 static void      mapper_put_or_filter_free(mapper_t* pmapper, context_t* pctx);
 
 static sllv_t*   mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_put_or_filter_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
+static void      mapper_put_or_filter_handle_begin(mapper_put_or_filter_state_t* pstate, context_t* pctx,
+	sllv_t* poutrecs);
+static lrec_t*   mapper_put_or_filter_process_record(mapper_put_or_filter_state_t* pstate, lrec_t* pinrec,
+	context_t* pctx, sllv_t* poutrecs);
+static int       ast_node_writes_output(mlr_dsl_ast_node_t* pnode);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_put_setup = {
@@ -436,6 +445,8 @@ static mapper_t* mapper_put_or_filter_alloc(
 	// Retain the string contents along with any in-pointers from the AST/CST
 	pstate->mlr_dsl_expression = mlr_dsl_expression;
 	pstate->past                     = past;
+	// Check before the CST build, which strips the AST.
+	int can_batch                    = !ast_node_writes_output(past->proot);
 	pstate->pcst                     = mlr_dsl_cst_alloc(past, print_ast, trace_stack_allocation,
 		type_inferencing, flush_every_record, do_final_filter, negate_final_filter);
 	pstate->at_begin                     = TRUE;
@@ -447,12 +458,14 @@ static mapper_t* mapper_put_or_filter_alloc(
 	pstate->plocal_stack                 = local_stack_alloc();
 	pstate->ploop_stack                  = loop_stack_alloc();
 	pstate->pwriter_opts                 = pwriter_opts;
+	pstate->pbatch_outrecs               = sllv_alloc();
 
 	cli_merge_writer_opts(pstate->pwriter_opts, pmain_writer_opts);
 
 	mapper_t* pmapper      = mlr_malloc_or_die(sizeof(mapper_t));
 	pmapper->pvstate       = (void*)pstate;
 	pmapper->pprocess_func = mapper_put_or_filter_process;
+	pmapper->pprocess_batch_func = can_batch ? mapper_put_or_filter_process_batch : NULL;
 	pmapper->pfree_func    = mapper_put_or_filter_free;
 
 	return pmapper;
@@ -469,11 +482,44 @@ static void mapper_put_or_filter_free(mapper_t* pmapper, context_t* pctx) {
 	// Free what's left of the stripped AST after the CST reorganized it.
 	mlr_dsl_ast_free(pstate->past);
 
+	sllv_free(pstate->pbatch_outrecs);
 	free(pstate->pwriter_opts);
 	free(pstate);
 	free(pmapper);
 }
 
+// ----------------------------------------------------------------
+// In batch mode, the main block runs for all of a batch's records before any
+// of them are written; output from print, tee, dump, redirected emit, etc.
+// would then come out in a different order relative to the record stream than
+// it does record-at-a-time. So, such expressions don't get the batch entry point.
+static int ast_node_writes_output(mlr_dsl_ast_node_t* pnode) {
+	switch (pnode->type) {
+	case MD_AST_NODE_TYPE_PIPE:
+	case MD_AST_NODE_TYPE_FILE_WRITE:
+	case MD_AST_NODE_TYPE_FILE_APPEND:
+	case MD_AST_NODE_TYPE_TEE:
+	case MD_AST_NODE_TYPE_DUMP:
+	case MD_AST_NODE_TYPE_EDUMP:
+	case MD_AST_NODE_TYPE_PRINT:
+	case MD_AST_NODE_TYPE_PRINTN:
+	case MD_AST_NODE_TYPE_EPRINT:
+	case MD_AST_NODE_TYPE_EPRINTN:
+	case MD_AST_NODE_TYPE_STDOUT:
+	case MD_AST_NODE_TYPE_STDERR:
+		return TRUE;
+	default:
+		break;
+	}
+	if (pnode->pchildren != NULL) {
+		for (sllve_t* pe = pnode->pchildren->phead; pe != NULL; pe = pe->pnext) {
+			if (ast_node_writes_output(pe->pvvalue))
+				return TRUE;
+		}
+	}
+	return FALSE;
+}
+
 // ----------------------------------------------------------------
 // The typed-overlay holds intermediate values such as in
 //
@@ -530,36 +576,8 @@ static sllv_t* mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, voi
 	sllv_t* poutrecs = sllv_alloc();
 	int should_emit_rec = TRUE;
 
-	if (pstate->at_begin) {
-		string_array_t* pregex_captures = NULL; // May be set to non-null on evaluation
-
-		variables_t variables = (variables_t) {
-			.pinrec           = NULL,
-			.ptyped_overlay   = NULL,
-			.poosvars         = pstate->poosvars,
-			.ppregex_captures = &pregex_captures,
-			.pctx             = pctx,
-			.plocal_stack     = pstate->plocal_stack,
-			.ploop_stack      = pstate->ploop_stack,
-			.return_state = {
-				.returned = FALSE,
-				.retval = box_ephemeral_val(mv_absent()),
-			},
-			.trace_execution              = pstate->trace_execution,
-			.json_quote_int_keys          = pstate->pwriter_opts->json_quote_int_keys,
-			.json_quote_non_string_values = pstate->pwriter_opts->json_quote_non_string_values,
-		};
-		cst_outputs_t cst_outputs = (cst_outputs_t) {
-			.pshould_emit_rec             = &should_emit_rec,
-			.poutrecs                     = poutrecs,
-			.oosvar_flatten_separator     = pstate->oosvar_flatten_separator,
-			.pwriter_opts                 = pstate->pwriter_opts,
-		};
-
-		string_array_free(pregex_captures);
-		mlr_dsl_cst_handle_top_level_statement_blocks(pstate->pcst->pbegin_blocks, &variables, &cst_outputs);
-		pstate->at_begin = FALSE;
-	}
+	if (pstate->at_begin)
+		mapper_put_or_filter_handle_begin(pstate, pctx, poutrecs);
 
 	if (pinrec == NULL) { // End of input stream
 		string_array_t* pregex_captures = NULL; // May be set to non-null on evaluation
@@ -594,10 +612,84 @@ static sllv_t* mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, voi
 		return poutrecs;
 	}
 
+	lrec_t* poutrec = mapper_put_or_filter_process_record(pstate, pinrec, pctx, poutrecs);
+	if (poutrec != NULL)
+		sllv_append(poutrecs, poutrec);
+	return poutrecs;
+}
+
+// ----------------------------------------------------------------
+// The context is the stream's, with NR and FNR set per record from the batch.
+static void mapper_put_or_filter_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	mapper_put_or_filter_state_t* pstate = (mapper_put_or_filter_state_t*)pvstate;
+	sllv_t* poutrecs = pstate->pbatch_outrecs;
+	context_t ctx = *pctx;
+
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		ctx.nr  = pentry->nr;
+		ctx.fnr = pentry->fnr;
+
+		if (pstate->at_begin)
+			mapper_put_or_filter_handle_begin(pstate, &ctx, poutrecs);
+
+		lrec_t* poutrec = mapper_put_or_filter_process_record(pstate, pentry->prec, &ctx, poutrecs);
+
+		// Emitted records precede the current record, as in the non-batch case.
+		while (poutrecs->phead != NULL)
+			lrec_batch_append(poutbatch, sllv_pop(poutrecs), pentry->nr, pentry->fnr);
+		if (poutrec != NULL)
+			lrec_batch_append(poutbatch, poutrec, pentry->nr, pentry->fnr);
+	}
+}
+
+// ----------------------------------------------------------------
+static void mapper_put_or_filter_handle_begin(mapper_put_or_filter_state_t* pstate, context_t* pctx,
+	sllv_t* poutrecs)
+{
+	int should_emit_rec = TRUE;
+	string_array_t* pregex_captures = NULL; // May be set to non-null on evaluation
+
+	variables_t variables = (variables_t) {
+		.pinrec           = NULL,
+		.ptyped_overlay   = NULL,
+		.poosvars         = pstate->poosvars,
+		.ppregex_captures = &pregex_captures,
+		.pctx             = pctx,
+		.plocal_stack     = pstate->plocal_stack,
+		.ploop_stack      = pstate->ploop_stack,
+		.return_state = {
+			.returned = FALSE,
+			.retval = box_ephemeral_val(mv_absent()),
+		},
+		.trace_execution              = pstate->trace_execution,
+		.json_quote_int_keys          = pstate->pwriter_opts->json_quote_int_keys,
+		.json_quote_non_string_values = pstate->pwriter_opts->json_quote_non_string_values,
+	};
+	cst_outputs_t cst_outputs = (cst_outputs_t) {
+		.pshould_emit_rec             = &should_emit_rec,
+		.poutrecs                     = poutrecs,
+		.oosvar_flatten_separator     = pstate->oosvar_flatten_separator,
+		.pwriter_opts                 = pstate->pwriter_opts,
+	};
+
+	string_array_free(pregex_captures);
+	mlr_dsl_cst_handle_top_level_statement_blocks(pstate->pcst->pbegin_blocks, &variables, &cst_outputs);
+	pstate->at_begin = FALSE;
+}
+
+// ----------------------------------------------------------------
+// Runs the main block on the record, appending any emitted records to
+// poutrecs. Returns the record to be passed along, or null if filtered out.
+static lrec_t* mapper_put_or_filter_process_record(mapper_put_or_filter_state_t* pstate, lrec_t* pinrec,
+	context_t* pctx, sllv_t* poutrecs)
+{
 	lhmsmv_t* ptyped_overlay = lhmsmv_alloc();
 	string_array_t* pregex_captures = NULL; // May be set to non-null on evaluation
 
-	should_emit_rec = TRUE;
+	int should_emit_rec = TRUE;
 
 	variables_t variables = (variables_t) {
 		.pinrec           = pinrec, // Note variables.pinrec pointer can update on '$* = ...'
@@ -646,9 +738,9 @@ static sllv_t* mapper_put_or_filter_process(lrec_t* pinrec, context_t* pctx, voi
 
 	// Note variables.pinrec pointer can update on '$* = ...'
 	if (should_emit_rec && !pstate->put_output_disabled) {
-		sllv_append(poutrecs, variables.pinrec);
+		return variables.pinrec;
 	} else {
 		lrec_free(variables.pinrec);
+		return NULL;
 	}
-	return poutrecs;
 }
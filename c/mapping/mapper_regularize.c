@@ -49,6 +49,7 @@ static mapper_t* mapper_regularize_alloc() {
 
 	pmapper->pvstate       = (void*)pstate;
 	pmapper->pprocess_func = mapper_regularize_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_regularize_free;
 
 	return pmapper;
@@ -52,6 +52,7 @@ static mapper_t* mapper_remove_empty_columns_alloc() {
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_remove_empty_columns_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_remove_empty_columns_free;
 
 	return pmapper;
@@ -29,6 +29,12 @@ static mapper_t* mapper_rename_alloc(ap_state_t* pargp, lhmss_t* pold_to_new, in
 static void      mapper_rename_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_rename_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 static sllv_t*   mapper_rename_regex_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static void      mapper_rename_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
+static void      mapper_rename_regex_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate);
+static void      mapper_rename(lrec_t* pinrec, mapper_rename_state_t* pstate);
+static void      mapper_rename_regex(lrec_t* pinrec, mapper_rename_state_t* pstate);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_rename_setup = {
@@ -114,6 +120,7 @@ static mapper_t* mapper_rename_alloc(ap_state_t* pargp, lhmss_t* pold_to_new, in
 	pstate->pargp = pargp;
 	if (do_regexes) {
 		pmapper->pprocess_func = mapper_rename_regex_process;
+		pmapper->pprocess_batch_func = mapper_rename_regex_process_batch;
 		pstate->pold_to_new    = pold_to_new;
 		pstate->pregex_pairs   = sllv_alloc();
 
@@ -131,6 +138,7 @@ static mapper_t* mapper_rename_alloc(ap_state_t* pargp, lhmss_t* pold_to_new, in
 		pstate->do_gsub = do_gsub;
 	} else {
 		pmapper->pprocess_func = mapper_rename_process;
+		pmapper->pprocess_batch_func = mapper_rename_process_batch;
 		pstate->pold_to_new    = pold_to_new;
 		pstate->pregex_pairs   = NULL;
 		pstate->psb            = NULL;
@@ -163,14 +171,7 @@ static void mapper_rename_free(mapper_t* pmapper, context_t* _) {
 // ----------------------------------------------------------------
 static sllv_t* mapper_rename_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	if (pinrec != NULL) {
-		mapper_rename_state_t* pstate = (mapper_rename_state_t*)pvstate;
-		for (lhmsse_t* pe = pstate->pold_to_new->phead; pe != NULL; pe = pe->pnext) {
-			char* old_name = pe->key;
-			char* new_name = pe->value;
-			if (lrec_get(pinrec, old_name) != NULL) {
-				lrec_rename(pinrec, old_name, new_name, FALSE);
-			}
-		}
+		mapper_rename(pinrec, pvstate);
 		return sllv_single(pinrec);
 	}
 	else {
@@ -178,42 +179,74 @@ static sllv_t* mapper_rename_process(lrec_t* pinrec, context_t* pctx, void* pvst
 	}
 }
 
-static sllv_t* mapper_rename_regex_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
-	if (pinrec != NULL) {
-		mapper_rename_state_t* pstate = (mapper_rename_state_t*)pvstate;
+static void mapper_rename_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		mapper_rename(pentry->prec, pvstate);
+		lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+	}
+}
 
-		for (sllve_t* pe = pstate->pregex_pairs->phead; pe != NULL; pe = pe->pnext) {
-			regex_pair_t* ppair = pe->pvvalue;
-			regex_t* pregex = &ppair->regex;
-			char* replacement = ppair->replacement;
-			for (lrece_t* pf = pinrec->phead; pf != NULL; pf = pf->pnext) {
-				int matched = FALSE;
-				int all_captured = FALSE;
-				char* old_name = pf->key;
-				if (pstate->do_gsub) {
-					char free_flags = NO_FREE;
-					char* new_name = regex_gsub(old_name, pregex, pstate->psb, replacement, &matched,
-						&all_captured, &free_flags);
-					int new_needs_freeing = FALSE;
-					if (free_flags & FREE_ENTRY_VALUE)
-						new_needs_freeing = TRUE;
-					if (matched)
-						lrec_rename(pinrec, old_name, new_name, new_needs_freeing);
-				} else {
-					char* new_name = regex_sub(old_name, pregex, pstate->psb, replacement, &matched,
-						&all_captured);
-					if (matched) {
-						lrec_rename(pinrec, old_name, new_name, TRUE);
-					} else {
-						free(new_name);
-					}
-				}
-			}
+static void mapper_rename(lrec_t* pinrec, mapper_rename_state_t* pstate) {
+	for (lhmsse_t* pe = pstate->pold_to_new->phead; pe != NULL; pe = pe->pnext) {
+		char* old_name = pe->key;
+		char* new_name = pe->value;
+		if (lrec_get(pinrec, old_name) != NULL) {
+			lrec_rename(pinrec, old_name, new_name, FALSE);
 		}
+	}
+}
 
+// ----------------------------------------------------------------
+static sllv_t* mapper_rename_regex_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	if (pinrec != NULL) {
+		mapper_rename_regex(pinrec, pvstate);
 		return sllv_single(pinrec);
 	}
 	else {
 		return sllv_single(NULL);
 	}
 }
+
+static void mapper_rename_regex_process_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch,
+	context_t* pctx, void* pvstate)
+{
+	for (int i = 0; i < pinbatch->length; i++) {
+		lrec_batch_entry_t* pentry = &pinbatch->pentries[i];
+		mapper_rename_regex(pentry->prec, pvstate);
+		lrec_batch_append(poutbatch, pentry->prec, pentry->nr, pentry->fnr);
+	}
+}
+
+static void mapper_rename_regex(lrec_t* pinrec, mapper_rename_state_t* pstate) {
+	for (sllve_t* pe = pstate->pregex_pairs->phead; pe != NULL; pe = pe->pnext) {
+		regex_pair_t* ppair = pe->pvvalue;
+		regex_t* pregex = &ppair->regex;
+		char* replacement = ppair->replacement;
+		for (lrece_t* pf = pinrec->phead; pf != NULL; pf = pf->pnext) {
+			int matched = FALSE;
+			int all_captured = FALSE;
+			char* old_name = pf->key;
+			if (pstate->do_gsub) {
+				char free_flags = NO_FREE;
+				char* new_name = regex_gsub(old_name, pregex, pstate->psb, replacement, &matched,
+					&all_captured, &free_flags);
+				int new_needs_freeing = FALSE;
+				if (free_flags & FREE_ENTRY_VALUE)
+					new_needs_freeing = TRUE;
+				if (matched)
+					lrec_rename(pinrec, old_name, new_name, new_needs_freeing);
+			} else {
+				char* new_name = regex_sub(old_name, pregex, pstate->psb, replacement, &matched,
+					&all_captured);
+				if (matched) {
+					lrec_rename(pinrec, old_name, new_name, TRUE);
+				} else {
+					free(new_name);
+				}
+			}
+		}
+	}
+}
@@ -78,6 +78,7 @@ static mapper_t* mapper_reorder_alloc(ap_state_t* pargp, slls_t* pfield_name_lis
 
 	pmapper->pvstate       = (void*)pstate;
 	pmapper->pprocess_func = mapper_reorder_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_reorder_free;
 
 	return pmapper;
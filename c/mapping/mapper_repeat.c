@@ -114,6 +114,7 @@ static mapper_t* mapper_repeat_alloc(ap_state_t* pargp, long long repeat_count,
 	else
 		pmapper->pprocess_func  = mapper_repeat_process_nop;
 
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func     = mapper_repeat_free;
 
 	return pmapper;
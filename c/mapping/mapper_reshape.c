@@ -247,6 +247,7 @@ static mapper_t* mapper_reshape_alloc(
 		pstate->other_keys_to_other_values_to_buckets = lhmslv_alloc();
 	}
 
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_reshape_free;
 
 	pmapper->pvstate = (void*)pstate;
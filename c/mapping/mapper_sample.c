@@ -27,6 +27,7 @@ void             sample_bucket_handle(sample_bucket_t* pbucket, lrec_t* prec, in
 typedef struct _mapper_sample_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	unsigned long long sample_count;
 	lhmslv_t* pbuckets_by_group;
 } mapper_sample_state_t;
@@ -90,11 +91,13 @@ static mapper_t* mapper_sample_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_
 
 	pstate->pargp                 = pargp;
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
+	pstate->pgroup_key            = group_key_alloc(pgroup_by_field_names);
 	pstate->sample_count          = sample_count;
 	pstate->pbuckets_by_group     = lhmslv_alloc();
 
 	pmapper->pvstate              = pstate;
 	pmapper->pprocess_func        = mapper_sample_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func           = mapper_sample_free;
 
 	return pmapper;
@@ -104,6 +107,7 @@ static void mapper_sample_free(mapper_t* pmapper, context_t* _) {
 	mapper_sample_state_t* pstate = pmapper->pvstate;
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
 	for (lhmslve_t* pa = pstate->pbuckets_by_group->phead; pa != NULL; pa = pa->pnext) {
 		sample_bucket_t* pbucket = pa->pvvalue;
@@ -119,17 +123,16 @@ static void mapper_sample_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_sample_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_sample_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			sample_bucket_t* pbucket = lhmslv_get(pstate->pbuckets_by_group, pgroup_by_field_values);
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (group_key_select(pgroup_key, pinrec)) {
+			sample_bucket_t* pbucket = lhmslv_get_with_hash(pstate->pbuckets_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (pbucket == NULL) {
 				pbucket = sample_bucket_alloc(pstate->sample_count);
-				lhmslv_put(pstate->pbuckets_by_group, slls_copy(pgroup_by_field_values), pbucket,
-					FREE_ENTRY_KEY);
+				lhmslv_put_with_hash(pstate->pbuckets_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+					pbucket, FREE_ENTRY_KEY);
 			}
 			sample_bucket_handle(pbucket, pinrec, pctx->nr);
-			slls_free(pgroup_by_field_values);
 		} else {
 			lrec_free(pinrec);
 		}
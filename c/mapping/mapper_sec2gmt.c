@@ -103,6 +103,7 @@ static mapper_t* mapper_sec2gmt_alloc(slls_t* pfield_names, int num_decimal_plac
 
 	pmapper->pprocess_func = mapper_sec2gmt_process;
 	pmapper->pvstate       = (void*)pstate;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_sec2gmt_free;
 
 	return pmapper;
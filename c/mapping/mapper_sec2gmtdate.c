@@ -61,6 +61,7 @@ static mapper_t* mapper_sec2gmtdate_alloc(slls_t* pfield_names)
 	pstate->pfield_names = pfield_names;
 	pmapper->pprocess_func = mapper_sec2gmtdate_process;
 	pmapper->pvstate       = (void*)pstate;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_sec2gmtdate_free;
 
 	return pmapper;
@@ -103,6 +103,7 @@ static mapper_t* mapper_seqgen_alloc(ap_state_t* pargp, char* field_name, mv_t s
 	pstate->step           = step;
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_seqgen_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_seqgen_free;
 
 	return pmapper;
@@ -9,19 +9,22 @@
 #include "containers/lhmslv.h"
 #include "containers/lhmsv.h"
 #include "containers/mixutil.h"
+#include "containers/lrec_store.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
 // ----------------------------------------------------------------
 typedef struct _mapper_shuffle_state_t {
-	ap_state_t* pargp;
-	sllv_t*     precs;
+	ap_state_t*   pargp;
+	lrec_store_t* pstore;
+	long long*    images;     // The permutation, at end of stream
+	long long     num_output; // At end of stream
 } mapper_shuffle_state_t;
 
 static void      mapper_shuffle_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_shuffle_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
-static mapper_t* mapper_shuffle_alloc(ap_state_t* pargp);
+static mapper_t* mapper_shuffle_alloc(ap_state_t* pargp, long long mem_budget, char* tmpdir);
 static void      mapper_shuffle_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_shuffle_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -35,38 +38,55 @@ mapper_setup_t mapper_shuffle_setup = {
 
 // ----------------------------------------------------------------
 static void mapper_shuffle_usage(FILE* o, char* argv0, char* verb) {
-	fprintf(o, "Usage: %s %s {no options}\n", argv0, verb);
+	fprintf(o, "Usage: %s %s [options]\n", argv0, verb);
 	fprintf(o, "Outputs records randomly permuted. No output records are produced until\n");
 	fprintf(o, "all input records are read.\n");
+	fprintf(o, "Options:\n");
+	fprintf(o, "--mem {size}   Memory budget for the records held, e.g. 500M or 4G. Past it,\n");
+	fprintf(o, "               they are written to a temporary file. Default: no limit.\n");
+	fprintf(o, "--tmpdir {dir} Directory for that file. Default: $TMPDIR, else /tmp.\n");
 	fprintf(o, "See also %s bootstrap and %s sample.\n", argv0, argv0);
 }
 
 static mapper_t* mapper_shuffle_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __)
 {
+	char* mem_budget_string = NULL;
+	char* tmpdir = NULL;
+	long long mem_budget = 0LL;
+
 	char* verb = argv[(*pargi)++];
 
 	ap_state_t* pstate = ap_alloc();
+	ap_define_string_flag(pstate, "--mem",    &mem_budget_string);
+	ap_define_string_flag(pstate, "--tmpdir", &tmpdir);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_shuffle_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (mem_budget_string != NULL && !mlr_try_byte_count_from_string(mem_budget_string, &mem_budget)) {
+		mapper_shuffle_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
-	return mapper_shuffle_alloc(pstate);
+	return mapper_shuffle_alloc(pstate, mem_budget, tmpdir);
 }
 
 // ----------------------------------------------------------------
-static mapper_t* mapper_shuffle_alloc(ap_state_t* pargp) {
+static mapper_t* mapper_shuffle_alloc(ap_state_t* pargp, long long mem_budget, char* tmpdir) {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
 	mapper_shuffle_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_shuffle_state_t));
 
-	pstate->pargp = pargp;
-	pstate->precs = sllv_alloc();
+	pstate->pargp      = pargp;
+	pstate->pstore     = lrec_store_alloc(mem_budget, tmpdir);
+	pstate->images     = NULL;
+	pstate->num_output = 0LL;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_shuffle_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_shuffle_free;
 
 	return pmapper;
@@ -74,8 +94,8 @@ static mapper_t* mapper_shuffle_alloc(ap_state_t* pargp) {
 
 static void mapper_shuffle_free(mapper_t* pmapper, context_t* _) {
 	mapper_shuffle_state_t* pstate = pmapper->pvstate;
-	// Records will have been freed by the emitter; here, free the list structure.
-	sllv_free(pstate->precs);
+	lrec_store_free(pstate->pstore);
+	free(pstate->images);
 	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
@@ -87,54 +107,45 @@ static sllv_t* mapper_shuffle_process(lrec_t* pinrec, context_t* pctx, void* pvs
 
 	// Not end of input stream: retain the record, and emit nothing until end of stream.
 	if (pinrec != NULL) {
-		sllv_append(pstate->precs, pinrec);
+		lrec_store_append(pstate->pstore, pinrec);
+		lrec_free(pinrec);
 		return NULL;
 	}
 
-	sllv_t* poutrecs = sllv_alloc();
-
-	// Knuth shuffle:
-	// * Initial permutation is identity.
-	// * Make a pseudorandom permutation using pseudorandom swaps in the image map.
-	int n = pstate->precs->length;
-	int* images = mlr_malloc_or_die(n * sizeof(int));
-	for (int i = 0; i < n; i++)
-		images[i] = i;
-
-	int unused_start = 0;
-	int num_unused   = n;
-	for (int i = 0; i < n; i++) {
-		// Select a pseudorandom element from the pool of unused images.
-		int u = unused_start + num_unused * get_mtrand_double();
-		int temp  = images[u];
-		images[u] = images[i];
-		images[i] = temp;
-
-		// Decrease the size of the pool by 1.  (Yes, unused_start and k always have the same value.
-		// Using two variables wastes neglible memory and makes the code easier to understand.)
-		unused_start++;
-		num_unused--;
-	}
-
-	// Make an array of pointers into the input list.
-	lrec_t** record_array = mlr_malloc_or_die(n * sizeof(lrec_t**));
-	sllve_t* pe = pstate->precs->phead;
-	for (int i = 0; i < n; i++, pe = pe->pnext) {
-		record_array[i] = pe->pvvalue;
-	}
-
-	// Transfer from input array to output list. Because permutations are one-to-one maps,
-	// all input records have ownership transferred exactly once. So, there are no
-	// records to copy here, or free here.
-	for (int i = 0; i < n; i++) {
-		sllv_append(poutrecs, record_array[images[i]]);
+	long long n = pstate->pstore->num_records;
+	if (pstate->images == NULL) {
+		// Knuth shuffle:
+		// * Initial permutation is identity.
+		// * Make a pseudorandom permutation using pseudorandom swaps in the image map.
+		long long* images = mlr_malloc_or_die((n + 1) * sizeof(long long));
+		for (long long i = 0; i < n; i++)
+			images[i] = i;
+
+		long long unused_start = 0;
+		long long num_unused   = n;
+		for (long long i = 0; i < n; i++) {
+			// Select a pseudorandom element from the pool of unused images.
+			long long u = unused_start + num_unused * get_mtrand_double();
+			long long temp = images[u];
+			images[u] = images[i];
+			images[i] = temp;
+
+			// Decrease the size of the pool by 1.  (Yes, unused_start and k always have the same value.
+			// Using two variables wastes neglible memory and makes the code easier to understand.)
+			unused_start++;
+			num_unused--;
+		}
+		pstate->images = images;
 	}
 
-	free(record_array);
-	free(images);
-
-	// Null-terminate the output list to signify end of stream.
-	sllv_append(poutrecs, NULL);
+	// Output is a piece at a time. Each stored record is read back once.
+	sllv_t* poutrecs = sllv_alloc();
+	while (pstate->num_output < n && poutrecs->length < LREC_STORE_OUTPUT_PIECE_SIZE)
+		sllv_append(poutrecs, lrec_store_get(pstate->pstore, pstate->images[pstate->num_output++]));
+	if (pstate->num_output < n)
+		pctx->more_output = TRUE;
+	else
+		sllv_append(poutrecs, NULL); // Null-terminate the output list to signify end of stream.
 	return poutrecs;
 }
 
@@ -63,6 +63,7 @@ static mapper_t* mapper_skip_trivial_records_alloc(ap_state_t* pargp)
 
 	pmapper->pprocess_func = NULL;
 	pmapper->pprocess_func = mapper_skip_trivial_records_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_skip_trivial_records_free;
 	return pmapper;
 }
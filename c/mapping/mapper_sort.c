@@ -4,9 +4,11 @@
 #include <math.h>
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
+#include "lib/mlrsort.h"
 #include "containers/sllv.h"
 #include "containers/slls.h"
 #include "containers/lhmslv.h"
+#include "containers/lrec_spool.h"
 #include "containers/mixutil.h"
 #include "mapping/mappers.h"
 
@@ -24,59 +26,162 @@
 //   pairs ["red","1"], and so on -- we keep a linked list of all the records
 //   having those sort-key values, in the order encountered.
 //
-// * For each of those unique sort-key-value combinations, we also parse the
-//   numerical fields at this point into an array of union-string-double.
-//   E.g. the list ["red", "1.0"] maps to the array ["red", 1.0].
+// * For each of those unique sort-key-value combinations, we also encode the
+//   values at this point into a single byte string which compares, as by
+//   memcmp, the way the values are to sort: strings as their bytes followed by
+//   a zero byte, numbers as eight bytes of order-preserving floating-point
+//   encoding, and every byte inverted for descending keys. E.g. the list
+//   ["red", "1.0"] maps to "red\0" followed by the bytes for 1.0.
 //
-// * The pairing of parsed-value array the linked list of same-key-value records
-//   is called a *bucket*. E.g the records
+// * The pairing of encoded sort key and the linked list of same-key-value
+//   records is called a *bucket*. E.g the records
 //     {"a":"red","b":"circle","x":"1.0","y":"3.9"}
 //     {"a":"red","b":"square","x":"1.0","z":"5.7", "q":"even"}
 //   would both land in the ["red","1.0"] bucket.
 //
 // * Buckets are retained in a hash map: the key is the string-list of the form
-//   ["red","1.0"] and the value is the pairing of parsed-value array ["red",1.0]
-//   ane linked list of records.
+//   ["red","1.0"] and the value is the pairing of encoded sort key and linked
+//   list of records.
 //
 // * Once all the input records are ingested into this hash map, we copy the
-//   bucket-pointers into an array and sort it: this being the pairing of
-//   parsed-value array and linked list of records. The comparator callback for
-//   the sort walks through the parsed-value arrays one slot at a time,
-//   looking at the first difference, e.g. if one has "a"="red" and the other
-//   has "a"="blue". If the first field matches then the sort moves to the
-//   second field, and so on.
+//   bucket-pointers into an array and sort it, on several threads if asked
+//   (--threads). Since all the sort fields are in the one encoded key, this is
+//   a radix sort on its bytes: first field first, then the second field where
+//   the first matches, and so on. The sort is stable, so buckets which sort
+//   equally stay in the order their first records were encountered.
 //
 // * Recall in particular that string keys ["a":"red","x":"1"] and
 //   ["a":"red","x":"1.0"] map to different buckets, but will sort equally.
 //
+// * With a memory budget (--mem), once the records held exceed it, they are
+//   sorted as above and written out to a temporary file as a sorted *run*, and
+//   the hash map starts over empty. Records missing sort keys go to a temporary
+//   file of their own. As runs pile up, the latest several are merged into one
+//   bigger run, so that only so many files are open. At end of stream, the
+//   records still in memory are spilled as the last run, the runs are merged,
+//   using a heap keyed on each run's next record, and the output is returned a
+//   piece at a time.
+//
+// * Records which sort equally come out of the merge as they would from
+//   memory: a bucket at a time, in the order the buckets were first seen, and
+//   within a bucket in the order of the runs they're in. With numeric keys one
+//   such group of records can span several buckets, e.g. x=0 and x=-0 with
+//   "-nf x"; then the merge goes back over the group once per bucket.
+//
+// * With a limit (--limit n), only the first n records of the output are
+//   wanted, so rather than buckets we keep, for each group (-g), a heap of the
+//   n best records so far with the worst of them on top. A record better than
+//   that one displaces it; any other is freed right away. Records which sort
+//   equally come out as they would without the limit: by when their bucket
+//   was first seen, then in the order encountered. For that, with numeric
+//   keys, we also remember when the sort-key values of the kept records were
+//   first seen. Memory is proportional to n, not to the input.
+//
 // ================================================================
 
 #define SORT_NUMERIC    0x80
 #define SORT_DESCENDING 0x40
 
+// Runs merged at once, and the most there are at any time, so as not to have
+// too many files open.
+#define SORT_MAX_MERGE_WIDTH 64
+// Runs of a level merged into one of the next level up. Each record is then
+// rewritten about log-base-this of the number of runs times.
+#define SORT_RUNS_PER_LEVEL 8
+// Records returned per call at end of stream, when merging runs.
+#define SORT_OUTPUT_PIECE_SIZE 1024
+
+typedef struct _sort_bucket_t {
+	mlr_sort_key_t sort_key; // First, for mlr_sort_pointers_by_key. Owns its bytes.
+	sllv_t*        precords;
+} sort_bucket_t;
+
+typedef struct _sort_merge_source_t {
+	lrec_spool_t*         pspool;
+	lrec_t*               prec;              // Next record; null once the run is used up
+	lrec_spool_position_t position;          // Next record's
+	mlr_sort_key_t        sort_key;          // Next record's
+	size_t                sort_key_capacity;
+	int                   index;             // Position of the run, for stability
+	int                   group_number;      // Of the last group read from this run
+	lrec_spool_position_t group_position;    // Where that group starts in this run
+} sort_merge_source_t;
+
+typedef struct _sort_merge_t {
+	int                   num_sources;
+	sort_merge_source_t*  psources;
+	sort_merge_source_t** pheap; // Min-heap on next record, then run position
+	int                   heap_size;
+	int*                  sort_params;
+	group_key_t*          pkey;  // The mapper's; for picking out sort-key values
+	context_t*            pctx;
+	// Groups of records which sort equally; only with numeric keys can they
+	// span buckets. Sort-key values are held as consecutive NUL-terminated
+	// strings.
+	int                   has_numeric_keys;
+	int                   in_group;
+	int                   group_number;
+	mlr_sort_key_t        group_key;
+	size_t                group_key_capacity;
+	char*                 pgroup_values;     // The bucket being output
+	size_t                group_values_capacity;
+	char*                 pnext_values;      // The first other bucket passed over; null if none
+	size_t                next_values_capacity;
+	sllv_t*               pdone_values;      // The buckets already output
+} sort_merge_t;
+
+typedef struct _sort_limit_bucket_t {
+	long long first_seq; // When these sort-key values were first seen
+	long long count;     // Kept records having them
+} sort_limit_bucket_t;
+
+typedef struct _sort_limit_entry_t {
+	mlr_sort_key_t       sort_key;          // Unused for records missing sort keys
+	size_t               sort_key_capacity;
+	long long            first_seq;         // Of the record's bucket, for stability
+	long long            seq;               // Position in the input, for stability
+	sort_limit_bucket_t* pbucket;           // Null unless there are numeric keys
+	lrec_t*              prec;
+} sort_limit_entry_t;
+
+typedef struct _sort_limit_group_t {
+	sort_limit_entry_t** pheap;    // Max-heap of the best records so far
+	long long            heap_size;
+	long long            heap_capacity;
+	sllv_t*              pmissing; // Records missing sort keys, up to the limit, as sort_limit_entry_t*
+} sort_limit_group_t;
+
 typedef struct _mapper_sort_state_t {
 	// Input parameters
 	slls_t* pkey_field_names; // Fields to sort on
 	int*    sort_params;      // Lexical/numeric; ascending/descending
 	int do_sort;              // If false, just do group-by
+	int has_numeric_keys;     // Else equal sort keys mean equal sort-key values
+	long long mem_budget;     // Bytes of records to hold before spilling; 0 for no limit
+	char*   tmpdir;           // Null for the default
+	int     num_threads;      // For sorting the buckets
+	long long limit;          // Records to output, per group; 0 for no limit
+	slls_t* pgroup_by_field_names; // For the limit
+	group_key_t* pkey;        // Scratch space used per-record
 	// Sort state: buckets of like records.
 	lhmslv_t* pbuckets_by_key_field_values;
 	sllv_t*   precords_missing_sort_keys;
+	// External-sort state
+	long long     mem_used;       // Approximate bytes of records held
+	sllv_t*       pruns;          // Sorted runs on disk, as lrec_spool_t*, in order
+	int           run_levels[SORT_MAX_MERGE_WIDTH]; // Per run: how many merges deep
+	lrec_spool_t* pmissing_spool; // Records missing sort keys, once anything is spilled
+	sort_merge_t* pmerge;         // At end of stream, once there are runs
+	// Sort-with-limit state
+	group_key_t*   pgroup_key;
+	lhmslv_t*      plimit_groups;
+	lhmslv_t*      plimit_buckets;    // Sort-key values to sort_limit_bucket_t*, with numeric keys
+	long long      num_records_kept;  // With sort keys, over all groups
+	long long      num_records_seen;
+	unsigned char* plimit_key_buffer; // Scratch space used per-record
+	size_t         limit_key_capacity;
 } mapper_sort_state_t;
 
-// Each sort key is string or number; use union to save space.
-typedef struct _typed_sort_key_t {
-	union {
-		char*  s;
-		double d;
-	} u;
-} typed_sort_key_t;
-
-typedef struct _sort_bucket_t {
-	typed_sort_key_t* typed_sort_keys;
-	sllv_t*           precords;
-} sort_bucket_t;
-
 // ----------------------------------------------------------------
 static void      mapper_sort_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_sort_parse_cli(int* pargi, int argc, char** argv,
@@ -84,19 +189,34 @@ static mapper_t* mapper_sort_parse_cli(int* pargi, int argc, char** argv,
 static void      mapper_group_by_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_group_by_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
-static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, int do_sort);
+static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, int do_sort,
+	long long mem_budget, char* tmpdir, int num_threads, long long limit, slls_t* pgroup_by_field_names);
 static void      mapper_sort_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_sort_process_limited(lrec_t* pinrec, context_t* pctx, void* pvstate);
+static sllv_t*   mapper_sort_emit_limited(mapper_sort_state_t* pstate);
+static sllv_t*   mapper_sort_take_sorted_records(mapper_sort_state_t* pstate);
+static void      mapper_sort_spill(mapper_sort_state_t* pstate, context_t* pctx);
+static void      mapper_sort_merge_latest_runs(mapper_sort_state_t* pstate, int num_runs, context_t* pctx);
+static sllv_t*   mapper_sort_emit_merged(mapper_sort_state_t* pstate, context_t* pctx);
 
-static typed_sort_key_t* parse_sort_keys(slls_t* pkey_field_values, int* sort_params, context_t* pctx);
+static sort_limit_group_t* sort_limit_group_alloc();
+static void sort_limit_group_free(sort_limit_group_t* pgroup);
+static sort_limit_entry_t* sort_limit_group_insert(sort_limit_group_t* pgroup, unsigned char* bytes,
+	size_t length, long long first_seq, long long seq, lrec_t* prec);
+static sort_limit_entry_t* sort_limit_group_replace_top(sort_limit_group_t* pgroup, unsigned char* bytes,
+	size_t length, long long first_seq, long long seq, lrec_t* prec);
+static sort_limit_bucket_t* sort_limit_hold_bucket(mapper_sort_state_t* pstate, sort_limit_bucket_t* pbucket,
+	long long seq);
+static void sort_limit_free_buckets(lhmslv_t* pbuckets);
 
-// qsort is non-reentrant but qsort_r isn't portable. But since Miller is
-// single-threaded, even if we've got one sort chained to another, only one is
-// active at a time. We adopt the convention that we set the sort params
-// right before the sort.
-static int* pcmp_sort_params  = NULL;
-static int  cmp_params_length = 0;
-static int pbucket_comparator(const void* pva, const void* pvb);
+static sort_merge_t* sort_merge_alloc(sllv_t* pruns, mapper_sort_state_t* pstate, context_t* pctx);
+static void          sort_merge_free(sort_merge_t* pmerge);
+static lrec_t*       sort_merge_next(sort_merge_t* pmerge);
+
+static size_t encode_sort_keys(slls_t* pkey_field_values, int* sort_params, unsigned char** pbuffer,
+	size_t* pcapacity, context_t* pctx);
+static unsigned char* encode_sort_double(unsigned char* p, double d, int sort_param);
 
 // ----------------------------------------------------------------
 mapper_setup_t mapper_sort_setup = {
@@ -122,6 +242,16 @@ static void mapper_sort_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "  -nf {comma-separated field names}  Same as -n\n");
 	fprintf(o, "  -r  {comma-separated field names}  Lexical descending\n");
 	fprintf(o, "  -nr {comma-separated field names}  Numerical descending; nulls sort first\n");
+	fprintf(o, "  --mem {size}    Memory budget for the records held, e.g. 500M or 4G. Past it,\n");
+	fprintf(o, "                  sorted runs are written to temporary files and merged at end\n");
+	fprintf(o, "                  of stream. Default: no limit.\n");
+	fprintf(o, "  --tmpdir {dir}  Directory for those files. Default: $TMPDIR, else /tmp.\n");
+	fprintf(o, "  --threads {n}   Sort on n threads, e.g. the number of cores. Default: 1.\n");
+	fprintf(o, "  --limit {n}     Output only the first n records, as with \"then head -n {n}\",\n");
+	fprintf(o, "                  but holding only that many in memory.\n");
+	fprintf(o, "  -g {a,b,c}      With --limit: the first n records for each distinct value of\n");
+	fprintf(o, "                  these fields, as with \"then head -n {n} -g {a,b,c}\". Records\n");
+	fprintf(o, "                  lacking them are dropped.\n");
 	fprintf(o, "Sorts records primarily by the first specified field, secondarily by the second\n");
 	fprintf(o, "field, and so on.  (Any records not having all specified sort keys will appear\n");
 	fprintf(o, "at the end of the output, in the order they were encountered, regardless of the\n");
@@ -145,6 +275,11 @@ static mapper_t* mapper_sort_parse_cli(int* pargi, int argc, char** argv,
 	*pargi += 1;
 	slls_t* pnames = slls_alloc();
 	slls_t* pflags = slls_alloc();
+	long long mem_budget = 0LL;
+	char* tmpdir = NULL;
+	int num_threads = 1;
+	long long limit = 0LL;
+	slls_t* pgroup_by_field_names = NULL;
 
 	while ((argc - *pargi) >= 1 && argv[*pargi][0] == '-') {
 		if ((argc - *pargi) < 2)
@@ -153,7 +288,33 @@ static mapper_t* mapper_sort_parse_cli(int* pargi, int argc, char** argv,
 		char* value = argv[*pargi+1];
 		*pargi += 2;
 
-		if (streq(flag, "-f")) {
+		if (streq(flag, "--mem")) {
+			if (!mlr_try_byte_count_from_string(value, &mem_budget)) {
+				mapper_sort_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			continue;
+		} else if (streq(flag, "--tmpdir")) {
+			tmpdir = value;
+			continue;
+		} else if (streq(flag, "--threads")) {
+			if (sscanf(value, "%d", &num_threads) != 1 || num_threads <= 0) {
+				mapper_sort_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			continue;
+		} else if (streq(flag, "--limit")) {
+			if (sscanf(value, "%lld", &limit) != 1 || limit <= 0LL) {
+				mapper_sort_usage(stderr, argv[0], verb);
+				return NULL;
+			}
+			continue;
+		} else if (streq(flag, "-g")) {
+			if (pgroup_by_field_names != NULL)
+				slls_free(pgroup_by_field_names);
+			pgroup_by_field_names = slls_from_line(value, ',', FALSE);
+			continue;
+		} else if (streq(flag, "-f")) {
 		} else if (streq(flag, "-n")) {
 		} else if (streq(flag, "-nf")) {
 		} else if (streq(flag, "-r")) {
@@ -172,6 +333,10 @@ static mapper_t* mapper_sort_parse_cli(int* pargi, int argc, char** argv,
 
 	if (pnames->length < 1)
 		mapper_sort_usage(stderr, argv[0], verb);
+	if (pgroup_by_field_names != NULL && limit == 0LL) {
+		mapper_sort_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
 	// Convert the list such as ["-nf","-nf","-r","-r","-r"] into an array of
 	// bit-flags, one per sort-key field.
@@ -190,7 +355,8 @@ static mapper_t* mapper_sort_parse_cli(int* pargi, int argc, char** argv,
 	}
 	slls_free(pflags);
 
-	return mapper_sort_alloc(pnames, opt_array, TRUE);
+	return mapper_sort_alloc(pnames, opt_array, TRUE, mem_budget, tmpdir, num_threads, limit,
+		pgroup_by_field_names);
 }
 
 // ----------------------------------------------------------------
@@ -213,11 +379,13 @@ static mapper_t* mapper_group_by_parse_cli(int* pargi, int argc, char** argv,
 		opt_array[i] = 0;
 
 	*pargi += 2;
-	return mapper_sort_alloc(pnames, opt_array, FALSE);
+	return mapper_sort_alloc(pnames, opt_array, FALSE, 0LL, NULL, 1, 0LL, NULL);
 }
 
 // ----------------------------------------------------------------
-static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, int do_sort) {
+static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, int do_sort,
+	long long mem_budget, char* tmpdir, int num_threads, long long limit, slls_t* pgroup_by_field_names)
+{
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
 	mapper_sort_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_sort_state_t));
@@ -227,9 +395,37 @@ static mapper_t* mapper_sort_alloc(slls_t* pkey_field_names, int* sort_params, i
 	pstate->pbuckets_by_key_field_values = lhmslv_alloc();
 	pstate->precords_missing_sort_keys   = sllv_alloc();
 	pstate->do_sort                      = do_sort;
+	pstate->has_numeric_keys             = FALSE;
+	for (int i = 0; i < pkey_field_names->length; i++)
+		if (sort_params[i] & SORT_NUMERIC)
+			pstate->has_numeric_keys = TRUE;
+	pstate->mem_budget                   = mem_budget;
+	pstate->tmpdir                       = tmpdir;
+	pstate->num_threads                  = num_threads;
+	pstate->limit                        = limit;
+	pstate->pgroup_by_field_names        = NULL;
+	pstate->pkey                         = group_key_alloc(pkey_field_names);
+	pstate->mem_used                     = 0LL;
+	pstate->pruns                        = sllv_alloc();
+	pstate->pmissing_spool               = NULL;
+	pstate->pmerge                       = NULL;
+	pstate->pgroup_key                   = NULL;
+	pstate->plimit_groups                = NULL;
+	pstate->plimit_buckets               = NULL;
+	pstate->num_records_kept             = 0LL;
+	pstate->num_records_seen             = 0LL;
+	pstate->plimit_key_buffer            = NULL;
+	pstate->limit_key_capacity           = 0;
+	if (limit > 0LL) {
+		pstate->pgroup_by_field_names = (pgroup_by_field_names != NULL) ? pgroup_by_field_names : slls_alloc();
+		pstate->pgroup_key            = group_key_alloc(pstate->pgroup_by_field_names);
+		pstate->plimit_groups         = lhmslv_alloc();
+		pstate->plimit_buckets        = lhmslv_alloc();
+	}
 
 	pmapper->pvstate       = pstate;
-	pmapper->pprocess_func = mapper_sort_process;
+	pmapper->pprocess_func = (limit > 0LL) ? mapper_sort_process_limited : mapper_sort_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_sort_free;
 
 	return pmapper;
@@ -240,15 +436,31 @@ static void mapper_sort_free(mapper_t* pmapper, context_t* _) {
 	mapper_sort_state_t* pstate = pmapper->pvstate;
 	if (pstate->pkey_field_names != NULL)
 		slls_free(pstate->pkey_field_names);
+	group_key_free(pstate->pkey);
 	// lhmslv_free will free the hashmap keys; we need to free the void-star hashmap values.
 	for (lhmslve_t* pa = pstate->pbuckets_by_key_field_values->phead; pa != NULL; pa = pa->pnext) {
 		sort_bucket_t* pbucket = pa->pvvalue;
-		free(pbucket->typed_sort_keys);
+		free(pbucket->sort_key.bytes);
 		free(pbucket);
 		// precords freed in emitter
 	}
 	lhmslv_free(pstate->pbuckets_by_key_field_values);
 	sllv_free(pstate->precords_missing_sort_keys);
+	for (sllve_t* pe = pstate->pruns->phead; pe != NULL; pe = pe->pnext)
+		lrec_spool_free(pe->pvvalue);
+	sllv_free(pstate->pruns);
+	lrec_spool_free(pstate->pmissing_spool);
+	sort_merge_free(pstate->pmerge);
+	if (pstate->plimit_groups != NULL) {
+		for (lhmslve_t* pe = pstate->plimit_groups->phead; pe != NULL; pe = pe->pnext)
+			sort_limit_group_free(pe->pvvalue);
+		lhmslv_free(pstate->plimit_groups);
+		sort_limit_free_buckets(pstate->plimit_buckets);
+	}
+	group_key_free(pstate->pgroup_key);
+	if (pstate->pgroup_by_field_names != NULL)
+		slls_free(pstate->pgroup_by_field_names);
+	free(pstate->plimit_key_buffer);
 	free(pstate->sort_params);
 	free(pstate);
 	free(pmapper);
@@ -259,23 +471,35 @@ static sllv_t* mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 	mapper_sort_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
 		// Consume another input record.
-		slls_t* pkey_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pkey_field_names);
-		if (pkey_field_values == NULL) {
+		group_key_t* pkey = pstate->pkey;
+		if (!group_key_select(pkey, pinrec)) {
 			sllv_append(pstate->precords_missing_sort_keys, pinrec);
 		} else {
-			sort_bucket_t* pbucket = lhmslv_get(pstate->pbuckets_by_key_field_values, pkey_field_values);
+			sort_bucket_t* pbucket = lhmslv_get_with_hash(pstate->pbuckets_by_key_field_values,
+				pkey->pvalues, pkey->hash);
 			if (pbucket == NULL) { // New key-field-value: new bucket and hash-map entry
-				slls_t* pkey_field_values_copy = slls_copy(pkey_field_values);
+				slls_t* pkey_field_values_copy = slls_copy(pkey->pvalues);
 				sort_bucket_t* pbucket = mlr_malloc_or_die(sizeof(sort_bucket_t));
-				pbucket->typed_sort_keys = parse_sort_keys(pkey_field_values_copy, pstate->sort_params, pctx);
+				unsigned char* bytes = NULL;
+				size_t capacity = 0;
+				size_t length = encode_sort_keys(pkey_field_values_copy, pstate->sort_params, &bytes, &capacity,
+					pctx);
+				mlr_sort_key_set(&pbucket->sort_key, bytes, length);
 				pbucket->precords = sllv_alloc();
 				sllv_append(pbucket->precords, pinrec);
-				lhmslv_put(pstate->pbuckets_by_key_field_values, pkey_field_values_copy, pbucket,
-					FREE_ENTRY_KEY);
+				lhmslv_put_with_hash(pstate->pbuckets_by_key_field_values, pkey_field_values_copy, pkey->hash,
+					pbucket, FREE_ENTRY_KEY);
+				if (pstate->mem_budget > 0LL)
+					pstate->mem_used += sizeof(sort_bucket_t) + sizeof(sllv_t) + sizeof(lhmslve_t)
+						+ length + pkey->pvalues->length * sizeof(sllse_t);
 			} else { // Previously seen key-field-value: append record to bucket
 				sllv_append(pbucket->precords, pinrec);
 			}
-			slls_free(pkey_field_values);
+		}
+		if (pstate->mem_budget > 0LL) {
+			pstate->mem_used += sizeof(sllve_t) + lrec_approximate_size(pinrec);
+			if (pstate->mem_used > pstate->mem_budget)
+				mapper_sort_spill(pstate, pctx);
 		}
 		return NULL;
 	} else if (!pstate->do_sort) {
@@ -289,87 +513,785 @@ static sllv_t* mapper_sort_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 		sllv_transfer(poutput, pstate->precords_missing_sort_keys);
 		sllv_append(poutput, NULL);
 		return poutput;
+	} else if (pstate->pruns->length == 0 && pstate->pmissing_spool == NULL && pstate->pmerge == NULL) {
+		// End of input stream, with everything in memory
+		sllv_t* poutput = mapper_sort_take_sorted_records(pstate);
+		sllv_transfer(poutput, pstate->precords_missing_sort_keys);
+		sllv_append(poutput, NULL); // Signal end of output-record stream.
+		return poutput;
 	} else {
-		// End of input stream: sort bucket labels
-		int num_buckets = pstate->pbuckets_by_key_field_values->num_occupied;
-		sort_bucket_t** pbucket_array = mlr_malloc_or_die(num_buckets * sizeof(sort_bucket_t*));
-
-		// Copy bucket-pointers to an array for qsort
-		int i = 0;
-		for (lhmslve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
-			pbucket_array[i] = pe->pvvalue;
+		// End of input stream, with records on disk
+		return mapper_sort_emit_merged(pstate, pctx);
+	}
+}
+
+// ----------------------------------------------------------------
+// Sorts the buckets and returns their records in order, leaving the hash map
+// empty.
+static sllv_t* mapper_sort_take_sorted_records(mapper_sort_state_t* pstate) {
+	int num_buckets = pstate->pbuckets_by_key_field_values->num_occupied;
+	sort_bucket_t** pbucket_array = mlr_malloc_or_die(num_buckets * sizeof(sort_bucket_t*));
+
+	// Copy bucket-pointers to an array for sorting
+	int i = 0;
+	for (lhmslve_t* pe = pstate->pbuckets_by_key_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
+		pbucket_array[i] = pe->pvvalue;
+	}
+
+	mlr_sort_pointers_by_key((void**)pbucket_array, num_buckets, pstate->num_threads);
+
+	// Emit each bucket's record
+	sllv_t* poutput = sllv_alloc();
+	for (i = 0; i < num_buckets; i++) {
+		sllv_t* plist = pbucket_array[i]->precords;
+		sllv_transfer(poutput, plist);
+		sllv_free(plist);
+		free(pbucket_array[i]->sort_key.bytes);
+		free(pbucket_array[i]);
+	}
+	free(pbucket_array);
+
+	lhmslv_free(pstate->pbuckets_by_key_field_values);
+	pstate->pbuckets_by_key_field_values = lhmslv_alloc();
+	return poutput;
+}
+
+// ----------------------------------------------------------------
+// Writes the records held so far to disk: those with sort keys as a sorted
+// run, and those without to the end of their own file.
+static void mapper_sort_spill(mapper_sort_state_t* pstate, context_t* pctx) {
+	sllv_t* psorted = mapper_sort_take_sorted_records(pstate);
+	if (psorted->length > 0) {
+		lrec_spool_t* pspool = lrec_spool_alloc(pstate->tmpdir);
+		while (psorted->phead != NULL) {
+			lrec_t* prec = sllv_pop(psorted);
+			lrec_spool_write(pspool, prec);
+			lrec_free(prec);
+		}
+		sllv_append(pstate->pruns, pspool);
+		pstate->run_levels[pstate->pruns->length - 1] = 0;
+
+		// Levels only go down toward the end of the list, so runs of the same
+		// level at the end are adjacent in the input, and merging them keeps
+		// the sort stable.
+		while (TRUE) {
+			int num_runs = pstate->pruns->length;
+			int level = pstate->run_levels[num_runs - 1];
+			int num_like = 1;
+			while (num_like < num_runs && pstate->run_levels[num_runs - 1 - num_like] == level)
+				num_like++;
+			if (num_like >= SORT_RUNS_PER_LEVEL) {
+				mapper_sort_merge_latest_runs(pstate, num_like, pctx);
+				pstate->run_levels[pstate->pruns->length - 1] = level + 1;
+			} else if (num_runs >= SORT_MAX_MERGE_WIDTH) {
+				level = pstate->run_levels[0];
+				mapper_sort_merge_latest_runs(pstate, num_runs, pctx);
+				pstate->run_levels[0] = level + 1;
+			} else {
+				break;
+			}
 		}
+	}
+	sllv_free(psorted);
 
-		pcmp_sort_params  = pstate->sort_params;
-		cmp_params_length = pstate->pkey_field_names->length;
+	if (pstate->precords_missing_sort_keys->length > 0) {
+		if (pstate->pmissing_spool == NULL)
+			pstate->pmissing_spool = lrec_spool_alloc(pstate->tmpdir);
+		while (pstate->precords_missing_sort_keys->phead != NULL) {
+			lrec_t* prec = sllv_pop(pstate->precords_missing_sort_keys);
+			lrec_spool_write(pstate->pmissing_spool, prec);
+			lrec_free(prec);
+		}
+	}
 
-		qsort(pbucket_array, num_buckets, sizeof(sort_bucket_t*), pbucket_comparator);
+	pstate->mem_used = 0LL;
+}
 
-		pcmp_sort_params  = NULL;
-		cmp_params_length = 0;
+// ----------------------------------------------------------------
+// Merges the latest runs into one, which takes their place at the end of the
+// list of runs.
+static void mapper_sort_merge_latest_runs(mapper_sort_state_t* pstate, int num_runs, context_t* pctx) {
+	sllv_t* pmerging = pstate->pruns;
+	pstate->pruns = sllv_alloc();
+	while (pmerging->length > num_runs)
+		sllv_append(pstate->pruns, sllv_pop(pmerging));
 
-		// Emit each bucket's record
-		sllv_t* poutput = sllv_alloc();
-		for (i = 0; i < num_buckets; i++) {
-			sllv_t* plist = pbucket_array[i]->precords;
-			sllv_transfer(poutput, plist);
-			sllv_free(plist);
+	sort_merge_t* pmerge = sort_merge_alloc(pmerging, pstate, pctx);
+	sllv_free(pmerging);
+	lrec_spool_t* pspool = lrec_spool_alloc(pstate->tmpdir);
+	lrec_t* prec;
+	while ((prec = sort_merge_next(pmerge)) != NULL) {
+		lrec_spool_write(pspool, prec);
+		lrec_free(prec);
+	}
+	sort_merge_free(pmerge);
+
+	sllv_append(pstate->pruns, pspool);
+}
+
+// ----------------------------------------------------------------
+// Returns the next piece of output: the merged runs, then the records missing
+// sort keys. The records still in memory at end of stream are spilled as the
+// last run, since the merge may need to read a run more than once.
+static sllv_t* mapper_sort_emit_merged(mapper_sort_state_t* pstate, context_t* pctx) {
+	if (pstate->pmerge == NULL) {
+		mapper_sort_spill(pstate, pctx);
+		pstate->pmerge = sort_merge_alloc(pstate->pruns, pstate, pctx);
+		if (pstate->pmissing_spool != NULL)
+			lrec_spool_rewind(pstate->pmissing_spool);
+	}
+
+	sllv_t* poutput = sllv_alloc();
+	while (poutput->length < SORT_OUTPUT_PIECE_SIZE) {
+		lrec_t* prec = sort_merge_next(pstate->pmerge);
+		if (prec == NULL && pstate->pmissing_spool != NULL)
+			prec = lrec_spool_read(pstate->pmissing_spool);
+		if (prec == NULL) {
+			sllv_append(poutput, NULL); // Signal end of output-record stream.
+			return poutput;
 		}
-		sllv_transfer(poutput, pstate->precords_missing_sort_keys);
-		free(pbucket_array);
-		sllv_append(poutput, NULL); // Signal end of output-record stream.
-		return poutput;
+		sllv_append(poutput, prec);
 	}
+	pctx->more_output = TRUE;
+	return poutput;
 }
 
-static int pbucket_comparator(const void* pva, const void* pvb) {
-	// We are sorting an array of sort_bucket_t*.
-	const sort_bucket_t** pba = (const sort_bucket_t**)pva;
-	const sort_bucket_t** pbb = (const sort_bucket_t**)pvb;
-	typed_sort_key_t* akeys = (*pba)->typed_sort_keys;
-	typed_sort_key_t* bkeys = (*pbb)->typed_sort_keys;
-	for (int i = 0; i < cmp_params_length; i++) {
-		int sort_param = pcmp_sort_params[i];
-		if (sort_param & SORT_NUMERIC) {
-			double a = akeys[i].u.d;
-			double b = bkeys[i].u.d;
-			if (isnan(a)) { // null input value
-				if (!isnan(b)) {
-					return (sort_param & SORT_DESCENDING) ? -1 : 1;
-				}
-			} else if (isnan(b)) {
-					return (sort_param & SORT_DESCENDING) ? 1 : -1;
+// ----------------------------------------------------------------
+static sllv_t* mapper_sort_process_limited(lrec_t* pinrec, context_t* pctx, void* pvstate) {
+	mapper_sort_state_t* pstate = pvstate;
+	if (pinrec == NULL) // End of input stream
+		return mapper_sort_emit_limited(pstate);
+
+	group_key_t* pgroup_key = pstate->pgroup_key;
+	if (!group_key_select(pgroup_key, pinrec)) {
+		lrec_free(pinrec);
+		return NULL;
+	}
+	sort_limit_group_t* pgroup = lhmslv_get_with_hash(pstate->plimit_groups, pgroup_key->pvalues,
+		pgroup_key->hash);
+	if (pgroup == NULL) {
+		pgroup = sort_limit_group_alloc();
+		lhmslv_put_with_hash(pstate->plimit_groups, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+			pgroup, FREE_ENTRY_KEY);
+	}
+	long long seq = pstate->num_records_seen++;
+
+	if (!group_key_select(pstate->pkey, pinrec)) {
+		// Whether these are output depends on how many records with sort keys
+		// the group ends up with, but no more than the limit can be.
+		if (pgroup->pmissing->length < pstate->limit) {
+			sort_limit_entry_t* pentry = mlr_malloc_or_die(sizeof(sort_limit_entry_t));
+			pentry->sort_key.bytes    = NULL;
+			pentry->sort_key_capacity = 0;
+			pentry->first_seq         = seq;
+			pentry->seq               = seq;
+			pentry->pbucket           = NULL;
+			pentry->prec              = pinrec;
+			sllv_append(pgroup->pmissing, pentry);
+		} else {
+			lrec_free(pinrec);
+		}
+		return NULL;
+	}
+
+	size_t length = encode_sort_keys(pstate->pkey->pvalues, pstate->sort_params, &pstate->plimit_key_buffer,
+		&pstate->limit_key_capacity, pctx);
+	sort_limit_bucket_t* pbucket = NULL;
+	long long first_seq = seq;
+	if (pstate->has_numeric_keys) {
+		if (pgroup->heap_size >= pstate->limit) {
+			mlr_sort_key_t sort_key;
+			mlr_sort_key_set(&sort_key, pstate->plimit_key_buffer, length);
+			if (mlr_sort_key_compare(&sort_key, &pgroup->pheap[0]->sort_key) > 0) {
+				lrec_free(pinrec);
+				return NULL;
+			}
+		}
+		pbucket = lhmslv_get_with_hash(pstate->plimit_buckets, pstate->pkey->pvalues, pstate->pkey->hash);
+		if (pbucket != NULL)
+			first_seq = pbucket->first_seq;
+	}
+
+	sort_limit_entry_t* pentry = NULL;
+	if (pgroup->heap_size < pstate->limit) {
+		pentry = sort_limit_group_insert(pgroup, pstate->plimit_key_buffer, length, first_seq, seq, pinrec);
+		pstate->num_records_kept++;
+	} else {
+		pentry = sort_limit_group_replace_top(pgroup, pstate->plimit_key_buffer, length, first_seq, seq, pinrec);
+	}
+	if (pentry == NULL)
+		lrec_free(pinrec);
+	else if (pstate->has_numeric_keys)
+		pentry->pbucket = sort_limit_hold_bucket(pstate, pbucket, seq);
+	return NULL;
+}
+
+static int sort_limit_entry_comparator(void* pva, void* pvb, void* _) {
+	sort_limit_entry_t* pa = pva;
+	sort_limit_entry_t* pb = pvb;
+	int s = mlr_sort_key_compare(&pa->sort_key, &pb->sort_key);
+	if (s != 0)
+		return s;
+	if (pa->first_seq != pb->first_seq)
+		return (pa->first_seq < pb->first_seq) ? -1 : 1;
+	return (pa->seq < pb->seq) ? -1 : (pa->seq > pb->seq) ? 1 : 0;
+}
+
+static int sort_limit_seq_comparator(void* pva, void* pvb, void* _) {
+	sort_limit_entry_t* pa = pva;
+	sort_limit_entry_t* pb = pvb;
+	return (pa->seq < pb->seq) ? -1 : (pa->seq > pb->seq) ? 1 : 0;
+}
+
+// The kept records of all groups, in sort order; then, as far as each group
+// has room left, its records missing sort keys, in input order.
+static sllv_t* mapper_sort_emit_limited(mapper_sort_state_t* pstate) {
+	long long num_kept = 0LL;
+	long long num_missing = 0LL;
+	for (lhmslve_t* pe = pstate->plimit_groups->phead; pe != NULL; pe = pe->pnext) {
+		sort_limit_group_t* pgroup = pe->pvvalue;
+		num_kept += pgroup->heap_size;
+		num_missing += pgroup->pmissing->length;
+	}
+	sort_limit_entry_t** pkept = mlr_malloc_or_die((num_kept + 1) * sizeof(sort_limit_entry_t*));
+	sort_limit_entry_t** pmissing = mlr_malloc_or_die((num_missing + 1) * sizeof(sort_limit_entry_t*));
+	num_kept = 0LL;
+	num_missing = 0LL;
+	for (lhmslve_t* pe = pstate->plimit_groups->phead; pe != NULL; pe = pe->pnext) {
+		sort_limit_group_t* pgroup = pe->pvvalue;
+		for (long long i = 0; i < pgroup->heap_size; i++)
+			pkept[num_kept++] = pgroup->pheap[i];
+		long long room = pstate->limit - pgroup->heap_size;
+		while (pgroup->pmissing->phead != NULL) {
+			sort_limit_entry_t* pentry = sllv_pop(pgroup->pmissing);
+			if (room-- > 0) {
+				pmissing[num_missing++] = pentry;
 			} else {
-				double d = a - b;
-				int s = (d < 0) ? -1 : (d > 0) ? 1 : 0;
-				if (s != 0)
-					return (sort_param & SORT_DESCENDING) ? -s : s;
+				lrec_free(pentry->prec);
+				free(pentry);
 			}
-		} else {
-			int s = strcmp(akeys[i].u.s, bkeys[i].u.s);
-			if (s != 0)
-				return (sort_param & SORT_DESCENDING) ? -s : s;
 		}
+		pgroup->heap_size = 0; // Now owned by the array
+		sort_limit_group_free(pgroup);
+	}
+	lhmslv_free(pstate->plimit_groups);
+	pstate->plimit_groups = lhmslv_alloc();
+	sort_limit_free_buckets(pstate->plimit_buckets);
+	pstate->plimit_buckets = lhmslv_alloc();
+	pstate->num_records_kept = 0LL;
+
+	mlr_sort_pointers((void**)pkept, num_kept, sort_limit_entry_comparator, NULL, 1);
+	mlr_sort_pointers((void**)pmissing, num_missing, sort_limit_seq_comparator, NULL, 1);
+
+	sllv_t* poutput = sllv_alloc();
+	for (long long i = 0; i < num_kept; i++) {
+		sllv_append(poutput, pkept[i]->prec);
+		free(pkept[i]->sort_key.bytes);
+		free(pkept[i]);
+	}
+	for (long long i = 0; i < num_missing; i++) {
+		sllv_append(poutput, pmissing[i]->prec);
+		free(pmissing[i]);
+	}
+	free(pkept);
+	free(pmissing);
+	sllv_append(poutput, NULL); // Signal end of output-record stream.
+	return poutput;
+}
+
+// ================================================================
+// Per-group heaps for sorting with a limit. The top is the worst record kept:
+// the last by sort key, then by when its bucket was first seen, then the last
+// encountered.
+//
+// The buckets of records no longer kept can be forgotten. Within a group, a
+// record is only dropped when it sorts after the top, and so after everything
+// kept since; any later record in its bucket, with the same sort key and
+// bucket but encountered later still, does as well. So while a bucket has
+// records kept in the group, the first of them is its first-seen record in
+// the group, and a forgotten bucket's later records in the group are dropped
+// whatever it's remembered as. With -g, buckets are shared by the groups, as
+// they are without the limit, but only remembered while some group keeps a
+// record in them: if one's first-seen record was dropped from its group, a
+// later group counts it as first seen there.
+
+static void sort_limit_sift_up(sort_limit_group_t* pgroup, long long i);
+static void sort_limit_sift_down(sort_limit_group_t* pgroup, long long i);
+static void sort_limit_entry_set(sort_limit_entry_t* pentry, unsigned char* bytes, size_t length,
+	long long first_seq, long long seq, lrec_t* prec);
+
+static sort_limit_group_t* sort_limit_group_alloc() {
+	sort_limit_group_t* pgroup = mlr_malloc_or_die(sizeof(sort_limit_group_t));
+	pgroup->heap_capacity = 16;
+	pgroup->heap_size     = 0;
+	pgroup->pheap         = mlr_malloc_or_die(pgroup->heap_capacity * sizeof(sort_limit_entry_t*));
+	pgroup->pmissing      = sllv_alloc();
+	return pgroup;
+}
+
+static void sort_limit_group_free(sort_limit_group_t* pgroup) {
+	for (long long i = 0; i < pgroup->heap_size; i++) {
+		lrec_free(pgroup->pheap[i]->prec);
+		free(pgroup->pheap[i]->sort_key.bytes);
+		free(pgroup->pheap[i]);
+	}
+	free(pgroup->pheap);
+	while (pgroup->pmissing->phead != NULL) {
+		sort_limit_entry_t* pentry = sllv_pop(pgroup->pmissing);
+		lrec_free(pentry->prec);
+		free(pentry);
+	}
+	sllv_free(pgroup->pmissing);
+	free(pgroup);
+}
+
+// The sort-key bytes are copied. Returns the new entry.
+static sort_limit_entry_t* sort_limit_group_insert(sort_limit_group_t* pgroup, unsigned char* bytes,
+	size_t length, long long first_seq, long long seq, lrec_t* prec)
+{
+	if (pgroup->heap_size >= pgroup->heap_capacity) {
+		pgroup->heap_capacity *= 2;
+		pgroup->pheap = mlr_realloc_or_die(pgroup->pheap, pgroup->heap_capacity * sizeof(sort_limit_entry_t*));
+	}
+	sort_limit_entry_t* pentry = mlr_malloc_or_die(sizeof(sort_limit_entry_t));
+	pentry->sort_key.bytes    = NULL;
+	pentry->sort_key_capacity = 0;
+	pentry->pbucket           = NULL;
+	sort_limit_entry_set(pentry, bytes, length, first_seq, seq, prec);
+	pgroup->pheap[pgroup->heap_size] = pentry;
+	sort_limit_sift_up(pgroup, pgroup->heap_size++);
+	return pentry;
+}
+
+// If the record sorts before the top one, it takes the top one's place, the
+// top one's record is freed, and the entry is returned. Otherwise returns
+// null, and the caller keeps ownership of the record.
+static sort_limit_entry_t* sort_limit_group_replace_top(sort_limit_group_t* pgroup, unsigned char* bytes,
+	size_t length, long long first_seq, long long seq, lrec_t* prec)
+{
+	sort_limit_entry_t* ptop = pgroup->pheap[0];
+	sort_limit_entry_t entry;
+	mlr_sort_key_set(&entry.sort_key, bytes, length);
+	entry.first_seq = first_seq;
+	entry.seq       = seq;
+	if (sort_limit_entry_comparator(&entry, ptop, NULL) >= 0)
+		return NULL;
+	lrec_free(ptop->prec);
+	if (ptop->pbucket != NULL)
+		ptop->pbucket->count--;
+	ptop->pbucket = NULL;
+	sort_limit_entry_set(ptop, bytes, length, first_seq, seq, prec);
+	sort_limit_sift_down(pgroup, 0);
+	return ptop;
+}
+
+// Counts a newly kept record in its bucket, which is null if not remembered.
+// Forgotten buckets are cleared out now and then, once they outnumber the kept
+// records.
+static sort_limit_bucket_t* sort_limit_hold_bucket(mapper_sort_state_t* pstate, sort_limit_bucket_t* pbucket,
+	long long seq)
+{
+	if (pbucket == NULL) {
+		if (pstate->plimit_buckets->num_occupied >= 2 * pstate->num_records_kept + 16) {
+			lhmslv_t* pbuckets = lhmslv_alloc();
+			for (lhmslve_t* pe = pstate->plimit_buckets->phead; pe != NULL; pe = pe->pnext) {
+				sort_limit_bucket_t* pother = pe->pvvalue;
+				if (pother->count > 0) {
+					lhmslv_put_with_hash(pbuckets, pe->key, pe->hash, pother, FREE_ENTRY_KEY);
+					pe->free_flags &= ~FREE_ENTRY_KEY;
+					pe->pvvalue = NULL;
+				}
+			}
+			sort_limit_free_buckets(pstate->plimit_buckets);
+			pstate->plimit_buckets = pbuckets;
+		}
+		pbucket = mlr_malloc_or_die(sizeof(sort_limit_bucket_t));
+		pbucket->first_seq = seq;
+		pbucket->count     = 0;
+		lhmslv_put_with_hash(pstate->plimit_buckets, slls_copy(pstate->pkey->pvalues), pstate->pkey->hash,
+			pbucket, FREE_ENTRY_KEY);
+	}
+	pbucket->count++;
+	return pbucket;
+}
+
+static void sort_limit_free_buckets(lhmslv_t* pbuckets) {
+	for (lhmslve_t* pe = pbuckets->phead; pe != NULL; pe = pe->pnext)
+		free(pe->pvvalue);
+	lhmslv_free(pbuckets);
+}
+
+static void sort_limit_entry_set(sort_limit_entry_t* pentry, unsigned char* bytes, size_t length,
+	long long first_seq, long long seq, lrec_t* prec)
+{
+	if (length > pentry->sort_key_capacity) {
+		pentry->sort_key.bytes = mlr_realloc_or_die(pentry->sort_key.bytes, length);
+		pentry->sort_key_capacity = length;
+	}
+	memcpy(pentry->sort_key.bytes, bytes, length);
+	mlr_sort_key_set(&pentry->sort_key, pentry->sort_key.bytes, length);
+	pentry->first_seq = first_seq;
+	pentry->seq       = seq;
+	pentry->prec      = prec;
+}
+
+static void sort_limit_sift_up(sort_limit_group_t* pgroup, long long i) {
+	sort_limit_entry_t** pheap = pgroup->pheap;
+	while (i > 0) {
+		long long parent = (i - 1) / 2;
+		if (sort_limit_entry_comparator(pheap[parent], pheap[i], NULL) >= 0)
+			break;
+		sort_limit_entry_t* ptemp = pheap[i];
+		pheap[i] = pheap[parent];
+		pheap[parent] = ptemp;
+		i = parent;
+	}
+}
+
+static void sort_limit_sift_down(sort_limit_group_t* pgroup, long long i) {
+	sort_limit_entry_t** pheap = pgroup->pheap;
+	long long n = pgroup->heap_size;
+	while (TRUE) {
+		long long l = 2*i + 1;
+		long long r = l + 1;
+		long long m = i;
+		if (l < n && sort_limit_entry_comparator(pheap[l], pheap[m], NULL) > 0)
+			m = l;
+		if (r < n && sort_limit_entry_comparator(pheap[r], pheap[m], NULL) > 0)
+			m = r;
+		if (m == i)
+			break;
+		sort_limit_entry_t* ptemp = pheap[i];
+		pheap[i] = pheap[m];
+		pheap[m] = ptemp;
+		i = m;
+	}
+}
+
+// ================================================================
+// K-way merge of sorted runs
+
+static lrec_t* sort_merge_pop(sort_merge_t* pmerge);
+static lrec_t* sort_merge_begin_group(sort_merge_t* pmerge);
+static void    sort_merge_end_pass(sort_merge_t* pmerge);
+static void    sort_merge_heapify(sort_merge_t* pmerge);
+static void    sort_merge_advance(sort_merge_t* pmerge, sort_merge_source_t* psource);
+static int     sort_merge_source_less(sort_merge_t* pmerge, sort_merge_source_t* pa, sort_merge_source_t* pb);
+static void    sort_merge_sift_down(sort_merge_t* pmerge, int i);
+static size_t  sort_merge_join_values(slls_t* pvalues, char** pbuffer, size_t* pcapacity);
+static int     sort_merge_values_equal(char* p, slls_t* pvalues);
+
+// Takes ownership of the runs, which are lrec_spool_t*. The list of runs is
+// left empty.
+static sort_merge_t* sort_merge_alloc(sllv_t* pruns, mapper_sort_state_t* pstate, context_t* pctx) {
+	sort_merge_t* pmerge = mlr_malloc_or_die(sizeof(sort_merge_t));
+	pmerge->num_sources   = pruns->length;
+	pmerge->psources      = mlr_malloc_or_die(pmerge->num_sources * sizeof(sort_merge_source_t));
+	pmerge->pheap         = mlr_malloc_or_die(pmerge->num_sources * sizeof(sort_merge_source_t*));
+	pmerge->heap_size     = 0;
+	pmerge->sort_params   = pstate->sort_params;
+	pmerge->pkey          = pstate->pkey;
+	pmerge->pctx          = pctx;
+
+	pmerge->has_numeric_keys = FALSE;
+	for (int i = 0; i < pstate->pkey_field_names->length; i++)
+		if (pstate->sort_params[i] & SORT_NUMERIC)
+			pmerge->has_numeric_keys = TRUE;
+	pmerge->in_group              = FALSE;
+	pmerge->group_number          = 0;
+	pmerge->group_key.bytes       = NULL;
+	pmerge->group_key_capacity    = 0;
+	pmerge->pgroup_values         = NULL;
+	pmerge->group_values_capacity = 0;
+	pmerge->pnext_values          = NULL;
+	pmerge->next_values_capacity  = 0;
+	pmerge->pdone_values          = sllv_alloc();
+
+	for (int i = 0; i < pmerge->num_sources; i++) {
+		sort_merge_source_t* psource = &pmerge->psources[i];
+		psource->pspool            = sllv_pop(pruns);
+		psource->prec              = NULL;
+		psource->sort_key.bytes    = NULL;
+		psource->sort_key_capacity = 0;
+		psource->index             = i;
+		psource->group_number      = -1;
+		lrec_spool_rewind(psource->pspool);
+		sort_merge_advance(pmerge, psource);
+	}
+	sort_merge_heapify(pmerge);
+
+	return pmerge;
+}
+
+static void sort_merge_free(sort_merge_t* pmerge) {
+	if (pmerge == NULL)
+		return;
+	for (int i = 0; i < pmerge->num_sources; i++) {
+		sort_merge_source_t* psource = &pmerge->psources[i];
+		lrec_free(psource->prec);
+		lrec_spool_free(psource->pspool);
+		free(psource->sort_key.bytes);
+	}
+	free(pmerge->psources);
+	free(pmerge->pheap);
+	free(pmerge->group_key.bytes);
+	free(pmerge->pgroup_values);
+	free(pmerge->pnext_values);
+	while (pmerge->pdone_values->phead != NULL)
+		free(sllv_pop(pmerge->pdone_values));
+	sllv_free(pmerge->pdone_values);
+	free(pmerge);
+}
+
+// Returns null once all the runs are used up.
+//
+// With numeric keys, each group of records which sort equally is read once
+// per bucket in it. The first pass outputs the bucket of the group's first
+// record, and notes the first other bucket it passes over; the next pass, from
+// the start of the group again, outputs that one; and so on. Since the runs
+// are in input order, and within a run buckets are in the order first seen,
+// this is the order the buckets were first seen overall. Nearly always a group
+// is one bucket, and one pass.
+static lrec_t* sort_merge_next(sort_merge_t* pmerge) {
+	if (!pmerge->has_numeric_keys)
+		return sort_merge_pop(pmerge);
+
+	while (TRUE) {
+		if (pmerge->in_group && (pmerge->heap_size == 0
+			|| mlr_sort_key_compare(&pmerge->pheap[0]->sort_key, &pmerge->group_key) != 0))
+		{
+			sort_merge_end_pass(pmerge);
+			continue;
+		}
+		if (pmerge->heap_size == 0)
+			return NULL;
+		if (!pmerge->in_group)
+			return sort_merge_begin_group(pmerge);
+
+		sort_merge_source_t* psource = pmerge->pheap[0];
+		group_key_select(pmerge->pkey, psource->prec);
+		if (psource->group_number != pmerge->group_number) {
+			psource->group_number   = pmerge->group_number;
+			psource->group_position = psource->position;
+		}
+
+		slls_t* pvalues = pmerge->pkey->pvalues;
+		if (sort_merge_values_equal(pmerge->pgroup_values, pvalues))
+			return sort_merge_pop(pmerge);
+		if (pmerge->pnext_values == NULL) {
+			int is_done = FALSE;
+			for (sllve_t* pe = pmerge->pdone_values->phead; pe != NULL && !is_done; pe = pe->pnext)
+				is_done = sort_merge_values_equal(pe->pvvalue, pvalues);
+			if (!is_done)
+				sort_merge_join_values(pvalues, &pmerge->pnext_values, &pmerge->next_values_capacity);
+		}
+		lrec_free(sort_merge_pop(pmerge));
 	}
-	return 0;
 }
 
-// E.g. parse the list ["red","1.0"] into the array ["red",1.0].
-static typed_sort_key_t* parse_sort_keys(slls_t* pkey_field_values, int* sort_params, context_t* pctx) {
-	typed_sort_key_t* typed_sort_keys = mlr_malloc_or_die(pkey_field_values->length * sizeof(typed_sort_key_t));
+// Returns the record on top of the heap, and moves its run on to the next.
+static lrec_t* sort_merge_pop(sort_merge_t* pmerge) {
+	if (pmerge->heap_size == 0)
+		return NULL;
+	sort_merge_source_t* psource = pmerge->pheap[0];
+	lrec_t* prec = psource->prec;
+	sort_merge_advance(pmerge, psource);
+	if (psource->prec == NULL)
+		pmerge->pheap[0] = pmerge->pheap[--pmerge->heap_size];
+	sort_merge_sift_down(pmerge, 0);
+	return prec;
+}
+
+// Returns the first record of a group. Only if the next record sorts the same
+// is the group more than this one, and its bucket needs noting.
+static lrec_t* sort_merge_begin_group(sort_merge_t* pmerge) {
+	sort_merge_source_t* psource = pmerge->pheap[0];
+	size_t length = psource->sort_key.length;
+	if (length > pmerge->group_key_capacity) {
+		pmerge->group_key.bytes = mlr_realloc_or_die(pmerge->group_key.bytes, length);
+		pmerge->group_key_capacity = length;
+	}
+	memcpy(pmerge->group_key.bytes, psource->sort_key.bytes, length);
+	mlr_sort_key_set(&pmerge->group_key, pmerge->group_key.bytes, length);
+	lrec_spool_position_t position = psource->position;
+
+	lrec_t* prec = sort_merge_pop(pmerge);
+	if (pmerge->heap_size == 0 || mlr_sort_key_compare(&pmerge->pheap[0]->sort_key, &pmerge->group_key) != 0)
+		return prec;
+
+	group_key_select(pmerge->pkey, prec);
+	sort_merge_join_values(pmerge->pkey->pvalues, &pmerge->pgroup_values, &pmerge->group_values_capacity);
+	pmerge->group_number++;
+	pmerge->in_group = TRUE;
+	psource->group_number   = pmerge->group_number;
+	psource->group_position = position;
+	return prec;
+}
+
+// Past the end of the group: goes back to its start for the next bucket, if
+// there is one.
+static void sort_merge_end_pass(sort_merge_t* pmerge) {
+	if (pmerge->pnext_values == NULL) {
+		while (pmerge->pdone_values->phead != NULL)
+			free(sllv_pop(pmerge->pdone_values));
+		pmerge->in_group = FALSE;
+		return;
+	}
+
+	sllv_append(pmerge->pdone_values, pmerge->pgroup_values);
+	pmerge->pgroup_values         = pmerge->pnext_values;
+	pmerge->group_values_capacity = pmerge->next_values_capacity;
+	pmerge->pnext_values          = NULL;
+	pmerge->next_values_capacity  = 0;
+
+	for (int i = 0; i < pmerge->num_sources; i++) {
+		sort_merge_source_t* psource = &pmerge->psources[i];
+		if (psource->group_number == pmerge->group_number) {
+			lrec_free(psource->prec);
+			lrec_spool_seek(psource->pspool, psource->group_position);
+			sort_merge_advance(pmerge, psource);
+		}
+	}
+	sort_merge_heapify(pmerge);
+}
+
+// Puts the runs not used up on the heap.
+static void sort_merge_heapify(sort_merge_t* pmerge) {
+	pmerge->heap_size = 0;
+	for (int i = 0; i < pmerge->num_sources; i++)
+		if (pmerge->psources[i].prec != NULL)
+			pmerge->pheap[pmerge->heap_size++] = &pmerge->psources[i];
+	for (int i = pmerge->heap_size / 2 - 1; i >= 0; i--)
+		sort_merge_sift_down(pmerge, i);
+}
+
+// Reads the source's next record and encodes its sort keys.
+static void sort_merge_advance(sort_merge_t* pmerge, sort_merge_source_t* psource) {
+	psource->position = lrec_spool_tell(psource->pspool);
+	psource->prec = lrec_spool_read(psource->pspool);
+	if (psource->prec != NULL) {
+		// Runs hold only records having all the sort keys.
+		MLR_INTERNAL_CODING_ERROR_UNLESS(group_key_select(pmerge->pkey, psource->prec));
+		size_t length = encode_sort_keys(pmerge->pkey->pvalues, pmerge->sort_params, &psource->sort_key.bytes,
+			&psource->sort_key_capacity, pmerge->pctx);
+		mlr_sort_key_set(&psource->sort_key, psource->sort_key.bytes, length);
+	}
+}
+
+static int sort_merge_source_less(sort_merge_t* pmerge, sort_merge_source_t* pa, sort_merge_source_t* pb) {
+	int s = mlr_sort_key_compare(&pa->sort_key, &pb->sort_key);
+	return s < 0 || (s == 0 && pa->index < pb->index);
+}
+
+static void sort_merge_sift_down(sort_merge_t* pmerge, int i) {
+	sort_merge_source_t** pheap = pmerge->pheap;
+	int n = pmerge->heap_size;
+	while (TRUE) {
+		int l = 2*i + 1;
+		int r = l + 1;
+		int m = i;
+		if (l < n && sort_merge_source_less(pmerge, pheap[l], pheap[m]))
+			m = l;
+		if (r < n && sort_merge_source_less(pmerge, pheap[r], pheap[m]))
+			m = r;
+		if (m == i)
+			break;
+		sort_merge_source_t* ptemp = pheap[i];
+		pheap[i] = pheap[m];
+		pheap[m] = ptemp;
+		i = m;
+	}
+}
+
+// Copies the values into the buffer, growing it as needed, one after another
+// with their terminators.
+static size_t sort_merge_join_values(slls_t* pvalues, char** pbuffer, size_t* pcapacity) {
+	size_t length = 0;
+	for (sllse_t* pe = pvalues->phead; pe != NULL; pe = pe->pnext)
+		length += strlen(pe->value) + 1;
+	if (length > *pcapacity) {
+		*pbuffer = mlr_realloc_or_die(*pbuffer, length);
+		*pcapacity = length;
+	}
+	char* p = *pbuffer;
+	for (sllse_t* pe = pvalues->phead; pe != NULL; pe = pe->pnext) {
+		size_t value_length = strlen(pe->value) + 1;
+		memcpy(p, pe->value, value_length);
+		p += value_length;
+	}
+	return length;
+}
+
+static int sort_merge_values_equal(char* p, slls_t* pvalues) {
+	for (sllse_t* pe = pvalues->phead; pe != NULL; pe = pe->pnext) {
+		if (!streq(p, pe->value))
+			return FALSE;
+		p += strlen(p) + 1;
+	}
+	return TRUE;
+}
+
+// ================================================================
+// Encodes the sort-key values into the buffer, growing it as needed, and
+// returns the encoded length. E.g. with "-f a -nr x", ["red","1.0"] becomes
+// the bytes of "red", a zero byte, and the eight inverted bytes of 1.0.
+static size_t encode_sort_keys(slls_t* pkey_field_values, int* sort_params, unsigned char** pbuffer,
+	size_t* pcapacity, context_t* pctx)
+{
+	size_t length = 0;
 	int i = 0;
+	for (sllse_t* pe = pkey_field_values->phead; pe != NULL; pe = pe->pnext, i++)
+		length += (sort_params[i] & SORT_NUMERIC) ? 8 : strlen(pe->value) + 1;
+	if (length > *pcapacity) {
+		*pbuffer = mlr_realloc_or_die(*pbuffer, length);
+		*pcapacity = length;
+	}
+
+	unsigned char* p = *pbuffer;
+	i = 0;
 	for (sllse_t* pe = pkey_field_values->phead; pe != NULL; pe = pe->pnext, i++) {
 		if (sort_params[i] & SORT_NUMERIC) {
+			double d;
 			if (*pe->value == 0) { // null input value
-				typed_sort_keys[i].u.d = nan("");
-			} else if (!mlr_try_float_from_string(pe->value, &typed_sort_keys[i].u.d)) {
+				d = nan("");
+			} else if (!mlr_try_float_from_string(pe->value, &d)) {
 				fprintf(stderr, "%s: couldn't parse \"%s\" as number in file \"%s\" record %lld.\n",
 					MLR_GLOBALS.bargv0, pe->value, pctx->filename, pctx->fnr);
 				exit(1);
 			}
+			p = encode_sort_double(p, d, sort_params[i]);
 		} else {
-			typed_sort_keys[i].u.s = pe->value;
+			// Strings have no zero bytes, so the terminator sorts a string
+			// before any longer string it's a prefix of. Inverted, it sorts
+			// after.
+			unsigned char* q = p;
+			for (char* s = pe->value; *s; s++)
+				*p++ = *s;
+			*p++ = 0;
+			if (sort_params[i] & SORT_DESCENDING)
+				for ( ; q < p; q++)
+					*q = ~*q;
 		}
 	}
-	return typed_sort_keys;
+	return length;
+}
+
+// Positive numbers get the sign bit set, and negative ones have all their bits
+// inverted, which puts the bit patterns in numerical order. Nulls come after
+// everything, or before when descending. Zero and minus zero sort equally.
+static unsigned char* encode_sort_double(unsigned char* p, double d, int sort_param) {
+	unsigned long long bits;
+	if (isnan(d)) {
+		bits = ~0ULL;
+	} else {
+		if (d == 0.0)
+			d = 0.0;
+		memcpy(&bits, &d, sizeof(bits));
+		bits = (bits & (1ULL << 63)) ? ~bits : bits | (1ULL << 63);
+	}
+	if (sort_param & SORT_DESCENDING)
+		bits = ~bits;
+	for (int i = 0; i < 8; i++)
+		*p++ = (unsigned char)(bits >> (56 - 8 * i));
+	return p;
 }
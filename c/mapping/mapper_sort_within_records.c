@@ -139,6 +139,7 @@ static mapper_t* mapper_sort_within_records_alloc() {
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_sort_within_records_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_sort_within_records_free;
 
 	return pmapper;
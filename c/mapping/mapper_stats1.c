@@ -31,6 +31,7 @@ typedef struct _mapper_stats1_state_t {
 	string_array_t*  pvalue_field_names;     // parameter
 	string_array_t*  pvalue_field_values;    // scratch space used per-record
 	slls_t*          pgroup_by_field_names;  // parameter
+	group_key_t*     pgroup_key;             // scratch space used per-record
 
 	group_by_ingestor_func_t* pgroup_by_ingestor;
 	value_ingestor_func_t*    pvalue_ingestor;
@@ -49,6 +50,7 @@ typedef struct _mapper_stats1_state_t {
 	int              do_iterative_stats;
 	int              allow_int_float;
 	int              do_interpolated_percentiles;
+	percentile_keeper_opts_t percentile_opts;
 } mapper_stats1_state_t;
 
 
@@ -58,7 +60,8 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_names, int do_regex_value_field_names, int invert_regex_value_field_names,
 	slls_t* pgroup_by_field_names, int do_regex_group_by_field_names, int invert_regex_group_by_field_names,
-	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles);
+	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles,
+	percentile_keeper_opts_t* ppercentile_opts);
 static void      mapper_stats1_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_stats1_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -121,6 +124,14 @@ static void mapper_stats1_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "--grfx {regex} Shorthand for --gr {regex} --fx {that same regex}\n");
 	fprintf(o, "-i           Use interpolated percentiles, like R's type=7; default like type=1.\n");
 	fprintf(o, "             Not sensical for string-valued fields.\n");
+	fprintf(o, "--tdigest    Approximate percentiles using a t-digest, in bounded memory per\n");
+	fprintf(o, "             group. Most accurate in the tails, e.g. p99 and p99.9.\n");
+	fprintf(o, "--kll        Approximate percentiles using a KLL sketch, in bounded memory per\n");
+	fprintf(o, "             group. Outputs are input values; rank error is even throughout.\n");
+	fprintf(o, "--sketch-size {n} For --tdigest, the compression (default %d); for --kll,\n",
+		TDIGEST_DEFAULT_COMPRESSION);
+	fprintf(o, "             k (default %d). Larger is more accurate and uses more memory.\n",
+		KLL_SKETCH_DEFAULT_K);
 	fprintf(o, "-s           Print iterative stats. Useful in tail -f contexts (in which\n");
 	fprintf(o, "             case please avoid pprint-format output since end of input\n");
 	fprintf(o, "             stream will never be seen).\n");
@@ -133,13 +144,15 @@ static void mapper_stats1_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "         with a through h, grouped by all field names starting with k.\n");
 	fprintf(o, "Notes:\n");
 	fprintf(o, "* p50 and median are synonymous.\n");
+	fprintf(o, "* Percentiles are exact by default, keeping all values in memory. With\n");
+	fprintf(o, "  --tdigest or --kll, non-numeric values are skipped for percentiles.\n");
 	fprintf(o, "* min and max output the same results as p0 and p100, respectively, but use\n");
 	fprintf(o, "  less memory.\n");
 	fprintf(o, "* String-valued data make sense unless arithmetic on them is required,\n");
 	fprintf(o, "  e.g. for sum, mean, interpolated percentiles, etc. In case of mixed data,\n");
 	fprintf(o, "  numbers are less than strings.\n");
-	fprintf(o, "* count and mode allow text input; the rest require numeric input.\n");
-	fprintf(o, "  In particular, 1 and 1.0 are distinct text for count and mode.\n");
+	fprintf(o, "* count, mode, and distinct allow text input; the rest require numeric input.\n");
+	fprintf(o, "  In particular, 1 and 1.0 are distinct text for count, mode, and distinct.\n");
 	fprintf(o, "* When there are mode ties, the first-encountered datum wins.\n");
 }
 
@@ -152,6 +165,8 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 	int             do_iterative_stats                = FALSE;
 	int             allow_int_float                   = TRUE;
 	int             do_interpolated_percentiles       = FALSE;
+	percentile_keeper_opts_t percentile_opts          = { .mode = PERCENTILE_KEEPER_EXACT, .sketch_size = 0.0 };
+	int             percentile_mode                   = PERCENTILE_KEEPER_EXACT;
 	int             do_regex_value_field_names        = FALSE;
 	int             invert_regex_value_field_names    = FALSE;
 	int             do_regex_group_by_field_names     = FALSE;
@@ -173,6 +188,9 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 	ap_define_true_flag(pstate,         "-s",   &do_iterative_stats);
 	ap_define_false_flag(pstate,        "-F",   &allow_int_float);
 	ap_define_true_flag(pstate,         "-i",   &do_interpolated_percentiles);
+	ap_define_int_value_flag(pstate,    "--tdigest", PERCENTILE_KEEPER_TDIGEST, &percentile_mode);
+	ap_define_int_value_flag(pstate,    "--kll",     PERCENTILE_KEEPER_KLL,     &percentile_mode);
+	ap_define_float_flag(pstate,        "--sketch-size", &percentile_opts.sketch_size);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_stats1_usage(stderr, argv[0], verb);
@@ -208,18 +226,20 @@ static mapper_t* mapper_stats1_parse_cli(int* pargi, int argc, char** argv,
 		mapper_stats1_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	percentile_opts.mode = percentile_mode;
 
 	return mapper_stats1_alloc(pstate, paccumulator_names,
 		pvalue_field_names, do_regex_value_field_names, invert_regex_value_field_names,
 		pgroup_by_field_names, do_regex_group_by_field_names, invert_regex_group_by_field_names,
-		do_iterative_stats, allow_int_float, do_interpolated_percentiles);
+		do_iterative_stats, allow_int_float, do_interpolated_percentiles, &percentile_opts);
 }
 
 // ----------------------------------------------------------------
 static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_names,
 	string_array_t* pvalue_field_names, int do_regex_value_field_names, int invert_regex_value_field_names,
 	slls_t* pgroup_by_field_names, int do_regex_group_by_field_names, int invert_regex_group_by_field_names,
-	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles)
+	int do_iterative_stats, int allow_int_float, int do_interpolated_percentiles,
+	percentile_keeper_opts_t* ppercentile_opts)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -252,6 +272,7 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 
 	if (do_regex_group_by_field_names) {
 		pstate->pgroup_by_field_names   = NULL;
+		pstate->pgroup_key              = NULL;
 		pstate->num_group_by_field_regexes = pgroup_by_field_names->length;
 		pstate->group_by_field_regexes     = mlr_malloc_or_die(sizeof(regex_t) * pstate->num_group_by_field_regexes);
 		int i = 0;
@@ -270,6 +291,7 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 		pstate->pgroup_by_ingestor                = mapper_stats1_group_by_ingest_without_regexes;
 		pstate->pemitter                          = mapper_stats1_emit_all_without_group_by_regexes;
 		pstate->pgroup_by_field_names             = pgroup_by_field_names;
+		pstate->pgroup_key                        = group_key_alloc(pgroup_by_field_names);
 		pstate->group_by_field_regexes            = NULL;
 		pstate->num_group_by_field_regexes        = 0;
 		pstate->invert_regex_group_by_field_names = FALSE;
@@ -280,9 +302,11 @@ static mapper_t* mapper_stats1_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 	pstate->do_iterative_stats            = do_iterative_stats;
 	pstate->allow_int_float               = allow_int_float;
 	pstate->do_interpolated_percentiles   = do_interpolated_percentiles;
+	pstate->percentile_opts               = *ppercentile_opts;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_stats1_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_stats1_free;
 
 	return pmapper;
@@ -294,6 +318,7 @@ static void mapper_stats1_free(mapper_t* pmapper, context_t* _) {
 	string_array_free(pstate->pvalue_field_names);
 	string_array_free(pstate->pvalue_field_values);
 	slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 
 	if (pstate->value_field_regexes != NULL) {
 		for (int i = 0; i < pstate->num_value_field_regexes; i++)
@@ -433,27 +458,22 @@ static void mapper_stats1_group_by_ingest_without_regexes(lrec_t* pinrec, mapper
 	// population on that, but retain full-population requirement on group-by.
 	// E.g. if accumulating stats of x,y on a,b then skip record with x,y,a but
 	// process record with x,a,b.
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-	if (pgroup_by_field_values == NULL) {
-		slls_free(pgroup_by_field_values);
+	group_key_t* pgroup_key = pstate->pgroup_key;
+	if (!group_key_select(pgroup_key, pinrec))
 		return;
-	}
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	lhmsv_t* pgroup_by_field_values_to_acc_fields = lhmslv_get(pstate->groups_without_group_by_regex,
-		pgroup_by_field_values);
+	lhmsv_t* pgroup_by_field_values_to_acc_fields = lhmslv_get_with_hash(pstate->groups_without_group_by_regex,
+		pgroup_key->pvalues, pgroup_key->hash);
 	if (pgroup_by_field_values_to_acc_fields == NULL) {
 		pgroup_by_field_values_to_acc_fields = lhmsv_alloc();
-		lhmslv_put(pstate->groups_without_group_by_regex, slls_copy(pgroup_by_field_values),
-			pgroup_by_field_values_to_acc_fields, FREE_ENTRY_KEY);
+		lhmslv_put_with_hash(pstate->groups_without_group_by_regex, slls_copy(pgroup_key->pvalues),
+			pgroup_key->hash, pgroup_by_field_values_to_acc_fields, FREE_ENTRY_KEY);
 	}
 
 	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
 	// for x=1 and y=2
 	pstate->pvalue_ingestor(pinrec, pstate, pgroup_by_field_values_to_acc_fields);
-
-	//  - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - -
-	slls_free(pgroup_by_field_values);
 }
 
 // ----------------------------------------------------------------
@@ -553,7 +573,7 @@ static void mapper_stats1_ingest_name_value(lrec_t* pinrec, mapper_stats1_state_
 	char* presence = lhmsv_get(acc_field_to_acc_state_in, fake_acc_name_for_setups);
 	if (presence == NULL) {
 		make_stats1_accs(value_field_name, pstate->paccumulator_names, pstate->allow_int_float,
-			pstate->do_interpolated_percentiles, acc_field_to_acc_state_in, acc_field_to_acc_state_out);
+			pstate->do_interpolated_percentiles, &pstate->percentile_opts, acc_field_to_acc_state_in, acc_field_to_acc_state_out);
 		lhmsv_put(acc_field_to_acc_state_in, fake_acc_name_for_setups, fake_acc_name_for_setups, NO_FREE);
 	}
 
@@ -44,6 +44,7 @@ typedef struct _mapper_stats2_state_t {
 	slls_t* paccumulator_names;
 	string_array_t* pvalue_field_name_pairs;
 	slls_t*   pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	lhmslv_t* acc_groups;
 	lhmslv_t* record_groups;
 	int       do_verbose;
@@ -188,6 +189,7 @@ static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 	pstate->paccumulator_names       = paccumulator_names;
 	pstate->pvalue_field_name_pairs  = pvalue_field_name_pairs; // caller validates length is even
 	pstate->pgroup_by_field_names    = pgroup_by_field_names;
+	pstate->pgroup_key               = group_key_alloc(pgroup_by_field_names);
 	pstate->acc_groups               = lhmslv_alloc();
 	pstate->record_groups            = lhmslv_alloc();
 	pstate->do_verbose               = do_verbose;
@@ -196,6 +198,7 @@ static mapper_t* mapper_stats2_alloc(ap_state_t* pargp, slls_t* paccumulator_nam
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_stats2_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_stats2_free;
 
 	return pmapper;
@@ -206,6 +209,7 @@ static void mapper_stats2_free(mapper_t* pmapper, context_t* _) {
 	slls_free(pstate->paccumulator_names);
 	string_array_free(pstate->pvalue_field_name_pairs);
 	slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 	// lhmslv_free and lhmsv_free will free the hashmap keys; we need to free
 	// the void-star hashmap values.
 	for (lhmslve_t* pa = pstate->acc_groups->phead; pa != NULL; pa = pa->pnext) {
@@ -293,22 +297,24 @@ static sllv_t* mapper_stats2_process(lrec_t* pinrec, context_t* pctx, void* pvst
 // ----------------------------------------------------------------
 static void mapper_stats2_ingest(lrec_t* pinrec, context_t* pctx, mapper_stats2_state_t* pstate) {
 	// ["s", "t"]
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-	if (pgroup_by_field_values == NULL) {
+	group_key_t* pgroup_key = pstate->pgroup_key;
+	if (!group_key_select(pgroup_key, pinrec)) {
 		return;
 	}
 
-	lhms2v_t* pgroup_to_acc_field = lhmslv_get(pstate->acc_groups, pgroup_by_field_values);
+	lhms2v_t* pgroup_to_acc_field = lhmslv_get_with_hash(pstate->acc_groups, pgroup_key->pvalues, pgroup_key->hash);
 	if (pgroup_to_acc_field == NULL) {
 		pgroup_to_acc_field = lhms2v_alloc();
-		lhmslv_put(pstate->acc_groups, slls_copy(pgroup_by_field_values), pgroup_to_acc_field, FREE_ENTRY_KEY);
+		lhmslv_put_with_hash(pstate->acc_groups, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+			pgroup_to_acc_field, FREE_ENTRY_KEY);
 	}
 
 	if (pstate->do_hold_and_fit) { // Retain the input record in memory, for fitting and delivery at end of stream
-		sllv_t* group_to_records = lhmslv_get(pstate->record_groups, pgroup_by_field_values);
+		sllv_t* group_to_records = lhmslv_get_with_hash(pstate->record_groups, pgroup_key->pvalues, pgroup_key->hash);
 		if (group_to_records == NULL) {
 			group_to_records = sllv_alloc();
-			lhmslv_put(pstate->record_groups, slls_copy(pgroup_by_field_values), group_to_records, FREE_ENTRY_KEY);
+			lhmslv_put_with_hash(pstate->record_groups, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+				group_to_records, FREE_ENTRY_KEY);
 		}
 		sllv_append(group_to_records, pinrec);
 	}
@@ -362,8 +368,6 @@ static void mapper_stats2_ingest(lrec_t* pinrec, context_t* pctx, mapper_stats2_
 				pacc_fields_to_acc_state);
 		}
 	}
-
-	slls_free(pgroup_by_field_values);
 }
 
 // ----------------------------------------------------------------
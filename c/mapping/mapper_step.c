@@ -43,6 +43,7 @@ typedef struct _mapper_step_state_t {
 	string_array_t* pvalue_field_names;    // parameter
 	string_array_t* pvalue_field_values;   // scratch space used per-record
 	slls_t*         pgroup_by_field_names; // parameter
+	group_key_t*    pgroup_key;            // scratch space used per-record
 	lhmslv_t*       groups;
 	int             allow_int_float;
 	slls_t*         pstring_alphas;
@@ -204,6 +205,7 @@ static mapper_t* mapper_step_alloc(ap_state_t* pargp, slls_t* pstepper_names, st
 	pstate->pvalue_field_names    = pvalue_field_names;
 	pstate->pvalue_field_values   = string_array_alloc(pvalue_field_names->length);
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
+	pstate->pgroup_key            = group_key_alloc(pgroup_by_field_names);
 	pstate->groups                = lhmslv_alloc();
 	pstate->allow_int_float       = allow_int_float;
 	pstate->pstring_alphas        = pstring_alphas;
@@ -211,6 +213,7 @@ static mapper_t* mapper_step_alloc(ap_state_t* pargp, slls_t* pstepper_names, st
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_step_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_step_free;
 
 	return pmapper;
@@ -222,6 +225,7 @@ static void mapper_step_free(mapper_t* pmapper, context_t* _) {
 	string_array_free(pstate->pvalue_field_names);
 	string_array_free(pstate->pvalue_field_values);
 	slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 	slls_free(pstate->pstring_alphas);
 	slls_free(pstate->pewma_suffixes);
 
@@ -253,19 +257,16 @@ static sllv_t* mapper_step_process(lrec_t* pinrec, context_t* pctx, void* pvstat
 
 	// ["s", "t"]
 	mlr_reference_values_from_record_into_string_array(pinrec, pstate->pvalue_field_names, pstate->pvalue_field_values);
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-
-	if (pgroup_by_field_values == NULL) {
-		slls_free(pgroup_by_field_values);
+	group_key_t* pgroup_key = pstate->pgroup_key;
+	if (!group_key_select(pgroup_key, pinrec))
 		return sllv_single(pinrec);
-	}
 
-	lhmsv_t* pgroup_to_acc_field = lhmslv_get(pstate->groups, pgroup_by_field_values);
+	lhmsv_t* pgroup_to_acc_field = lhmslv_get_with_hash(pstate->groups, pgroup_key->pvalues, pgroup_key->hash);
 	if (pgroup_to_acc_field == NULL) {
 		pgroup_to_acc_field = lhmsv_alloc();
-		lhmslv_put(pstate->groups, slls_copy(pgroup_by_field_values), pgroup_to_acc_field, FREE_ENTRY_KEY);
+		lhmslv_put_with_hash(pstate->groups, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+			pgroup_to_acc_field, FREE_ENTRY_KEY);
 	}
-	slls_free(pgroup_by_field_values);
 
 	// for x=1 and y=2
 	int n = pstate->pvalue_field_names->length;
@@ -1,16 +1,20 @@
 #include <stdio.h>
 #include "lib/mlrutil.h"
 #include "containers/sllv.h"
+#include "containers/lrec_store.h"
 #include "mapping/mappers.h"
+#include "cli/argparse.h"
 
 typedef struct _mapper_tac_state_t {
-	sllv_t* records;
+	ap_state_t*   pargp;
+	lrec_store_t* pstore;
+	long long     num_left; // Records not yet output, at end of stream
 } mapper_tac_state_t;
 
 static void      mapper_tac_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_tac_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
-static mapper_t* mapper_tac_alloc();
+static mapper_t* mapper_tac_alloc(ap_state_t* pargp, long long mem_budget, char* tmpdir);
 static void      mapper_tac_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_tac_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -24,31 +28,54 @@ mapper_setup_t mapper_tac_setup = {
 
 // ----------------------------------------------------------------
 static void mapper_tac_usage(FILE* o, char* argv0, char* verb) {
-	fprintf(o, "Usage: %s %s\n", argv0, verb);
+	fprintf(o, "Usage: %s %s [options]\n", argv0, verb);
 	fprintf(o, "Prints records in reverse order from the order in which they were encountered.\n");
+	fprintf(o, "Options:\n");
+	fprintf(o, "--mem {size}   Memory budget for the records held, e.g. 500M or 4G. Past it,\n");
+	fprintf(o, "               they are written to a temporary file. Default: no limit.\n");
+	fprintf(o, "--tmpdir {dir} Directory for that file. Default: $TMPDIR, else /tmp.\n");
 }
 
 static mapper_t* mapper_tac_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __)
 {
+	char* mem_budget_string = NULL;
+	char* tmpdir = NULL;
+	long long mem_budget = 0LL;
+
 	if ((argc - *pargi) < 1) {
 		mapper_tac_usage(stderr, argv[0], argv[*pargi]);
 		return NULL;
 	}
-	mapper_t* pmapper = mapper_tac_alloc();
-	*pargi += 1;
-	return pmapper;
+	char* verb = argv[(*pargi)++];
+
+	ap_state_t* pargp = ap_alloc();
+	ap_define_string_flag(pargp, "--mem",    &mem_budget_string);
+	ap_define_string_flag(pargp, "--tmpdir", &tmpdir);
+	if (!ap_parse(pargp, verb, pargi, argc, argv)) {
+		mapper_tac_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (mem_budget_string != NULL && !mlr_try_byte_count_from_string(mem_budget_string, &mem_budget)) {
+		mapper_tac_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+
+	return mapper_tac_alloc(pargp, mem_budget, tmpdir);
 }
 
 // ----------------------------------------------------------------
-static mapper_t* mapper_tac_alloc() {
+static mapper_t* mapper_tac_alloc(ap_state_t* pargp, long long mem_budget, char* tmpdir) {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
 	mapper_tac_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_tac_state_t));
-	pstate->records = sllv_alloc();
+	pstate->pargp    = pargp;
+	pstate->pstore   = lrec_store_alloc(mem_budget, tmpdir);
+	pstate->num_left = -1LL;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_tac_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_tac_free;
 
 	return pmapper;
@@ -56,8 +83,8 @@ static mapper_t* mapper_tac_alloc() {
 
 static void mapper_tac_free(mapper_t* pmapper, context_t* _) {
 	mapper_tac_state_t* pstate = pmapper->pvstate;
-	// Free the container
-	sllv_free(pstate->records);
+	lrec_store_free(pstate->pstore);
+	ap_free(pstate->pargp);
 	free(pstate);
 	free(pmapper);
 }
@@ -66,15 +93,20 @@ static void mapper_tac_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_tac_process(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_tac_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		// The caller will free the outrecs
-		sllv_append(pstate->records, pinrec);
+		lrec_store_append(pstate->pstore, pinrec);
+		lrec_free(pinrec);
 		return NULL;
 	}
-	else {
-		sllv_reverse(pstate->records);
-		sllv_append(pstate->records, NULL);
-		sllv_t* retval = pstate->records;
-		pstate->records = sllv_alloc();
-		return retval;
-	}
+
+	// End of stream: output is a piece at a time.
+	if (pstate->num_left < 0LL)
+		pstate->num_left = pstate->pstore->num_records;
+	sllv_t* poutrecs = sllv_alloc();
+	while (pstate->num_left > 0LL && poutrecs->length < LREC_STORE_OUTPUT_PIECE_SIZE)
+		sllv_append(poutrecs, lrec_store_get(pstate->pstore, --pstate->num_left));
+	if (pstate->num_left > 0LL)
+		pctx->more_output = TRUE;
+	else
+		sllv_append(poutrecs, NULL);
+	return poutrecs;
 }
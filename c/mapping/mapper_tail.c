@@ -14,6 +14,7 @@
 typedef struct _mapper_tail_state_t {
 	ap_state_t* pargp;
 	slls_t* pgroup_by_field_names;
+	group_key_t* pgroup_key;
 
 	// for tail +n 10
 	unsigned long long tail_start;
@@ -84,6 +85,7 @@ static mapper_t* mapper_tail_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 
 	pstate->pargp                   = pargp;
 	pstate->pgroup_by_field_names   = pgroup_by_field_names;
+	pstate->pgroup_key              = group_key_alloc(pgroup_by_field_names);
 	pstate->tail_start              = tail_start;
 	pstate->tail_count              = tail_count;
 	pstate->precord_counts_by_group = lhmslv_alloc();
@@ -93,6 +95,7 @@ static mapper_t* mapper_tail_alloc(ap_state_t* pargp, slls_t* pgroup_by_field_na
 	pmapper->pprocess_func = tail_start > 0
 		? mapper_tail_process_from_start
 		: mapper_tail_process_from_count;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_tail_free;
 
 	return pmapper;
@@ -102,6 +105,7 @@ static void mapper_tail_free(mapper_t* pmapper, context_t* _) {
 	mapper_tail_state_t* pstate = pmapper->pvstate;
 	if (pstate->pgroup_by_field_names != NULL)
 		slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 
 	lhmslv_free(pstate->precord_counts_by_group);
 
@@ -124,18 +128,16 @@ static void mapper_tail_free(mapper_t* pmapper, context_t* _) {
 static sllv_t* mapper_tail_process_from_start(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_tail_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* precord_count_for_group = lhmslv_get(pstate->precord_counts_by_group,
-				pgroup_by_field_values);
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (group_key_select(pgroup_key, pinrec)) {
+			unsigned long long* precord_count_for_group = lhmslv_get_with_hash(pstate->precord_counts_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (precord_count_for_group == NULL) {
 				precord_count_for_group = mlr_malloc_or_die(sizeof(unsigned long long));
 				*precord_count_for_group = 0LL;
-				lhmslv_put(pstate->precord_counts_by_group, slls_copy(pgroup_by_field_values),
+				lhmslv_put_with_hash(pstate->precord_counts_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
 					precord_count_for_group, FREE_ENTRY_KEY | FREE_ENTRY_VALUE);
 			}
-			slls_free(pgroup_by_field_values);
 			(*precord_count_for_group)++;
 
 			if (*precord_count_for_group < pstate->tail_start) {
@@ -157,16 +159,15 @@ static sllv_t* mapper_tail_process_from_start(lrec_t* pinrec, context_t* pctx, v
 static sllv_t* mapper_tail_process_from_count(lrec_t* pinrec, context_t* pctx, void* pvstate) {
 	mapper_tail_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			sllv_t* precord_list_for_group = lhmslv_get(pstate->precord_lists_by_group, pgroup_by_field_values);
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (group_key_select(pgroup_key, pinrec)) {
+			sllv_t* precord_list_for_group = lhmslv_get_with_hash(pstate->precord_lists_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (precord_list_for_group == NULL) {
 				precord_list_for_group = sllv_alloc();
-				lhmslv_put(pstate->precord_lists_by_group, slls_copy(pgroup_by_field_values),
+				lhmslv_put_with_hash(pstate->precord_lists_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
 					precord_list_for_group, FREE_ENTRY_KEY);
 			}
-			slls_free(pgroup_by_field_values);
 			if (precord_list_for_group->length >= pstate->tail_count) {
 				lrec_t* porec = sllv_pop(precord_list_for_group);
 				lrec_free(porec);
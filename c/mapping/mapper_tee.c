@@ -124,6 +124,7 @@ static mapper_t* mapper_tee_alloc(int do_append, int flush_every_record,
 
 	pmapper->pvstate           = pstate;
 	pmapper->pprocess_func     = mapper_tee_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func        = mapper_tee_free;
 	return pmapper;
 }
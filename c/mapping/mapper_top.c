@@ -23,6 +23,7 @@ typedef struct _mapper_top_state_t {
 	ap_state_t* pargp;
 	slls_t* pvalue_field_names;
 	slls_t* pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	int top_count;
 	int show_full_records;
 	int allow_int_float;
@@ -117,6 +118,7 @@ static mapper_t* mapper_top_alloc(ap_state_t* pargp, slls_t* pvalue_field_names,
 	pstate->pargp                 = pargp;
 	pstate->pvalue_field_names    = pvalue_field_names;
 	pstate->pgroup_by_field_names = pgroup_by_field_names;
+	pstate->pgroup_key            = group_key_alloc(pgroup_by_field_names);
 	pstate->show_full_records     = show_full_records;
 	pstate->allow_int_float       = allow_int_float;
 	pstate->top_count             = top_count;
@@ -126,6 +128,7 @@ static mapper_t* mapper_top_alloc(ap_state_t* pargp, slls_t* pvalue_field_names,
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_top_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_top_free;
 
 	return pmapper;
@@ -135,6 +138,7 @@ static void mapper_top_free(mapper_t* pmapper, context_t* _) {
 	mapper_top_state_t* pstate = pmapper->pvstate;
 	slls_free(pstate->pvalue_field_names);
 	slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 
 	// Free the hashmap pvvalues; the lhm free methods will free the hashmap keys.
 	for (lhmslve_t* pa = pstate->groups->phead; pa != NULL; pa = pa->pnext) {
@@ -166,30 +170,26 @@ static sllv_t* mapper_top_process(lrec_t* pinrec, context_t* pctx, void* pvstate
 
 // ----------------------------------------------------------------
 static void mapper_top_ingest(lrec_t* pinrec, mapper_top_state_t* pstate) {
-	// ["s", "t"]
-	slls_t* pvalue_field_values    = mlr_reference_selected_values_from_record(pinrec, pstate->pvalue_field_names);
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pgroup_by_field_names);
-
-	// Heterogeneous-data case -- not all sought fields were present in record
-	if (pvalue_field_values == NULL || pgroup_by_field_values == NULL) {
-		slls_free(pvalue_field_values);
-		slls_free(pgroup_by_field_values);
+	group_key_t* pgroup_key = pstate->pgroup_key;
+	if (!group_key_select(pgroup_key, pinrec)) {
 		lrec_free(pinrec);
 		return;
 	}
-	if (pgroup_by_field_values->length != pstate->pgroup_by_field_names->length) {
-		slls_free(pvalue_field_values);
-		slls_free(pgroup_by_field_values);
+	// ["s", "t"]
+	slls_t* pvalue_field_values = mlr_reference_selected_values_from_record(pinrec, pstate->pvalue_field_names);
+
+	// Heterogeneous-data case -- not all sought fields were present in record
+	if (pvalue_field_values == NULL) {
 		lrec_free(pinrec);
 		return;
 	}
 
-	lhmsv_t* group_to_acc_field = lhmslv_get(pstate->groups, pgroup_by_field_values);
+	lhmsv_t* group_to_acc_field = lhmslv_get_with_hash(pstate->groups, pgroup_key->pvalues, pgroup_key->hash);
 	if (group_to_acc_field == NULL) {
 		group_to_acc_field = lhmsv_alloc();
-		lhmslv_put(pstate->groups, slls_copy(pgroup_by_field_values), group_to_acc_field, FREE_ENTRY_KEY);
+		lhmslv_put_with_hash(pstate->groups, slls_copy(pgroup_key->pvalues), pgroup_key->hash, group_to_acc_field,
+			FREE_ENTRY_KEY);
 	}
-	slls_free(pgroup_by_field_values);
 
 	sllse_t* pa = pstate->pvalue_field_names->phead;
 	sllse_t* pb =         pvalue_field_values->phead;
@@ -3,20 +3,24 @@
 #include <string.h>
 #include <math.h>
 #include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
 #include "containers/sllv.h"
 #include "containers/lhmsll.h"
 #include "containers/lhmslv.h"
 #include "containers/lhmsv.h"
 #include "containers/lhmsll.h"
 #include "containers/mixutil.h"
+#include "containers/hyperloglog.h"
 #include "mapping/mappers.h"
 #include "cli/argparse.h"
 
 #define DEFAULT_OUTPUT_FIELD_NAME "count"
+#define HLL_SKETCH_FIELD_NAME "hll_sketch"
 
 typedef struct _mapper_uniq_state_t {
 	ap_state_t* pargp;
 	slls_t*   pgroup_by_field_names;
+	group_key_t* pgroup_key;
 	int       show_counts;
 	int       show_num_distinct_only;
 	lhmsll_t* puniqified_record_counts; // lrec_sprintf -> counts
@@ -24,6 +28,10 @@ typedef struct _mapper_uniq_state_t {
 	lhmslv_t* pcounts_by_group;
 	lhmsv_t*  pcounts_unlashed; // string field name -> string field value -> long long count
 	char* output_field_name;
+	int       hll_precision; // 0 for exact counting
+	hyperloglog_t* phll;
+	lhmsv_t*  phlls_unlashed; // string field name -> hyperloglog_t*
+	int       hll_emit_sketch;
 } mapper_uniq_state_t;
 
 // ----------------------------------------------------------------
@@ -58,7 +66,10 @@ static mapper_t* mapper_uniq_alloc(
 	int show_counts,
 	int show_num_distinct_only,
 	char* output_field_name,
-	int uniqify_entire_records);
+	int uniqify_entire_records,
+	int hll_precision,
+	int hll_emit_sketch,
+	int hll_merge);
 
 static void mapper_uniq_free(
 	mapper_t* pmapper,
@@ -79,16 +90,46 @@ static sllv_t* mapper_uniq_process_uniqify_entire_records_show_num_distinct_only
 	context_t* pctx,
 	void* pvstate);
 
+static sllv_t* mapper_uniq_process_uniqify_entire_records_approximate(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
 static sllv_t* mapper_uniq_process_unlashed(
 	lrec_t* pinrec,
 	context_t* pctx,
 	void* pvstate);
 
+static sllv_t* mapper_uniq_process_unlashed_approximate(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
 static sllv_t* mapper_uniq_process_num_distinct_only(
 	lrec_t* pinrec,
 	context_t* pctx,
 	void* pvstate);
 
+static sllv_t* mapper_uniq_process_num_distinct_only_approximate(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
+static sllv_t* mapper_uniq_process_hll_merge(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate);
+
+static hyperloglog_t* mapper_uniq_merge_sketch(
+	hyperloglog_t* phll,
+	char* field_name,
+	char* field_value);
+
+static void mapper_uniq_put_sketch(
+	mapper_uniq_state_t* pstate,
+	lrec_t* poutrec,
+	hyperloglog_t* phll);
+
 static sllv_t* mapper_uniq_process_with_counts(
 	lrec_t* pinrec,
 	context_t* pctx,
@@ -134,6 +175,23 @@ static void mapper_count_distinct_usage(
 	fprintf(o, "              and b field values. With -f a,b and with -u, computes counts\n");
 	fprintf(o, "              for distinct a field values and counts for distinct b field\n");
 	fprintf(o, "              values separately.\n");
+	fprintf(o, "--hll         Estimate the number of distinct values using a HyperLogLog sketch,\n");
+	fprintf(o, "              in bounded memory, rather than keeping every distinct value. Implies\n");
+	fprintf(o, "              -n; with -u, gives one estimate per field. Error is about 1%%.\n");
+	fprintf(o, "--hll-precision {p} Same as --hll, with 2^p registers: from %d to %d; default %d.\n",
+		HYPERLOGLOG_MIN_PRECISION, HYPERLOGLOG_MAX_PRECISION, HYPERLOGLOG_DEFAULT_PRECISION);
+	fprintf(o, "              Error is about 1.04/sqrt(2^p); memory is at most 2^p bytes per count.\n");
+	fprintf(o, "--hll-emit-sketch Same as --hll, also writing each sketch as a hex string in field\n");
+	fprintf(o, "              \"%s\", so that counts from separate runs can be combined.\n",
+		HLL_SKETCH_FIELD_NAME);
+	fprintf(o, "--hll-merge   The -f fields hold sketches written by --hll-emit-sketch: estimate\n");
+	fprintf(o, "              the number of distinct values over all of them. Records having a\n");
+	fprintf(o, "              \"field\" field, as written with -u, are merged per field instead.\n");
+	fprintf(o, "              Sketches must have the same precision. Not compatible with -u.\n");
+	fprintf(o, "Example: mlr count-distinct -f a --hll-emit-sketch day1.dat > day1.sketch\n");
+	fprintf(o, "         mlr count-distinct -f a --hll-emit-sketch day2.dat > day2.sketch\n");
+	fprintf(o, "         mlr count-distinct -f %s --hll-merge day1.sketch day2.sketch\n",
+		HLL_SKETCH_FIELD_NAME);
 }
 
 // ----------------------------------------------------------------
@@ -148,6 +206,9 @@ static mapper_t* mapper_count_distinct_parse_cli(
 	int     show_num_distinct_only = FALSE;
 	char*   output_field_name = DEFAULT_OUTPUT_FIELD_NAME;
 	int     do_lashed = TRUE;
+	int     hll_precision = 0;
+	int     hll_emit_sketch = FALSE;
+	int     hll_merge = FALSE;
 
 	char* verb = argv[(*pargi)++];
 
@@ -156,11 +217,19 @@ static mapper_t* mapper_count_distinct_parse_cli(
 	ap_define_true_flag(pstate,        "-n", &show_num_distinct_only);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
 	ap_define_false_flag(pstate,       "-u", &do_lashed);
+	ap_define_int_value_flag(pstate,   "--hll", HYPERLOGLOG_DEFAULT_PRECISION, &hll_precision);
+	ap_define_int_flag(pstate,         "--hll-precision", &hll_precision);
+	ap_define_true_flag(pstate,        "--hll-emit-sketch", &hll_emit_sketch);
+	ap_define_true_flag(pstate,        "--hll-merge", &hll_merge);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_count_distinct_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	// With --hll-merge the precision comes from the sketches; this one is only
+	// for when there are none.
+	if ((hll_emit_sketch || hll_merge) && hll_precision == 0)
+		hll_precision = HYPERLOGLOG_DEFAULT_PRECISION;
 
 	if (pfield_names == NULL) {
 		mapper_count_distinct_usage(stderr, argv[0], verb);
@@ -170,9 +239,20 @@ static mapper_t* mapper_count_distinct_parse_cli(
 		mapper_count_distinct_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (!do_lashed && hll_merge) {
+		mapper_count_distinct_usage(stderr, argv[0], verb);
+		return NULL;
+	}
+	if (hll_precision != 0) {
+		if (hll_precision < HYPERLOGLOG_MIN_PRECISION || hll_precision > HYPERLOGLOG_MAX_PRECISION) {
+			mapper_count_distinct_usage(stderr, argv[0], verb);
+			return NULL;
+		}
+		show_num_distinct_only = do_lashed;
+	}
 
 	return mapper_uniq_alloc(pstate, pfield_names, do_lashed, TRUE, show_num_distinct_only,
-		output_field_name, FALSE);
+		output_field_name, FALSE, hll_precision, hll_emit_sketch, hll_merge);
 }
 
 // ----------------------------------------------------------------
@@ -194,6 +274,12 @@ static void mapper_uniq_usage(
 	fprintf(o, "              With -c, produces unique records, with repeat counts for each.\n");
 	fprintf(o, "              With -n, produces only one record which is the unique-record count.\n");
 	fprintf(o, "              With neither -c nor -n, produces unique records.\n");
+	fprintf(o, "--hll         With -n, estimate the number of distinct values using a HyperLogLog\n");
+	fprintf(o, "              sketch, in bounded memory. Error is about 1%%.\n");
+	fprintf(o, "--hll-precision {p} Same as --hll, with 2^p registers: from %d to %d; default %d.\n",
+		HYPERLOGLOG_MIN_PRECISION, HYPERLOGLOG_MAX_PRECISION, HYPERLOGLOG_DEFAULT_PRECISION);
+	fprintf(o, "--hll-emit-sketch Same as --hll, also writing the sketch as a hex string in field\n");
+	fprintf(o, "              \"%s\". See count-distinct --hll-merge.\n", HLL_SKETCH_FIELD_NAME);
 }
 
 static mapper_t* mapper_uniq_parse_cli(
@@ -209,6 +295,8 @@ static mapper_t* mapper_uniq_parse_cli(
 	char*   output_field_name = DEFAULT_OUTPUT_FIELD_NAME;
 	int     do_lashed = TRUE;
 	int     uniqify_entire_records = FALSE;
+	int     hll_precision = 0;
+	int     hll_emit_sketch = FALSE;
 
 	char* verb = argv[(*pargi)++];
 
@@ -219,11 +307,16 @@ static mapper_t* mapper_uniq_parse_cli(
 	ap_define_true_flag(pstate,        "-n", &show_num_distinct_only);
 	ap_define_string_flag(pstate,      "-o", &output_field_name);
 	ap_define_true_flag(pstate,        "-a", &uniqify_entire_records);
+	ap_define_int_value_flag(pstate,   "--hll", HYPERLOGLOG_DEFAULT_PRECISION, &hll_precision);
+	ap_define_int_flag(pstate,         "--hll-precision", &hll_precision);
+	ap_define_true_flag(pstate,        "--hll-emit-sketch", &hll_emit_sketch);
 
 	if (!ap_parse(pstate, verb, pargi, argc, argv)) {
 		mapper_uniq_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (hll_emit_sketch && hll_precision == 0)
+		hll_precision = HYPERLOGLOG_DEFAULT_PRECISION;
 
 	if (uniqify_entire_records) {
 		if (pgroup_by_field_names != NULL) {
@@ -240,9 +333,20 @@ static mapper_t* mapper_uniq_parse_cli(
 			return NULL;
 		}
 	}
+	// Without -n, the distinct values themselves are needed.
+	if (hll_precision != 0) {
+		if (!show_num_distinct_only || show_counts) {
+			mapper_uniq_usage(stderr, argv[0], verb);
+			return NULL;
+		}
+		if (hll_precision < HYPERLOGLOG_MIN_PRECISION || hll_precision > HYPERLOGLOG_MAX_PRECISION) {
+			mapper_uniq_usage(stderr, argv[0], verb);
+			return NULL;
+		}
+	}
 
 	return mapper_uniq_alloc(pstate, pgroup_by_field_names, do_lashed, show_counts, show_num_distinct_only,
-		output_field_name, uniqify_entire_records);
+		output_field_name, uniqify_entire_records, hll_precision, hll_emit_sketch, FALSE);
 }
 
 // ----------------------------------------------------------------
@@ -253,7 +357,10 @@ static mapper_t* mapper_uniq_alloc(
 	int show_counts,
 	int show_num_distinct_only,
 	char* output_field_name,
-	int uniqify_entire_records)
+	int uniqify_entire_records,
+	int hll_precision,
+	int hll_emit_sketch,
+	int hll_merge)
 {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
@@ -261,6 +368,8 @@ static mapper_t* mapper_uniq_alloc(
 
 	pstate->pargp                    = pargp;
 	pstate->pgroup_by_field_names    = pgroup_by_field_names;
+	pstate->pgroup_key               = (pgroup_by_field_names == NULL) ? NULL
+		: group_key_alloc(pgroup_by_field_names);
 	pstate->show_counts              = show_counts;
 	pstate->show_num_distinct_only   = show_num_distinct_only;
 	pstate->puniqified_record_counts = lhmsll_alloc();
@@ -268,9 +377,23 @@ static mapper_t* mapper_uniq_alloc(
 	pstate->pcounts_by_group         = lhmslv_alloc();
 	pstate->pcounts_unlashed         = lhmsv_alloc();
 	pstate->output_field_name        = output_field_name;
+	pstate->hll_precision            = hll_precision;
+	// With --hll-merge, the first sketch read becomes the accumulator.
+	pstate->phll                     = (hll_precision == 0 || hll_merge) ? NULL : hyperloglog_alloc(hll_precision);
+	pstate->phlls_unlashed           = lhmsv_alloc();
+	pstate->hll_emit_sketch          = hll_emit_sketch;
 
 	pmapper->pvstate = pstate;
-	if (uniqify_entire_records) {
+	if (hll_merge) {
+		pmapper->pprocess_func = mapper_uniq_process_hll_merge;
+	} else if (hll_precision != 0) {
+		if (uniqify_entire_records)
+			pmapper->pprocess_func = mapper_uniq_process_uniqify_entire_records_approximate;
+		else if (!do_lashed)
+			pmapper->pprocess_func = mapper_uniq_process_unlashed_approximate;
+		else
+			pmapper->pprocess_func = mapper_uniq_process_num_distinct_only_approximate;
+	} else if (uniqify_entire_records) {
 		if (show_counts)
 			pmapper->pprocess_func = mapper_uniq_process_uniqify_entire_records_show_counts;
 		else if (show_num_distinct_only)
@@ -285,6 +408,7 @@ static mapper_t* mapper_uniq_alloc(
 		pmapper->pprocess_func = mapper_uniq_process_with_counts;
 	else
 		pmapper->pprocess_func = mapper_uniq_process_no_counts;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func = mapper_uniq_free;
 
 	return pmapper;
@@ -297,6 +421,7 @@ static void mapper_uniq_free(
 	mapper_uniq_state_t* pstate = pmapper->pvstate;
 
 	slls_free(pstate->pgroup_by_field_names);
+	group_key_free(pstate->pgroup_key);
 
 	lhmsll_free(pstate->puniqified_record_counts);
 	pstate->puniqified_record_counts = NULL;
@@ -324,6 +449,15 @@ static void mapper_uniq_free(
 	lhmsv_free(pstate->pcounts_unlashed);
 	pstate->pcounts_unlashed = NULL;
 
+	hyperloglog_free(pstate->phll);
+	pstate->phll = NULL;
+	for (lhmsve_t* pb = pstate->phlls_unlashed->phead; pb != NULL; pb = pb->pnext) {
+		hyperloglog_t* phll = pb->pvvalue;
+		hyperloglog_free(phll);
+	}
+	lhmsv_free(pstate->phlls_unlashed);
+	pstate->phlls_unlashed = NULL;
+
 	pstate->pgroup_by_field_names = NULL;
 	pstate->pcounts_by_group = NULL;
 
@@ -420,6 +554,34 @@ static sllv_t* mapper_uniq_process_uniqify_entire_records_show_num_distinct_only
 	}
 }
 
+// Estimate count of unique records. Each field's key and value is chained into
+// the hash, so that no string for the whole record is formatted.
+static sllv_t* mapper_uniq_process_uniqify_entire_records_approximate(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		unsigned long long hash = HYPERLOGLOG_HASH_SEED;
+		for (lrece_t* pe = pinrec->phead; pe != NULL; pe = pe->pnext) {
+			hash = hyperloglog_string_hash(pe->key, hash);
+			hash = hyperloglog_string_hash(pe->value, hash);
+		}
+		hyperloglog_add_hash(pstate->phll, hash);
+		lrec_free(pinrec);
+		return NULL;
+	} else { // end of record stream
+		sllv_t* poutrecs = sllv_alloc();
+		lrec_t* poutrec = lrec_unbacked_alloc();
+		long long count = hyperloglog_count(pstate->phll);
+		lrec_put(poutrec, pstate->output_field_name, mlr_alloc_string_from_ll(count), FREE_ENTRY_VALUE);
+		mapper_uniq_put_sketch(pstate, poutrec, pstate->phll);
+		sllv_append(poutrecs, poutrec);
+		return poutrecs;
+	}
+}
+
 // ----------------------------------------------------------------
 static sllv_t* mapper_uniq_process_unlashed(
 	lrec_t* pinrec,
@@ -464,6 +626,42 @@ static sllv_t* mapper_uniq_process_unlashed(
 	}
 }
 
+static sllv_t* mapper_uniq_process_unlashed_approximate(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext) {
+			char* field_name = pe->value;
+			hyperloglog_t* phll = lhmsv_get(pstate->phlls_unlashed, field_name);
+			if (phll == NULL) {
+				phll = hyperloglog_alloc(pstate->hll_precision);
+				lhmsv_put(pstate->phlls_unlashed, field_name, phll, NO_FREE);
+			}
+			char* field_value = lrec_get(pinrec, field_name);
+			if (field_value != NULL)
+				hyperloglog_add_string(phll, field_value);
+		}
+		lrec_free(pinrec);
+		return NULL;
+	}
+	else {
+		sllv_t* poutrecs = sllv_alloc();
+		for (lhmsve_t* pe = pstate->phlls_unlashed->phead; pe != NULL; pe = pe->pnext) {
+			hyperloglog_t* phll = pe->pvvalue;
+			lrec_t* poutrec = lrec_unbacked_alloc();
+			lrec_put(poutrec, "field", pe->key, NO_FREE);
+			lrec_put(poutrec, "count", mlr_alloc_string_from_ll(hyperloglog_count(phll)), FREE_ENTRY_VALUE);
+			mapper_uniq_put_sketch(pstate, poutrec, phll);
+			sllv_append(poutrecs, poutrec);
+		}
+		sllv_append(poutrecs, NULL);
+		return poutrecs;
+	}
+}
+
 static sllv_t* mapper_uniq_process_num_distinct_only(
 	lrec_t* pinrec,
 	context_t* pctx,
@@ -471,18 +669,18 @@ static sllv_t* mapper_uniq_process_num_distinct_only(
 {
 	mapper_uniq_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (group_key_select(pgroup_key, pinrec)) {
+			unsigned long long* pcount = lhmslv_get_with_hash(pstate->pcounts_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (pcount == NULL) {
 				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+				lhmslv_put_with_hash(pstate->pcounts_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+					pcount, FREE_ENTRY_KEY);
 			} else {
 				(*pcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
@@ -500,6 +698,119 @@ static sllv_t* mapper_uniq_process_num_distinct_only(
 	}
 }
 
+static sllv_t* mapper_uniq_process_num_distinct_only_approximate(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (group_key_select(pgroup_key, pinrec)) {
+			unsigned long long hash = HYPERLOGLOG_HASH_SEED;
+			for (sllse_t* pe = pgroup_key->pvalues->phead; pe != NULL; pe = pe->pnext)
+				hash = hyperloglog_string_hash(pe->value, hash);
+			hyperloglog_add_hash(pstate->phll, hash);
+		}
+		lrec_free(pinrec);
+		return NULL;
+	}
+	else {
+		sllv_t* poutrecs = sllv_alloc();
+
+		lrec_t* poutrec = lrec_unbacked_alloc();
+		long long count = hyperloglog_count(pstate->phll);
+		lrec_put(poutrec, "count", mlr_alloc_string_from_ll(count), FREE_ENTRY_VALUE);
+		mapper_uniq_put_sketch(pstate, poutrec, pstate->phll);
+		sllv_append(poutrecs, poutrec);
+
+		sllv_append(poutrecs, NULL);
+		return poutrecs;
+	}
+}
+
+// ----------------------------------------------------------------
+// The sketches in the -f fields are merged into one, or, for records from
+// count-distinct -u which name the field they were counted for, into one per
+// such field.
+static sllv_t* mapper_uniq_process_hll_merge(
+	lrec_t* pinrec,
+	context_t* pctx,
+	void* pvstate)
+{
+	mapper_uniq_state_t* pstate = pvstate;
+	if (pinrec != NULL) {
+		char* counted_field_name = lrec_get(pinrec, "field");
+		for (sllse_t* pe = pstate->pgroup_by_field_names->phead; pe != NULL; pe = pe->pnext) {
+			char* field_value = lrec_get(pinrec, pe->value);
+			if (field_value == NULL)
+				continue;
+			if (counted_field_name == NULL) {
+				pstate->phll = mapper_uniq_merge_sketch(pstate->phll, pe->value, field_value);
+			} else {
+				hyperloglog_t* phll = lhmsv_get(pstate->phlls_unlashed, counted_field_name);
+				hyperloglog_t* pmerged = mapper_uniq_merge_sketch(phll, pe->value, field_value);
+				if (phll == NULL)
+					lhmsv_put(pstate->phlls_unlashed, mlr_strdup_or_die(counted_field_name), pmerged,
+						FREE_ENTRY_KEY);
+			}
+		}
+		lrec_free(pinrec);
+		return NULL;
+	}
+	else {
+		sllv_t* poutrecs = sllv_alloc();
+
+		if (pstate->phll != NULL || pstate->phlls_unlashed->num_occupied == 0) {
+			if (pstate->phll == NULL)
+				pstate->phll = hyperloglog_alloc(pstate->hll_precision);
+			lrec_t* poutrec = lrec_unbacked_alloc();
+			long long count = hyperloglog_count(pstate->phll);
+			lrec_put(poutrec, "count", mlr_alloc_string_from_ll(count), FREE_ENTRY_VALUE);
+			mapper_uniq_put_sketch(pstate, poutrec, pstate->phll);
+			sllv_append(poutrecs, poutrec);
+		}
+
+		sllv_t* punlashed_outrecs = mapper_uniq_process_unlashed_approximate(NULL, pctx, pvstate);
+		sllv_transfer(poutrecs, punlashed_outrecs);
+		sllv_free(punlashed_outrecs);
+		return poutrecs;
+	}
+}
+
+// Returns the sketch merged into, which is the parsed one if phll is NULL.
+static hyperloglog_t* mapper_uniq_merge_sketch(
+	hyperloglog_t* phll,
+	char* field_name,
+	char* field_value)
+{
+	hyperloglog_t* pother = hyperloglog_from_hex(field_value);
+	if (pother == NULL) {
+		fprintf(stderr, "%s count-distinct: field \"%s\" does not hold a HyperLogLog sketch.\n",
+			MLR_GLOBALS.bargv0, field_name);
+		exit(1);
+	}
+	if (phll == NULL)
+		return pother;
+	if (pother->precision != phll->precision) {
+		fprintf(stderr, "%s count-distinct: cannot merge HyperLogLog sketches of precisions %d and %d.\n",
+			MLR_GLOBALS.bargv0, phll->precision, pother->precision);
+		exit(1);
+	}
+	hyperloglog_merge(phll, pother);
+	hyperloglog_free(pother);
+	return phll;
+}
+
+static void mapper_uniq_put_sketch(
+	mapper_uniq_state_t* pstate,
+	lrec_t* poutrec,
+	hyperloglog_t* phll)
+{
+	if (pstate->hll_emit_sketch)
+		lrec_put(poutrec, HLL_SKETCH_FIELD_NAME, hyperloglog_to_hex(phll), FREE_ENTRY_VALUE);
+}
+
 static sllv_t* mapper_uniq_process_with_counts(
 	lrec_t* pinrec,
 	context_t* pctx,
@@ -507,18 +818,18 @@ static sllv_t* mapper_uniq_process_with_counts(
 {
 	mapper_uniq_state_t* pstate = pvstate;
 	if (pinrec != NULL) {
-		slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-			pstate->pgroup_by_field_names);
-		if (pgroup_by_field_values != NULL) {
-			unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+		group_key_t* pgroup_key = pstate->pgroup_key;
+		if (group_key_select(pgroup_key, pinrec)) {
+			unsigned long long* pcount = lhmslv_get_with_hash(pstate->pcounts_by_group,
+				pgroup_key->pvalues, pgroup_key->hash);
 			if (pcount == NULL) {
 				pcount = mlr_malloc_or_die(sizeof(unsigned long long));
 				*pcount = 1LL;
-				lhmslv_put(pstate->pcounts_by_group, slls_copy(pgroup_by_field_values), pcount, FREE_ENTRY_KEY);
+				lhmslv_put_with_hash(pstate->pcounts_by_group, slls_copy(pgroup_key->pvalues), pgroup_key->hash,
+					pcount, FREE_ENTRY_KEY);
 			} else {
 				(*pcount)++;
 			}
-			slls_free(pgroup_by_field_values);
 		}
 		lrec_free(pinrec);
 		return NULL;
@@ -558,19 +869,19 @@ static sllv_t* mapper_uniq_process_no_counts(
 		return sllv_single(NULL);
 	}
 
-	slls_t* pgroup_by_field_values = mlr_reference_selected_values_from_record(pinrec,
-		pstate->pgroup_by_field_names);
-	if (pgroup_by_field_values == NULL) {
+	group_key_t* pgroup_key = pstate->pgroup_key;
+	if (!group_key_select(pgroup_key, pinrec)) {
 		lrec_free(pinrec);
 		return NULL;
 	}
 
-	unsigned long long* pcount = lhmslv_get(pstate->pcounts_by_group, pgroup_by_field_values);
+	unsigned long long* pcount = lhmslv_get_with_hash(pstate->pcounts_by_group,
+		pgroup_key->pvalues, pgroup_key->hash);
 	if (pcount == NULL) {
 		pcount = mlr_malloc_or_die(sizeof(unsigned long long));
 		*pcount = 1LL;
-		slls_t* pcopy = slls_copy(pgroup_by_field_values);
-		lhmslv_put(pstate->pcounts_by_group, pcopy, pcount, FREE_ENTRY_KEY);
+		slls_t* pcopy = slls_copy(pgroup_key->pvalues);
+		lhmslv_put_with_hash(pstate->pcounts_by_group, pcopy, pgroup_key->hash, pcount, FREE_ENTRY_KEY);
 
 		lrec_t* poutrec = lrec_unbacked_alloc();
 
@@ -581,12 +892,10 @@ static sllv_t* mapper_uniq_process_no_counts(
 		}
 
 		lrec_free(pinrec);
-		slls_free(pgroup_by_field_values);
 		return sllv_single(poutrec);
 	} else {
 		(*pcount)++;
 		lrec_free(pinrec);
-		slls_free(pgroup_by_field_values);
 		return NULL;
 	}
 }
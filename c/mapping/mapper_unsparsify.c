@@ -3,11 +3,13 @@
 #include "cli/argparse.h"
 #include "containers/lhmsi.h"
 #include "containers/sllv.h"
+#include "containers/lrec_store.h"
 #include "mapping/mappers.h"
 
 typedef struct _mapper_unsparsify_state_t {
 	lhmsi_t* key_names;
-	sllv_t* records;
+	lrec_store_t* pstore;
+	long long num_output; // At end of stream
 	char*   filler;
 	ap_state_t* pargp;
 } mapper_unsparsify_state_t;
@@ -15,7 +17,7 @@ typedef struct _mapper_unsparsify_state_t {
 static void      mapper_unsparsify_usage(FILE* o, char* argv0, char* verb);
 static mapper_t* mapper_unsparsify_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __);
-static mapper_t* mapper_unsparsify_alloc(ap_state_t* pargp, char* filler);
+static mapper_t* mapper_unsparsify_alloc(ap_state_t* pargp, char* filler, long long mem_budget, char* tmpdir);
 static void      mapper_unsparsify_free(mapper_t* pmapper, context_t* _);
 static sllv_t*   mapper_unsparsify_process(lrec_t* pinrec, context_t* pctx, void* pvstate);
 
@@ -37,6 +39,11 @@ static void mapper_unsparsify_usage(FILE* o, char* argv0, char* verb) {
 	fprintf(o, "Options:\n");
 	fprintf(o, "--fill-with {filler string}  What to fill absent fields with. Defaults to\n");
 	fprintf(o, "                             the empty string.\n");
+	fprintf(o, "--mem {size}                 Memory budget for the records retained, e.g.\n");
+	fprintf(o, "                             500M or 4G. Past it, they are written to a\n");
+	fprintf(o, "                             temporary file. Default: no limit.\n");
+	fprintf(o, "--tmpdir {dir}               Directory for that file. Default: $TMPDIR,\n");
+	fprintf(o, "                             else /tmp.\n");
 	fprintf(o, "\n");
 	fprintf(o, "Example: if the input is two records, one being 'a=1,b=2' and the other\n");
 	fprintf(o, "being 'b=3,c=4', then the output is the two records 'a=1,b=2,c=' and\n");
@@ -47,6 +54,9 @@ static mapper_t* mapper_unsparsify_parse_cli(int* pargi, int argc, char** argv,
 	cli_reader_opts_t* _, cli_writer_opts_t* __)
 {
 	char* filler = "";
+	char* mem_budget_string = NULL;
+	char* tmpdir = NULL;
+	long long mem_budget = 0LL;
 
 	if ((argc - *pargi) < 1) {
 		mapper_unsparsify_usage(stderr, argv[0], argv[*pargi]);
@@ -57,27 +67,35 @@ static mapper_t* mapper_unsparsify_parse_cli(int* pargi, int argc, char** argv,
 
 	ap_state_t* pargp = ap_alloc();
 	ap_define_string_flag(pargp, "--fill-with", &filler);
+	ap_define_string_flag(pargp, "--mem",       &mem_budget_string);
+	ap_define_string_flag(pargp, "--tmpdir",    &tmpdir);
 	if (!ap_parse(pargp, verb, pargi, argc, argv)) {
 		mapper_unsparsify_usage(stderr, argv[0], verb);
 		return NULL;
 	}
+	if (mem_budget_string != NULL && !mlr_try_byte_count_from_string(mem_budget_string, &mem_budget)) {
+		mapper_unsparsify_usage(stderr, argv[0], verb);
+		return NULL;
+	}
 
-	mapper_t* pmapper = mapper_unsparsify_alloc(pargp, filler);
+	mapper_t* pmapper = mapper_unsparsify_alloc(pargp, filler, mem_budget, tmpdir);
 	return pmapper;
 }
 
 // ----------------------------------------------------------------
-static mapper_t* mapper_unsparsify_alloc(ap_state_t* pargp, char* filler) {
+static mapper_t* mapper_unsparsify_alloc(ap_state_t* pargp, char* filler, long long mem_budget, char* tmpdir) {
 	mapper_t* pmapper = mlr_malloc_or_die(sizeof(mapper_t));
 
 	mapper_unsparsify_state_t* pstate = mlr_malloc_or_die(sizeof(mapper_unsparsify_state_t));
-	pstate->records = sllv_alloc();
+	pstate->pstore = lrec_store_alloc(mem_budget, tmpdir);
+	pstate->num_output = 0LL;
 	pstate->key_names = lhmsi_alloc();
 	pstate->filler = filler;
 	pstate->pargp = pargp;
 
 	pmapper->pvstate       = pstate;
 	pmapper->pprocess_func = mapper_unsparsify_process;
+	pmapper->pprocess_batch_func = NULL;
 	pmapper->pfree_func    = mapper_unsparsify_free;
 
 	return pmapper;
@@ -85,8 +103,7 @@ static mapper_t* mapper_unsparsify_alloc(ap_state_t* pargp, char* filler) {
 
 static void mapper_unsparsify_free(mapper_t* pmapper, context_t* _) {
 	mapper_unsparsify_state_t* pstate = pmapper->pvstate;
-	// Free the container
-	sllv_free(pstate->records);
+	lrec_store_free(pstate->pstore);
 	lhmsi_free(pstate->key_names);
 	ap_free(pstate->pargp);
 	free(pstate);
@@ -103,15 +120,17 @@ static sllv_t* mapper_unsparsify_process(lrec_t* pinrec, context_t* pctx, void*
 				lhmsi_put(pstate->key_names, mlr_strdup_or_die(pe->key), 1, FREE_ENTRY_KEY);
 			}
 		}
-		// The caller will free the outrecs
-		sllv_append(pstate->records, pinrec);
+		lrec_store_append(pstate->pstore, pinrec);
+		lrec_free(pinrec);
 		return NULL;
 	}
 	else {
-		// End of stream.
+		// End of stream: output is a piece at a time.
 		sllv_t* poutrecs = sllv_alloc();
-		for (sllve_t* pe = pstate->records->phead; pe != NULL; pe = pe->pnext) {
-			lrec_t* pinrec = pe->pvvalue;
+		while (pstate->num_output < pstate->pstore->num_records
+			&& poutrecs->length < LREC_STORE_OUTPUT_PIECE_SIZE)
+		{
+			lrec_t* pinrec = lrec_store_get(pstate->pstore, pstate->num_output++);
 			lrec_t* poutrec = lrec_unbacked_alloc();
 			for (lhmsie_t* pf = pstate->key_names->phead; pf != NULL; pf = pf->pnext) {
 				char* key = pf->key;
@@ -124,11 +143,13 @@ static sllv_t* mapper_unsparsify_process(lrec_t* pinrec, context_t* pctx, void*
 				}
 			}
 			sllv_append(poutrecs, poutrec);
-			// Free the void-star payload
 			lrec_free(pinrec);
 		}
 
-		sllv_append(poutrecs, NULL);
+		if (pstate->num_output < pstate->pstore->num_records)
+			pctx->more_output = TRUE;
+		else
+			sllv_append(poutrecs, NULL);
 		return poutrecs;
 	}
 }
@@ -10,6 +10,7 @@
 #include "containers/lhmss.h"
 #include "containers/lhmsll.h"
 #include "containers/percentile_keeper.h"
+#include "containers/hyperloglog.h"
 #include "lib/mvfuncs.h"
 #include "mapping/stats1_accumulators.h"
 
@@ -19,6 +20,7 @@ void make_stats1_accs(
 	slls_t*  paccumulator_names,          // input
 	int      allow_int_float,             // input
 	int      do_interpolated_percentiles, // input
+	percentile_keeper_opts_t* ppercentile_opts, // input
 	lhmsv_t* acc_field_to_acc_state_in,   // output
 	lhmsv_t* acc_field_to_acc_state_out)  // output
 {
@@ -34,7 +36,7 @@ void make_stats1_accs(
 		if (is_percentile_acc_name(stats1_acc_name)) {
 			if (ppercentile_acc == NULL) {
 				ppercentile_acc = stats1_percentile_alloc(value_field_name, stats1_acc_name, allow_int_float,
-					do_interpolated_percentiles);
+					do_interpolated_percentiles, ppercentile_opts);
 				if (ppercentile_acc == NULL) {
 					fprintf(stderr, "%s stats1: accumulator \"%s\" not found.\n",
 						MLR_GLOBALS.bargv0, stats1_acc_name);
@@ -247,6 +249,48 @@ stats1_acc_t* stats1_antimode_alloc(char* value_field_name, char* stats1_acc_nam
 	return pstats1_acc;
 }
 
+// ----------------------------------------------------------------
+// Like count and mode, on the text: "1" and "1.0" are distinct.
+typedef struct _stats1_distinct_state_t {
+	hyperloglog_t* phll;
+	char* output_field_name;
+} stats1_distinct_state_t;
+static void stats1_distinct_singest(void* pvstate, char* val) {
+	stats1_distinct_state_t* pstate = pvstate;
+	hyperloglog_add_string(pstate->phll, val);
+}
+static void stats1_distinct_emit(void* pvstate, char* value_field_name, char* stats1_acc_name, int copy_data, lrec_t* poutrec) {
+	stats1_distinct_state_t* pstate = pvstate;
+	char* val = mlr_alloc_string_from_ll(hyperloglog_count(pstate->phll));
+	if (copy_data)
+		lrec_put(poutrec, mlr_strdup_or_die(pstate->output_field_name), val, FREE_ENTRY_KEY|FREE_ENTRY_VALUE);
+	else
+		lrec_put(poutrec, pstate->output_field_name, val, FREE_ENTRY_VALUE);
+}
+static void stats1_distinct_free(stats1_acc_t* pstats1_acc) {
+	stats1_distinct_state_t* pstate = pstats1_acc->pvstate;
+	hyperloglog_free(pstate->phll);
+	free(pstate->output_field_name);
+	free(pstate);
+	free(pstats1_acc);
+}
+stats1_acc_t* stats1_distinct_alloc(char* value_field_name, char* stats1_acc_name, int allow_int_float,
+	int do_interpolated_percentiles)
+{
+	stats1_acc_t* pstats1_acc   = mlr_malloc_or_die(sizeof(stats1_acc_t));
+	stats1_distinct_state_t* pstate = mlr_malloc_or_die(sizeof(stats1_distinct_state_t));
+	pstate->phll                = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	pstate->output_field_name   = mlr_paste_3_strings(value_field_name, "_", stats1_acc_name);
+
+	pstats1_acc->pvstate        = (void*)pstate;
+	pstats1_acc->pdingest_func  = NULL;
+	pstats1_acc->pningest_func  = NULL;
+	pstats1_acc->psingest_func  = stats1_distinct_singest;
+	pstats1_acc->pemit_func     = stats1_distinct_emit;
+	pstats1_acc->pfree_func     = stats1_distinct_free;
+	return pstats1_acc;
+}
+
 // ----------------------------------------------------------------
 typedef struct _stats1_sum_state_t {
 	mv_t sum;
@@ -681,11 +725,11 @@ static void stats1_percentile_free(stats1_acc_t* pstats1_acc) {
 	}
 }
 stats1_acc_t* stats1_percentile_alloc(char* value_field_name, char* stats1_acc_name, int allow_int_float,
-	int do_interpolated_percentiles)
+	int do_interpolated_percentiles, percentile_keeper_opts_t* ppercentile_opts)
 {
 	stats1_acc_t* pstats1_acc   = mlr_malloc_or_die(sizeof(stats1_acc_t));
 	stats1_percentile_state_t* pstate = mlr_malloc_or_die(sizeof(stats1_percentile_state_t));
-	pstate->ppercentile_keeper  = percentile_keeper_alloc();
+	pstate->ppercentile_keeper  = percentile_keeper_alloc_with_opts(ppercentile_opts);
 	pstate->poutput_field_names = lhmss_alloc();
 	pstate->reference_count     = 1;
 	pstate->ppercentile_keeper_emitter = (do_interpolated_percentiles)
@@ -4,6 +4,7 @@
 #include "containers/lrec.h"
 #include "containers/slls.h"
 #include "containers/lhmsv.h"
+#include "containers/percentile_keeper.h"
 
 // ----------------------------------------------------------------
 // These are used by mlr stats1 as well as mlr merge-fields.
@@ -49,6 +50,7 @@ typedef stats1_acc_t* stats1_alloc_func_t(char* value_field_name, char* stats1_a
 stats1_acc_t* stats1_count_alloc             (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_mode_alloc              (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_antimode_alloc          (char* value_field_name, char* stats1_acc_name, int aif, int dip);
+stats1_acc_t* stats1_distinct_alloc          (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_sum_alloc               (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_mean_alloc              (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_stddev_var_meaneb_alloc (char* value_field_name, char* stats1_acc_name, cumulant2o_t do_which);
@@ -59,7 +61,8 @@ stats1_acc_t* stats1_skewness_alloc          (char* value_field_name, char* stat
 stats1_acc_t* stats1_kurtosis_alloc          (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_min_alloc               (char* value_field_name, char* stats1_acc_name, int aif, int dip);
 stats1_acc_t* stats1_max_alloc               (char* value_field_name, char* stats1_acc_name, int aif, int dip);
-stats1_acc_t* stats1_percentile_alloc        (char* value_field_name, char* stats1_acc_name, int aif, int dip);
+stats1_acc_t* stats1_percentile_alloc        (char* value_field_name, char* stats1_acc_name, int aif, int dip,
+	percentile_keeper_opts_t* ppercentile_opts);
 void          stats1_percentile_reuse        (stats1_acc_t* pstats1_acc);
 
 
@@ -72,6 +75,7 @@ void make_stats1_accs(
 	slls_t*  paccumulator_names,
 	int      allow_int_float,
 	int      do_interpolated_percentiles,
+	percentile_keeper_opts_t* ppercentile_opts, // NULL for exact percentiles
 	lhmsv_t* acc_field_to_acc_state_in,
 	lhmsv_t* acc_field_to_acc_state_out);
 
@@ -94,6 +98,7 @@ static stats1_acc_lookup_t stats1_acc_lookup_table[] = {
 	{"count",    stats1_count_alloc,    "Count instances of fields"},
 	{"mode",     stats1_mode_alloc,     "Find most-frequently-occurring values for fields; first-found wins tie"},
 	{"antimode", stats1_antimode_alloc, "Find least-frequently-occurring values for fields; first-found wins tie"},
+	{"distinct", stats1_distinct_alloc, "Estimate number of distinct values for fields (HyperLogLog, ~1% error)"},
 	{"sum",      stats1_sum_alloc,      "Compute sums of specified fields"},
 	{"mean",     stats1_mean_alloc,     "Compute averages (sample means) of specified fields"},
 	{"stddev",   stats1_stddev_alloc,   "Compute sample standard deviation of specified fields"},
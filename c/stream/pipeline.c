@@ -0,0 +1,212 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "lib/mlrutil.h"
+#include "lib/mlr_globals.h"
+#include "containers/spsc_queue.h"
+#include "mapping/mapper.h"
+#include "stream/pipeline.h"
+
+// Records per batch, and batches per queue.
+#define PIPELINE_BATCH_SIZE    256
+#define PIPELINE_QUEUE_BATCHES 8
+
+typedef struct _pipeline_item_t {
+	lrec_t*   prec; // Null for end of stream
+	context_t ctx;
+} pipeline_item_t;
+
+typedef struct _pipeline_batch_t {
+	int             length;
+	int             is_last; // Nothing follows this batch on its queue
+	pipeline_item_t items[PIPELINE_BATCH_SIZE];
+} pipeline_batch_t;
+
+struct _pipeline_t;
+
+typedef struct _pipeline_stage_t {
+	struct _pipeline_t* ppipeline;
+	mapper_t*           pmapper;  // Null for the writer stage
+	spsc_queue_t*       pinput_queue;
+	spsc_queue_t*       poutput_queue; // Null for the writer stage
+	pthread_t           thread;
+} pipeline_stage_t;
+
+struct _pipeline_t {
+	int               num_stages; // Mappers plus writer
+	pipeline_stage_t* pstages;
+	spsc_queue_t**    pqueues;    // Into each stage
+	pipeline_batch_t* pbatch;     // Being filled by the main thread
+
+	lrec_writer_t*    plrec_writer;
+	FILE*             output_stream;
+
+	int               force_eof;  // Set by any mapper thread; read by the main thread
+	int               is_finished;
+};
+
+static void* pipeline_mapper_main(void* pvarg);
+static void* pipeline_writer_main(void* pvarg);
+
+// ----------------------------------------------------------------
+static pipeline_batch_t* pipeline_batch_alloc() {
+	pipeline_batch_t* pbatch = mlr_malloc_or_die(sizeof(pipeline_batch_t));
+	pbatch->length  = 0;
+	pbatch->is_last = FALSE;
+	return pbatch;
+}
+
+// ----------------------------------------------------------------
+pipeline_t* pipeline_alloc(sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream) {
+	pipeline_t* ppipeline = mlr_malloc_or_die(sizeof(pipeline_t));
+
+	ppipeline->num_stages    = pmapper_list->length + 1;
+	ppipeline->pstages       = mlr_malloc_or_die(ppipeline->num_stages * sizeof(pipeline_stage_t));
+	ppipeline->pqueues       = mlr_malloc_or_die(ppipeline->num_stages * sizeof(spsc_queue_t*));
+	ppipeline->pbatch        = pipeline_batch_alloc();
+	ppipeline->plrec_writer  = plrec_writer;
+	ppipeline->output_stream = output_stream;
+	ppipeline->force_eof     = FALSE;
+	ppipeline->is_finished   = FALSE;
+
+	for (int i = 0; i < ppipeline->num_stages; i++)
+		ppipeline->pqueues[i] = spsc_queue_alloc(PIPELINE_QUEUE_BATCHES);
+
+	int i = 0;
+	for (sllve_t* pe = pmapper_list->phead; pe != NULL; pe = pe->pnext, i++) {
+		pipeline_stage_t* pstage = &ppipeline->pstages[i];
+		pstage->ppipeline     = ppipeline;
+		pstage->pmapper       = pe->pvvalue;
+		pstage->pinput_queue  = ppipeline->pqueues[i];
+		pstage->poutput_queue = ppipeline->pqueues[i+1];
+	}
+	pipeline_stage_t* pwriter_stage = &ppipeline->pstages[i];
+	pwriter_stage->ppipeline     = ppipeline;
+	pwriter_stage->pmapper       = NULL;
+	pwriter_stage->pinput_queue  = ppipeline->pqueues[i];
+	pwriter_stage->poutput_queue = NULL;
+
+	for (i = 0; i < ppipeline->num_stages; i++) {
+		pipeline_stage_t* pstage = &ppipeline->pstages[i];
+		int rc = pthread_create(&pstage->thread, NULL,
+			pstage->pmapper != NULL ? pipeline_mapper_main : pipeline_writer_main, pstage);
+		if (rc != 0) {
+			fprintf(stderr, "%s: could not create pipeline thread: %s.\n", MLR_GLOBALS.bargv0, strerror(rc));
+			exit(1);
+		}
+	}
+
+	return ppipeline;
+}
+
+// ----------------------------------------------------------------
+// The threads will have exited by now, since end of stream has been sent.
+void pipeline_free(pipeline_t* ppipeline) {
+	if (ppipeline == NULL)
+		return;
+	MLR_INTERNAL_CODING_ERROR_IF(!ppipeline->is_finished);
+	for (int i = 0; i < ppipeline->num_stages; i++)
+		spsc_queue_free(ppipeline->pqueues[i]);
+	free(ppipeline->pqueues);
+	free(ppipeline->pstages);
+	free(ppipeline);
+}
+
+// ----------------------------------------------------------------
+void pipeline_process(pipeline_t* ppipeline, lrec_t* pinrec, context_t* pctx) {
+	pipeline_batch_t* pbatch = ppipeline->pbatch;
+	pipeline_item_t* pitem = &pbatch->items[pbatch->length++];
+	pitem->prec = pinrec;
+	pitem->ctx  = *pctx;
+
+	if (pinrec == NULL) {
+		pbatch->is_last = TRUE;
+		spsc_queue_push(ppipeline->pqueues[0], pbatch);
+		ppipeline->pbatch = NULL;
+		for (int i = 0; i < ppipeline->num_stages; i++)
+			pthread_join(ppipeline->pstages[i].thread, NULL);
+		ppipeline->is_finished = TRUE;
+	} else if (pbatch->length == PIPELINE_BATCH_SIZE) {
+		spsc_queue_push(ppipeline->pqueues[0], pbatch);
+		ppipeline->pbatch = pipeline_batch_alloc();
+	}
+}
+
+// ----------------------------------------------------------------
+int pipeline_is_force_eof(pipeline_t* ppipeline) {
+	return __atomic_load_n(&ppipeline->force_eof, __ATOMIC_RELAXED);
+}
+
+// ----------------------------------------------------------------
+// Calls the mapper on each record, with the context it was read with. The
+// output records, including the end-of-stream null if the mapper returns one,
+// go to the next stage as they would in chain_map in stream.c -- as does each
+// piece of end-of-stream output, if the mapper returns it in pieces.
+static void* pipeline_mapper_main(void* pvarg) {
+	pipeline_stage_t* pstage = pvarg;
+	mapper_t* pmapper = pstage->pmapper;
+	pipeline_batch_t* poutbatch = pipeline_batch_alloc();
+
+	while (TRUE) {
+		pipeline_batch_t* pinbatch = spsc_queue_pop(pstage->pinput_queue);
+
+		for (int i = 0; i < pinbatch->length; i++) {
+			context_t* pctx = &pinbatch->items[i].ctx;
+			int more_output = FALSE;
+			do {
+				sllv_t* outrecs = pmapper->pprocess_func(pinbatch->items[i].prec, pctx, pmapper->pvstate);
+				more_output = pctx->more_output;
+				pctx->more_output = FALSE;
+				if (pctx->force_eof)
+					__atomic_store_n(&pstage->ppipeline->force_eof, TRUE, __ATOMIC_RELAXED);
+				if (outrecs == NULL)
+					continue;
+
+				for (sllve_t* pe = outrecs->phead; pe != NULL; pe = pe->pnext) {
+					pipeline_item_t* pitem = &poutbatch->items[poutbatch->length++];
+					pitem->prec = pe->pvvalue;
+					pitem->ctx  = *pctx;
+					if (poutbatch->length == PIPELINE_BATCH_SIZE) {
+						spsc_queue_push(pstage->poutput_queue, poutbatch);
+						poutbatch = pipeline_batch_alloc();
+					}
+				}
+				sllv_free(outrecs);
+			} while (more_output);
+		}
+
+		int is_last = pinbatch->is_last;
+		free(pinbatch);
+		if (is_last)
+			break;
+	}
+
+	poutbatch->is_last = TRUE;
+	spsc_queue_push(pstage->poutput_queue, poutbatch);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+// As in drive_lrec in stream.c, null records aren't passed to the writer. The
+// main thread drains the writer after the pipeline finishes.
+static void* pipeline_writer_main(void* pvarg) {
+	pipeline_stage_t* pstage = pvarg;
+	lrec_writer_t* plrec_writer = pstage->ppipeline->plrec_writer;
+	FILE* output_stream = pstage->ppipeline->output_stream;
+
+	while (TRUE) {
+		pipeline_batch_t* pinbatch = spsc_queue_pop(pstage->pinput_queue);
+		for (int i = 0; i < pinbatch->length; i++) {
+			pipeline_item_t* pitem = &pinbatch->items[i];
+			if (pitem->prec != NULL) // writer frees records
+				plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, pitem->prec, &pitem->ctx);
+		}
+		int is_last = pinbatch->is_last;
+		free(pinbatch);
+		if (is_last)
+			break;
+	}
+	return NULL;
+}
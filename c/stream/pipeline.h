@@ -0,0 +1,40 @@
+// ================================================================
+// Pipeline-parallel execution of the mapper chain, for --pipeline.
+//
+// Each mapper in the then-chain runs on a thread of its own, as does the
+// record-writer, joined by single-producer, single-consumer queues which carry
+// batches of records. The main thread reads records and feeds them to the
+// first mapper.
+//
+// Each record travels with a copy of the context (NR, FNR, FILENAME, etc.) as
+// it was when the record was read, and each mapper is called with that
+// context, so the mappers see what they would have seen without --pipeline.
+// The end-of-stream null record flows down the chain as in stream.c. If a
+// mapper sets force_eof (e.g. head), the main thread stops reading soon
+// thereafter -- though, unlike in the single-threaded case, a few more records
+// may have been read by then.
+// ================================================================
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <stdio.h>
+#include "lib/context.h"
+#include "containers/lrec.h"
+#include "containers/sllv.h"
+#include "output/lrec_writer.h"
+
+typedef struct _pipeline_t pipeline_t;
+
+pipeline_t* pipeline_alloc(sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream);
+void pipeline_free(pipeline_t* ppipeline);
+
+// Called from the main thread, as with drive_lrec in stream.c. The null record
+// marks end of stream: this returns only once the mapper and writer threads
+// have processed everything and exited.
+void pipeline_process(pipeline_t* ppipeline, lrec_t* pinrec, context_t* pctx);
+
+// True once any mapper has set force_eof in its context.
+int pipeline_is_force_eof(pipeline_t* ppipeline);
+
+#endif // PIPELINE_H
@@ -1,26 +1,50 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 #include "lib/mlrutil.h"
 #include "lib/mlr_globals.h"
 #include "containers/lrec.h"
 #include "containers/sllv.h"
+#include "containers/lrec_batch.h"
 #include "input/lrec_readers.h"
 #include "mapping/mappers.h"
 #include "output/lrec_writers.h"
+#include "stream/pipeline.h"
 
 static int do_stream_chained_in_place(context_t* pctx, cli_opts_t* popts);
 static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cli_opts_t* popts);
 
 static int do_file_chained(char* filename, context_t* pctx,
-	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
-	cli_opts_t* popts);
-
-static sllv_t* chain_map(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head);
-
-static void drive_lrec(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, lrec_writer_t* plrec_writer,
-	FILE* output_stream);
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, pipeline_t* ppipeline, lrec_writer_t* plrec_writer,
+	FILE* output_stream, cli_opts_t* popts);
+
+static void chain_map(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, sllv_t* poutrecs,
+	lrec_writer_t* plrec_writer, FILE* output_stream);
+static void write_lrecs(sllv_t* poutrecs, context_t* pctx, lrec_writer_t* plrec_writer, FILE* output_stream);
+
+static void drive_lrec(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, pipeline_t* ppipeline,
+	lrec_writer_t* plrec_writer, FILE* output_stream);
+static void drive_lrec_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch, context_t* pctx,
+	sllve_t* pmapper_list_head, lrec_writer_t* plrec_writer, FILE* output_stream);
+static int chain_supports_batches(sllv_t* pmapper_list);
+static int get_records_per_batch(char* filename, cli_opts_t* popts);
+static void drive_pending_batch_at_exit(void);
+
+// The record-readers exit the process on malformed input. Records read before
+// then would have been written already if not for batching; this lets them be
+// written on the way out. It's set only while the reader is running, so that a
+// batch is never driven twice if a mapper exits partway through it.
+static struct {
+	int            active;
+	lrec_batch_t*  pinbatch;
+	lrec_batch_t*  poutbatch;
+	context_t*     pctx;
+	sllve_t*       pmapper_list_head;
+	lrec_writer_t* plrec_writer;
+	FILE*          output_stream;
+} pending_batch = { .active = FALSE };
 
 typedef void progress_indicator_t(context_t* pctx, long long nr_progress_mod);
 static void null_progress_indicator(context_t* pctx, long long nr_progress_mod);
@@ -83,11 +107,15 @@ static int do_stream_chained_in_place(context_t* pctx, cli_opts_t* popts) {
 			exit(1);
 		}
 
+		pipeline_t* ppipeline = popts->use_pipeline
+			? pipeline_alloc(pmapper_list, plrec_writer, output_stream)
+			: NULL;
+
 		pctx->filenum++;
 		pctx->filename = filename;
 		pctx->fnr = 0;
 
-		ok = do_file_chained(filename, pctx, plrec_reader, pmapper_list, plrec_writer,
+		ok = do_file_chained(filename, pctx, plrec_reader, pmapper_list, ppipeline, plrec_writer,
 			output_stream, popts) && ok;
 
 		// For in-place mode, there's no breaking from the loop over input files. Just an early
@@ -97,9 +125,10 @@ static int do_stream_chained_in_place(context_t* pctx, cli_opts_t* popts) {
 
 		// Mappers and writers receive end-of-stream notifications via null input record.
 		// Do that, now that data from the input file have been exhausted.
-		drive_lrec(NULL, pctx, pmapper_list->phead, plrec_writer, output_stream);
+		drive_lrec(NULL, pctx, pmapper_list->phead, ppipeline, plrec_writer, output_stream);
 		// Drain the pretty-printer.
 		plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, NULL, pctx);
+		pipeline_free(ppipeline);
 
 		fclose(output_stream);
 		int rc = rename(tempname, filename);
@@ -131,6 +160,10 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 
 	MLR_INTERNAL_CODING_ERROR_IF(pmapper_list->length < 1); // Should not have been allowed by the CLI parser.
 
+	pipeline_t* ppipeline = popts->use_pipeline
+		? pipeline_alloc(pmapper_list, plrec_writer, output_stream)
+		: NULL;
+
 	int ok = 1;
 	if (popts->filenames == NULL) {
 		// No input at all
@@ -139,7 +172,7 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 		pctx->filenum++;
 		pctx->filename = "(stdin)";
 		pctx->fnr = 0;
-		ok = do_file_chained("-", pctx, plrec_reader, pmapper_list, plrec_writer,
+		ok = do_file_chained("-", pctx, plrec_reader, pmapper_list, ppipeline, plrec_writer,
 			output_stream, popts) && ok;
 	} else {
 		// Read from each file name in turn
@@ -148,7 +181,7 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 			pctx->filenum++;
 			pctx->filename = filename;
 			pctx->fnr = 0;
-			ok = do_file_chained(filename, pctx, plrec_reader, pmapper_list, plrec_writer,
+			ok = do_file_chained(filename, pctx, plrec_reader, pmapper_list, ppipeline, plrec_writer,
 				output_stream, popts) && ok;
 			if (pctx->force_eof == TRUE) // e.g. mlr head
 				break;
@@ -157,11 +190,13 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 
 	// Mappers and writers receive end-of-stream notifications via null input record.
 	// Do that, now that data from all input file(s) have been exhausted.
-	drive_lrec(NULL, pctx, pmapper_list->phead, plrec_writer, output_stream);
+	drive_lrec(NULL, pctx, pmapper_list->phead, ppipeline, plrec_writer, output_stream);
 
 	// Drain the pretty-printer.
 	plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, NULL, pctx);
 
+	pipeline_free(ppipeline);
+
 	plrec_reader->pfree_func(plrec_reader);
 	plrec_writer->pfree_func(plrec_writer, pctx);
 
@@ -170,8 +205,8 @@ static int do_stream_chained_to_stdout(context_t* pctx, sllv_t* pmapper_list, cl
 
 // ----------------------------------------------------------------
 static int do_file_chained(char* filename, context_t* pctx,
-	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, lrec_writer_t* plrec_writer, FILE* output_stream,
-	cli_opts_t* popts)
+	lrec_reader_t* plrec_reader, sllv_t* pmapper_list, pipeline_t* ppipeline, lrec_writer_t* plrec_writer,
+	FILE* output_stream, cli_opts_t* popts)
 {
 	void* pvhandle = plrec_reader->popen_func(plrec_reader->pvstate, popts->reader_opts.prepipe, filename);
 	progress_indicator_t* pindicator = popts->nr_progress_mod == 0LL
@@ -181,10 +216,40 @@ static int do_file_chained(char* filename, context_t* pctx,
 	// Start-of-file hook, e.g. expecting CSV headers on input.
 	plrec_reader->psof_func(plrec_reader->pvstate, pvhandle);
 
+	// Batches are per file, so that FILENAME etc. are the same for all records
+	// in a batch. Not with --pass-comments, since the reader writes comment lines
+	// as it goes and they'd come out ahead of the batch's records.
+	lrec_batch_t* pinbatch = NULL;
+	lrec_batch_t* poutbatch = NULL;
+	int records_per_batch = get_records_per_batch(filename, popts);
+	if (ppipeline == NULL && records_per_batch > 1
+		&& popts->reader_opts.comment_handling != PASS_COMMENTS
+		&& chain_supports_batches(pmapper_list))
+	{
+		pinbatch  = lrec_batch_alloc(records_per_batch);
+		poutbatch = lrec_batch_alloc(records_per_batch);
+
+		static int registered = FALSE;
+		if (!registered) {
+			atexit(drive_pending_batch_at_exit);
+			registered = TRUE;
+		}
+		pending_batch.pinbatch          = pinbatch;
+		pending_batch.poutbatch         = poutbatch;
+		pending_batch.pctx              = pctx;
+		pending_batch.pmapper_list_head = pmapper_list->phead;
+		pending_batch.plrec_writer      = plrec_writer;
+		pending_batch.output_stream     = output_stream;
+	}
+
 	while (1) {
+		pending_batch.active = pinbatch != NULL;
 		lrec_t* pinrec = plrec_reader->pprocess_func(plrec_reader->pvstate, pvhandle, pctx);
+		pending_batch.active = FALSE;
 		if (pinrec == NULL)
 			break;
+		if (ppipeline != NULL && pipeline_is_force_eof(ppipeline))
+			pctx->force_eof = TRUE;
 		if (pctx->force_eof == TRUE) { // e.g. mlr head
 			lrec_free(pinrec);
 			break;
@@ -194,7 +259,20 @@ static int do_file_chained(char* filename, context_t* pctx,
 
 		pindicator(pctx, popts->nr_progress_mod);
 
-		drive_lrec(pinrec, pctx, pmapper_list->phead, plrec_writer, output_stream);
+		if (pinbatch != NULL) {
+			lrec_batch_append(pinbatch, pinrec, pctx->nr, pctx->fnr);
+			if (pinbatch->length >= records_per_batch)
+				drive_lrec_batch(pinbatch, poutbatch, pctx, pmapper_list->phead, plrec_writer, output_stream);
+		} else {
+			drive_lrec(pinrec, pctx, pmapper_list->phead, ppipeline, plrec_writer, output_stream);
+		}
+	}
+
+	if (pinbatch != NULL) {
+		if (pinbatch->length > 0)
+			drive_lrec_batch(pinbatch, poutbatch, pctx, pmapper_list->phead, plrec_writer, output_stream);
+		lrec_batch_free(pinbatch);
+		lrec_batch_free(poutbatch);
 	}
 
 	plrec_reader->pclose_func(plrec_reader->pvstate, pvhandle, popts->reader_opts.prepipe);
@@ -202,45 +280,118 @@ static int do_file_chained(char* filename, context_t* pctx,
 }
 
 // ----------------------------------------------------------------
-static void drive_lrec(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, lrec_writer_t* plrec_writer,
-	FILE* output_stream)
+// With --pipeline, the mappers and writer run on threads of their own: see
+// pipeline.h.
+static void drive_lrec(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, pipeline_t* ppipeline,
+	lrec_writer_t* plrec_writer, FILE* output_stream)
 {
-	sllv_t* outrecs = chain_map(pinrec, pctx, pmapper_list_head);
-	if (outrecs != NULL) {
-		for (sllve_t* pe = outrecs->phead; pe != NULL; pe = pe->pnext) {
-			lrec_t* poutrec = pe->pvvalue;
-			if (poutrec != NULL) // writer frees records (sllv void-star payload)
-				plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, poutrec, pctx);
-		}
-		sllv_free(outrecs); // we free the list
+	if (ppipeline != NULL) {
+		pipeline_process(ppipeline, pinrec, pctx);
+		return;
+	}
+
+	sllv_t* outrecs = sllv_alloc();
+	chain_map(pinrec, pctx, pmapper_list_head, outrecs, plrec_writer, output_stream);
+	write_lrecs(outrecs, pctx, plrec_writer, output_stream);
+	sllv_free(outrecs); // we free the list
+}
+
+// Empties the list.
+static void write_lrecs(sllv_t* poutrecs, context_t* pctx, lrec_writer_t* plrec_writer, FILE* output_stream) {
+	while (poutrecs->phead != NULL) {
+		lrec_t* poutrec = sllv_pop(poutrecs);
+		if (poutrec != NULL) // writer frees records (sllv void-star payload)
+			plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, poutrec, pctx);
 	}
 }
 
+// ----------------------------------------------------------------
+// Passes a batch of records through each mapper in turn, then to the writer,
+// without the per-record list allocations of chain_map. On return both batches
+// are empty.
+static void drive_lrec_batch(lrec_batch_t* pinbatch, lrec_batch_t* poutbatch, context_t* pctx,
+	sllve_t* pmapper_list_head, lrec_writer_t* plrec_writer, FILE* output_stream)
+{
+	for (sllve_t* pe = pmapper_list_head; pe != NULL; pe = pe->pnext) {
+		mapper_t* pmapper = pe->pvvalue;
+		pmapper->pprocess_batch_func(pinbatch, poutbatch, pctx, pmapper->pvstate);
+		pinbatch->length = 0;
+		lrec_batch_t* ptemp = pinbatch;
+		pinbatch = poutbatch;
+		poutbatch = ptemp;
+	}
+
+	for (int i = 0; i < pinbatch->length; i++) // writer frees records
+		plrec_writer->pprocess_func(plrec_writer->pvstate, output_stream, pinbatch->pentries[i].prec, pctx);
+	pinbatch->length = 0;
+}
+
+static void drive_pending_batch_at_exit(void) {
+	if (pending_batch.active && pending_batch.pinbatch->length > 0) {
+		pending_batch.active = FALSE;
+		drive_lrec_batch(pending_batch.pinbatch, pending_batch.poutbatch, pending_batch.pctx,
+			pending_batch.pmapper_list_head, pending_batch.plrec_writer, pending_batch.output_stream);
+	}
+}
+
+static int chain_supports_batches(sllv_t* pmapper_list) {
+	for (sllve_t* pe = pmapper_list->phead; pe != NULL; pe = pe->pnext) {
+		mapper_t* pmapper = pe->pvvalue;
+		if (pmapper->pprocess_batch_func == NULL)
+			return FALSE;
+	}
+	return TRUE;
+}
+
+// Unless --records-per-batch is given, only regular files are read in batches.
+// Otherwise, e.g. from tail -f or a slow pipe, records already read would be
+// held back while the reader waits for the rest of the batch.
+static int get_records_per_batch(char* filename, cli_opts_t* popts) {
+	if (popts->records_per_batch > 0)
+		return popts->records_per_batch;
+	if (popts->reader_opts.prepipe != NULL)
+		return 1;
+	struct stat stat_buf;
+	int rc = streq(filename, "-") ? fstat(fileno(stdin), &stat_buf) : stat(filename, &stat_buf);
+	if (rc != 0 || !S_ISREG(stat_buf.st_mode))
+		return 1;
+	return DEFAULT_RECORDS_PER_BATCH;
+}
+
 // ----------------------------------------------------------------
 // Map a single input record (maybe null at end of input stream) to zero or
 // more output records.
 //
-// Return: list of lrec_t*. Input: lrec_t* and list of mapper_t*.
+// Output: list of lrec_t*, appended to. Input: lrec_t* and list of mapper_t*.
+//
+// A mapper may return its end-of-stream output in pieces (see mapper.h). Each
+// piece goes through the rest of the chain, and the output list is written out,
+// before the next is asked for.
 
-static sllv_t* chain_map(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head) {
+static void chain_map(lrec_t* pinrec, context_t* pctx, sllve_t* pmapper_list_head, sllv_t* poutrecs,
+	lrec_writer_t* plrec_writer, FILE* output_stream)
+{
 	mapper_t* pmapper = pmapper_list_head->pvvalue;
-	sllv_t* outrecs = pmapper->pprocess_func(pinrec, pctx, pmapper->pvstate);
-	if (pmapper_list_head->pnext == NULL) {
-		return outrecs;
-	} else if (outrecs == NULL) { // end of input stream
-		return NULL;
-	} else {
-		sllv_t* nextrecs = sllv_alloc();
-
-		for (sllve_t* pe = outrecs->phead; pe != NULL; pe = pe->pnext) {
-			lrec_t* poutrec = pe->pvvalue;
-			sllv_t* nextrecsi = chain_map(poutrec, pctx, pmapper_list_head->pnext);
-			sllv_transfer(nextrecs, nextrecsi);
-			sllv_free(nextrecsi);
+	while (TRUE) {
+		sllv_t* outrecs = pmapper->pprocess_func(pinrec, pctx, pmapper->pvstate);
+		int more_output = pctx->more_output;
+		pctx->more_output = FALSE;
+
+		if (outrecs != NULL) {
+			if (pmapper_list_head->pnext == NULL) {
+				sllv_transfer(poutrecs, outrecs);
+			} else {
+				for (sllve_t* pe = outrecs->phead; pe != NULL; pe = pe->pnext) {
+					lrec_t* poutrec = pe->pvvalue;
+					chain_map(poutrec, pctx, pmapper_list_head->pnext, poutrecs, plrec_writer, output_stream);
+				}
+			}
+			sllv_free(outrecs);
 		}
-		sllv_free(outrecs);
 
-		return nextrecs;
+		if (!more_output)
+			break;
+		write_lrecs(poutrecs, pctx, plrec_writer, output_stream);
 	}
 }
 
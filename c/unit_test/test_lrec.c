@@ -145,6 +145,60 @@ static char* test_lrec_nidx_api() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+// Lines longer than the 16- or 32-byte blocks used by the vectorized splitters,
+// with separators straddling block boundaries.
+static char* test_lrec_dkvp_nidx_long_lines() {
+	char* line = mlr_strdup_or_die("abcdefghijklmno=1,pqrstuvwxyzabcd=2,,,no_equals_sign,x=y=z,=empty_key,last=");
+	lrec_t* prec = lrec_parse_stdio_dkvp_single_sep(line, ',', '=', FALSE);
+	mu_assert_lf(prec->field_count == 8);
+	mu_assert_lf(streq(lrec_get(prec, "abcdefghijklmno"), "1"));
+	mu_assert_lf(streq(lrec_get(prec, "pqrstuvwxyzabcd"), "2"));
+	mu_assert_lf(streq(lrec_get(prec, "3"), ""));
+	mu_assert_lf(streq(lrec_get(prec, "4"), ""));
+	mu_assert_lf(streq(lrec_get(prec, "5"), "no_equals_sign"));
+	mu_assert_lf(streq(lrec_get(prec, "x"), "y=z"));
+	mu_assert_lf(streq(lrec_get(prec, "7"), "empty_key"));
+	mu_assert_lf(streq(lrec_get(prec, "last"), ""));
+	lrec_free(prec);
+
+	line = mlr_strdup_or_die(",,,abcdefghijklmno=1,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,,pqrstuvwxyzabcd=2,,,");
+	prec = lrec_parse_stdio_dkvp_single_sep(line, ',', '=', TRUE);
+	mu_assert_lf(prec->field_count == 2);
+	mu_assert_lf(streq(lrec_get(prec, "abcdefghijklmno"), "1"));
+	mu_assert_lf(streq(lrec_get(prec, "pqrstuvwxyzabcd"), "2"));
+	lrec_free(prec);
+
+	line = mlr_strdup_or_die("abcdefghijklmno:=1;;pqrstuvwxyzabcd:=2;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;;x:=:=3;;;");
+	prec = lrec_parse_stdio_dkvp_multi_sep(line, ";;", ":=", 2, 2, TRUE);
+	mu_assert_lf(prec->field_count == 4);
+	mu_assert_lf(streq(lrec_get(prec, "abcdefghijklmno"), "1"));
+	mu_assert_lf(streq(lrec_get(prec, "pqrstuvwxyzabcd"), "2"));
+	mu_assert_lf(streq(lrec_get(prec, "x"), ":=3"));
+	mu_assert_lf(streq(lrec_get(prec, "4"), ";"));
+	lrec_free(prec);
+
+	line = mlr_strdup_or_die("   abcdefghijklmnopqrstuvwxyz                                   b   c   ");
+	prec = lrec_parse_stdio_nidx_single_sep(line, ' ', TRUE);
+	mu_assert_lf(prec->field_count == 3);
+	mu_assert_lf(streq(lrec_get(prec, "1"), "abcdefghijklmnopqrstuvwxyz"));
+	mu_assert_lf(streq(lrec_get(prec, "2"), "b"));
+	mu_assert_lf(streq(lrec_get(prec, "3"), "c"));
+	lrec_free(prec);
+
+	line = mlr_strdup_or_die("abcdefghijklmnopqrstuvwxyz||b|||c||||||||||||||||||||||||||||||||||||d");
+	prec = lrec_parse_stdio_nidx_multi_sep(line, "||", 2, FALSE);
+	mu_assert_lf(prec->field_count == 21);
+	mu_assert_lf(streq(lrec_get(prec, "1"), "abcdefghijklmnopqrstuvwxyz"));
+	mu_assert_lf(streq(lrec_get(prec, "2"), "b"));
+	mu_assert_lf(streq(lrec_get(prec, "3"), "|c"));
+	mu_assert_lf(streq(lrec_get(prec, "4"), ""));
+	mu_assert_lf(streq(lrec_get(prec, "21"), "d"));
+	lrec_free(prec);
+
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_lrec_csv_api() {
 	char* hdr_line = mlr_strdup_or_die("w,x,y,z");
@@ -401,15 +455,67 @@ static char* test_lrec_put_after() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+// Many fields, spanning several entry blocks, with removes and re-adds
+// reusing entries.
+static char* test_lrec_many_fields() {
+	lrec_t* prec = lrec_unbacked_alloc();
+	for (int i = 1; i <= 300; i++) {
+		char free_flags = 0;
+		char* key = low_int_to_string(i, &free_flags);
+		lrec_put(prec, key, mlr_alloc_string_from_ll(i), free_flags | FREE_ENTRY_VALUE);
+	}
+	mu_assert_lf(prec->field_count == 300);
+	mu_assert_lf(streq(lrec_get(prec, "1"), "1"));
+	mu_assert_lf(streq(lrec_get(prec, "300"), "300"));
+
+	for (int i = 2; i <= 300; i += 2) {
+		char free_flags = 0;
+		char* key = low_int_to_string(i, &free_flags);
+		lrec_remove(prec, key);
+		if (free_flags & FREE_ENTRY_KEY)
+			free(key);
+	}
+	mu_assert_lf(prec->field_count == 150);
+	mu_assert_lf(lrec_get(prec, "2") == NULL);
+	mu_assert_lf(streq(lrec_get(prec, "299"), "299"));
+
+	lrec_put(prec, "new", "x", NO_FREE);
+	lrec_prepend(prec, "first", "y", NO_FREE);
+	mu_assert_lf(prec->field_count == 152);
+	mu_assert_lf(streq(prec->phead->key, "first"));
+	mu_assert_lf(streq(prec->ptail->key, "new"));
+
+	lrec_t* pcopy = lrec_copy(prec);
+	lrec_free(prec);
+	mu_assert_lf(pcopy->field_count == 152);
+	int n = 0;
+	for (lrece_t* pe = pcopy->phead; pe != NULL; pe = pe->pnext)
+		n++;
+	mu_assert_lf(n == 152);
+	mu_assert_lf(streq(lrec_get(pcopy, "151"), "151"));
+
+	lrec_clear(pcopy);
+	mu_assert_lf(pcopy->field_count == 0);
+	lrec_reserve(pcopy, 20);
+	lrec_put(pcopy, "a", "1", NO_FREE);
+	mu_assert_lf(streq(lrec_get(pcopy, "a"), "1"));
+	lrec_free(pcopy);
+
+	return NULL;
+}
+
 // ================================================================
 static char * run_all_tests() {
 	mu_run_test(test_lrec_unbacked_api);
 	mu_run_test(test_lrec_dkvp_api);
 	mu_run_test(test_lrec_nidx_api);
+	mu_run_test(test_lrec_dkvp_nidx_long_lines);
 	mu_run_test(test_lrec_csv_api);
 	mu_run_test(test_lrec_csv_api_disjoint_allocs);
 	mu_run_test(test_lrec_xtab_api);
 	mu_run_test(test_lrec_put_after);
+	mu_run_test(test_lrec_many_fields);
 	return 0;
 }
 
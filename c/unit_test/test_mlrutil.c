@@ -3,6 +3,8 @@
 #include "lib/minunit.h"
 #include "lib/mlr_globals.h"
 #include "lib/mlrutil.h"
+#include "lib/mlrsort.h"
+#include "lib/byte_scan.h"
 
 int tests_run         = 0;
 int tests_failed      = 0;
@@ -148,6 +150,165 @@ static char * test_scanners() {
 	mu_assert("error: mlr_alloc_string_from_double", streq(mlr_alloc_string_from_double(4.25, "%.4f"), "4.2500"));
 	mu_assert("error: mlr_alloc_string_from_ull", streq(mlr_alloc_string_from_ull(12345LL), "12345"));
 	mu_assert("error: mlr_alloc_string_from_int", streq(mlr_alloc_string_from_int(12345), "12345"));
+	mu_assert_lf(streq(mlr_alloc_string_from_ll(-9223372036854775807LL-1), "-9223372036854775808"));
+	mu_assert_lf(streq(mlr_alloc_string_from_double(0.0078125, "%lf"), "0.007812"));
+	mu_assert_lf(streq(mlr_alloc_string_from_double(-2.5, "%.0lf"), "-2"));
+	mu_assert_lf(streq(mlr_alloc_string_from_double(-1e-9, "%lf"), "-0.000000"));
+	mu_assert_lf(streq(mlr_alloc_string_from_double(0.1, "%.18lf"), "0.100000000000000006"));
+	mu_assert_lf(streq(mlr_alloc_string_from_double(1e20, "%.2lf"), "100000000000000000000.00"));
+	mu_assert_lf(streq(mlr_alloc_string_from_double(3.25, "%08.3lf"), "0003.250"));
+	return 0;
+}
+
+// ----------------------------------------------------------------
+static char * test_number_parsers() {
+	long long i = 0LL;
+	double d = 0.0;
+
+	mu_assert_lf(mlr_try_int_from_string("12345", &i) && i == 12345LL);
+	mu_assert_lf(mlr_try_int_from_string("-12345", &i) && i == -12345LL);
+	mu_assert_lf(mlr_try_int_from_string("+7", &i) && i == 7LL);
+	mu_assert_lf(mlr_try_int_from_string("0xff", &i) && i == 255LL);
+	mu_assert_lf(mlr_try_int_from_string("0xffffffffffffffff", &i) && i == -1LL);
+	mu_assert_lf(mlr_try_int_from_string("010", &i) && i == 8LL);
+	mu_assert_lf(mlr_try_int_from_string("9223372036854775807", &i) && i == 9223372036854775807LL);
+	mu_assert_lf(mlr_try_int_from_string(" 3", &i) && i == 3LL);
+	mu_assert_lf(!mlr_try_int_from_string("", &i));
+	mu_assert_lf(!mlr_try_int_from_string("-", &i));
+	mu_assert_lf(!mlr_try_int_from_string("3 ", &i));
+	mu_assert_lf(!mlr_try_int_from_string("300ms", &i));
+	mu_assert_lf(!mlr_try_int_from_string("1.5", &i));
+	mu_assert_lf(!mlr_try_int_from_string("abc", &i));
+
+	mu_assert_lf(mlr_try_float_from_string("0.1", &d) && d == 0.1);
+	mu_assert_lf(mlr_try_float_from_string("-1.5e3", &d) && d == -1500.0);
+	mu_assert_lf(mlr_try_float_from_string(".5", &d) && d == 0.5);
+	mu_assert_lf(mlr_try_float_from_string("5.", &d) && d == 5.0);
+	mu_assert_lf(mlr_try_float_from_string("9007199254740993", &d) && d == 9007199254740992.0);
+	mu_assert_lf(mlr_try_float_from_string("0.30000000000000004441", &d) && d == 0.30000000000000004);
+	mu_assert_lf(mlr_try_float_from_string("1e-320", &d) && d == 1e-320);
+	mu_assert_lf(mlr_try_float_from_string("0x1p3", &d) && d == 8.0);
+	mu_assert_lf(mlr_try_float_from_string("-Infinity", &d) && d < -1e308);
+	mu_assert_lf(mlr_try_float_from_string("NaN", &d) && d != d);
+	mu_assert_lf(!mlr_try_float_from_string("", &d));
+	mu_assert_lf(!mlr_try_float_from_string(".", &d));
+	mu_assert_lf(!mlr_try_float_from_string("1.5 ", &d));
+	mu_assert_lf(!mlr_try_float_from_string("300ms", &d));
+	mu_assert_lf(!mlr_try_float_from_string("1.2.3", &d));
+	mu_assert_lf(!mlr_try_float_from_string("abc", &d));
+
+	return 0;
+}
+
+// ----------------------------------------------------------------
+static char * test_byte_count_parser() {
+	long long n = 0LL;
+
+	mu_assert_lf(mlr_try_byte_count_from_string("500", &n) && n == 500LL);
+	mu_assert_lf(mlr_try_byte_count_from_string("64k", &n) && n == 65536LL);
+	mu_assert_lf(mlr_try_byte_count_from_string("500M", &n) && n == 500LL << 20);
+	mu_assert_lf(mlr_try_byte_count_from_string("4G", &n) && n == 4LL << 30);
+	mu_assert_lf(mlr_try_byte_count_from_string("2t", &n) && n == 2LL << 40);
+	mu_assert_lf(!mlr_try_byte_count_from_string("", &n));
+	mu_assert_lf(!mlr_try_byte_count_from_string("0", &n));
+	mu_assert_lf(!mlr_try_byte_count_from_string("-1G", &n));
+	mu_assert_lf(!mlr_try_byte_count_from_string("G", &n));
+	mu_assert_lf(!mlr_try_byte_count_from_string("4GB", &n));
+	mu_assert_lf(!mlr_try_byte_count_from_string("1.5G", &n));
+	mu_assert_lf(!mlr_try_byte_count_from_string("99999999999T", &n));
+
+	return 0;
+}
+
+// ----------------------------------------------------------------
+// Items are pairs of sort key and original position; only the key is compared.
+static int compare_first_of_pair(void* pva, void* pvb, void* pvcontext) {
+	long long a = ((long long*)pva)[0];
+	long long b = ((long long*)pvb)[0];
+	return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+static int is_stably_sorted(void** items, long long n) {
+	for (long long i = 1; i < n; i++) {
+		long long* pprev = items[i-1];
+		long long* pcurr = items[i];
+		if (pprev[0] > pcurr[0] || (pprev[0] == pcurr[0] && pprev[1] > pcurr[1]))
+			return FALSE;
+	}
+	return TRUE;
+}
+
+static char * test_sort_pointers() {
+	// Enough for several threads, with many ties.
+	long long n = 200000;
+	long long* pairs = mlr_malloc_or_die(2 * n * sizeof(long long));
+	void** items = mlr_malloc_or_die(n * sizeof(void*));
+
+	int thread_counts[] = { 1, 3, 8 };
+	for (int t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+		for (long long m = 1; m <= n; m *= 7) {
+			for (long long i = 0; i < m; i++) {
+				pairs[2*i]   = (i * 7919) % 1000;
+				pairs[2*i+1] = i;
+				items[i] = &pairs[2*i];
+			}
+			mlr_sort_pointers(items, m, compare_first_of_pair, NULL, thread_counts[t]);
+			mu_assert_lf(is_stably_sorted(items, m));
+		}
+	}
+
+	free(items);
+	free(pairs);
+	return 0;
+}
+
+// ----------------------------------------------------------------
+typedef struct _keyed_item_t {
+	mlr_sort_key_t key;
+	long long      position;
+} keyed_item_t;
+
+static char * test_sort_pointers_by_key() {
+	// Keys of various lengths over a small alphabet, so there are long common
+	// prefixes, keys which are prefixes of others, and many ties.
+	long long n = 100000;
+	unsigned char* bytes = mlr_malloc_or_die(n * 12);
+	keyed_item_t* pairs = mlr_malloc_or_die(n * sizeof(keyed_item_t));
+	void** items = mlr_malloc_or_die(n * sizeof(void*));
+
+	int thread_counts[] = { 1, 4 };
+	for (int t = 0; t < sizeof(thread_counts) / sizeof(thread_counts[0]); t++) {
+		for (long long m = 1; m <= n; m *= 5) {
+			unsigned long long seed = 12345;
+			for (long long i = 0; i < m; i++) {
+				seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+				size_t length = (seed >> 33) % 13;
+				for (size_t j = 0; j < length; j++)
+					bytes[12*i + j] = (j < 9) ? 0 : (seed >> (40 + j)) & 3;
+				if (length > 0)
+					bytes[12*i + length - 1] = (seed >> 20) & 3;
+				mlr_sort_key_set(&pairs[i].key, &bytes[12*i], length);
+				pairs[i].position = i;
+				items[i] = &pairs[i];
+			}
+			mlr_sort_pointers_by_key(items, m, thread_counts[t]);
+			for (long long i = 1; i < m; i++) {
+				keyed_item_t* pprev = items[i-1];
+				keyed_item_t* pcurr = items[i];
+				int s = mlr_sort_key_compare(&pprev->key, &pcurr->key);
+				mu_assert_lf(s < 0 || (s == 0 && pprev->position < pcurr->position));
+
+				// Agrees with a plain memcmp-then-length comparison
+				size_t min_length = (pprev->key.length < pcurr->key.length) ? pprev->key.length : pcurr->key.length;
+				int c = memcmp(pprev->key.bytes, pcurr->key.bytes, min_length);
+				mu_assert_lf(c < 0 || (c == 0 && pprev->key.length <= pcurr->key.length));
+			}
+		}
+	}
+
+	free(items);
+	free(pairs);
+	free(bytes);
 	return 0;
 }
 
@@ -171,6 +332,131 @@ static char * test_unbackslash() {
 	return 0;
 }
 
+// ----------------------------------------------------------------
+// Fixed values, so that any change to the hash shows up here: e.g. the portable
+// fallback for the 128-bit multiply not agreeing with the __int128 one.
+static char * test_string_hash_values() {
+	char* strings[] = {
+		"", "a", "ab", "abc", "abcd", "abcdefg", "abcdefgh", "abcdefghijklmno", "abcdefghijklmnop",
+		"abcdefghijklmnopq", "abcdefghijklmnopqrstuvwxyzABCDEF", "abcdefghijklmnopqrstuvwxyzABCDEFG",
+	};
+	int expected[] = {
+		984093001, -1120266942, 1169205009, 121349838,
+		1729747463, -960124179, -1461341796, 996067788,
+		-2131315324, -340227665, -608780133, 2055511230,
+	};
+	for (int i = 0; i < sizeof(strings) / sizeof(strings[0]); i++)
+		mu_assert_lf(mlr_string_hash_func(strings[i]) == expected[i]);
+
+	mu_assert_lf(mlr_string_pair_hash_func("abc", "def") == -1919347993);
+	mu_assert_lf(mlr_string_pair_hash_func("abc", "def") != mlr_string_pair_hash_func("abcd", "ef"));
+	mu_assert_lf(mlr_string_pair_hash_func("abc", "def") != mlr_string_pair_hash_func("def", "abc"));
+	mu_assert_lf(mlr_string_pair_hash_func("abc", "def")
+		== mlr_string_hash_finish(mlr_string_hash_continue("def", mlr_string_hash_continue("abc", 0ULL))));
+	return 0;
+}
+
+// Keys of up to 16 bytes are hashed from overlapping head and tail reads, and
+// longer ones 16 bytes at a time with the same for the remainder. At every
+// length through a few rounds of that, and at every alignment, the hash must
+// depend on each of the string's bytes and on nothing past its terminator.
+static char * test_string_hash_tails() {
+	unsigned long long storage[16]; // For 8-byte alignment of offset 0
+	char* buf = (char*)storage;
+	char model[48];
+	int hashes_by_length[41];
+
+	for (int len = 0; len <= 40; len++) {
+		for (int i = 0; i < len; i++)
+			model[i] = 'a' + (i * 7) % 26;
+		model[len] = 0;
+		int expected = mlr_string_hash_func(model);
+		hashes_by_length[len] = expected;
+		for (int j = 0; j < len; j++)
+			mu_assert_lf(hashes_by_length[j] != expected);
+
+		for (int offset = 0; offset < 16; offset++) {
+			memset(buf, 0xa5, sizeof(storage));
+			char* s = buf + offset;
+			memcpy(s, model, len + 1);
+			mu_assert_lf(mlr_string_hash_func(s) == expected);
+			for (int i = 0; i < len; i++) {
+				s[i] ^= 0x01;
+				mu_assert_lf(mlr_string_hash_func(s) != expected);
+				s[i] ^= 0x01;
+			}
+		}
+	}
+	return 0;
+}
+
+// ----------------------------------------------------------------
+static char* byte_scan_scalar_find3(char* p, char c1, char c2, char c3) {
+	while (*p && *p != c1 && *p != c2 && *p != c3)
+		p++;
+	return p;
+}
+
+// Walks the two-character block masks as the DKVP and NIDX splitters do.
+static char* byte_scan_mask_find(const byte_scanner_t* pscanner, char* p, char c1, char c2) {
+	const char* block = byte_scan_block_start(pscanner, p);
+	unsigned int mask = byte_scan_first_mask(pscanner, block, p, c1, c2);
+	while (mask == 0) {
+		block += pscanner->block_size;
+		mask = pscanner->pblock_func(block, c1, c2);
+	}
+	return (char*)block + byte_scan_lowest_bit(mask);
+}
+
+// Each vectorized scanner, and the byte-at-a-time fallback, against a plain
+// loop: starting at every offset within a block, with the first separator or
+// the null terminator at every position up to a few blocks in, and with a
+// separator just before the start which must not be matched.
+static char * test_byte_scanners() {
+	const byte_scanner_t* pscanners[] = {
+		byte_scanner_get_by_name("sse2"),
+		byte_scanner_get_by_name("avx2"), // NULL if the CPU doesn't have it
+		NULL,
+	};
+	int num_scanners = sizeof(pscanners) / sizeof(pscanners[0]);
+	char stops[] = { ',', '=', '"', '\0' };
+	char filler[] = "ab\xff\x80 ";
+
+	const byte_scanner_t* pbest = byte_scanner_get();
+	mu_assert_lf(pbest == (pscanners[1] != NULL ? pscanners[1] : pscanners[0]));
+	mu_assert_lf(byte_scanner_get() == pbest);
+
+	char* raw = mlr_malloc_or_die(512);
+	char* buf = (char*)(((unsigned long)raw + 63) & ~63UL);
+	for (int si = 0; si < num_scanners; si++) {
+		const byte_scanner_t* pscanner = pscanners[si];
+		for (int offset = 0; offset < 64; offset++) {
+			for (int len = 0; len < 96; len++) {
+				for (int ci = 0; ci < sizeof(stops); ci++) {
+					for (int i = 0; i < 256; i++)
+						buf[i] = filler[i % (sizeof(filler) - 1)];
+					if (offset > 0)
+						buf[offset - 1] = stops[ci] == '\0' ? ',' : stops[ci];
+					buf[offset + len] = stops[ci];
+					buf[offset + len + 1] = '\0';
+					char* p = &buf[offset];
+
+					mu_assert_lf(byte_scan_find3(pscanner, p, ',', '=', '"') == byte_scan_scalar_find3(p, ',', '=', '"'));
+					mu_assert_lf(byte_scan_find3(pscanner, p, ',', '=', '"') == &buf[offset + len]);
+					if (pscanner != NULL) {
+						mu_assert_lf(byte_scan_mask_find(pscanner, p, ',', '=')
+							== byte_scan_scalar_find3(p, ',', '=', ','));
+						mu_assert_lf(byte_scan_mask_find(pscanner, p, '\xff', '\xff')
+							== byte_scan_scalar_find3(p, '\xff', '\xff', '\xff'));
+					}
+				}
+			}
+		}
+	}
+	free(raw);
+	return 0;
+}
+
 // ================================================================
 static char * all_tests() {
 	mu_run_test(test_canonical_mod);
@@ -180,8 +466,15 @@ static char * all_tests() {
 	mu_run_test(test_strdup_quoted);
 	mu_run_test(test_starts_or_ends_with);
 	mu_run_test(test_scanners);
+	mu_run_test(test_number_parsers);
+	mu_run_test(test_byte_count_parser);
+	mu_run_test(test_sort_pointers);
+	mu_run_test(test_sort_pointers_by_key);
 	mu_run_test(test_paste);
 	mu_run_test(test_unbackslash);
+	mu_run_test(test_byte_scanners);
+	mu_run_test(test_string_hash_values);
+	mu_run_test(test_string_hash_tails);
 	return 0;
 }
 
@@ -18,6 +18,11 @@
 #include "containers/percentile_keeper.h"
 #include "containers/top_keeper.h"
 #include "containers/dheap.h"
+#include "containers/bloom_filter.h"
+#include "containers/tdigest.h"
+#include "containers/kll_sketch.h"
+#include "containers/hyperloglog.h"
+#include "containers/space_saving.h"
 #include "lib/mvfuncs.h"
 
 int tests_run         = 0;
@@ -688,6 +693,107 @@ static char* test_lhmsmv() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+// Each map keeps the full hash of each key, which probes compare before the
+// keys themselves and which enlargement reinserts with. So the stored hash
+// must always be the key's hash, through enlargements, removals, and copies.
+#define STORED_HASH_NUM_KEYS 1000
+
+static char* test_stored_hashes() {
+	static char keys[STORED_HASH_NUM_KEYS][48];
+	int n = STORED_HASH_NUM_KEYS;
+	for (int i = 0; i < n; i++)
+		sprintf(keys[i], "%d-%.*s", i, i % 34, "abcdefghijklmnopqrstuvwxyzABCDEFGH");
+
+	hss_t*    phss    = hss_alloc();
+	lhmsi_t*  plhmsi  = lhmsi_alloc();
+	lhmsll_t* plhmsll = lhmsll_alloc();
+	lhmss_t*  plhmss  = lhmss_alloc();
+	lhmsv_t*  plhmsv  = lhmsv_alloc();
+	lhms2v_t* plhms2v = lhms2v_alloc();
+	lhmslv_t* plhmslv = lhmslv_alloc();
+	lhmsmv_t* plhmsmv = lhmsmv_alloc();
+	for (int i = 0; i < n; i++) {
+		hss_add(phss, keys[i]);
+		lhmsi_put(plhmsi, keys[i], i, NO_FREE);
+		lhmsll_put(plhmsll, keys[i], i, NO_FREE);
+		lhmss_put(plhmss, keys[i], keys[i], NO_FREE);
+		lhmsv_put(plhmsv, keys[i], keys[i], NO_FREE);
+		lhms2v_put(plhms2v, keys[i], keys[n-1-i], keys[i], NO_FREE);
+		slls_t* plist = slls_alloc();
+		slls_append_no_free(plist, keys[i]);
+		slls_append_no_free(plist, keys[n-1-i]);
+		lhmslv_put(plhmslv, plist, keys[i], FREE_ENTRY_KEY);
+		mv_t value = mv_from_int(i);
+		lhmsmv_put(plhmsmv, keys[i], &value, NO_FREE);
+	}
+	for (int i = 0; i < n; i += 3)
+		hss_remove(phss, keys[i]);
+
+	lhmsi_t*  plhmsi_copy  = lhmsi_copy(plhmsi);
+	lhmsll_t* plhmsll_copy = lhmsll_copy(plhmsll);
+	lhmss_t*  plhmss_copy  = lhmss_copy(plhmss);
+	lhmsmv_t* plhmsmv_copy = lhmsmv_copy(plhmsmv);
+
+	int num_hss = 0;
+	for (int i = 0; i < phss->array_length; i++) {
+		hsse_t* pe = &phss->array[i];
+		if (pe->key != NULL) {
+			mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+			num_hss++;
+		}
+	}
+	mu_assert_lf(num_hss == phss->num_occupied);
+	mu_assert_lf(num_hss == n - (n + 2) / 3);
+
+	for (lhmsie_t* pe = plhmsi->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhmsie_t* pe = plhmsi_copy->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhmslle_t* pe = plhmsll->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhmslle_t* pe = plhmsll_copy->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhmsse_t* pe = plhmss->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhmsse_t* pe = plhmss_copy->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhmsve_t* pe = plhmsv->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhms2ve_t* pe = plhms2v->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_pair_hash_func(pe->key1, pe->key2));
+	for (lhmslve_t* pe = plhmslv->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == slls_hash_func(pe->key));
+	for (lhmsmve_t* pe = plhmsmv->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+	for (lhmsmve_t* pe = plhmsmv_copy->phead; pe != NULL; pe = pe->pnext)
+		mu_assert_lf(pe->hash == mlr_string_hash_func(pe->key));
+
+	mu_assert_lf(plhmsi->num_occupied == n);
+	mu_assert_lf(lhmsi_check_counts(plhmsi));
+	mu_assert_lf(lhmsll_check_counts(plhmsll));
+	mu_assert_lf(lhmss_check_counts(plhmss));
+	mu_assert_lf(lhmsv_check_counts(plhmsv));
+	mu_assert_lf(lhms2v_check_counts(plhms2v));
+	mu_assert_lf(lhmslv_check_counts(plhmslv));
+	mu_assert_lf(lhmsmv_check_counts(plhmsmv));
+
+	hss_free(phss);
+	lhmsi_free(plhmsi);
+	lhmsi_free(plhmsi_copy);
+	lhmsll_free(plhmsll);
+	lhmsll_free(plhmsll_copy);
+	lhmss_free(plhmss);
+	lhmss_free(plhmss_copy);
+	lhmsv_free(plhmsv);
+	lhms2v_free(plhms2v);
+	lhmslv_free(plhmslv);
+	lhmsmv_free(plhmsmv);
+	lhmsmv_free(plhmsmv_copy);
+
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_percentile_keeper() {
 
@@ -736,6 +842,49 @@ static char* test_percentile_keeper() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+// Selection on ints, floats, and a mix, in scrambled order with duplicates,
+// checked against a full sort. More percentiles are asked for than are done
+// by selection before sorting everything.
+static char* test_percentile_keeper_selection() {
+	int n = 10007;
+	for (int kind = 0; kind < 3; kind++) {
+		percentile_keeper_t* ppercentile_keeper = percentile_keeper_alloc();
+		mv_t* sorted = mlr_malloc_or_die(n * sizeof(mv_t));
+		for (int i = 0; i < n; i++) {
+			long long v = ((i * 7919LL) % n) / 3 - 1000;
+			mv_t value = (kind == 0 || (kind == 2 && (i & 1))) ? mv_from_int(v) : mv_from_float(v + 0.25);
+			percentile_keeper_ingest(ppercentile_keeper, value);
+			sorted[i] = value;
+		}
+		qsort(sorted, n, sizeof(mv_t), mv_xx_comparator);
+
+		double ps[] = { 50.0, 25.0, 75.0, 50.0, 0.0, 100.0, 99.0, 1.0, 10.0, 90.0, 33.3, 66.6, 12.5 };
+		for (int i = 0; i < sizeof(ps)/sizeof(ps[0]); i++) {
+			mv_t q = percentile_keeper_emit_non_interpolated(ppercentile_keeper, ps[i]);
+			long long index = ps[i] * n / 100.0;
+			if (index >= n)
+				index = n - 1;
+			mu_assert_lf(mv_xx_comparator(&q, &sorted[index]) == 0);
+			mv_t r = percentile_keeper_emit_linearly_interpolated(ppercentile_keeper, ps[i]);
+			double findex = (ps[i] / 100.0) * (n - 1);
+			long long iindex = (long long)findex;
+			double lo = (sorted[iindex].type == MT_INT) ? sorted[iindex].u.intv : sorted[iindex].u.fltv;
+			double hi = lo;
+			if (iindex < n - 1)
+				hi = (sorted[iindex+1].type == MT_INT) ? sorted[iindex+1].u.intv : sorted[iindex+1].u.fltv;
+			double expected = lo + (findex - iindex) * (hi - lo);
+			double actual = (r.type == MT_INT) ? r.u.intv : r.u.fltv;
+			mu_assert_lf(fabs(actual - expected) < 1e-9);
+		}
+		mu_assert_lf(ppercentile_keeper->sorted);
+
+		free(sorted);
+		percentile_keeper_free(ppercentile_keeper);
+	}
+	return NULL;
+}
+
 // ----------------------------------------------------------------
 static char* test_top_keeper() {
 	int capacity = 3;
@@ -861,6 +1010,317 @@ static char* test_dheap() {
 	return NULL;
 }
 
+// ----------------------------------------------------------------
+static char* test_bloom_filter() {
+	int n = 10000;
+	bloom_filter_t* pfilter = bloom_filter_alloc(n);
+	char buf[32];
+
+	for (int i = 0; i < n; i++) {
+		sprintf(buf, "in%d", i);
+		bloom_filter_add(pfilter, mlr_string_hash_func(buf));
+	}
+
+	// No false negatives
+	for (int i = 0; i < n; i++) {
+		sprintf(buf, "in%d", i);
+		mu_assert_lf(bloom_filter_might_contain(pfilter, mlr_string_hash_func(buf)));
+	}
+
+	// Few false positives: about 0.5% are expected.
+	int num_false_positives = 0;
+	for (int i = 0; i < n; i++) {
+		sprintf(buf, "out%d", i);
+		if (bloom_filter_might_contain(pfilter, mlr_string_hash_func(buf)))
+			num_false_positives++;
+	}
+	printf("bloom filter false positives: %d of %d\n", num_false_positives, n);
+	mu_assert_lf(num_false_positives < n / 50);
+
+	bloom_filter_free(pfilter);
+
+	// Empty filter
+	pfilter = bloom_filter_alloc(0);
+	mu_assert_lf(!bloom_filter_might_contain(pfilter, 12345));
+	bloom_filter_add(pfilter, 12345);
+	mu_assert_lf(bloom_filter_might_contain(pfilter, 12345));
+	bloom_filter_free(pfilter);
+
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+// Values 0 to n-1 in scrambled order: 7919 is prime so this is a permutation.
+static char* test_tdigest() {
+	int n = 100000;
+	tdigest_t* pa = tdigest_alloc(TDIGEST_DEFAULT_COMPRESSION);
+	tdigest_t* pb = tdigest_alloc(TDIGEST_DEFAULT_COMPRESSION);
+	mu_assert_lf(isnan(tdigest_quantile(pa, 0.5)));
+
+	for (int i = 0; i < n; i++)
+		tdigest_add((i < n/2) ? pa : pb, (double)((i * 7919LL) % n));
+	tdigest_merge(pa, pb);
+	mu_assert_lf(tdigest_count(pa) == n);
+	printf("tdigest centroids: %d\n", pa->num_centroids);
+	mu_assert_lf(pa->num_centroids <= 2 * TDIGEST_DEFAULT_COMPRESSION);
+
+	double qs[] = { 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999 };
+	for (int i = 0; i < sizeof(qs)/sizeof(qs[0]); i++) {
+		double v = tdigest_quantile(pa, qs[i]);
+		printf("tdigest q%.3lf -> %.2lf\n", qs[i], v);
+		mu_assert_lf(fabs(v - qs[i] * n) < 0.005 * n);
+	}
+	mu_assert_lf(tdigest_quantile(pa, 0.0) == 0.0);
+	mu_assert_lf(tdigest_quantile(pa, 1.0) == n - 1);
+	mu_assert_lf(tdigest_percentile(pa, 0.0, FALSE) == 0.0);
+	mu_assert_lf(tdigest_percentile(pa, 100.0, FALSE) == n - 1);
+	mu_assert_lf(tdigest_percentile(pa, 100.0, TRUE) == n - 1);
+
+	tdigest_free(pa);
+	tdigest_free(pb);
+
+	// Exact while the centroids are single values: as the percentile-keeper
+	// on 1..11.
+	tdigest_t* psmall = tdigest_alloc(TDIGEST_DEFAULT_COMPRESSION);
+	mu_assert_lf(isnan(tdigest_percentile(psmall, 50.0, FALSE)));
+	for (int i = 11; i >= 1; i--)
+		tdigest_add(psmall, (double)i);
+	mu_assert_lf(tdigest_percentile(psmall, 0.0, FALSE) == 1.0);
+	mu_assert_lf(tdigest_percentile(psmall, 50.0, FALSE) == 6.0);
+	mu_assert_lf(tdigest_percentile(psmall, 100.0, FALSE) == 11.0);
+	mu_assert_lf(tdigest_percentile(psmall, 25.0, TRUE) == 3.5);
+	mu_assert_lf(fabs(tdigest_percentile(psmall, 99.0, TRUE) - 10.9) < 1e-9);
+	tdigest_free(psmall);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_kll_sketch() {
+	// Exact while small: as the percentile-keeper on 1..5.
+	kll_sketch_t* psketch = kll_sketch_alloc(KLL_SKETCH_DEFAULT_K);
+	mu_assert_lf(isnan(kll_sketch_percentile(psketch, 50.0, FALSE)));
+	for (int i = 5; i >= 1; i--)
+		kll_sketch_add(psketch, (double)i);
+	mu_assert_lf(kll_sketch_percentile(psketch, 0.0, FALSE) == 1.0);
+	mu_assert_lf(kll_sketch_percentile(psketch, 10.0, FALSE) == 1.0);
+	mu_assert_lf(kll_sketch_percentile(psketch, 50.0, FALSE) == 3.0);
+	mu_assert_lf(kll_sketch_percentile(psketch, 90.0, FALSE) == 5.0);
+	mu_assert_lf(kll_sketch_percentile(psketch, 100.0, FALSE) == 5.0);
+	mu_assert_lf(kll_sketch_percentile(psketch, 25.0, TRUE) == 2.0);
+	mu_assert_lf(fabs(kll_sketch_percentile(psketch, 30.0, TRUE) - 2.2) < 1e-9);
+	kll_sketch_free(psketch);
+
+	int n = 100000;
+	kll_sketch_t* pa = kll_sketch_alloc(KLL_SKETCH_DEFAULT_K);
+	kll_sketch_t* pb = kll_sketch_alloc(KLL_SKETCH_DEFAULT_K);
+	for (int i = 0; i < n; i++)
+		kll_sketch_add((i < n/2) ? pa : pb, (double)((i * 7919LL) % n));
+	kll_sketch_merge(pa, pb);
+	mu_assert_lf(kll_sketch_count(pa) == n);
+	printf("kll items: %d in %d levels\n", pa->num_items, pa->num_levels);
+	mu_assert_lf(pa->num_items <= 3 * KLL_SKETCH_DEFAULT_K);
+
+	double ps[] = { 1.0, 10.0, 25.0, 50.0, 75.0, 90.0, 99.0 };
+	for (int i = 0; i < sizeof(ps)/sizeof(ps[0]); i++) {
+		double v = kll_sketch_percentile(pa, ps[i], FALSE);
+		printf("kll p%.0lf -> %.0lf\n", ps[i], v);
+		mu_assert_lf(fabs(v - ps[i] * n / 100.0) < 0.02 * n);
+	}
+	// Compaction drops items, but not the extremes.
+	mu_assert_lf(kll_sketch_percentile(pa, 0.0, FALSE) == 0.0);
+	mu_assert_lf(kll_sketch_percentile(pa, 100.0, FALSE) == n - 1);
+	mu_assert_lf(kll_sketch_percentile(pa, 100.0, TRUE) == n - 1);
+
+	kll_sketch_free(pa);
+	kll_sketch_free(pb);
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_hyperloglog() {
+	char buf[32];
+
+	// Nearly exact while sparse; repeats don't count.
+	hyperloglog_t* phll = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	mu_assert_lf(hyperloglog_count(phll) == 0LL);
+	for (int i = 0; i < 3000; i++) {
+		sprintf(buf, "%d", i % 1000);
+		hyperloglog_add_string(phll, buf);
+	}
+	mu_assert_lf(phll->pregisters == NULL);
+	printf("hll sparse count of 1000: %lld\n", hyperloglog_count(phll));
+	mu_assert_lf(llabs(hyperloglog_count(phll) - 1000LL) <= 2LL);
+	hyperloglog_free(phll);
+
+	// Dense: overlapping halves, merged.
+	int n = 1000000;
+	hyperloglog_t* pa = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	hyperloglog_t* pb = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	for (int i = 0; i < n; i++) {
+		sprintf(buf, "x%d", i);
+		if (i < 6*n/10)
+			hyperloglog_add_string(pa, buf);
+		if (i >= 4*n/10)
+			hyperloglog_add_string(pb, buf);
+	}
+	mu_assert_lf(pa->pregisters != NULL);
+	long long count_a = hyperloglog_count(pa);
+	printf("hll dense count of %d: %lld\n", 6*n/10, count_a);
+	mu_assert_lf(llabs(count_a - 6*n/10) < 0.02 * n);
+	hyperloglog_merge(pa, pb);
+	long long count = hyperloglog_count(pa);
+	printf("hll merged count of %d: %lld\n", n, count);
+	mu_assert_lf(llabs(count - n) < 0.02 * n);
+	hyperloglog_free(pa);
+	hyperloglog_free(pb);
+
+	// Sparse into sparse stays sparse, and is the same as adding to one.
+	pa = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	pb = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	hyperloglog_t* pc = hyperloglog_alloc(HYPERLOGLOG_DEFAULT_PRECISION);
+	for (int i = 0; i < 500; i++) {
+		sprintf(buf, "%d", i);
+		hyperloglog_add_string((i < 300) ? pa : pb, buf);
+		hyperloglog_add_string(pc, buf);
+	}
+	hyperloglog_merge(pa, pb);
+	mu_assert_lf(pa->pregisters == NULL);
+	mu_assert_lf(hyperloglog_count(pa) == hyperloglog_count(pc));
+	hyperloglog_free(pa);
+	hyperloglog_free(pb);
+	hyperloglog_free(pc);
+
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static char* test_hyperloglog_hex() {
+	char buf[32];
+
+	// Sparse and dense sketches survive the round trip, and merging decoded
+	// sketches is the same as merging the originals.
+	hyperloglog_t* pa = hyperloglog_alloc(12);
+	hyperloglog_t* pb = hyperloglog_alloc(12);
+	for (int i = 0; i < 20000; i++) {
+		sprintf(buf, "%d", i);
+		if (i < 100)
+			hyperloglog_add_string(pa, buf);
+		if (i >= 50)
+			hyperloglog_add_string(pb, buf);
+	}
+	mu_assert_lf(pa->pregisters == NULL);
+	mu_assert_lf(pb->pregisters != NULL);
+
+	char* hex_a = hyperloglog_to_hex(pa);
+	char* hex_b = hyperloglog_to_hex(pb);
+	mu_assert_lf(strncmp(hex_a, "010c00", 6) == 0);
+	mu_assert_lf(strncmp(hex_b, "010c01", 6) == 0);
+	mu_assert_lf(strlen(hex_b) == 6 + 2 * 4096);
+
+	hyperloglog_t* pa2 = hyperloglog_from_hex(hex_a);
+	hyperloglog_t* pb2 = hyperloglog_from_hex(hex_b);
+	mu_assert_lf(pa2 != NULL && pa2->precision == 12 && pa2->pregisters == NULL);
+	mu_assert_lf(pb2 != NULL && pb2->precision == 12 && pb2->pregisters != NULL);
+	mu_assert_lf(hyperloglog_count(pa2) == hyperloglog_count(pa));
+	mu_assert_lf(hyperloglog_count(pb2) == hyperloglog_count(pb));
+	char* hex_a2 = hyperloglog_to_hex(pa2);
+	mu_assert_lf(streq(hex_a2, hex_a));
+	free(hex_a2);
+
+	hyperloglog_merge(pa, pb);
+	hyperloglog_merge(pa2, pb2);
+	mu_assert_lf(hyperloglog_count(pa2) == hyperloglog_count(pa));
+
+	// Malformed input
+	mu_assert_lf(hyperloglog_from_hex("") == NULL);
+	mu_assert_lf(hyperloglog_from_hex("010c0") == NULL);
+	mu_assert_lf(hyperloglog_from_hex("020c00") == NULL);
+	mu_assert_lf(hyperloglog_from_hex("011f00") == NULL);
+	mu_assert_lf(hyperloglog_from_hex("010c02") == NULL);
+	mu_assert_lf(hyperloglog_from_hex("010c000000") == NULL);
+	mu_assert_lf(hyperloglog_from_hex("010c00000000zz") == NULL);
+	mu_assert_lf(hyperloglog_from_hex("010c0000000000") == NULL); // rho 0
+	mu_assert_lf(hyperloglog_from_hex("010c01") == NULL);
+	hex_b[7] = 'x';
+	mu_assert_lf(hyperloglog_from_hex(hex_b) == NULL);
+
+	hyperloglog_t* pempty = hyperloglog_from_hex("010c00");
+	mu_assert_lf(pempty != NULL && hyperloglog_count(pempty) == 0LL);
+
+	hyperloglog_free(pempty);
+	free(hex_a);
+	free(hex_b);
+	hyperloglog_free(pa);
+	hyperloglog_free(pb);
+	hyperloglog_free(pa2);
+	hyperloglog_free(pb2);
+
+	return NULL;
+}
+
+// ----------------------------------------------------------------
+static space_saving_counter_t* space_saving_counter_for(space_saving_t* pss, char* key) {
+	for (int i = 0; i < pss->num_counters; i++)
+		if (streq(pss->pcounters[i].pkey->phead->value, key))
+			return &pss->pcounters[i];
+	return NULL;
+}
+
+static char* test_space_saving() {
+	char buf[32];
+
+	// Exact while there are no more keys than counters.
+	space_saving_t* pss = space_saving_alloc(10);
+	for (int i = 0; i < 100; i++) {
+		sprintf(buf, "%d", i % 4);
+		slls_t* pkey = slls_single_no_free(buf);
+		space_saving_add(pss, pkey, slls_hash_func(pkey));
+		slls_free(pkey);
+	}
+	mu_assert_lf(pss->num_counters == 4);
+	for (int i = 0; i < pss->num_counters; i++) {
+		mu_assert_lf(pss->pcounters[i].count == 25LL);
+		mu_assert_lf(pss->pcounters[i].error == 0LL);
+	}
+	space_saving_free(pss);
+
+	// Three heavy hitters among many singletons, with 50 counters. Each
+	// singleton evicts another, so the hash table sees many removals.
+	int n = 100000;
+	pss = space_saving_alloc(50);
+	long long true_counts[3] = { 0LL, 0LL, 0LL };
+	for (int i = 0; i < n; i++) {
+		int h = (i % 10 < 3) ? i % 10 : -1;
+		if (h >= 0) {
+			sprintf(buf, "heavy%d", h);
+			true_counts[h]++;
+		} else {
+			sprintf(buf, "light%d", i);
+		}
+		slls_t* pkey = slls_single_no_free(buf);
+		space_saving_add(pss, pkey, slls_hash_func(pkey));
+		slls_free(pkey);
+	}
+	mu_assert_lf(pss->num_counters == 50);
+	long long total = 0LL;
+	for (int i = 0; i < pss->num_counters; i++)
+		total += pss->pcounters[i].count;
+	mu_assert_lf(total == n);
+	for (int h = 0; h < 3; h++) {
+		sprintf(buf, "heavy%d", h);
+		space_saving_counter_t* pcounter = space_saving_counter_for(pss, buf);
+		mu_assert_lf(pcounter != NULL);
+		printf("space-saving %s: true %lld, count %lld, error %lld\n", buf, true_counts[h],
+			pcounter->count, pcounter->error);
+		mu_assert_lf(pcounter->count >= true_counts[h]);
+		mu_assert_lf(pcounter->count - pcounter->error <= true_counts[h]);
+		mu_assert_lf(pcounter->error <= n / 50);
+	}
+	space_saving_free(pss);
+
+	return NULL;
+}
+
 // ================================================================
 static char * run_all_tests() {
 	mu_run_test(test_slls);
@@ -875,9 +1335,17 @@ static char * run_all_tests() {
 	mu_run_test(test_lhms2v);
 	mu_run_test(test_lhmslv);
 	mu_run_test(test_lhmsmv);
+	mu_run_test(test_stored_hashes);
 	mu_run_test(test_percentile_keeper);
+	mu_run_test(test_percentile_keeper_selection);
 	mu_run_test(test_top_keeper);
 	mu_run_test(test_dheap);
+	mu_run_test(test_bloom_filter);
+	mu_run_test(test_tdigest);
+	mu_run_test(test_kll_sketch);
+	mu_run_test(test_hyperloglog);
+	mu_run_test(test_hyperloglog_hex);
+	mu_run_test(test_space_saving);
 	return 0;
 }
 
@@ -237,6 +237,62 @@ static char * test_numbers() {
 	return 0;
 }
 
+// ----------------------------------------------------------------
+// The format is examined only when it changes from one call to the next.
+static char * test_fmtnum() {
+	printf("\n");
+	printf("-- TEST_RVAL_EVALUATORS test_fmtnum ENTER\n");
+	context_t ctx = {.nr = 888, .fnr = 999, .filenum = 123, .filename = "filename-goes-here", .force_eof = FALSE,
+		.ips = "=", .ifs = ",", .irs = "\n", .ops = "=", .ofs = ",", .ors = "\n", .auto_line_term = "\n"
+	};
+
+	rval_evaluator_t* px       = rval_evaluator_alloc_from_field_name("x", TYPE_INFER_STRING_FLOAT_INT);
+	rval_evaluator_t* pf       = rval_evaluator_alloc_from_field_name("f", TYPE_INFER_STRING_FLOAT_INT);
+	rval_evaluator_t* pfmtnum  = rval_evaluator_alloc_from_fmtnum_func(px, pf);
+
+	lrec_t* prec = lrec_unbacked_alloc();
+	lhmsmv_t* ptyped_overlay = lhmsmv_alloc();
+	mlhmmv_root_t* poosvars = mlhmmv_root_alloc();
+	string_array_t* pregex_captures = NULL;
+	loop_stack_t* ploop_stack = loop_stack_alloc();
+
+	variables_t variables = (variables_t) {
+		.pinrec           = prec,
+		.ptyped_overlay   = ptyped_overlay,
+		.poosvars         = poosvars,
+		.ppregex_captures = &pregex_captures,
+		.pctx             = &ctx,
+		.ploop_stack      = ploop_stack,
+	};
+
+	char* cases[][3] = {
+		{ "3.1415926", "%.3lf",   "3.142"     },
+		{ "2.5",       "%.3lf",   "2.500"     },
+		{ "-0.0625",   "%.2lf",   "-0.06"     },
+		{ "17",        "%08llx",  "00000011"  },
+		{ "17.25",     "%lf",     "17.250000" },
+		{ "17.25",     "%.3le",   "1.725e+01" },
+		{ "17.25",     "X%.1lfY", "X17.2Y"    },
+		{ "17.25",     "%.1lf",   "17.2"      },
+	};
+	for (int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		lrec_put(prec, "x", cases[i][0], NO_FREE);
+		lrec_put(prec, "f", cases[i][1], NO_FREE);
+		mv_t val = pfmtnum->pprocess_func(pfmtnum->pvstate, &variables);
+		printf("fmtnum(%s, \"%s\") = %s\n", cases[i][0], cases[i][1], mv_describe_val(val));
+		mu_assert_lf(val.type == MT_STRING);
+		mu_assert_lf(streq(val.u.strv, cases[i][2]));
+		mv_free(&val);
+	}
+
+	lrec_put(prec, "x", "abc", NO_FREE);
+	mv_t val = pfmtnum->pprocess_func(pfmtnum->pvstate, &variables);
+	mu_assert_lf(val.type == MT_ERROR);
+
+	pfmtnum->pfree_func(pfmtnum);
+	return 0;
+}
+
 // ----------------------------------------------------------------
 static char * test_logical_and() {
 	printf("\n");
@@ -437,6 +493,7 @@ static char * all_tests() {
 	mu_run_test(test_caps);
 	mu_run_test(test_strings);
 	mu_run_test(test_numbers);
+	mu_run_test(test_fmtnum);
 	mu_run_test(test_logical_and);
 	mu_run_test(test_logical_or);
 	mu_run_test(test_logical_xor);